@@ -3,20 +3,44 @@ layout (location = 0) in vec3 aPos;
 //layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec3 aNormal;
 layout (location = 3) in vec2 aTexCoords;
+layout (location = 4) in float aDrawID; //Per instance, only fed by the indirect renderer's arena (base instance = draw index)
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+//Camera matrices, written once per frame into the stream ring and bound at block binding 0
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+};
+uniform mat3 normalMatrix; //Inverse transpose of the model, computed on the CPU
+
+//Indirect draws read their model and normal matrix from the per-draw texture buffer instead of the uniforms
+uniform bool useDrawData;
+uniform samplerBuffer drawData; //8 texels per draw: model columns (4), normal matrix columns (3), material
+uniform int drawIDBase; //Added to the draw id, used when drawing without base instance
 
 out vec3 FragPosition;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out int MaterialIndex; //Material of the draw, only meaningful with useDrawData
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
-    FragPosition = vec3(model * vec4(aPos, 1.0)); //Get the fragment's world position
-    //Normal = mat3(transpose(inverse(model))) * aNormal; //Generate the normal matrix using inverse/transpose for non-uniform scaling. This is costly though. Better to do before the shader on the CPU.
-    Normal = aNormal;
+    mat4 drawModel = model;
+    mat3 drawNormalMatrix = normalMatrix;
+    if (useDrawData) {
+        int texel = (int(aDrawID) + drawIDBase) * 8;
+        drawModel = mat4(texelFetch(drawData, texel), texelFetch(drawData, texel + 1), texelFetch(drawData, texel + 2), texelFetch(drawData, texel + 3));
+        drawNormalMatrix = mat3(texelFetch(drawData, texel + 4).xyz, texelFetch(drawData, texel + 5).xyz, texelFetch(drawData, texel + 6).xyz);
+        MaterialIndex = int(texelFetch(drawData, texel + 7).x);
+    }
+    else {
+        MaterialIndex = 0;
+    }
+
+    gl_Position = projection * view * drawModel * vec4(aPos, 1.0f);
+    FragPosition = vec3(drawModel * vec4(aPos, 1.0)); //Get the fragment's world position
+    Normal = drawNormalMatrix * aNormal; //Normal matrix handles non-uniform scaling, generated on the CPU since inverse() per vertex is costly
     TexCoords = aTexCoords;
 }
\ No newline at end of file
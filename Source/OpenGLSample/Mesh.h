@@ -4,7 +4,16 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <vector>
+#include <iostream>
 #include "texture2d.h"
+#include "meshoptimizer.h"
+#include "meshlet.h"
+#include "frustum.h"
+#include "meshsimplifier.h"
+#include "vertexformat.h"
+
+#include <thread>
+#include <atomic>
 
 //define PI
 #define M_PI 3.1415926535897932384626433832795
@@ -27,15 +36,66 @@ public:
 	//Position of the object:
 	glm::vec3 Position;
 
+	//Places the vertex data in the scene. Identity for meshes that bake their position into the vertices
+	glm::mat4 LocalTransform = glm::mat4(1.0f);
+
 	//Vector of vertices
 	vector<float> Vertices;
 
-	//VAO and VBO
-	unsigned int VAO, VBO;
+	//Read-only data the VBO was filled from when Vertices is empty (the compile time tables), nullptr otherwise
+	const float* StaticVertexData = nullptr;
+
+	//Vector of indices into Vertices, empty until the mesh is welded (drawn with glDrawArrays while empty)
+	vector<unsigned int> Indices;
+
+	//VAO, VBO and EBO (EBO is 0 for non-indexed meshes, VAO is 0 for meshes drawn through the shared VertexFormat VAO)
+	unsigned int VAO = 0, VBO = 0;
+	unsigned int EBO = 0;
+
+	//Post-transform cache miss ratio (misses per triangle) before and after OptimizeGeometry
+	float AcmrBefore = 0.0f;
+	float AcmrAfter = 0.0f;
+
+	//When true, meshes with CPU vertex data are welded into indexed meshes and optimized before upload
+	static inline bool OptimizeOnLoad = true;
+
+	//When true, OptimizeGeometry prints the ACMR before and after to the console
+	static inline bool ReportOptimization = false;
+
+	//Meshlets covering Indices in order, empty for meshes without CPU side indices
+	vector<Meshlet> Meshlets;
+
+	//True if the mesh has no open edges, only closed meshes are cone culled
+	bool MeshletsClosed = false;
 
-	//Binds the VAO associated with this object
+	//When true, indexed meshes are split into meshlets before upload
+	static inline bool BuildMeshletsOnLoad = true;
+
+	//When true, meshes constructed from now on only build their CPU data (no GL calls, so they can be built on a worker
+	//thread) and wait for UploadDeferred on the GL thread
+	static inline bool DeferUpload = false;
+
+	//DeferUpload for the calling thread only, for threads that build meshes while the GL thread keeps drawing (the world streamer)
+	static inline thread_local bool DeferUploadOnThread = false;
+
+	//Simplified levels of detail (LOD0 is Indices itself), filled by GenerateLods
+	vector<MeshLod> Lods;
+
+	//Draw calls issued by all meshes since the last reset (a glMultiDrawElements counts as one)
+	static inline unsigned int DrawCalls = 0;
+
+	//Bounding sphere of the vertex data (object space), used for LOD selection
+	glm::vec3 BoundsCenter = glm::vec3(0.0f);
+	float BoundsRadius = 0.0f;
+
+	//Binds the VAO associated with this object, or the shared one with this object's buffers
 	void BindVAO() {
-		glBindVertexArray(VAO);
+		if (VAO) {
+			glBindVertexArray(VAO);
+		}
+		else {
+			VertexFormat::Bind(VBO, EBO);
+		}
 	}
 
 	//Draws the object
@@ -43,6 +103,223 @@ public:
 
 		//Bind Vert Array
 		BindVAO();
+		BindTextures();
+
+		//Render the object
+		DrawCalls++;
+		if (IndexCount > 0) {
+			glDrawElements(GL_TRIANGLES, IndexCount, GL_UNSIGNED_INT, (void*)0);
+		}
+		else {
+			glDrawArrays(GL_TRIANGLES, 0, VertexCount);
+		}
+	}
+
+	//Draws the meshlets that pass the frustum test and, on closed meshes, the normal cone test (perspective only, see
+	//MeshletCuller::IsVisible).
+	//Survivors next to each other in the index buffer are merged, the rest go out in one glMultiDrawElements.
+	//Meshes without meshlets fall back to Draw
+	void DrawCulled(const Frustum& frustum, const glm::vec3& cameraPosition, const glm::mat4& model, bool coneCulling = true) {
+		if (Meshlets.empty() || IndexCount == 0) {
+			Draw();
+			return;
+		}
+
+		glm::mat3 normalMatrix = GetNormalMatrix(model);
+		float maxScale = MeshletCuller::MaxScale(model);
+		bool useCone = coneCulling && MeshletsClosed;
+
+		drawCounts.clear();
+		drawOffsets.clear();
+		unsigned int rangeEnd = ~0u;
+
+		for (const Meshlet& meshlet : Meshlets) {
+			MeshletCuller::MeshletsTested++;
+			MeshletCuller::TrianglesTested += meshlet.TriangleCount;
+
+			if (!MeshletCuller::IsVisible(meshlet, model, normalMatrix, maxScale, frustum, cameraPosition, useCone)) {
+				continue;
+			}
+
+			MeshletCuller::MeshletsDrawn++;
+			MeshletCuller::TrianglesDrawn += meshlet.TriangleCount;
+
+			if (meshlet.IndexOffset == rangeEnd) {
+				drawCounts.back() += meshlet.TriangleCount * 3;
+			}
+			else {
+				drawCounts.push_back(meshlet.TriangleCount * 3);
+				drawOffsets.push_back(reinterpret_cast<const void*>(static_cast<size_t>(meshlet.IndexOffset) * sizeof(unsigned int)));
+			}
+			rangeEnd = meshlet.IndexOffset + meshlet.TriangleCount * 3;
+		}
+
+		if (drawCounts.empty()) {
+			return;
+		}
+
+		BindVAO();
+		BindTextures();
+		DrawCalls++;
+		glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), static_cast<GLsizei>(drawCounts.size()));
+	}
+
+	//Draws a level of detail, 0 (or a level that does not exist) draws the full mesh
+	void DrawLod(int level) {
+		if (level <= 0 || level > static_cast<int>(Lods.size())) {
+			Draw();
+			return;
+		}
+
+		const MeshLod& lod = Lods[level - 1];
+		BindVAO();
+		BindTextures();
+		DrawCalls++;
+		glDrawElements(GL_TRIANGLES, lod.IndexCount, GL_UNSIGNED_INT, reinterpret_cast<const void*>(static_cast<size_t>(lod.IndexOffset) * sizeof(unsigned int)));
+	}
+
+	//Returns the coarsest level whose error covers at most maxPixelError pixels on screen.
+	//pixelsPerUnit is the screen height over 2 * tan(fov / 2), i.e. the pixel size of one unit at distance 1
+	int SelectLod(const glm::mat4& model, const glm::vec3& cameraPosition, float pixelsPerUnit, float maxPixelError = 1.0f) {
+		if (Lods.empty()) {
+			return 0;
+		}
+
+		float scale = MeshletCuller::MaxScale(model);
+		float distance = glm::length(glm::vec3(model * glm::vec4(BoundsCenter, 1.0f)) - cameraPosition) - BoundsRadius * scale;
+		if (distance <= 0.0f) {
+			return 0;
+		}
+
+		int level = 0;
+		for (int i = 0; i < static_cast<int>(Lods.size()); i++) {
+			if (Lods[i].Error * scale / distance * pixelsPerUnit <= maxPixelError) {
+				level = i + 1;
+			}
+		}
+		return level;
+	}
+
+	//Simplifies the CPU data into LODs at the given triangle ratios (CPU only, safe to run on a worker thread).
+	//Call UploadLods on the GL thread afterwards
+	void GenerateLods(const vector<float>& ratios) {
+		Lods.clear();
+		if (Indices.empty()) {
+			return;
+		}
+
+		ComputeBounds(Vertices.data(), Vertices.size());
+
+		Lods = MeshSimplifier::BuildLodChain(Vertices, numVertexAttributes, Indices, ratios);
+
+		//Each LOD gets the same cache order as LOD0
+		for (MeshLod& lod : Lods) {
+			lod.Indices = MeshOptimizer::OptimizeVertexCache(lod.Indices, static_cast<int>(Vertices.size() / numVertexAttributes));
+		}
+	}
+
+	//Uploads a mesh that was built with DeferUpload, call on the GL thread
+	void UploadDeferred() {
+		if (!uploadPending) {
+			return;
+		}
+
+		uploadPending = false;
+		GenerateVertexArrayAndBuffer(Vertices.data(), static_cast<int>(Vertices.size() / numVertexAttributes),
+			Indices.empty() ? nullptr : Indices.data(), static_cast<int>(Indices.size()));
+	}
+
+	//Uploads CPU data that is already optimized and split into meshlets (e.g. read back by the MeshCache). Waits for
+	//UploadDeferred like the constructors when DeferUpload is set
+	void UploadPrepared() {
+		if (DeferUpload || DeferUploadOnThread) {
+			uploadPending = true;
+			return;
+		}
+
+		GenerateVertexArrayAndBuffer(Vertices.data(), static_cast<int>(Vertices.size() / numVertexAttributes),
+			Indices.empty() ? nullptr : Indices.data(), static_cast<int>(Indices.size()));
+	}
+
+	//Re-uploads the index buffer as LOD0 followed by every LOD
+	void UploadLods() {
+		if (!EBO || Lods.empty()) {
+			return;
+		}
+
+		vector<unsigned int> combined = Indices;
+		for (MeshLod& lod : Lods) {
+			lod.IndexOffset = static_cast<int>(combined.size());
+			lod.IndexCount = static_cast<int>(lod.Indices.size());
+			combined.insert(combined.end(), lod.Indices.begin(), lod.Indices.end());
+		}
+
+		//Same buffer name, so the VAO (own or shared) keeps pointing at it
+		glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+		glBufferData(GL_COPY_WRITE_BUFFER, combined.size() * sizeof(unsigned int), combined.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	//Bytes of vertex and index data (LODs included) the mesh uploads, 0 once ReleaseGeometryData has run
+	size_t GeometryBytes() const {
+		size_t indices = Indices.size();
+		for (const MeshLod& lod : Lods) {
+			indices += lod.Indices.size();
+		}
+		return Vertices.size() * sizeof(float) + indices * sizeof(unsigned int);
+	}
+
+	//Frees the CPU copies of the vertices and indices (LODs included) once everything is uploaded. Drawing only needs the
+	//buffers, the meshlets, the LOD ranges and the bounds; the mesh can no longer be batched, registered or optimized
+	void ReleaseGeometryData() {
+		Vertices = vector<float>();
+		Indices = vector<unsigned int>();
+		for (MeshLod& lod : Lods) {
+			lod.Indices = vector<unsigned int>();
+		}
+	}
+
+	//Generates the LODs for a set of meshes, one mesh per worker thread at a time, then uploads them on the calling thread.
+	//Every mesh is simplified on its own data, so the results are the same whatever the thread count
+	static void GenerateLods(const vector<Mesh*>& meshes, const vector<float>& ratios, unsigned int threadCount = std::thread::hardware_concurrency()) {
+		threadCount = glm::clamp(threadCount, 1u, static_cast<unsigned int>(glm::max<size_t>(meshes.size(), 1)));
+
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t i = next++; i < meshes.size(); i = next++) {
+				meshes[i]->GenerateLods(ratios);
+			}
+		};
+
+		vector<std::thread> workers;
+		for (unsigned int t = 1; t < threadCount; t++) {
+			workers.emplace_back(worker);
+		}
+		worker();
+		for (std::thread& thread : workers) {
+			thread.join();
+		}
+
+		for (Mesh* mesh : meshes) {
+			mesh->UploadLods();
+		}
+	}
+
+	//Splits the indexed CPU data into meshlets and reorders Indices to match. Call after OptimizeGeometry so the meshlets are seeded in cache order
+	void BuildMeshlets() {
+		if (Indices.empty()) {
+			return;
+		}
+
+		//Meshlet order changes the triangle order, so refresh the fetch order and the ACMR to match
+		Meshlets = MeshletBuilder::Build(Indices, Vertices, numVertexAttributes);
+		MeshletsClosed = MeshletBuilder::IsClosed(Indices, Vertices, numVertexAttributes);
+		MeshOptimizer::OptimizeVertexFetch(Vertices, numVertexAttributes, Indices);
+		AcmrAfter = MeshOptimizer::CalculateACMR(Indices, static_cast<int>(Vertices.size() / numVertexAttributes));
+	}
+
+	//Binds the base and overlay textures
+	void BindTextures() {
 
 		if (DiffuseTexture.Texture && SpecularTexture.Texture)
 		{
@@ -69,15 +346,46 @@ public:
 			glActiveTexture(GL_TEXTURE3);
 			glBindTexture(GL_TEXTURE_2D, 0);
 		}
-
-		//Render the object
-		glDrawArrays(GL_TRIANGLES, 0, (Vertices.size() / numVertexAttributes));
 	}
 
-	//De-allocates the resources associated with the VAO/VBO
+	//De-allocates the resources associated with the VAO/VBO/EBO
 	void DeallocateVertexArrayBuffers() {
-		glDeleteVertexArrays(1, &VAO);
+		if (VAO) {
+			glDeleteVertexArrays(1, &VAO);
+		}
 		glDeleteBuffers(1, &VBO);
+		if (EBO) {
+			glDeleteBuffers(1, &EBO);
+		}
+	}
+
+	//Welds the vertex data into an indexed mesh (if it is not already), then reorders triangles for the vertex cache and overdraw
+	//and the vertices for fetch locality. Runs on the CPU data, so call before the mesh is uploaded.
+	void OptimizeGeometry() {
+		if (Vertices.empty()) {
+			return;
+		}
+
+		if (Indices.empty()) {
+			vector<float> soup;
+			soup.swap(Vertices);
+			MeshOptimizer::WeldVertices(soup, numVertexAttributes, Vertices, Indices);
+		}
+
+		int uniqueVertices = static_cast<int>(Vertices.size() / numVertexAttributes);
+		AcmrBefore = MeshOptimizer::CalculateACMR(Indices, uniqueVertices);
+
+		vector<unsigned int> clusters;
+		Indices = MeshOptimizer::OptimizeVertexCache(Indices, uniqueVertices, MeshOptimizer::DefaultCacheSize, &clusters);
+		Indices = MeshOptimizer::OptimizeOverdraw(Indices, Vertices, numVertexAttributes, clusters);
+		MeshOptimizer::OptimizeVertexFetch(Vertices, numVertexAttributes, Indices);
+
+		AcmrAfter = MeshOptimizer::CalculateACMR(Indices, static_cast<int>(Vertices.size() / numVertexAttributes));
+
+		if (ReportOptimization) {
+			std::cout << "MESH::OPTIMIZED::TRIS " << Indices.size() / 3 << " VERTS " << Vertices.size() / numVertexAttributes
+				<< " ACMR " << AcmrBefore << " -> " << AcmrAfter << std::endl;
+		}
 	}
 
 	//Sets the base textures
@@ -100,21 +408,81 @@ public:
 		return (OverlayDiffuseTexture.Texture != 0 || OverlaySpecularTexture.Texture != 0) ? 1 : 0;
 	}
 
+	//Returns true if both meshes bind the same textures with the same shininess, so they can share a draw
+	bool SameMaterial(Mesh& other)
+	{
+		return DiffuseTexture.Texture == other.DiffuseTexture.Texture && SpecularTexture.Texture == other.SpecularTexture.Texture
+			&& OverlayDiffuseTexture.Texture == other.OverlayDiffuseTexture.Texture && OverlaySpecularTexture.Texture == other.OverlaySpecularTexture.Texture
+			&& GetShininess() == other.GetShininess();
+	}
+
+	//Takes the textures (and so the shininess) of another mesh
+	void CopyMaterial(Mesh& other)
+	{
+		SetTextures(other.DiffuseTexture, other.SpecularTexture);
+		SetOverlayTextures(other.OverlayDiffuseTexture, other.OverlaySpecularTexture);
+	}
+
+	//Returns the number of vertices uploaded
+	int GetVertexCount()
+	{
+		return VertexCount;
+	}
+
+	//Returns the number of triangles uploaded
+	int GetTriangleCount()
+	{
+		return (IndexCount > 0) ? IndexCount / 3 : VertexCount / 3;
+	}
+
+	//Returns the position of a triangle corner from the CPU side data, indexed or not
+	glm::vec3 GetTriangleCorner(int triangle, int corner)
+	{
+		size_t vertex = Indices.empty() ? static_cast<size_t>(triangle * 3 + corner) : Indices[triangle * 3 + corner];
+		const float* data = &Vertices[vertex * numVertexAttributes];
+		return glm::vec3(data[0], data[1], data[2]);
+	}
+
+	//Returns the normal matrix for a model matrix (inverse transpose, handles the non-uniform scaling of LocalTransform)
+	static glm::mat3 GetNormalMatrix(const glm::mat4& model)
+	{
+		return glm::transpose(glm::inverse(glm::mat3(model)));
+	}
+
 	//Returns the shininess of the base texture
 	float GetShininess()
 	{
 		return DiffuseTexture.GetShininess();
 	}
 
+	//Returns the GL names of the material textures (0 if not set)
+	unsigned int GetDiffuseTexture() { return DiffuseTexture.Texture; }
+	unsigned int GetSpecularTexture() { return SpecularTexture.Texture; }
+	unsigned int GetOverlayDiffuseTexture() { return OverlayDiffuseTexture.Texture; }
+	unsigned int GetOverlaySpecularTexture() { return OverlaySpecularTexture.Texture; }
+
 protected:
 	const int numVertexAttributes = 11;
 
+	//Number of vertices uploaded to the VBO
+	int VertexCount = 0;
+
+	//Number of indices uploaded to the EBO
+	int IndexCount = 0;
+
+	//Built with DeferUpload and not uploaded yet
+	bool uploadPending = false;
+
 	//Textures
 	Texture2D DiffuseTexture;
 	Texture2D SpecularTexture;
 	Texture2D OverlayDiffuseTexture;
 	Texture2D OverlaySpecularTexture;
 
+	//Draw ranges reused by DrawCulled each frame
+	vector<GLsizei> drawCounts;
+	vector<const void*> drawOffsets;
+
 	//Helper function to add the vertices
 	void AddVertex(float x, float y, float z, const glm::vec3& color, const glm::vec3& normals, float u, float v) {
 		Vertices.push_back(x);
@@ -147,6 +515,56 @@ protected:
 
 	//Generates the VAO and VBO for the object
 	void GenerateVertexArrayAndBuffer() {
+		if (OptimizeOnLoad) {
+			OptimizeGeometry();
+		}
+
+		if (BuildMeshletsOnLoad) {
+			BuildMeshlets();
+		}
+
+		if (DeferUpload || DeferUploadOnThread) {
+			uploadPending = true;
+			return;
+		}
+
+		GenerateVertexArrayAndBuffer(Vertices.data(), static_cast<int>(Vertices.size() / numVertexAttributes),
+			Indices.empty() ? nullptr : Indices.data(), static_cast<int>(Indices.size()));
+	}
+
+	//Sets BoundsCenter and BoundsRadius to the sphere around the box of the vertex positions
+	void ComputeBounds(const float* vertexData, size_t floatCount) {
+		glm::vec3 boxMin = glm::vec3(INFINITY);
+		glm::vec3 boxMax = glm::vec3(-INFINITY);
+		for (size_t i = 0; i + 2 < floatCount; i += numVertexAttributes) {
+			glm::vec3 p = glm::vec3(vertexData[i], vertexData[i + 1], vertexData[i + 2]);
+			boxMin = glm::min(boxMin, p);
+			boxMax = glm::max(boxMax, p);
+		}
+		BoundsCenter = (boxMin + boxMax) * 0.5f;
+		BoundsRadius = glm::length(boxMax - boxMin) * 0.5f;
+	}
+
+	//Generates the VAO and VBO (and EBO if there are indices) from data that can live outside the Vertices vector (e.g. the compile time tables)
+	void GenerateVertexArrayAndBuffer(const float* vertexData, int vertexCount, const unsigned int* indexData = nullptr, int indexCount = 0) {
+
+		VertexCount = vertexCount;
+		IndexCount = indexCount;
+
+		//With the shared vertex format only the buffers are needed, BindVAO attaches them
+		if (VertexFormat::IsShared()) {
+			VAO = 0;
+			glGenBuffers(1, &VBO);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+			glBufferData(GL_COPY_WRITE_BUFFER, vertexCount * numVertexAttributes * sizeof(float), vertexData, GL_STATIC_DRAW);
+			if (indexData && indexCount > 0) {
+				glGenBuffers(1, &EBO);
+				glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+				glBufferData(GL_COPY_WRITE_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+			}
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			return;
+		}
 
 		//Gen the vertex array
 		glGenVertexArrays(1, &VAO);
@@ -155,7 +573,7 @@ protected:
 		//Gen and bind the buffer
 		glGenBuffers(1, &VBO);
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, Vertices.size() * sizeof(float), &Vertices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertexCount * numVertexAttributes * sizeof(float), vertexData, GL_STATIC_DRAW);
 
 		//Configure the Buffer Attributes
 
@@ -172,6 +590,13 @@ protected:
 		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, numVertexAttributes * sizeof(float), (void*)(9 * sizeof(float)));
 		glEnableVertexAttribArray(3);
 
+		//Index buffer, stays bound to the VAO
+		if (indexData && indexCount > 0) {
+			glGenBuffers(1, &EBO);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+		}
+
 	}
 
 };
@@ -1,4 +1,16 @@
-﻿#include <glad/glad.h>
+﻿//The asset pack and the shared asset cache map memory with the Win32 API. windows.h comes first, before glad and GLFW
+//define APIENTRY and before anything can include it without NOMINMAX
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+#include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
 #include <iostream>
@@ -15,9 +27,30 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <vector>
 #include <random>
+#include <chrono>
+#include <optional>
+#include <memory>
 #include "cube.h"
 #include "texture2d.h"
 #include "sphere.h"
+#include "fixedprimitives.h"
+#include "staticbatch.h"
+#include "indirectrenderer.h"
+#include "glextensions.h"
+#include "streamring.h"
+#include "textureresidency.h"
+#include "taskgraph.h"
+#include "scenefile.h"
+#include "meshcache.h"
+#include "meshimporter.h"
+#include "worldstreamer.h"
+#include "assetpack.h"
+#include "sharedassetcache.h"
+#include "scenegraph.h"
+#include "renderobjects.h"
+#include "jobsystem.h"
+#include "renderthread.h"
+#include "benchmarks.h"
 
 //define PI
 #define M_PI 3.1415926535897932384626433832795
@@ -31,8 +64,12 @@ void scroll_callback(GLFWwindow* window, double xOffset, double yOffset);
 void key_callback(GLFWwindow* window, int key, int scanCode, int action, int mods);
 void ToggleProjectionMatrix();
 glm::mat4  ResetModelView(float angle);
+bool IsFixedSceneMesh(const SceneObject& object);
+std::shared_ptr<Mesh> CreateSceneMesh(const Scene& scene, const SceneObject& object);
+uint64_t HashSceneMesh(const Scene& scene, const SceneObject& object);
 
 // settings
+const int PointLightCount = 4; //NR_POINT_LIGHTS in sampleMultiLightFragm.glsl
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
@@ -45,6 +82,73 @@ glm::mat4 projection; //Projection matrix
 bool useDirectionalLight = true;
 bool useFlashlight = false;
 
+bool useMeshletCulling = true; //Frustum and normal cone culling of meshlets
+bool useLods = true; //Distance based level of detail
+bool useStaticBatching = true; //Draw the static meshes from the merged per-material batches
+bool useIndirect = true; //Draw the opaque pass from the shared arena with multi-draw indirect (overrides batching)
+bool useMaterialArray = true; //Indirect pass reads every material from one texture array (one draw call instead of one per material)
+
+//Static scene submit stats since the last batching toggle (kept by the render thread)
+unsigned int staticDrawCalls = 0;
+double staticSubmitMilliseconds = 0.0;
+unsigned int staticSubmitFrames = 0;
+bool reportArenaStats = false; //Print the indirect renderer's pool usage after the next frame
+bool reportTextureStats = false; //Print the resident texture levels after the next frame
+bool reportStreamingStats = false; //Print the world streamer's cells after the next frame
+bool reportBatchingStats = false; //Print the static scene submit stats from before the last batching toggle with the next frame
+bool reportMeshletStats = false; //Print what meshlet culling culled in the last frame with the next frame
+bool reportRenderThreadStats = false; //Print the simulation and render thread timings
+
+bool useWireframe = false;
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
+
+//Layout of the FrameData uniform block (std140) and its binding point
+struct FrameData
+{
+    glm::mat4 View;
+    glm::mat4 Projection;
+};
+const GLuint FrameDataBinding = 0;
+
+//A frame as the render thread gets it (see renderthread.h), built by the simulation and not changed while it is drawn:
+//the camera, the settings of the frame and the visible render objects in submission order with their transforms, so the
+//render thread never reads the camera, the toggles, the scene graph or the render objects themselves
+struct RenderDraw
+{
+    glm::mat4 Model;
+    glm::mat3 NormalMatrix;
+    uint32_t MeshId; //Index into renderMeshes
+    int Lod;
+};
+struct RenderSnapshot
+{
+    glm::mat4 View;
+    glm::mat4 Projection;
+    glm::vec3 CameraPosition;
+    glm::vec3 CameraFront;
+    float PixelsPerUnit; //For LODs and texture levels, see Mesh::SelectLod
+    int ViewportWidth;
+    int ViewportHeight;
+    bool Wireframe;
+    bool UsePerspective;
+    bool UseLods; //LODs on and a perspective projection
+    bool UseDirectionalLight;
+    bool UseFlashlight;
+    bool UseMeshletCulling;
+    bool UseStaticBatching;
+    bool UseIndirect;
+    bool UseMaterialArray;
+    bool ReportBatchingStats;
+    bool ReportMeshletStats;
+    bool ReportArenaStats;
+    bool ReportTextureStats;
+    bool ReportStreamingStats;
+    std::vector<RenderDraw> Draws; //Static objects first, the moving ones from FirstMovingDraw
+    size_t FirstMovingDraw;
+    std::vector<glm::mat4> LightModels; //Marker cube of each scene light
+};
+
 float lastX = SCR_WIDTH / 2;
 float lastY = SCR_HEIGHT / 2;
 bool firstMouse = true;
@@ -58,13 +162,68 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+int main(int argc, char* argv[])
 {
+    //Convert a text scene to the binary form and exit: --compile-scene <scene> <binary scene>
+    for (int i = 1; i + 2 < argc; i++) {
+        if (std::string(argv[i]) == "--compile-scene") {
+            Scene scene;
+            bool compiled = scene.Load(argv[i + 1]) && scene.WriteBinary(argv[i + 2]);
+            std::cout << (compiled ? "SCENE::COMPILED " : "ERROR::SCENE::NOT_COMPILED ") << argv[i + 2] << std::endl;
+            return compiled ? 0 : -1;
+        }
+    }
+
+    //Pack asset directories into one file and exit: --build-pack <pack> <directory>...
+    for (int i = 1; i + 2 < argc; i++) {
+        if (std::string(argv[i]) == "--build-pack") {
+            std::vector<std::string> directories(argv + i + 2, argv + argc);
+            return AssetPack::Build(argv[i + 1], directories) ? 0 : -1;
+        }
+    }
+
+    //Textures, shaders and scenes are read from the asset pack if there is one (--pack <path>), else from the loose files
+    std::string packPath = "assets.pack";
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--pack")
+            packPath = argv[i + 1];
+    }
+    AssetPack assetPack;
+    if (assetPack.Open(packPath)) {
+        AssetPack::Mounted = &assetPack;
+        std::cout << "ASSETPACK::MOUNTED " << packPath << " (" << assetPack.EntryCount() << " FILES)" << std::endl;
+    }
+    else {
+        std::cout << "ASSETPACK::NO PACK AT " << packPath << ", USING THE LOOSE FILES" << std::endl;
+    }
+
+    //Decoded textures and meshes are shared with the other viewers on this host (--shared-cache [name]). The first one
+    //creates the segment and fills it, the later ones map it read-only. --shared-cache-clear deletes the segment first
+    std::string sharedCacheName;
+    bool clearSharedCache = false;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--shared-cache")
+            sharedCacheName = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[i + 1] : "glviewer-assets";
+        else if (argument == "--shared-cache-clear")
+            clearSharedCache = true;
+    }
+    SharedAssetCache sharedCache;
+    if (!sharedCacheName.empty()) {
+        if (clearSharedCache)
+            SharedAssetCache::Remove(sharedCacheName);
+        if (sharedCache.Open(sharedCacheName)) {
+            SharedAssetCache::Mounted = &sharedCache;
+            std::cout << "SHAREDCACHE::" << (sharedCache.IsWriter() ? "CREATED " : "MAPPED ") << sharedCacheName << std::endl;
+        }
+        else {
+            std::cout << "ERROR::SHAREDCACHE::NOT_OPENED " << sharedCacheName << std::endl;
+        }
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
@@ -73,7 +232,14 @@ int main()
 
     // glfw window creation
     // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "My 3D Scene - Christopher Roelle", NULL, NULL);
+    //Ask for the newest context first for the optional fast paths (see glextensions.h), 3.3 is the minimum
+    int contextVersions[][2] = { { 4, 6 }, { 4, 3 }, { 3, 3 } };
+    GLFWwindow* window = NULL;
+    for (size_t i = 0; i < sizeof(contextVersions) / sizeof(contextVersions[0]) && window == NULL; i++) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, contextVersions[i][0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, contextVersions[i][1]);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "My 3D Scene - Christopher Roelle", NULL, NULL);
+    }
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -100,6 +266,59 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    GLExtensions::Load((GLADloadproc)glfwGetProcAddress);
+
+    //Run the benchmarks instead of the scene if requested
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--benchmark") {
+            RunBenchmarks();
+            glfwTerminate();
+            return 0;
+        }
+    }
+
+    //Scene layout, text or binary (--scene <path> to load another one)
+    std::string scenePath = "scenes/candles.scene";
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--scene")
+            scenePath = argv[i + 1];
+    }
+    Scene scene;
+    auto sceneStart = std::chrono::high_resolution_clock::now();
+    if (!scene.Load(scenePath))
+    {
+        std::cout << "Failed to load scene " << scenePath << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    std::cout << "SCENE::LOADED " << scenePath << " (" << scene.Objects.size() << " OBJECTS, " << scene.Instances.size() << " INSTANCES) IN "
+        << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sceneStart).count() << " ms" << std::endl;
+    if (scene.Lights.size() > PointLightCount)
+        std::cout << "SCENE::ONLY THE FIRST " << PointLightCount << " LIGHTS ARE USED" << std::endl;
+
+    //With --stream the static objects are loaded by distance to the camera instead of at startup (see worldstreamer.h).
+    //Prototype parts are drawn by every instance and the fixed primitives are compile time data, those always load here
+    bool streamWorld = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--stream")
+            streamWorld = true;
+    }
+    std::vector<size_t> streamedObjects;
+    std::vector<bool> loadAtStartup(scene.Objects.size(), true);
+    std::vector<bool> textureAtStartup(scene.Textures.size(), !streamWorld);
+    for (size_t i = 0; i < scene.Objects.size(); i++) {
+        const SceneObject& object = scene.Objects[i];
+        if (streamWorld && object.Prototype < 0 && !IsFixedSceneMesh(object)) {
+            streamedObjects.push_back(i);
+            loadAtStartup[i] = false;
+            continue;
+        }
+        const SceneMaterial& material = scene.Materials[object.Material];
+        for (int32_t texture : { material.Diffuse, material.Specular, material.OverlayDiffuse, material.OverlaySpecular }) {
+            if (texture >= 0)
+                textureAtStartup[texture] = true;
+        }
+    }
 
     //Enable depth testing (will stay on until we disable with) glDisable(GL_DEPTH_TEST);
     glEnable(GL_DEPTH_TEST);
@@ -108,153 +327,361 @@ int main()
     //glEnable(GL_CULL_FACE);
     //glCullFace(GL_BACK);
 
+    //Startup runs as a task graph: file reads, decoding, tessellation and simplification on worker threads, GL work
+    //(shader submission, uploads) on this thread as soon as its inputs are ready. The timeline goes to startup_trace.json
+    TaskGraph startup;
+
     // build and compile our shader program
     // ------------------------------------
-    Shader lightCubeSampleShader("shaderfiles/lightCubeVertex.glsl", "shaderfiles/lightCubeFragm.glsl");
-    Shader multiLightShader("shaderfiles/sampleMultiLightVertex.glsl", "shaderfiles/sampleMultiLightFragm.glsl");
+    //Linked programs are cached on disk, a cold start compiles from source and a warm start loads the binaries.
+    //Both are only submitted here (deferred), the driver builds them while the textures and meshes load
+    std::optional<Shader> lightCubeProgram, multiLightProgram;
+    startup.Add("Submit shaders", TASK_MAIN, [&]() {
+        lightCubeProgram.emplace("shaderfiles/lightCubeVertex.glsl", "shaderfiles/lightCubeFragm.glsl", "", true);
+        multiLightProgram.emplace("shaderfiles/sampleMultiLightVertex.glsl", "shaderfiles/sampleMultiLightFragm.glsl", "", true);
+    });
+
+    //Per-frame uniform blocks, room for a few in each frame
+    GLsizeiptr uniformAlignment = StreamRing::UniformAlignment();
+    StreamRing frameStream = StreamRing(GL_UNIFORM_BUFFER, 4 * uniformAlignment + 4 * sizeof(FrameData));
 
     //Texture stuff
-    //Generate and store textures (Default constructor: FilePath, hasAlphaChannel), Texture2D.Texture to return the texture data
-    Texture2D groundPlaneDiffuseTexture = Texture2D("textures/blackWood-diffuse.jpg", false);
-    Texture2D groundPlaneSpecularTexture = Texture2D("textures/blackWood-specular.jpg", false);
-
-    Texture2D ceramicDiffuseTexture = Texture2D("textures/ceramicJar-diffuse.jpg", false);
-    Texture2D ceramicBlackDiffuseTexture = Texture2D("textures/ceramicJarBlack-diffuse.jpg", false);
-    Texture2D ceramicSpecularTexture = Texture2D("textures/ceramicJar-specular.png", true);
-
-    Texture2D waxDiffuseTexture = Texture2D("textures/wax-diffuse.jpg", false);
-    Texture2D waxSpecularTexture = Texture2D("textures/wax-specular.jpg", false);
+    //Textures are loaded through the residency manager: coarse mips at load, finer ones streamed in as objects get close.
+    //Decoded and mipmapped on a worker, uploaded here
+    TextureResidency textureResidency = TextureResidency(64 * 1024 * 1024);
+    std::vector<Texture2D> sceneTextures(scene.Textures.size());
+    for (size_t i = 0; i < scene.Textures.size(); i++) {
+        if (!textureAtStartup[i])
+            continue;
+        const char* path = scene.String(scene.Textures[i].Path);
+        bool repeatU = scene.Textures[i].RepeatU != 0; //Labels do not repeat on U
+        auto decoded = std::make_shared<TextureResidency::DecodedTexture>();
+        Texture2D* target = &sceneTextures[i];
+        int decode = startup.Add(std::string("Decode ") + path, TASK_WORKER, [decoded, path]() { *decoded = TextureResidency::Decode(path); });
+        startup.Add(std::string("Upload ") + path, TASK_MAIN, [&textureResidency, decoded, target, repeatU]() {
+            *target = textureResidency.Upload(std::move(*decoded), repeatU, true);
+        }, { decode });
+    }
 
-    Texture2D wickDiffuseTexture = Texture2D("textures/wick-diffuse.jpg", false);
-    Texture2D wickSpecularTexture = Texture2D("textures/wick-specular.jpg", false);
+    //Models
+    //Generated meshes are tessellated, optimized and simplified into LODs on a worker (Mesh::DeferUpload keeps GL out of
+    //the constructors), then uploaded here. The LOD index data goes up once both are done. The fixed primitives are
+    //compile time data with nothing to build, they are created here directly.
+    //The built meshes are kept in the MeshCache (meshcache/), later launches read them back instead of building them again
+    const char* primitiveNames[] = { "plane", "cylinder", "sphere", "fixedcylinder", "model" };
+    const std::vector<float> lodRatios = { 0.5f, 0.25f, 0.125f };
+    MeshCache::ResetStats();
+    Mesh::DeferUpload = true;
+    std::vector<std::shared_ptr<Mesh>> sceneMeshes(scene.Objects.size());
+    for (size_t i = 0; i < scene.Objects.size(); i++) {
+        const SceneObject& object = scene.Objects[i];
+        std::shared_ptr<Mesh>* slot = &sceneMeshes[i];
+        if (!loadAtStartup[i])
+            continue;
+        std::string name = std::string(primitiveNames[object.Primitive]) + " " + std::to_string(i);
+        if (IsFixedSceneMesh(object)) {
+            startup.Add("Create " + name, TASK_MAIN, [slot, &scene, &object]() { *slot = CreateSceneMesh(scene, object); });
+            continue;
+        }
 
-    Texture2D candleLabelDiffuseTexture = Texture2D("textures/label-diffuse.png", true, false, true, true, true); //Using Overload to turn off repeat of texture
-    Texture2D candleLabelSpecularTexture = Texture2D("textures/label-specular.png", true, false, true, true, true); //Using Overload to turn off repeat of texture
+        uint64_t key = MeshCache::Key(HashSceneMesh(scene, object), lodRatios);
+        auto cached = std::make_shared<bool>(false);
+        int tessellate = startup.Add("Tessellate " + name, TASK_WORKER, [slot, &scene, &object, key, cached]() {
+            std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+            *cached = MeshCache::Load(key, *mesh);
+            if (*cached)
+                mesh->UploadPrepared();
+            else
+                mesh = CreateSceneMesh(scene, object);
+            *slot = mesh;
+        });
+        int simplify = startup.Add("Simplify " + name, TASK_WORKER, [slot, &lodRatios, key, cached]() {
+            if (*cached)
+                return;
+            (*slot)->GenerateLods(lodRatios);
+            MeshCache::Store(key, **slot);
+        }, { tessellate });
+        int upload = startup.Add("Upload " + name, TASK_MAIN, [slot]() { (*slot)->UploadDeferred(); }, { tessellate });
+        startup.Add("Upload LODs " + name, TASK_MAIN, [slot]() { (*slot)->UploadLods(); }, { simplify, upload });
+    }
 
-    Texture2D silverDiffuseTexture = Texture2D("textures/silver-diffuse.jpg", false);
-    Texture2D silverSpecularTexture = Texture2D("textures/silver-specular.jpg", false);
-    silverDiffuseTexture.SetShininess(64.0f);
-    silverSpecularTexture.SetShininess(64.0f);
+    startup.Run();
+    Mesh::DeferUpload = false;
+    startup.PrintCriticalPath();
+    std::cout << "MESHCACHE::" << MeshCache::Hits << " MESHES LOADED, " << MeshCache::Misses << " BUILT" << std::endl;
+    if (SharedAssetCache::Mounted)
+        sharedCache.PrintStats();
+    startup.WriteTrace("startup_trace.json");
 
-    Texture2D pumpkinDiffuseTexture = Texture2D("textures/pumpkin-diffuse.jpg", false);
-    Texture2D pumpkinSpecularTexture = Texture2D("textures/pumpkin-specular.jpg", false);
+    Shader& lightCubeSampleShader = *lightCubeProgram;
+    Shader& multiLightShader = *multiLightProgram;
 
-    //Models
-    // 
-    // 
+    //Materials. Static objects are copied into meshes, prototype parts (the pumpkin's body and stem) are drawn per instance
     std::vector<Mesh> meshes;
+    std::vector<uint32_t> meshMaterials;
+    std::vector<std::vector<Mesh*>> prototypeParts(scene.Prototypes.size());
+    std::vector<std::vector<uint32_t>> prototypePartMaterials(scene.Prototypes.size());
+    for (size_t i = 0; i < scene.Objects.size(); i++) {
+        if (!loadAtStartup[i])
+            continue;
+        const SceneObject& object = scene.Objects[i];
+        const SceneMaterial& material = scene.Materials[object.Material];
+        Mesh& mesh = *sceneMeshes[i];
+
+        Texture2D diffuse = sceneTextures[material.Diffuse];
+        Texture2D specular = sceneTextures[material.Specular];
+        diffuse.SetShininess(material.Shininess);
+        specular.SetShininess(material.Shininess);
+        mesh.SetTextures(diffuse, specular);
+        if (material.OverlayDiffuse >= 0)
+            mesh.SetOverlayTextures(sceneTextures[material.OverlayDiffuse], sceneTextures[material.OverlaySpecular]);
+
+        if (object.Prototype < 0) {
+            meshes.push_back(mesh);
+            meshMaterials.push_back(object.Material);
+        }
+        else {
+            prototypeParts[object.Prototype].push_back(&mesh);
+            prototypePartMaterials[object.Prototype].push_back(object.Material);
+        }
+    }
 
-    // TODO:: Implement Indices to cut down on extra verts
-    // 
-    //                       Position                       len    wid
-    Plane floorPlane = Plane(glm::vec3(0.0f, -0.01f, 0.3f), 3.0f,  8.0f);
-    floorPlane.SetTextures(groundPlaneDiffuseTexture, groundPlaneSpecularTexture);
-    meshes.push_back(floorPlane);
-
-    //Candle Jar, Wax and Wicks
-    Cylinder candleJar = Cylinder(glm::vec3(0.0f,  0.0f, 0.0f), 0.5f, 0.75f, 40,   3,           false,   true); //No top, because its a candle holder
-    candleJar.SetTextures(ceramicDiffuseTexture, ceramicSpecularTexture);
-    candleJar.SetOverlayTextures(candleLabelDiffuseTexture, candleLabelSpecularTexture);
-    meshes.push_back(candleJar);
-
-    Cylinder candle = Cylinder(glm::vec3(0.0f, 0.01f, 0.0f), 0.49f, 0.3f, 40, 1, true, false);
-    candle.SetTextures(waxDiffuseTexture, waxSpecularTexture);
-    meshes.push_back(candle);
-
-    Cylinder wick1 = Cylinder(glm::vec3( 0.20f, 0.3f,  0.15f), 0.05f, 0.1f, 8, 1, true, false);
-    wick1.SetTextures(wickDiffuseTexture, wickSpecularTexture);
-    meshes.push_back(wick1);
-
-    Cylinder wick2 = Cylinder(glm::vec3(-0.20f, 0.3f,  0.15f), 0.05f, 0.1f, 8, 1, true, false);
-    wick2.SetTextures(wickDiffuseTexture, wickSpecularTexture);
-    meshes.push_back(wick2);
-
-    Cylinder wick3 = Cylinder(glm::vec3(  0.0f, 0.3f, -0.20f), 0.05f, 0.1f, 8, 1, true, false);
-    wick3.SetTextures(wickDiffuseTexture, wickSpecularTexture);
-    meshes.push_back(wick3);
-
-    //Pumpkin Holder
-    Sphere pumpkinHolderBase = Sphere(glm::vec3(1.5f, 0.0f, 0.5f), 0.4f, 0.2f, 30, true);//position, radLong, radLat, sides, semi
-    pumpkinHolderBase.SetTextures(silverDiffuseTexture, silverSpecularTexture);
-    meshes.push_back(pumpkinHolderBase);
-    Cylinder pumpkinHolderStem = Cylinder(glm::vec3(1.5f, 0.17f, 0.5f), 0.2f, 0.2f, 30, 3, false, false); //position, rad, height, sides, subdivs, draw top, draw btm
-    pumpkinHolderStem.SetTextures(silverDiffuseTexture, silverSpecularTexture);
-    meshes.push_back(pumpkinHolderStem);
-    Cylinder pumpkinHolderBody = Cylinder(glm::vec3(1.5f, 0.37f, 0.5f), 0.6f, 1.5f, 40, 3, false, true); //position, rad, height, sides, subdivs, draw top, draw btm
-    pumpkinHolderBody.SetTextures(silverDiffuseTexture, silverSpecularTexture);
-    meshes.push_back(pumpkinHolderBody);
-
-    //Pumpkin
-    Sphere pumpkinBody = Sphere(glm::vec3(0.0f, 0.0f, 0.0f), 0.4f, 0.3f, 15, false);
-    pumpkinBody.SetTextures(pumpkinDiffuseTexture, pumpkinSpecularTexture);
-    Cylinder pumpkinStem = Cylinder(glm::vec3(0.0f, 0.28f, 0.0f), 0.045f, 0.08f, 15, 3, true, false); //position, rad, height, sides, subdivs, draw top, draw btm
-    pumpkinStem.SetTextures(wickDiffuseTexture, wickSpecularTexture);
-
-    //Black Candle Jar, similar in height as the pumpkin holder.
-    Cylinder blackJar = Cylinder(glm::vec3(-1.1f, 0.0f, 0.85f), 0.6f, 1.9f, 40, 3, false, true);
-    blackJar.SetTextures(ceramicBlackDiffuseTexture, ceramicSpecularTexture);
-    meshes.push_back(blackJar);
-
-    Cube lightCube = Cube(glm::vec3(0.0f), 0.05f, 0.05f, 0.05f);
-
-
-    //Initial Set Camera Projection Matrix
-    ToggleProjectionMatrix();
-
-    //Adjust the intensity of the values
-    float keyIntensity = 1.0f;
-    float candleIntensity = 0.5f;
+    FixedCube lightCube = FixedCube(glm::vec3(0.0f), 0.05f, 0.05f, 0.05f);
 
-    glm::vec3 keyLightPosition = glm::vec3(0.0f, 3.0f, 3.0);
-    glm::vec3 keyLightColor = glm::vec3(0.3f);
-    glm::vec3 keyLightAttenuation = glm::vec3(1.0f, 0.09f, 0.032f);
+    //Streamed objects are built like the startup ones (from the MeshCache when they are in it) on the streamer's loader thread
+    WorldStreamer worldStreamer(scene, textureResidency, [&scene, &lodRatios](size_t i) {
+        const SceneObject& object = scene.Objects[i];
+        uint64_t key = MeshCache::Key(HashSceneMesh(scene, object), lodRatios);
+        std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>();
+        if (MeshCache::Load(key, *mesh)) {
+            mesh->UploadPrepared();
+            return mesh;
+        }
+        mesh = CreateSceneMesh(scene, object);
+        mesh->GenerateLods(lodRatios);
+        MeshCache::Store(key, *mesh);
+        return mesh;
+    }, streamedObjects);
+    if (streamWorld)
+        std::cout << "STREAMING::" << streamedObjects.size() << " OBJECTS STREAMED BY DISTANCE" << std::endl;
+
+    //Everything in meshes is static, merge it into one batch per material (batches draw LOD0 with meshlet culling)
+    std::vector<Mesh*> staticMeshes;
+    for (Mesh& mesh : meshes)
+        staticMeshes.push_back(&mesh);
+    std::vector<StaticBatch> staticBatches = StaticBatch::Build(staticMeshes);
+
+    //Transform hierarchy. Static meshes and the light markers are roots. The pumpkins hang off one node for the holder (the
+    //180 degree turn), each instance off that, and the first part of a prototype is the parent of the others (the stem sits
+    //on the body). World and normal matrices are only recomputed for what moved
+    SceneGraph sceneGraph;
+    std::vector<int> staticNodes;
+    for (Mesh* mesh : staticMeshes)
+        staticNodes.push_back(sceneGraph.Add(mesh->LocalTransform));
+
+    int pumpkinHolderNode = sceneGraph.Add(ResetModelView(180.0f));
+    std::vector<std::vector<int>> instanceNodes(scene.Instances.size());
+    for (size_t i = 0; i < scene.Instances.size(); i++) {
+        const SceneInstance& instance = scene.Instances[i];
+        glm::mat4 placement = glm::translate(glm::mat4(1.0f), glm::make_vec3(instance.Position));
+        placement = glm::scale(placement, glm::vec3(instance.Scale));
+        placement = glm::rotate(placement, glm::radians(instance.Angle), glm::vec3(1.0f, 0.0f, 1.0f));
+        int instanceNode = sceneGraph.Add(placement, pumpkinHolderNode);
+
+        const std::vector<Mesh*>& parts = prototypeParts[instance.Prototype];
+        for (size_t p = 0; p < parts.size(); p++) {
+            if (p == 0)
+                instanceNodes[i].push_back(sceneGraph.Add(parts[0]->LocalTransform, instanceNode));
+            else
+                instanceNodes[i].push_back(sceneGraph.Add(glm::inverse(parts[0]->LocalTransform) * parts[p]->LocalTransform, instanceNodes[i][0]));
+        }
+    }
 
-    //Point Lights
-    glm::vec3 candleLightPositions[] = {
-        glm::vec3(wick1.Position.x, wick1.Position.y + wick1.Dimensions.y, wick1.Position.z), //candle light 1
-        glm::vec3(wick2.Position.x, wick2.Position.y + wick2.Dimensions.y, wick2.Position.z), //candle light 2
-        glm::vec3(wick3.Position.x, wick3.Position.y + wick3.Dimensions.y, wick3.Position.z)  //candle light 3
-    };
+    std::vector<int> lightNodes;
+    for (const SceneLight& light : scene.Lights) {
+        glm::mat4 marker = glm::translate(glm::mat4(1.0f), glm::make_vec3(light.Position));
+        marker = glm::scale(marker, glm::vec3(light.CubeScale)); //The key light is drawn larger
+        lightNodes.push_back(sceneGraph.Add(marker * lightCube.LocalTransform));
+    }
+    sceneGraph.Update();
+    std::cout << "SCENEGRAPH::" << sceneGraph.Size() << " NODES" << std::endl;
+
+    //Opaque meshes suballocated from one arena for the indirect path
+    std::vector<Mesh*> opaqueMeshes = staticMeshes;
+    for (std::vector<Mesh*>& parts : prototypeParts)
+        opaqueMeshes.insert(opaqueMeshes.end(), parts.begin(), parts.end());
+
+    int arenaVertices = 0, arenaIndices = 0;
+    for (Mesh* mesh : opaqueMeshes)
+        GeometryArena::Measure(*mesh, arenaVertices, arenaIndices);
+
+    //Twice the scene so objects can be streamed in and out of the pools
+    IndirectRenderer indirectRenderer = IndirectRenderer(arenaVertices * 2, arenaIndices * 2, 1024);
+    std::vector<int> staticObjects;
+    for (Mesh* mesh : staticMeshes)
+        staticObjects.push_back(indirectRenderer.Register(*mesh));
+    std::vector<std::vector<int>> prototypeObjects(prototypeParts.size());
+    for (size_t p = 0; p < prototypeParts.size(); p++) {
+        for (Mesh* part : prototypeParts[p])
+            prototypeObjects[p].push_back(indirectRenderer.Register(*part));
+    }
 
-    glm::vec3 candleLightColors[] = {
-        //glm::vec3(1.0f, 1.0f, 1.0f) * keyIntensity,    //Key Light
-        glm::vec3(1.0f, 0.0f, 0.0f) * candleIntensity, //candle light 1
-        glm::vec3(0.5f, 0.5f, 0.0f) * candleIntensity, //candle light 1
-        glm::vec3(1.0f, 0.5f, 0.0f) * candleIntensity  //candle light 1
+    //Render objects (renderobjects.h): the static meshes and every pumpkin part, following their scene graph nodes.
+    //They point into renderMeshes (with the indirect renderer object of each mesh in renderArenaObjects) and the scene's
+    //materials by index. Meshes without bounds are never culled
+    std::vector<Mesh*> renderMeshes;
+    std::vector<int> renderArenaObjects;
+    RenderObjects renderObjects;
+    auto localBounds = [](const Mesh& mesh) {
+        return glm::vec4(mesh.BoundsCenter, mesh.BoundsRadius > 0.0f ? mesh.BoundsRadius : INFINITY);
     };
+    for (size_t i = 0; i < staticMeshes.size(); i++) {
+        renderObjects.Create(sceneGraph.World(staticNodes[i]), localBounds(*staticMeshes[i]), (uint32_t)renderMeshes.size(), meshMaterials[i],
+            RENDER_STATIC, staticNodes[i]);
+        renderMeshes.push_back(staticMeshes[i]);
+        renderArenaObjects.push_back(staticObjects[i]);
+    }
+    std::vector<std::vector<uint32_t>> prototypeMeshIds(prototypeParts.size());
+    for (size_t p = 0; p < prototypeParts.size(); p++) {
+        for (size_t part = 0; part < prototypeParts[p].size(); part++) {
+            prototypeMeshIds[p].push_back((uint32_t)renderMeshes.size());
+            renderMeshes.push_back(prototypeParts[p][part]);
+            renderArenaObjects.push_back(prototypeObjects[p][part]);
+        }
+    }
+    for (size_t i = 0; i < scene.Instances.size(); i++) {
+        int prototype = scene.Instances[i].Prototype;
+        for (size_t part = 0; part < prototypeParts[prototype].size(); part++) {
+            int node = instanceNodes[i][part];
+            renderObjects.Create(sceneGraph.World(node), localBounds(*prototypeParts[prototype][part]), prototypeMeshIds[prototype][part],
+                prototypePartMaterials[prototype][part], 0, node);
+        }
+    }
+    std::vector<uint32_t> visibleObjects;
+
+    //Per-frame work before drawing, as a frame graph on the job system: the scene graph and render object transforms, culling,
+    //sorting, LOD picks and the snapshot's draw list run on the workers, split further with ParallelFor. Only the GL
+    //submission is left for the render thread. The frame* values are the inputs of the frame, set before each Run
+    JobSystem jobs;
+    std::cout << "JOBS::" << jobs.ThreadCount() << " THREADS" << std::endl;
+    const size_t objectGrain = 1024;
+    Frustum frameFrustum;
+    glm::vec3 frameCamera = glm::vec3(0.0f);
+    float framePixelsPerUnit = 1.0f;
+    RenderSnapshot* frameSnapshot = nullptr;
+    std::vector<std::vector<uint32_t>> visiblePieces;
+    std::vector<std::pair<uint64_t, uint32_t>> visibleKeys;
+    std::vector<int> visibleLods;
+
+    FrameGraph frameGraph;
+    int transformTask = frameGraph.Add("Transforms", TASK_WORKER, [&]() {
+        if (sceneGraph.Update() == 0)
+            return;
+        jobs.ParallelFor(renderObjects.Size(), objectGrain, [&](size_t first, size_t last) {
+            renderObjects.SyncTransforms(sceneGraph, first, last);
+        });
+    });
+    int cullTask = frameGraph.Add("Cull", TASK_WORKER, [&]() {
+        visiblePieces.resize(JobSystem::PieceCount(renderObjects.Size(), objectGrain));
+        jobs.ParallelFor(renderObjects.Size(), objectGrain, [&](size_t first, size_t last) {
+            std::vector<uint32_t>& piece = visiblePieces[first / objectGrain];
+            piece.clear();
+            renderObjects.CullRange(frameFrustum, first, last, piece);
+        });
+        visibleObjects.clear();
+        for (const std::vector<uint32_t>& piece : visiblePieces)
+            visibleObjects.insert(visibleObjects.end(), piece.begin(), piece.end());
+    }, { transformTask });
+    //Static ones first, then grouped by material and mesh and front to back
+    int sortTask = frameGraph.Add("Sort", TASK_WORKER, [&]() {
+        visibleKeys.resize(visibleObjects.size());
+        jobs.ParallelFor(visibleObjects.size(), objectGrain, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                visibleKeys[i] = { renderObjects.SortKey(visibleObjects[i], frameCamera), visibleObjects[i] };
+        });
+        jobs.ParallelSort(visibleKeys, objectGrain);
+        for (size_t i = 0; i < visibleKeys.size(); i++)
+            visibleObjects[i] = visibleKeys[i].second;
+    }, { cullTask });
+    int lodTask = frameGraph.Add("LODs", TASK_WORKER, [&]() {
+        visibleLods.assign(visibleObjects.size(), 0);
+        if (!useLods || !usePerspective)
+            return;
+        jobs.ParallelFor(visibleObjects.size(), objectGrain, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                uint32_t index = visibleObjects[i];
+                visibleLods[i] = renderMeshes[renderObjects.MeshIds[index]]->SelectLod(renderObjects.Transforms[index], frameCamera, framePixelsPerUnit);
+            }
+        });
+    }, { sortTask });
+    //The visible objects copied into the snapshot in draw order, with the light markers
+    frameGraph.Add("Draw list", TASK_WORKER, [&]() {
+        std::vector<RenderDraw>& draws = frameSnapshot->Draws;
+        draws.resize(visibleObjects.size());
+        jobs.ParallelFor(visibleObjects.size(), objectGrain, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                uint32_t index = visibleObjects[i];
+                draws[i] = { renderObjects.Transforms[index], renderObjects.NormalMatrices[index], renderObjects.MeshIds[index], visibleLods[i] };
+            }
+        });
+        frameSnapshot->FirstMovingDraw = std::partition_point(visibleObjects.begin(), visibleObjects.end(),
+            [&renderObjects](uint32_t index) { return (renderObjects.Flags[index] & RENDER_STATIC) != 0; }) - visibleObjects.begin();
+        frameSnapshot->LightModels.clear();
+        for (int node : lightNodes)
+            frameSnapshot->LightModels.push_back(sceneGraph.World(node));
+    }, { lodTask });
+
+    //Every opaque material in one texture array, so the indirect pass is a single draw call
+    indirectRenderer.BuildMaterialArray(1024, &textureResidency);
+
+    //First use of the programs, check how they built (only waits if the driver is still busy with them)
+    bool programsReady = lightCubeSampleShader.IsReady() && multiLightShader.IsReady();
+    auto programFinishStart = std::chrono::high_resolution_clock::now();
+    lightCubeSampleShader.Finish();
+    multiLightShader.Finish();
+    std::cout << "SHADER::PROGRAMS WAITED "
+        << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - programFinishStart).count() << " ms AFTER LOADING ("
+        << (programsReady ? "ALREADY DONE" : "STILL BUILDING") << ", " << (ProgramCache::Misses == 0 && ProgramCache::Hits > 0 ? "WARM" : "COLD") << ", "
+        << ProgramCache::Hits << " FROM CACHE, " << ProgramCache::Misses << " COMPILED)" << std::endl;
+
+    //The per-draw data sampler needs its own unit even when unused, a buffer and a 2D sampler can not share one
+    multiLightShader.use();
+    multiLightShader.setInt("drawData", IndirectRenderer::DrawDataUnit);
+    multiLightShader.setInt("materialTextures", IndirectRenderer::MaterialArrayUnit);
+    glUniformBlockBinding(multiLightShader.ID, glGetUniformBlockIndex(multiLightShader.ID, "FrameData"), FrameDataBinding);
 
-    //CONSTANT, LINEAR, QUADRATIC
-    glm::vec3 candleLightAttenuations[]{
-        glm::vec3(1.0f, 0.1f, 7.8f),
-        glm::vec3(1.0f, 0.1f, 7.8f),
-        glm::vec3(1.0f, 0.1f, 7.8f)
-    };
-    
+    //Initial Set Camera Projection Matrix
+    ToggleProjectionMatrix();
 
-    //TODO::ADD ATTENUATION ARRAY FOR THE POINT LIGHTS
+    //GL submission runs on its own thread (--single-thread to keep it on this one). This thread keeps the window: it polls
+    //the events, runs the input and the frame graph and fills a snapshot of the frame, which the render thread draws while
+    //this one goes on with the next frame. --render-buffers 3 lets the simulation get one frame further ahead
+    bool useRenderThread = true;
+    unsigned int renderBuffers = 2;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--single-thread")
+            useRenderThread = false;
+        else if (argument == "--render-buffers" && i + 1 < argc)
+            renderBuffers = (unsigned int)std::max(std::atoi(argv[i + 1]), 2);
+    }
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window))
+    //Draws one snapshot, on the thread holding the GL context
+    auto renderFrame = [&](const RenderSnapshot& frame)
     {
-        //Delta Time stuff
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
+        //Load and free streamed cells around the camera, uploads within the per-frame budget
+        worldStreamer.Update(frame.CameraPosition);
 
         // render
         // ------
+        glViewport(0, 0, frame.ViewportWidth, frame.ViewportHeight);
+        glPolygonMode(GL_FRONT_AND_BACK, frame.Wireframe ? GL_LINE : GL_FILL);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); //GL_DEPTH_BUFFER_BIT to clear depth info from prev. frame.
 
         //Generate transforms
         glm::mat4 model = glm::mat4(1.0f); //Create the Model Matrix (for rendering in 3D) [MOVED BELOW FOR MULTI POSITION]
-        float rotationAngle = 0.0f;
-        glm::vec3 transformAxis = glm::vec3(0.0f);
 
         /*
         * =====================
@@ -262,11 +689,10 @@ int main()
         * =====================
         */
 
-        glm::mat4 view = camera.GetViewMatrix();
         multiLightShader.use(); //Primary Shader
 
         //Set the viewer's position (the camera)
-        multiLightShader.setVec3("viewPos", camera.Position);
+        multiLightShader.setVec3("viewPos", frame.CameraPosition);
 
         //Set the material
         multiLightShader.setInt("material.diffuse", 0);
@@ -283,36 +709,36 @@ int main()
         glBindTexture(GL_TEXTURE_2D, 0);
 
         //Set the Directional Light
-        multiLightShader.setBool("dirLight.useDirectionalLight", useDirectionalLight);     //Toggles the calculations for directional lights
+        multiLightShader.setBool("dirLight.useDirectionalLight", frame.UseDirectionalLight);     //Toggles the calculations for directional lights
         multiLightShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f); //Direction of the light
         multiLightShader.setVec3("dirLight.ambient", 0.2f, 0.2f, 0.2f);   //Set low to not overbear
         multiLightShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);      //Light color
         multiLightShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);     //Color of the specular highlight
 
-        //Candle Lights
-        for (int i = 0; i < sizeof(candleLightPositions) / sizeof(candleLightPositions[0]); i++) {
-            multiLightShader.setVec3("pointLights[" + std::to_string(i) + "].position", candleLightPositions[i]); //Light Position
-            multiLightShader.setVec3("pointLights[" + std::to_string(i) + "].ambient", candleLightColors[i] / 0.5f); //Set low to not overbear
-            multiLightShader.setVec3("pointLights[" + std::to_string(i) + "].diffuse", candleLightColors[i] / 0.5f); //Light color
-            multiLightShader.setVec3("pointLights[" + std::to_string(i) + "].specular", candleLightColors[i] / 0.5f); //Color of the specular highlight
-            multiLightShader.setFloat("pointLights[" + std::to_string(i) + "].constant", candleLightAttenuations[i].x); //Attenuation Variables
-            multiLightShader.setFloat("pointLights[" + std::to_string(i) + "].linear", candleLightAttenuations[i].y); //Attenuation Variables
-            multiLightShader.setFloat("pointLights[" + std::to_string(i) + "].quadratic", candleLightAttenuations[i].z); //Attenuation Variables
+        //Point lights from the scene (the candles and the key light), slots without a light are switched off
+        for (int i = 0; i < PointLightCount; i++) {
+            std::string light = "pointLights[" + std::to_string(i) + "]";
+            glm::vec3 position = glm::vec3(0.0f);
+            glm::vec3 color = glm::vec3(0.0f);
+            glm::vec3 attenuation = glm::vec3(1.0f, 0.0f, 0.0f);
+            if (i < (int)scene.Lights.size()) {
+                position = glm::make_vec3(scene.Lights[i].Position);
+                color = glm::make_vec3(scene.Lights[i].Color);
+                attenuation = glm::make_vec3(scene.Lights[i].Attenuation);
+            }
+            multiLightShader.setVec3(light + ".position", position); //Light Position
+            multiLightShader.setVec3(light + ".ambient", color / 0.5f); //Set low to not overbear
+            multiLightShader.setVec3(light + ".diffuse", color / 0.5f); //Light color
+            multiLightShader.setVec3(light + ".specular", color / 0.5f); //Color of the specular highlight
+            multiLightShader.setFloat(light + ".constant", attenuation.x); //Attenuation Variables
+            multiLightShader.setFloat(light + ".linear", attenuation.y); //Attenuation Variables
+            multiLightShader.setFloat(light + ".quadratic", attenuation.z); //Attenuation Variables
         }
 
-        //Key light
-        multiLightShader.setVec3("pointLights[" +  std::to_string(3) + "].position", keyLightPosition); //Light Position
-        multiLightShader.setVec3("pointLights[" +  std::to_string(3) + "].ambient", keyLightColor / 0.5f); //Set low to not overbear
-        multiLightShader.setVec3("pointLights[" +  std::to_string(3) + "].diffuse", keyLightColor / 0.5f); //Light color
-        multiLightShader.setVec3("pointLights[" +  std::to_string(3) + "].specular", keyLightColor / 0.5f); //Color of the specular highlight
-        multiLightShader.setFloat("pointLights[" + std::to_string(3) + "].constant", keyLightAttenuation.x); //Attenuation Variables
-        multiLightShader.setFloat("pointLights[" + std::to_string(3) + "].linear", keyLightAttenuation.y); //Attenuation Variables
-        multiLightShader.setFloat("pointLights[" + std::to_string(3) + "].quadratic", keyLightAttenuation.z); //Attenuation Variables
-
         // SpotLight (Flashlight)
-        multiLightShader.setBool("spotLight.useSpotLight", useFlashlight);
-        multiLightShader.setVec3("spotLight.position", camera.Position); //Where the light is coming from, Flashlight, so camera
-        multiLightShader.setVec3("spotLight.direction", camera.Front); //Direction, since flashlight, itll be the front of the camera
+        multiLightShader.setBool("spotLight.useSpotLight", frame.UseFlashlight);
+        multiLightShader.setVec3("spotLight.position", frame.CameraPosition); //Where the light is coming from, Flashlight, so camera
+        multiLightShader.setVec3("spotLight.direction", frame.CameraFront); //Direction, since flashlight, itll be the front of the camera
         multiLightShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f); //Set low to not overbear
         multiLightShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f); //Light color
         multiLightShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f); //Color of the specular highlight
@@ -324,75 +750,140 @@ int main()
 
         model = glm::mat4(1.0f); //Resetting the model view
         multiLightShader.setMat4("model", model);
-        multiLightShader.setMat4("view", view);
-        multiLightShader.setMat4("projection", projection);
+        multiLightShader.setMat3("normalMatrix", glm::mat3(1.0f));
+        //Camera block for this frame, straight into the stream
+        frameStream.BeginFrame();
+        FrameData frameData = { frame.View, frame.Projection };
+        GLintptr frameDataOffset = frameStream.Write(&frameData, sizeof(FrameData), uniformAlignment);
+        frameStream.Commit();
+        glBindBufferRange(GL_UNIFORM_BUFFER, FrameDataBinding, frameStream.Buffer, frameDataOffset, sizeof(FrameData));
+
+        //Frustum for meshlet culling, world space. What the previous frame culled is printed before it is reset
+        Frustum frustum(frame.Projection * frame.View);
+        if (frame.ReportMeshletStats) {
+            std::cout << "MESHLETS::CULLING " << (frame.UseMeshletCulling ? "ON" : "OFF")
+                << " DRAWN " << MeshletCuller::MeshletsDrawn << "/" << MeshletCuller::MeshletsTested
+                << " TRIS " << MeshletCuller::TrianglesDrawn << "/" << MeshletCuller::TrianglesTested << std::endl;
+        }
+        MeshletCuller::ResetStats();
 
         /*
         * =====================
         * Draw all Objects with the multiLightShader
         * =====================
         */
-        for (Mesh mesh : meshes)
+        if (frame.ReportBatchingStats) {
+            std::cout << "BATCHING::" << (frame.UseStaticBatching ? "OFF" : "ON") << " DRAWS " << staticDrawCalls
+                << " SUBMIT " << (staticSubmitFrames ? staticSubmitMilliseconds / staticSubmitFrames : 0.0) << " ms" << std::endl;
+            staticSubmitMilliseconds = 0.0;
+            staticSubmitFrames = 0;
+        }
+        auto staticSubmitStart = std::chrono::high_resolution_clock::now();
+        Mesh::DrawCalls = 0;
+
+        //Draws one mesh on its own, for the render objects without batching or the indirect path and for the streamed meshes
+        auto drawMesh = [&](Mesh& mesh, const glm::mat4& model, const glm::mat3& normalMatrix, int lod)
         {
             //Set shader params
+            multiLightShader.setMat4("model", model);
+            multiLightShader.setMat3("normalMatrix", normalMatrix);
             multiLightShader.setBool("material.useOverlayTexture", mesh.HasOverlay());
             multiLightShader.setFloat("material.shininess", mesh.GetShininess());
 
-            mesh.Draw();
-        }        
+            //The normal cone test needs an eye point, with the orthographic projection meshlets are only frustum culled
+            if (lod > 0)
+                mesh.DrawLod(lod);
+            else if (frame.UseMeshletCulling)
+                mesh.DrawCulled(frustum, frame.CameraPosition, model, frame.UsePerspective);
+            else
+                mesh.Draw();
+        };
+
+        //Draws the snapshot's draws from first to last, or queues them for the indirect renderer
+        auto drawObjects = [&](size_t first, size_t last)
+        {
+            for (size_t d = first; d < last; d++)
+            {
+                const RenderDraw& draw = frame.Draws[d];
+                if (!frame.UseIndirect)
+                {
+                    drawMesh(*renderMeshes[draw.MeshId], draw.Model, draw.NormalMatrix, draw.Lod);
+                    continue;
+                }
+                indirectRenderer.Submit(renderArenaObjects[draw.MeshId], draw.Model, frustum, draw.Lod);
+            }
+        };
+
+        if (frame.UseIndirect)
+        {
+            //Queued here with the pumpkins, drawn by the Flush after them
+            indirectRenderer.Begin();
+            drawObjects(0, frame.FirstMovingDraw);
+        }
+        else if (frame.UseStaticBatching)
+        {
+            glm::mat4 identity = glm::mat4(1.0f);
+            multiLightShader.setMat4("model", identity);
+            multiLightShader.setMat3("normalMatrix", glm::mat3(1.0f));
+
+            for (StaticBatch& batch : staticBatches)
+            {
+                multiLightShader.setBool("material.useOverlayTexture", batch.HasOverlay());
+                multiLightShader.setFloat("material.shininess", batch.GetShininess());
+
+                if (frame.UseMeshletCulling)
+                    batch.DrawCulled(frustum, frame.CameraPosition, identity, frame.UsePerspective);
+                else
+                    batch.Draw();
+            }
+        }
+        else
+        {
+            drawObjects(0, frame.FirstMovingDraw);
+        }
+
+        //Sampled before the streamed meshes, so the batching report only counts the static scene
+        staticDrawCalls = Mesh::DrawCalls;
+        staticSubmitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - staticSubmitStart).count();
+        staticSubmitFrames++;
+
+        //Streamed cells come and go, so they are drawn one by one whatever the path above (not batched, in the arena or in
+        //the scene graph)
+        for (Mesh* mesh : worldStreamer.ResidentMeshes())
+            drawMesh(*mesh, mesh->LocalTransform, Mesh::GetNormalMatrix(mesh->LocalTransform),
+                frame.UseLods ? mesh->SelectLod(mesh->LocalTransform, frame.CameraPosition, frame.PixelsPerUnit) : 0);
 
         /*
         * =====================
         * Pumpkins
         * =====================
         */
-        //Positions of the individual pumpkins in the container.
-        glm::vec3 pumpkinPositions[]{
-            glm::vec3(-1.5f,  0.7f,  -0.5f),
-            glm::vec3(-1.4f,  1.3f,  -0.4f),
-            glm::vec3(-1.7f,  1.7f,  -0.7f),
-            glm::vec3(-1.25f, 1.9f,  -0.4f),
-            glm::vec3(-1.7f,  1.83f, -0.3f),
-            glm::vec3(-1.3f,  1.83f, -0.8f),
-        };
+        //Instances of the scene's prototypes (the pumpkins in the container), the draws after the static ones
+        drawObjects(frame.FirstMovingDraw, frame.Draws.size());
 
-        //Ratations of the individual pumpkins in the container.
-        float pumpkinRotationAngles[]{
-        0.0f,
-        15.0f,
-        -20.0f,
-        25.0f,
-        -15.0f,
-        19.0f
-        };
-
-        //Scales of the individual pumpkins in the container.
-        float pumpkinScales[]{
-            1.0f,
-            1.0f,
-            0.75f,
-            0.75f,
-            0.80f,
-            0.5f
-        };
+        //The whole opaque pass in one multi-draw per material
+        if (frame.UseIndirect) {
+            indirectRenderer.UseMaterialArray = frame.UseMaterialArray;
+            indirectRenderer.Flush(multiLightShader);
+        }
 
-        for (int i = 0; i < sizeof(pumpkinPositions) / sizeof(pumpkinPositions[0]); i++)
-        {
-            //Reset then rotate the pumpkins so that they are haphazardly placed in the jar
-            model = ResetModelView(180.0f);
-            model = glm::translate(model, pumpkinPositions[i]);
-            model = glm::scale(model, glm::vec3(pumpkinScales[i]));
-            model = glm::rotate(model, glm::radians(pumpkinRotationAngles[i]), glm::vec3(1.0f, 0.0f, 1.0f));
-            multiLightShader.setMat4("model", model);
+        //Texture levels the visible objects need at this distance, then stream them in (or evict) for next frame. They are
+        //requested here, the residency manager belongs to the GL thread
+        for (const RenderDraw& draw : frame.Draws)
+            textureResidency.RequestForMesh(*renderMeshes[draw.MeshId], draw.Model, frame.CameraPosition, frame.PixelsPerUnit);
+        for (Mesh* mesh : worldStreamer.ResidentMeshes())
+            textureResidency.RequestForMesh(*mesh, mesh->LocalTransform, frame.CameraPosition, frame.PixelsPerUnit);
+        textureResidency.Update();
+        if (frame.ReportTextureStats)
+            textureResidency.PrintStats();
 
-            multiLightShader.setBool("material.useOverlayTexture", pumpkinBody.HasOverlay());
-            multiLightShader.setFloat("material.shininess", pumpkinBody.GetShininess());
-            pumpkinBody.Draw();
+        if (frame.ReportStreamingStats)
+            worldStreamer.PrintStats();
 
-            multiLightShader.setBool("material.useOverlayTexture", pumpkinStem.HasOverlay());
-            multiLightShader.setFloat("material.shininess", pumpkinStem.GetShininess());
-            pumpkinStem.Draw();
-        }
+        //Close gaps left by unregistered objects a little every frame
+        indirectRenderer.Compact(256 * 1024);
+        if (frame.ReportArenaStats)
+            indirectRenderer.PrintStats();
 
         /*
         * =====================
@@ -402,42 +893,115 @@ int main()
 
         //Draw the light cube
         lightCubeSampleShader.use();
-        lightCubeSampleShader.setMat4("projection", projection);
-        lightCubeSampleShader.setMat4("view", view);
-
-        for (int i = 0; i < sizeof(candleLightPositions) / sizeof(candleLightPositions[0]); i++) {
-            model = glm::mat4(1.0f); //Reset the model
-            model = glm::translate(model, candleLightPositions[i]);
-            lightCubeSampleShader.setMat4("model", model);
-            lightCubeSampleShader.setVec3("lightColor", candleLightColors[i]);
+        lightCubeSampleShader.setMat4("projection", frame.Projection);
+        lightCubeSampleShader.setMat4("view", frame.View);
 
+        for (size_t i = 0; i < frame.LightModels.size(); i++) {
+            lightCubeSampleShader.setMat4("model", frame.LightModels[i]);
+            lightCubeSampleShader.setVec3("lightColor", glm::make_vec3(scene.Lights[i].Color));
             lightCube.Draw();
         }
 
-        //Draw the key light
-        model = glm::mat4(1.0f); //Reset the model
-        model = glm::translate(model, keyLightPosition);
-        model = glm::scale(model, glm::vec3(3.0f));
-        lightCubeSampleShader.setMat4("model", model);
-        lightCubeSampleShader.setVec3("lightColor", keyLightColor);
-        lightCube.Draw();
+        //Everything reading this frame's uniform blocks is queued
+        frameStream.EndFrame();
 
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
+        // glfw: swap buffers
+        // ------------------
         glfwSwapBuffers(window);
+    };
+
+    RenderThread<RenderSnapshot> renderThread(renderBuffers);
+    if (useRenderThread)
+        glfwMakeContextCurrent(NULL);
+    renderThread.Start(renderFrame, useRenderThread, [window]() { glfwMakeContextCurrent(window); }, []() { glfwMakeContextCurrent(NULL); });
+    std::cout << "RENDERTHREAD::" << (useRenderThread ? "ON " : "OFF ") << renderThread.Buffers() << " BUFFERS" << std::endl;
+
+    // render loop
+    // -----------
+    while (!glfwWindowShouldClose(window))
+    {
+        //Waits while the render thread still has every snapshot
+        RenderSnapshot& frame = renderThread.Acquire();
+
+        //Delta Time stuff
+        float currentFrame = glfwGetTime();
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        // glfw: poll IO events (keys pressed/released, mouse moved etc.), then the input
+        // -------------------------------------------------------------------------------
         glfwPollEvents();
+        processInput(window);
+        if (reportRenderThreadStats) {
+            renderThread.PrintStats();
+            reportRenderThreadStats = false;
+        }
+
+        glm::mat4 view = camera.GetViewMatrix();
+
+        //Pixel size of one unit at distance 1 at the current framebuffer height, for picking LODs and texture levels.
+        //Orthographic always draws LOD0
+        float lodPixelsPerUnit = (float)std::max(framebufferHeight, 1) / (2.0f * tan(glm::radians(camera.CurrentFOV) * 0.5f));
+
+        //Everything up to the draw list on the job system (world matrices of whatever moved, objects in view in draw order
+        //with their LODs), straight into the snapshot
+        frameFrustum = Frustum(projection * view);
+        frameCamera = camera.Position;
+        framePixelsPerUnit = lodPixelsPerUnit;
+        frameSnapshot = &frame;
+        frameGraph.Run(jobs);
+
+        //The rest of the frame's state, the one-shot reports go with it
+        frame.View = view;
+        frame.Projection = projection;
+        frame.CameraPosition = camera.Position;
+        frame.CameraFront = camera.Front;
+        frame.PixelsPerUnit = lodPixelsPerUnit;
+        frame.ViewportWidth = framebufferWidth;
+        frame.ViewportHeight = framebufferHeight;
+        frame.Wireframe = useWireframe;
+        frame.UsePerspective = usePerspective;
+        frame.UseLods = useLods && usePerspective;
+        frame.UseDirectionalLight = useDirectionalLight;
+        frame.UseFlashlight = useFlashlight;
+        frame.UseMeshletCulling = useMeshletCulling;
+        frame.UseStaticBatching = useStaticBatching;
+        frame.UseIndirect = useIndirect;
+        frame.UseMaterialArray = useMaterialArray;
+        frame.ReportBatchingStats = reportBatchingStats;
+        frame.ReportMeshletStats = reportMeshletStats;
+        frame.ReportArenaStats = reportArenaStats;
+        frame.ReportTextureStats = reportTextureStats;
+        frame.ReportStreamingStats = reportStreamingStats;
+        reportBatchingStats = reportMeshletStats = reportArenaStats = reportTextureStats = reportStreamingStats = false;
+
+        renderThread.Submit();
     }
 
+    //Draw what is queued and take the context back for the cleanup
+    renderThread.Stop();
+    renderThread.PrintStats();
+    if (useRenderThread)
+        glfwMakeContextCurrent(window);
+
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
 
-    for (Mesh mesh : meshes)
+    for (Mesh& mesh : meshes)
     {
         mesh.DeallocateVertexArrayBuffers();
     }
 
-    pumpkinBody.DeallocateVertexArrayBuffers();
-    pumpkinStem.DeallocateVertexArrayBuffers();
+    for (std::vector<Mesh*>& parts : prototypeParts)
+    {
+        for (Mesh* part : parts)
+            part->DeallocateVertexArrayBuffers();
+    }
+    worldStreamer.Deallocate();
+    indirectRenderer.Deallocate();
+    frameStream.Deallocate();
+    textureResidency.Deallocate();
+    VertexFormat::Deallocate();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -455,16 +1019,62 @@ glm::mat4 ResetModelView(float angle) {
     return model;
 }
 
+//Fixed cylinders come from compile time tables, only the sizes used by the scenes are compiled in
+bool IsFixedSceneMesh(const SceneObject& object) {
+    return object.Primitive == SCENE_FIXED_CYLINDER
+        && ((object.Sides == 8 && object.Subdivisions == 1) || (object.Sides == 15 && object.Subdivisions == 3));
+}
+
+//Hash of the generator parameters of a scene object (not its material or prototype), the MeshCache source of its mesh.
+//Models hash the contents of their file instead of its path, so editing the file rebuilds the mesh
+uint64_t HashSceneMesh(const Scene& scene, const SceneObject& object) {
+    uint64_t hash = MeshCache::Hash(&object.Primitive, sizeof(object.Primitive));
+    if (object.Primitive == SCENE_MODEL) {
+        uint64_t file = MeshCache::HashFile(scene.String(object.Path));
+        hash = MeshCache::Hash(&file, sizeof(file), hash);
+    }
+    hash = MeshCache::Hash(object.Position, sizeof(object.Position), hash);
+    hash = MeshCache::Hash(object.Size, sizeof(object.Size), hash);
+    hash = MeshCache::Hash(&object.Sides, sizeof(object.Sides), hash);
+    hash = MeshCache::Hash(&object.Subdivisions, sizeof(object.Subdivisions), hash);
+    return MeshCache::Hash(&object.Flags, sizeof(object.Flags), hash);
+}
+
+//Builds the mesh of a scene object. Fixed cylinders of a size that is not compiled in are generated instead
+std::shared_ptr<Mesh> CreateSceneMesh(const Scene& scene, const SceneObject& object) {
+    glm::vec3 position = glm::make_vec3(object.Position);
+    bool drawTop = (object.Flags & SCENE_DRAW_TOP) != 0;
+    bool drawBottom = (object.Flags & SCENE_DRAW_BOTTOM) != 0;
+
+    switch (object.Primitive) {
+    case SCENE_PLANE:
+        return std::make_shared<Plane>(position, object.Size[0], object.Size[1]);
+    case SCENE_SPHERE:
+        return std::make_shared<Sphere>(position, object.Size[0], object.Size[1], object.Sides, (object.Flags & SCENE_SEMI_CIRCLE) != 0,
+            (object.Flags & SCENE_GEODESIC) ? GEODESIC_SPHERE : UV_SPHERE);
+    case SCENE_FIXED_CYLINDER:
+        if (object.Sides == 8 && object.Subdivisions == 1)
+            return std::make_shared<FixedCylinder<8, 1, true, false>>(position, object.Size[0], object.Size[1]);
+        if (object.Sides == 15 && object.Subdivisions == 3)
+            return std::make_shared<FixedCylinder<15, 3, true, false>>(position, object.Size[0], object.Size[1]);
+        break;
+    case SCENE_MODEL:
+        return std::make_shared<ImportedMesh>(scene.String(object.Path), position, object.Size[0]);
+    }
+    return std::make_shared<Cylinder>(position, object.Size[0], object.Size[1], object.Sides, object.Subdivisions, drawTop, drawBottom);
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow* window)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+    //Wireframe, applied by the render thread
     if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        useWireframe = true;
     if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        useWireframe = false;
 
     //Movement
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
@@ -504,6 +1114,47 @@ void key_callback(GLFWwindow* window, int key, int scanCode, int action, int mod
     //Toggle Flashlight
     if (key == GLFW_KEY_F && action == GLFW_PRESS)
         useFlashlight = !useFlashlight;
+
+    //Toggle static batching, the render thread prints the static scene's draw calls and average CPU submit time before the switch
+    if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+        useStaticBatching = !useStaticBatching;
+        reportBatchingStats = true;
+    }
+
+    //Toggle the indirect renderer
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        useIndirect = !useIndirect;
+        std::cout << "RENDERER::INDIRECT " << (useIndirect ? "ON" : "OFF") << std::endl;
+        reportArenaStats = true;
+    }
+
+    //Toggle the material texture array of the indirect renderer
+    if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+        useMaterialArray = !useMaterialArray;
+        std::cout << "MATERIALS::ARRAY " << (useMaterialArray ? "ON" : "OFF") << std::endl;
+    }
+
+    //Print texture residency
+    if (key == GLFW_KEY_T && action == GLFW_PRESS)
+        reportTextureStats = true;
+
+    //Print the world streamer's cells
+    if (key == GLFW_KEY_G && action == GLFW_PRESS)
+        reportStreamingStats = true;
+
+    //Toggle LODs
+    if (key == GLFW_KEY_L && action == GLFW_PRESS)
+        useLods = !useLods;
+
+    //Toggle meshlet culling, the render thread prints what the last frame culled
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        useMeshletCulling = !useMeshletCulling;
+        reportMeshletStats = true;
+    }
+
+    //Print the simulation and render thread timings
+    if (key == GLFW_KEY_R && action == GLFW_PRESS)
+        reportRenderThreadStats = true;
 }
 
 //Callback for the mouse
@@ -541,7 +1192,9 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    // The render thread sets the viewport from the next snapshot
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 //Swaps between Perspective and Orthographic Matrices
@@ -0,0 +1,471 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include "blockcompression.h"
+
+//A translation unit that also uses glad or GLFW includes windows.h (with NOMINMAX) before them, see Source.cpp
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using std::vector;
+
+//Bytes of an asset, either inside the mapped pack or in a caller's buffer. Valid as long as both of those are
+struct AssetView
+{
+	const char* Data = nullptr;
+	size_t Size = 0;
+};
+
+//A read-only file mapped into memory, pages are read in by the OS on first touch
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path)
+	{
+		Close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			Close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping) {
+			Close();
+			return false;
+		}
+		data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		size = static_cast<size_t>(fileSize.QuadPart);
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0) {
+			return false;
+		}
+		struct stat status;
+		if (fstat(file, &status) != 0 || status.st_size == 0) {
+			close(file);
+			return false;
+		}
+		void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		//The mapping keeps the file alive on its own
+		close(file);
+		if (view == MAP_FAILED) {
+			return false;
+		}
+		data = static_cast<const char*>(view);
+		size = static_cast<size_t>(status.st_size);
+#endif
+		if (!data) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (data) {
+			UnmapViewOfFile(data);
+		}
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data) {
+			munmap(const_cast<char*>(data), size);
+		}
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	const char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+};
+
+//All the loose asset files (textures, shaders, scenes) in one file that is memory-mapped at startup. A lookup hashes the
+//path into an open addressing table of contents, so finding an asset is a probe or two instead of a file open. Entries are
+//aligned, and the ones that shrink enough are stored compressed with BlockCompression. Stored entries are viewed in place
+//in the mapping (images and other already compressed formats stay stored), compressed ones decode into the caller's buffer.
+//
+//Layout: PackHeader, the slot table (TableSize entry indices + 1, 0 is empty), the entries, the path strings, then the
+//data of each entry at a multiple of Alignment.
+//
+//Consumers go through Load, which falls back to the loose file when no pack is mounted or the pack does not have the path.
+class AssetPack
+{
+public:
+	//Pack the consumers read from, nullptr to use the loose files
+	static inline AssetPack* Mounted = nullptr;
+
+	//Entry data alignment, a cache line
+	static const uint32_t Alignment = 64;
+
+	//Entries are compressed if that saves at least this fraction of their size
+	static constexpr float MinSaving = 0.1f;
+
+	AssetPack() {}
+
+	AssetPack(const AssetPack&) = delete;
+	AssetPack& operator=(const AssetPack&) = delete;
+
+	//Maps a pack and checks its table of contents. Returns false if it does not exist or is malformed
+	bool Open(const std::string& path)
+	{
+		Close();
+		if (!file.Open(path)) {
+			return false;
+		}
+
+		const char* data = file.Data();
+		size_t size = file.Size();
+		if (size < sizeof(PackHeader)) {
+			return Fail(path);
+		}
+		memcpy(&header, data, sizeof(header));
+		if (header.Magic != Magic || header.Version != Version || header.TableSize < 2 || (header.TableSize & (header.TableSize - 1)) != 0) {
+			return Fail(path);
+		}
+
+		//Table, entries and strings are 4 or 8 byte aligned in the file and the mapping is page aligned, so they are used in place
+		size_t tableBytes = static_cast<size_t>(header.TableSize) * sizeof(uint32_t);
+		size_t entryBytes = static_cast<size_t>(header.EntryCount) * sizeof(PackEntry);
+		if (tableBytes > size || entryBytes > size || header.StringBytes > size
+			|| sizeof(PackHeader) + tableBytes + entryBytes + header.StringBytes > size) {
+			return Fail(path);
+		}
+		table = reinterpret_cast<const uint32_t*>(data + sizeof(PackHeader));
+		entries = reinterpret_cast<const PackEntry*>(data + sizeof(PackHeader) + tableBytes);
+		strings = data + sizeof(PackHeader) + tableBytes + entryBytes;
+
+		for (uint32_t i = 0; i < header.TableSize; i++) {
+			if (table[i] > header.EntryCount) {
+				return Fail(path);
+			}
+		}
+		for (uint32_t i = 0; i < header.EntryCount; i++) {
+			const PackEntry& entry = entries[i];
+			if (entry.NameOffset > header.StringBytes || entry.NameLength > header.StringBytes - entry.NameOffset
+				|| entry.Offset > size || entry.StoredSize > size - entry.Offset
+				|| (!(entry.Flags & EntryCompressed) && entry.StoredSize != entry.Size)
+				|| ((entry.Flags & EntryCompressed) && entry.Size / 255 > entry.StoredSize)) {
+				return Fail(path);
+			}
+		}
+		return true;
+	}
+
+	void Close()
+	{
+		file.Close();
+		table = nullptr;
+		entries = nullptr;
+		strings = nullptr;
+		memset(&header, 0, sizeof(header));
+	}
+
+	bool IsOpen() const { return file.Data() != nullptr; }
+
+	size_t EntryCount() const { return IsOpen() ? header.EntryCount : 0; }
+
+	//Finds an asset. Stored entries are returned in place, compressed ones are decoded into scratch. Returns false if the
+	//pack does not have the path or the entry does not decode
+	bool Find(const std::string& path, vector<char>& scratch, AssetView& view) const
+	{
+		const PackEntry* entry = FindEntry(path);
+		if (!entry) {
+			return false;
+		}
+
+		const char* stored = file.Data() + entry->Offset;
+		if (!(entry->Flags & EntryCompressed)) {
+			view.Data = stored;
+			view.Size = static_cast<size_t>(entry->Size);
+			return true;
+		}
+
+		scratch.resize(static_cast<size_t>(entry->Size));
+		if (!BlockCompression::Decompress(stored, static_cast<size_t>(entry->StoredSize), scratch.data(), scratch.size())) {
+			std::cout << "ERROR::ASSETPACK::BAD_ENTRY " << path << std::endl;
+			return false;
+		}
+		view.Data = scratch.data();
+		view.Size = scratch.size();
+		return true;
+	}
+
+	//Reads an asset from the mounted pack, or from the loose file (in one read, into scratch) if it is not packed.
+	//Returns false if neither has it
+	static bool Load(const std::string& path, vector<char>& scratch, AssetView& view)
+	{
+		if (Mounted && Mounted->Find(path, scratch, view)) {
+			return true;
+		}
+		return ReadFile(path, scratch, view);
+	}
+
+	//Packs every file under the directories (recursively) into one pack, paths are stored as "<directory>/<file>" with
+	//forward slashes, the same way the consumers ask for them
+	static bool Build(const std::string& output, const vector<std::string>& directories)
+	{
+		struct Source
+		{
+			std::string Path;
+			vector<char> Data;
+			vector<char> Compressed;
+		};
+		vector<Source> sources;
+
+		for (const std::string& directory : directories) {
+			std::error_code error;
+			if (!std::filesystem::is_directory(directory, error)) {
+				std::cout << "ERROR::ASSETPACK::NOT_A_DIRECTORY " << directory << std::endl;
+				return false;
+			}
+			for (const auto& item : std::filesystem::recursive_directory_iterator(directory, error)) {
+				if (!item.is_regular_file()) {
+					continue;
+				}
+				Source source;
+				source.Path = item.path().generic_string();
+				AssetView view;
+				if (!ReadFile(source.Path, source.Data, view)) {
+					std::cout << "ERROR::ASSETPACK::FILE_NOT_SUCCESSFULLY_READ " << source.Path << std::endl;
+					return false;
+				}
+				sources.push_back(std::move(source));
+			}
+		}
+
+		//Sorted so the same directories always give the same pack
+		std::sort(sources.begin(), sources.end(), [](const Source& a, const Source& b) { return a.Path < b.Path; });
+		for (size_t i = 1; i < sources.size(); i++) {
+			if (sources[i].Path == sources[i - 1].Path) {
+				std::cout << "ERROR::ASSETPACK::DUPLICATE_PATH " << sources[i].Path << std::endl;
+				return false;
+			}
+		}
+
+		PackHeader packHeader;
+		memset(&packHeader, 0, sizeof(packHeader));
+		packHeader.Magic = Magic;
+		packHeader.Version = Version;
+		packHeader.EntryCount = static_cast<uint32_t>(sources.size());
+		//At most half full, so probes stay short. At least 2 slots keeps the entries after the table 8 byte aligned
+		packHeader.TableSize = 2;
+		while (packHeader.TableSize < packHeader.EntryCount * 2) {
+			packHeader.TableSize *= 2;
+		}
+
+		vector<uint32_t> slots(packHeader.TableSize, 0);
+		vector<PackEntry> packEntries(sources.size());
+		std::string stringTable;
+		for (size_t i = 0; i < sources.size(); i++) {
+			PackEntry& entry = packEntries[i];
+			memset(&entry, 0, sizeof(entry));
+			entry.Hash = Hash(sources[i].Path);
+			entry.NameOffset = static_cast<uint32_t>(stringTable.size());
+			entry.NameLength = static_cast<uint32_t>(sources[i].Path.size());
+			stringTable += sources[i].Path;
+
+			uint32_t slot = static_cast<uint32_t>(entry.Hash) & (packHeader.TableSize - 1);
+			while (slots[slot] != 0) {
+				slot = (slot + 1) & (packHeader.TableSize - 1);
+			}
+			slots[slot] = static_cast<uint32_t>(i) + 1;
+
+			//Only kept if it pays for the decode
+			Source& source = sources[i];
+			source.Compressed = BlockCompression::Compress(source.Data.data(), source.Data.size());
+			entry.Size = source.Data.size();
+			if (source.Compressed.size() <= source.Data.size() * (1.0f - MinSaving)) {
+				entry.Flags |= EntryCompressed;
+				entry.StoredSize = source.Compressed.size();
+			}
+			else {
+				source.Compressed.clear();
+				entry.StoredSize = source.Data.size();
+			}
+		}
+		packHeader.StringBytes = static_cast<uint32_t>(stringTable.size());
+
+		uint64_t offset = sizeof(PackHeader) + slots.size() * sizeof(uint32_t) + packEntries.size() * sizeof(PackEntry) + stringTable.size();
+		for (PackEntry& entry : packEntries) {
+			offset = (offset + Alignment - 1) / Alignment * Alignment;
+			entry.Offset = offset;
+			offset += entry.StoredSize;
+		}
+
+		//Written to a temporary name first so a running scene never maps a half written pack
+		std::string temporary = output + ".tmp";
+		uint64_t storedBytes = 0, totalBytes = 0;
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(&packHeader), sizeof(packHeader));
+			file.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(uint32_t));
+			file.write(reinterpret_cast<const char*>(packEntries.data()), packEntries.size() * sizeof(PackEntry));
+			file.write(stringTable.data(), stringTable.size());
+
+			uint64_t written = sizeof(PackHeader) + slots.size() * sizeof(uint32_t) + packEntries.size() * sizeof(PackEntry) + stringTable.size();
+			for (size_t i = 0; i < sources.size(); i++) {
+				const vector<char>& data = (packEntries[i].Flags & EntryCompressed) ? sources[i].Compressed : sources[i].Data;
+				static const char padding[Alignment] = {};
+				file.write(padding, static_cast<std::streamsize>(packEntries[i].Offset - written));
+				file.write(data.data(), data.size());
+				written = packEntries[i].Offset + data.size();
+				storedBytes += data.size();
+				totalBytes += packEntries[i].Size;
+			}
+			if (!file) {
+				std::cout << "ERROR::ASSETPACK::WRITE_FAILED " << temporary << std::endl;
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporary, output, error);
+		if (error) {
+			std::cout << "ERROR::ASSETPACK::WRITE_FAILED " << output << " " << error.message() << std::endl;
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+
+		std::cout << "ASSETPACK::BUILT " << output << " (" << sources.size() << " FILES, " << totalBytes / 1024 << " KB -> "
+			<< storedBytes / 1024 << " KB)" << std::endl;
+		return true;
+	}
+
+private:
+	//"GLAP"
+	static const uint32_t Magic = 0x50414C47;
+	static const uint32_t Version = 1;
+
+	//PackEntry::Flags
+	static const uint32_t EntryCompressed = 1;
+
+	struct PackHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t EntryCount;
+		uint32_t TableSize;    //Slots, a power of two
+		uint32_t StringBytes;
+		uint32_t Reserved;
+	};
+
+	struct PackEntry
+	{
+		uint64_t Hash;         //Hash of the path
+		uint32_t NameOffset;   //Path in the string table
+		uint32_t NameLength;
+		uint64_t Offset;       //Data from the start of the file
+		uint64_t Size;         //Decoded size
+		uint64_t StoredSize;   //Size in the pack, Size unless compressed
+		uint32_t Flags;
+		uint32_t Reserved;
+	};
+
+	MappedFile file;
+	PackHeader header = {};
+	const uint32_t* table = nullptr;
+	const PackEntry* entries = nullptr;
+	const char* strings = nullptr;
+
+	//Reads a loose file in one read
+	static bool ReadFile(const std::string& path, vector<char>& scratch, AssetView& view)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			return false;
+		}
+		scratch.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		if (!file.read(scratch.data(), scratch.size())) {
+			return false;
+		}
+		view.Data = scratch.data();
+		view.Size = scratch.size();
+		return true;
+	}
+
+	//64 bit FNV-1a of a path
+	static uint64_t Hash(const std::string& path)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : path) {
+			hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	//Probes from the path's slot until its entry or an empty slot. The table is at most half full
+	const PackEntry* FindEntry(const std::string& path) const
+	{
+		if (!IsOpen()) {
+			return nullptr;
+		}
+
+		uint64_t hash = Hash(path);
+		uint32_t mask = header.TableSize - 1;
+		for (uint32_t slot = static_cast<uint32_t>(hash) & mask, probes = 0; table[slot] != 0 && probes < header.TableSize; slot = (slot + 1) & mask, probes++) {
+			const PackEntry& entry = entries[table[slot] - 1];
+			if (entry.Hash == hash && entry.NameLength == path.size() && memcmp(strings + entry.NameOffset, path.data(), path.size()) == 0) {
+				return &entry;
+			}
+		}
+		return nullptr;
+	}
+
+	bool Fail(const std::string& path)
+	{
+		std::cout << "ERROR::ASSETPACK::BAD_FILE " << path << std::endl;
+		Close();
+		return false;
+	}
+};
+
+#endif
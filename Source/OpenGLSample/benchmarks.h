@@ -0,0 +1,921 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include "sphere.h"
+#include "cylinder.h"
+#include "cube.h"
+#include "plane.h"
+#include "bufferpool.h"
+#include "shader.h"
+#include "meshcache.h"
+#include "meshimporter.h"
+#include "scenegraph.h"
+#include "renderobjects.h"
+#include "jobsystem.h"
+#include "scenefile.h"
+
+using namespace std;
+
+//Benchmarks are run with the --benchmark switch once the GL context exists (the meshes upload on construction). Results print to the console.
+
+//Returns the milliseconds elapsed since start
+inline double ElapsedMilliseconds(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+//Compares the triangle count against the silhouette error for both sphere tessellation modes
+inline void BenchmarkSphereTessellation()
+{
+	cout << "BENCHMARK::SPHERE_TESSELLATION" << endl;
+	cout << left << setw(10) << "Mode" << setw(8) << "Semi" << setw(8) << "Sides" << setw(8) << "Level"
+		<< setw(12) << "Triangles" << setw(16) << "SilhouetteErr" << "Build(ms)" << endl;
+
+	int sideCounts[] = { 8, 15, 30, 60 };
+	bool semiCircles[] = { false, true };
+	SphereTessellation modes[] = { UV_SPHERE, GEODESIC_SPHERE };
+
+	for (bool semiCircle : semiCircles) {
+		for (int sides : sideCounts) {
+			for (SphereTessellation mode : modes) {
+				//Same ellipsoid as the pumpkins so the RadiusLong/RadiusLat scaling is measured too
+				auto start = std::chrono::high_resolution_clock::now();
+				Sphere sphere = Sphere(glm::vec3(0.0f), 0.4f, 0.3f, sides, semiCircle, mode);
+				double buildTime = ElapsedMilliseconds(start);
+
+				cout << left << setw(10) << (mode == UV_SPHERE ? "UV" : "Geodesic") << setw(8) << (semiCircle ? "yes" : "no")
+					<< setw(8) << sides << setw(8) << (mode == UV_SPHERE ? 0 : sphere.GeodesicLevel)
+					<< setw(12) << sphere.GetTriangleCount() << setw(16) << sphere.CalculateSilhouetteError()
+					<< fixed << setprecision(3) << buildTime << defaultfloat << endl;
+
+				sphere.DeallocateVertexArrayBuffers();
+			}
+		}
+	}
+}
+
+//Prints the post-transform cache miss ratio of the generated meshes before and after the optimizer (lower means fewer vertex shader runs per triangle)
+inline void PrintMeshOptimization(const char* name, Mesh& mesh, double buildTime)
+{
+	cout << left << setw(24) << name << setw(12) << mesh.GetTriangleCount() << setw(12) << mesh.Vertices.size() / 11
+		<< setw(14) << mesh.AcmrBefore << setw(14) << mesh.AcmrAfter << fixed << setprecision(3) << buildTime << defaultfloat << endl;
+	mesh.DeallocateVertexArrayBuffers();
+}
+
+//Compares ACMR of the generator's loop order (after welding) with the optimized order for the scene's primitives
+inline void BenchmarkMeshOptimization()
+{
+	cout << "BENCHMARK::MESH_OPTIMIZATION (FIFO cache of " << MeshOptimizer::DefaultCacheSize << ", unindexed ACMR is 3.0)" << endl;
+	cout << left << setw(24) << "Mesh" << setw(12) << "Triangles" << setw(12) << "Vertices"
+		<< setw(14) << "ACMR before" << setw(14) << "ACMR after" << "Build(ms)" << endl;
+
+	bool previous = Mesh::OptimizeOnLoad;
+	Mesh::OptimizeOnLoad = true;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	Cylinder candleJar = Cylinder(glm::vec3(0.0f), 0.5f, 0.75f, 40, 3, false, true);
+	PrintMeshOptimization("Cylinder 40x3", candleJar, ElapsedMilliseconds(start));
+
+	start = std::chrono::high_resolution_clock::now();
+	Cylinder tallCylinder = Cylinder(glm::vec3(0.0f), 0.5f, 2.0f, 64, 32, true, true);
+	PrintMeshOptimization("Cylinder 64x32", tallCylinder, ElapsedMilliseconds(start));
+
+	start = std::chrono::high_resolution_clock::now();
+	Sphere uvSphere = Sphere(glm::vec3(0.0f), 0.4f, 0.3f, 60, false);
+	PrintMeshOptimization("Sphere UV 60", uvSphere, ElapsedMilliseconds(start));
+
+	start = std::chrono::high_resolution_clock::now();
+	Sphere geodesicSphere = Sphere(glm::vec3(0.0f), 0.4f, 0.3f, 60, false, GEODESIC_SPHERE);
+	PrintMeshOptimization("Sphere Geodesic 60", geodesicSphere, ElapsedMilliseconds(start));
+
+	start = std::chrono::high_resolution_clock::now();
+	Cube cube = Cube(glm::vec3(0.0f), 1.0f, 1.0f, 1.0f);
+	PrintMeshOptimization("Cube", cube, ElapsedMilliseconds(start));
+
+	Mesh::OptimizeOnLoad = previous;
+}
+
+//Returns an FNV-1a hash of every LOD index list, to compare simplification runs
+inline uint64_t HashLods(const Mesh& mesh)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (const MeshLod& lod : mesh.Lods) {
+		for (unsigned int index : lod.Indices) {
+			hash ^= index;
+			hash *= 1099511628211ull;
+		}
+	}
+	return hash;
+}
+
+//Builds the LOD chain for a set of meshes on one thread and on every thread, checks both runs match, then prints each level
+inline void BenchmarkSimplification()
+{
+	vector<float> ratios = { 0.5f, 0.25f, 0.125f };
+	cout << "BENCHMARK::SIMPLIFICATION (LOD ratios 0.5, 0.25, 0.125)" << endl;
+
+	Sphere uvSphere = Sphere(glm::vec3(0.0f), 0.4f, 0.3f, 60, false);
+	Sphere geodesicSphere = Sphere(glm::vec3(0.0f), 0.4f, 0.3f, 60, false, GEODESIC_SPHERE);
+	Sphere semiSphere = Sphere(glm::vec3(0.0f), 0.4f, 0.2f, 30, true, GEODESIC_SPHERE);
+	Cylinder tallCylinder = Cylinder(glm::vec3(0.0f), 0.5f, 2.0f, 64, 32, true, true);
+	Cylinder candleJar = Cylinder(glm::vec3(0.0f), 0.5f, 0.75f, 40, 3, false, true);
+
+	vector<Mesh*> meshes = { &uvSphere, &geodesicSphere, &semiSphere, &tallCylinder, &candleJar };
+	const char* names[] = { "Sphere UV 60", "Sphere Geodesic 60", "Semi Geodesic 30", "Cylinder 64x32", "Cylinder 40x3" };
+
+	auto start = std::chrono::high_resolution_clock::now();
+	Mesh::GenerateLods(meshes, ratios, 1);
+	double singleTime = ElapsedMilliseconds(start);
+
+	vector<uint64_t> hashes;
+	for (Mesh* mesh : meshes) {
+		hashes.push_back(HashLods(*mesh));
+	}
+
+	unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+	start = std::chrono::high_resolution_clock::now();
+	Mesh::GenerateLods(meshes, ratios, threads);
+	double threadedTime = ElapsedMilliseconds(start);
+
+	bool deterministic = true;
+	for (size_t i = 0; i < meshes.size(); i++) {
+		deterministic = deterministic && hashes[i] == HashLods(*meshes[i]);
+	}
+
+	cout << "1 thread " << singleTime << " ms, " << threads << " threads " << threadedTime << " ms, runs match: " << (deterministic ? "yes" : "NO") << endl;
+	cout << left << setw(24) << "Mesh" << setw(8) << "LOD" << setw(12) << "Triangles" << "Error" << endl;
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		cout << left << setw(24) << names[i] << setw(8) << 0 << setw(12) << meshes[i]->GetTriangleCount() << 0.0f << endl;
+		for (size_t l = 0; l < meshes[i]->Lods.size(); l++) {
+			cout << left << setw(24) << "" << setw(8) << l + 1 << setw(12) << meshes[i]->Lods[l].Indices.size() / 3 << meshes[i]->Lods[l].Error << endl;
+		}
+	}
+
+	for (Mesh* mesh : meshes) {
+		mesh->DeallocateVertexArrayBuffers();
+	}
+}
+
+//Streams random sized meshes in and out, once with a buffer per mesh and once through a BufferPool, then compacts the pool
+inline void BenchmarkBufferPool()
+{
+	const int slots = 256;
+	const int operations = 4000;
+	const unsigned int vertexSize = 11 * sizeof(float);
+	cout << "BENCHMARK::BUFFER_POOL (" << operations << " replacements over " << slots << " live meshes)" << endl;
+
+	//Same sizes for both runs
+	std::mt19937 random(1234);
+	std::uniform_int_distribution<unsigned int> vertexCounts(24, 8192);
+	std::uniform_int_distribution<int> picks(0, slots - 1);
+	vector<unsigned int> sizes(slots + operations);
+	vector<int> replaced(operations);
+	for (unsigned int& size : sizes) {
+		size = vertexCounts(random);
+	}
+	for (int& pick : replaced) {
+		pick = picks(random);
+	}
+	vector<float> data(static_cast<size_t>(8192) * 11, 1.0f);
+
+	//A GL buffer per mesh, as Mesh does
+	vector<unsigned int> buffers(slots);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < slots; i++) {
+		glGenBuffers(1, &buffers[i]);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizes[i]) * vertexSize, data.data(), GL_STATIC_DRAW);
+	}
+	for (int i = 0; i < operations; i++) {
+		unsigned int& buffer = buffers[replaced[i]];
+		glDeleteBuffers(1, &buffer);
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizes[slots + i]) * vertexSize, data.data(), GL_STATIC_DRAW);
+	}
+	glFinish();
+	double bufferTime = ElapsedMilliseconds(start);
+	glDeleteBuffers(slots, buffers.data());
+
+	//The same churn through one pool, sized for twice the average live set
+	BufferPool pool = BufferPool(GL_ARRAY_BUFFER, vertexSize, slots * 8192);
+	vector<int> handles(slots);
+	start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < slots; i++) {
+		handles[i] = pool.Allocate(sizes[i]);
+		pool.Upload(handles[i], data.data(), sizes[i]);
+	}
+	int failures = 0;
+	for (int i = 0; i < operations; i++) {
+		int& handle = handles[replaced[i]];
+		pool.Free(handle);
+		handle = pool.Allocate(sizes[slots + i]);
+		if (handle == BufferPool::InvalidHandle) {
+			failures++;
+			continue;
+		}
+		pool.Upload(handle, data.data(), sizes[slots + i]);
+	}
+	glFinish();
+	double poolTime = ElapsedMilliseconds(start);
+
+	cout << "Buffer per mesh " << bufferTime << " ms, pool " << poolTime << " ms, pool out of space " << failures << " times" << endl;
+	pool.PrintStats("AFTER_CHURN");
+
+	//Compact in frame sized steps until nothing moves
+	int steps = 0;
+	size_t moved = 0;
+	start = std::chrono::high_resolution_clock::now();
+	for (size_t step = pool.Compact(4 * 1024 * 1024); step > 0; step = pool.Compact(4 * 1024 * 1024)) {
+		moved += step;
+		steps++;
+	}
+	glFinish();
+	double compactTime = ElapsedMilliseconds(start);
+
+	cout << "Compacted " << moved / 1024 << " KB in " << steps << " steps of 4 MB, " << compactTime << " ms" << endl;
+	pool.PrintStats("AFTER_COMPACT");
+	pool.Deallocate();
+}
+
+//Compiles the smallest program that reads the position attribute, for benchmarks that only measure submission
+inline unsigned int CreatePositionOnlyProgram()
+{
+	const char* vertexSource = "#version 330 core\nlayout(location = 0) in vec3 aPos;\nvoid main() { gl_Position = vec4(aPos * 0.01, 1.0); }\n";
+	const char* fragmentSource = "#version 330 core\nout vec4 FragColor;\nvoid main() { FragColor = vec4(1.0); }\n";
+
+	unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(vertex, 1, &vertexSource, nullptr);
+	glCompileShader(vertex);
+	unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragment, 1, &fragmentSource, nullptr);
+	glCompileShader(fragment);
+
+	unsigned int program = glCreateProgram();
+	glAttachShader(program, vertex);
+	glAttachShader(program, fragment);
+	glLinkProgram(program);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+	return program;
+}
+
+//Draws the same set of meshes with a VAO per mesh and with the shared vertex format VAO, timing the CPU side of the submission
+inline void BenchmarkVertexFormat()
+{
+	const int meshCount = 512;
+	const int frames = 200;
+	cout << "BENCHMARK::VERTEX_FORMAT (" << meshCount << " meshes, " << frames << " frames)" << endl;
+
+	if (!GLExtensions::SeparateAttribFormat) {
+		cout << "Vertex attrib binding not supported, every mesh uses its own VAO" << endl;
+		return;
+	}
+
+	unsigned int program = CreatePositionOnlyProgram();
+	glUseProgram(program);
+
+	bool sharedModes[] = { false, true };
+	for (bool shared : sharedModes) {
+		VertexFormat::Enabled = shared;
+		vector<Cube> cubes;
+		cubes.reserve(meshCount);
+		for (int i = 0; i < meshCount; i++) {
+			cubes.emplace_back(glm::vec3(0.0f), 0.1f, 0.1f, 0.1f);
+		}
+
+		glFinish();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			for (Cube& cube : cubes) {
+				cube.BindVAO();
+				glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(cube.Indices.size()), GL_UNSIGNED_INT, (void*)0);
+			}
+		}
+		double submitTime = ElapsedMilliseconds(start);
+		glFinish();
+		double totalTime = ElapsedMilliseconds(start);
+
+		cout << left << setw(16) << (shared ? "Shared VAO" : "VAO per mesh") << "submit " << fixed << setprecision(3)
+			<< submitTime / frames << " ms/frame, with GPU " << totalTime / frames << " ms/frame" << defaultfloat << endl;
+
+		for (Cube& cube : cubes) {
+			cube.DeallocateVertexArrayBuffers();
+		}
+	}
+
+	VertexFormat::Enabled = true;
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glDeleteProgram(program);
+}
+
+//Builds the scene's programs from source and from the program cache. Drivers keep their own shader cache too, so the
+//source times after the first run of the benchmark may already be faster than a true first launch
+inline void BenchmarkProgramCache()
+{
+	const int runs = 5;
+	cout << "BENCHMARK::PROGRAM_CACHE (scene programs, average of " << runs << " runs)" << endl;
+
+	if (!GLExtensions::ProgramBinary) {
+		cout << "Program binaries not supported, every program compiles from source" << endl;
+		return;
+	}
+
+	//Keep the benchmark's binaries away from the scene's
+	std::string directory = ProgramCache::Directory;
+	ProgramCache::Directory = directory + "-benchmark";
+	ProgramCache::Clear();
+
+	auto buildPrograms = []() {
+		auto start = std::chrono::high_resolution_clock::now();
+		Shader lightCube("shaderfiles/lightCubeVertex.glsl", "shaderfiles/lightCubeFragm.glsl");
+		Shader multiLight("shaderfiles/sampleMultiLightVertex.glsl", "shaderfiles/sampleMultiLightFragm.glsl");
+		//Make sure the driver is done, some finish linking lazily
+		GLint linked = 0;
+		glGetProgramiv(lightCube.ID, GL_LINK_STATUS, &linked);
+		glGetProgramiv(multiLight.ID, GL_LINK_STATUS, &linked);
+		double time = ElapsedMilliseconds(start);
+		glDeleteProgram(lightCube.ID);
+		glDeleteProgram(multiLight.ID);
+		return time;
+	};
+
+	//Cold: from source every time
+	ProgramCache::Enabled = false;
+	double coldTime = 0.0;
+	for (int i = 0; i < runs; i++) {
+		coldTime += buildPrograms();
+	}
+
+	//Warm: the first build stores the binaries, the rest load them
+	ProgramCache::Enabled = true;
+	ProgramCache::ResetStats();
+	buildPrograms();
+	double warmTime = 0.0;
+	for (int i = 0; i < runs; i++) {
+		warmTime += buildPrograms();
+	}
+
+	cout << "Source " << coldTime / runs << " ms, cache " << warmTime / runs << " ms, "
+		<< ProgramCache::Hits << " hits " << ProgramCache::Misses << " misses " << ProgramCache::Rejected << " rejected" << endl;
+
+	ProgramCache::Clear();
+	ProgramCache::Directory = directory;
+	ProgramCache::ResetStats();
+}
+
+//Builds permutations of the multi-light program one after another (check after every step) and all at once (submit
+//everything, then check). Each permutation has its own define so the driver's shader cache can not answer for it
+inline void BenchmarkParallelCompile()
+{
+	const int permutations = 16;
+	cout << "BENCHMARK::PARALLEL_COMPILE (" << permutations << " programs, parallel shader compile "
+		<< (GLExtensions::ParallelShaderCompile ? "on" : "not supported") << ")" << endl;
+
+	ProgramCache::Enabled = false;
+	static int run = 0;
+	bool deferredModes[] = { false, true };
+	for (bool deferred : deferredModes) {
+		//A new define per run and permutation
+		run++;
+		vector<Shader> shaders;
+		shaders.reserve(permutations);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < permutations; i++) {
+			std::string defines = "#define PERMUTATION " + std::to_string(run * permutations + i);
+			shaders.emplace_back("shaderfiles/sampleMultiLightVertex.glsl", "shaderfiles/sampleMultiLightFragm.glsl", defines, deferred);
+		}
+		double submitTime = ElapsedMilliseconds(start);
+		for (Shader& shader : shaders) {
+			shader.Finish();
+		}
+		double totalTime = ElapsedMilliseconds(start);
+
+		cout << left << setw(16) << (deferred ? "Submit all" : "One by one") << "submit " << submitTime << " ms, ready after " << totalTime << " ms" << endl;
+
+		for (Shader& shader : shaders) {
+			glDeleteProgram(shader.ID);
+		}
+	}
+	ProgramCache::Enabled = true;
+	ProgramCache::ResetStats();
+}
+
+//Builds a set of generated meshes with their LODs, then reads the same meshes back from the mesh cache. CPU side only
+//(uploads are deferred and skipped), and the cache files are likely in the OS file cache, so this is the warm case
+inline void BenchmarkMeshCache()
+{
+	const int runs = 5;
+	vector<float> ratios = { 0.5f, 0.25f, 0.125f };
+	cout << "BENCHMARK::MESH_CACHE (5 meshes with LODs, average of " << runs << " runs)" << endl;
+
+	//Keep the benchmark's meshes away from the scene's
+	std::string directory = MeshCache::Directory;
+	MeshCache::Directory = directory + "-benchmark";
+	MeshCache::Clear();
+	MeshCache::ResetStats();
+	bool deferUpload = Mesh::DeferUpload;
+	Mesh::DeferUpload = true;
+
+	//Builds mesh i and its LODs, and stores it if store is set
+	auto generate = [&ratios](auto&& mesh, uint64_t key, bool store) {
+		mesh.GenerateLods(ratios);
+		if (store) {
+			MeshCache::Store(key, mesh);
+		}
+	};
+	const int meshCount = 5;
+
+	auto buildAll = [&](bool cached) {
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t bytes = 0;
+		for (int i = 0; i < meshCount; i++) {
+			uint64_t key = MeshCache::Key(MeshCache::Hash(&i, sizeof(i)), ratios);
+			Mesh loaded;
+			if (cached && MeshCache::Load(key, loaded)) {
+				bytes += loaded.Vertices.size() * sizeof(float) + loaded.Indices.size() * sizeof(unsigned int);
+				continue;
+			}
+
+			switch (i) {
+			case 0: generate(Sphere(glm::vec3(0.0f), 0.4f, 0.3f, 60, false), key, cached); break;
+			case 1: generate(Sphere(glm::vec3(0.0f), 0.4f, 0.3f, 60, false, GEODESIC_SPHERE), key, cached); break;
+			case 2: generate(Sphere(glm::vec3(0.0f), 0.4f, 0.2f, 30, true, GEODESIC_SPHERE), key, cached); break;
+			case 3: generate(Cylinder(glm::vec3(0.0f), 0.5f, 2.0f, 64, 32, true, true), key, cached); break;
+			default: generate(Cylinder(glm::vec3(0.0f), 0.5f, 0.75f, 40, 3, false, true), key, cached); break;
+			}
+		}
+		return std::make_pair(ElapsedMilliseconds(start), bytes);
+	};
+
+	//Generate: nothing cached
+	double generateTime = 0.0;
+	for (int r = 0; r < runs; r++) {
+		generateTime += buildAll(false).first;
+	}
+
+	//Cache: the first run stores the meshes, the rest load them
+	buildAll(true);
+	MeshCache::ResetStats();
+	double cacheTime = 0.0;
+	size_t bytes = 0;
+	for (int r = 0; r < runs; r++) {
+		auto result = buildAll(true);
+		cacheTime += result.first;
+		bytes = result.second;
+	}
+
+	cout << "Generate " << generateTime / runs << " ms, cache " << cacheTime / runs << " ms (" << bytes / 1024 << " KB of vertices and indices), "
+		<< MeshCache::Hits << " hits " << MeshCache::Misses << " misses" << endl;
+
+	Mesh::DeferUpload = deferUpload;
+	MeshCache::Clear();
+	MeshCache::Directory = directory;
+	MeshCache::ResetStats();
+}
+
+//Runs every benchmark
+//Writes a grid of quads as an OBJ (quad faces, fanned by the importer) and as a GLB, both with positions, normals and UVs
+inline void WriteImportBenchmarkFiles(int quads, const std::string& objPath, const std::string& glbPath)
+{
+	int side = quads + 1;
+	size_t vertexCount = static_cast<size_t>(side) * side;
+
+	std::ofstream obj(objPath, std::ios::binary | std::ios::trunc);
+	char line[128];
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			obj.write(line, snprintf(line, sizeof(line), "v %.4f %.4f 0\nvt %.4f %.4f\nvn 0 0 1\n",
+				x / static_cast<float>(quads), y / static_cast<float>(quads), x / static_cast<float>(quads), y / static_cast<float>(quads)));
+		}
+	}
+	for (int y = 0; y < quads; y++) {
+		for (int x = 0; x < quads; x++) {
+			int a = y * side + x + 1, b = a + 1, c = a + side + 1, d = a + side;
+			obj.write(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c, d, d, d));
+		}
+	}
+	obj.close();
+
+	//GLB: positions, normals, UVs and indices in one buffer, one view each
+	vector<float> attributes;
+	attributes.reserve(vertexCount * 8);
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			float u = x / static_cast<float>(quads), v = y / static_cast<float>(quads);
+			attributes.insert(attributes.end(), { u, v, 0.0f });
+		}
+	}
+	for (size_t i = 0; i < vertexCount; i++) {
+		attributes.insert(attributes.end(), { 0.0f, 0.0f, 1.0f });
+	}
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			attributes.insert(attributes.end(), { x / static_cast<float>(quads), y / static_cast<float>(quads) });
+		}
+	}
+	vector<uint32_t> indices;
+	indices.reserve(static_cast<size_t>(quads) * quads * 6);
+	for (int y = 0; y < quads; y++) {
+		for (int x = 0; x < quads; x++) {
+			uint32_t a = y * side + x, b = a + 1, c = a + side + 1, d = a + side;
+			indices.insert(indices.end(), { a, b, c, a, c, d });
+		}
+	}
+
+	size_t positionBytes = vertexCount * 12, normalBytes = vertexCount * 12, uvBytes = vertexCount * 8, indexBytes = indices.size() * 4;
+	size_t binaryBytes = positionBytes + normalBytes + uvBytes + indexBytes;
+	std::string json = "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":" + std::to_string(binaryBytes) + "}],"
+		"\"bufferViews\":["
+		"{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + std::to_string(positionBytes) + "},"
+		"{\"buffer\":0,\"byteOffset\":" + std::to_string(positionBytes) + ",\"byteLength\":" + std::to_string(normalBytes) + "},"
+		"{\"buffer\":0,\"byteOffset\":" + std::to_string(positionBytes + normalBytes) + ",\"byteLength\":" + std::to_string(uvBytes) + "},"
+		"{\"buffer\":0,\"byteOffset\":" + std::to_string(positionBytes + normalBytes + uvBytes) + ",\"byteLength\":" + std::to_string(indexBytes) + "}],"
+		"\"accessors\":["
+		"{\"bufferView\":0,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) + ",\"type\":\"VEC3\"},"
+		"{\"bufferView\":1,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) + ",\"type\":\"VEC3\"},"
+		"{\"bufferView\":2,\"componentType\":5126,\"count\":" + std::to_string(vertexCount) + ",\"type\":\"VEC2\"},"
+		"{\"bufferView\":3,\"componentType\":5125,\"count\":" + std::to_string(indices.size()) + ",\"type\":\"SCALAR\"}],"
+		"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}]}";
+	while (json.size() % 4 != 0) {
+		json.push_back(' ');
+	}
+
+	uint32_t header[5] = { 0x46546C67, 2, static_cast<uint32_t>(12 + 8 + json.size() + 8 + binaryBytes),
+		static_cast<uint32_t>(json.size()), 0x4E4F534A };
+	uint32_t binaryHeader[2] = { static_cast<uint32_t>(binaryBytes), 0x004E4942 };
+	std::ofstream glb(glbPath, std::ios::binary | std::ios::trunc);
+	glb.write(reinterpret_cast<const char*>(header), sizeof(header));
+	glb.write(json.data(), json.size());
+	glb.write(reinterpret_cast<const char*>(binaryHeader), sizeof(binaryHeader));
+	glb.write(reinterpret_cast<const char*>(attributes.data()), attributes.size() * sizeof(float));
+	glb.write(reinterpret_cast<const char*>(indices.data()), indexBytes);
+}
+
+//Parse throughput of the importers on a 2 million triangle file (parsing only, the mesh is not optimized or uploaded)
+inline void BenchmarkImport()
+{
+	const int quads = 1000;
+	const std::string objPath = "benchmark-import.obj", glbPath = "benchmark-import.glb";
+	cout << "BENCHMARK::IMPORT (" << quads * quads * 2 << " triangles)" << endl;
+	WriteImportBenchmarkFiles(quads, objPath, glbPath);
+
+	auto report = [](const char* name, const MappedFile& file, auto&& parse) {
+		vector<float> vertices;
+		vector<unsigned int> indices;
+		auto start = std::chrono::high_resolution_clock::now();
+		bool ok = parse(file, vertices, indices);
+		double time = ElapsedMilliseconds(start);
+		if (!ok) {
+			cout << name << " FAILED" << endl;
+			return;
+		}
+		cout << left << setw(16) << name << right << fixed << setprecision(1) << time << " ms, "
+			<< indices.size() / 3 / (time * 1000.0) << " M triangles/s, " << vertices.size() / 11 << " vertices, "
+			<< file.Size() / (1024 * 1024) << " MB" << defaultfloat << endl;
+	};
+
+	MappedFile obj, glb;
+	if (!obj.Open(objPath) || !glb.Open(glbPath)) {
+		cout << "ERROR::BENCHMARK::IMPORT_FILES_NOT_WRITTEN" << endl;
+		return;
+	}
+	unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+	report("OBJ 1 thread", obj, [](const MappedFile& file, vector<float>& vertices, vector<unsigned int>& indices) {
+		return MeshImporter::ParseObj(file.Data(), file.Size(), vertices, indices, 1);
+	});
+	if (threads > 1) {
+		std::string threadsName = "OBJ " + std::to_string(threads) + " threads";
+		report(threadsName.c_str(), obj, [threads](const MappedFile& file, vector<float>& vertices, vector<unsigned int>& indices) {
+			return MeshImporter::ParseObj(file.Data(), file.Size(), vertices, indices, threads);
+		});
+	}
+	report("GLB", glb, [](const MappedFile& file, vector<float>& vertices, vector<unsigned int>& indices) {
+		return MeshImporter::ParseGltf(file.Data(), file.Size(), ".", vertices, indices);
+	});
+
+	obj.Close();
+	glb.Close();
+	std::error_code error;
+	std::filesystem::remove(objPath, error);
+	std::filesystem::remove(glbPath, error);
+}
+
+//Scene file load times on a generated scene of 100k objects and 20k instances: the text parser, writing the binary form and
+//loading it back in place. The loads start from the file in memory, so disk speed is left out
+inline void BenchmarkSceneFile()
+{
+	const size_t objectCount = 100000, instanceCount = 20000;
+	const std::string textPath = "benchmark-scene.scene", binaryPath = "benchmark-scene.scnb";
+	cout << "BENCHMARK::SCENE FILE (" << objectCount << " objects, " << instanceCount << " instances)" << endl;
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+	{
+		std::ofstream text(textPath);
+		text << std::setprecision(4);
+		text << "texture diffuse textures/diffuse.jpg\ntexture specular textures/specular.png clampu\n";
+		text << "material plain diffuse specular\nmaterial shiny diffuse specular shininess 64\n";
+		text << "sphere plain 0 0 0 0.4 0.3 15 0 geodesic in pumpkin\n";
+		for (size_t i = 0; i < objectCount; i++) {
+			const char* material = (i & 1) ? "plain" : "shiny";
+			float x = coordinate(random), y = coordinate(random), z = coordinate(random);
+			switch (i % 3) {
+			case 0:
+				text << "cylinder " << material << " " << x << " " << y << " " << z << " 0.5 0.75 40 3 0 1\n";
+				break;
+			case 1:
+				text << "sphere " << material << " " << x << " " << y << " " << z << " 0.4 0.2 30 1 uv\n";
+				break;
+			default:
+				text << "plane " << material << " " << x << " " << y << " " << z << " 2 2\n";
+			}
+		}
+		for (size_t i = 0; i < instanceCount; i++) {
+			float x = coordinate(random), y = coordinate(random), z = coordinate(random);
+			text << "instance pumpkin " << x << " " << y << " " << z << " 0.5 45\n";
+		}
+	}
+
+	auto readFile = [](const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		return vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	};
+	auto report = [](const char* name, double time, size_t bytes, bool ok) {
+		cout << left << setw(14) << name << right << fixed << setprecision(1) << time << " ms, " << bytes / 1024 << " KB"
+			<< (ok ? "" : " FAILED") << defaultfloat << endl;
+	};
+
+	//The text parser needs a terminator after the text
+	vector<char> text = readFile(textPath);
+	size_t textBytes = text.size();
+	text.push_back('\0');
+	Scene scene;
+	auto start = std::chrono::high_resolution_clock::now();
+	bool parsed = scene.LoadText(std::move(text));
+	report("Text", ElapsedMilliseconds(start), textBytes, parsed && scene.Objects.size() == objectCount + 1);
+
+	start = std::chrono::high_resolution_clock::now();
+	bool written = parsed && scene.WriteBinary(binaryPath);
+	double writeTime = ElapsedMilliseconds(start);
+	vector<char> binary = readFile(binaryPath);
+	report("Write binary", writeTime, binary.size(), written);
+
+	size_t binaryBytes = binary.size();
+	Scene loaded;
+	start = std::chrono::high_resolution_clock::now();
+	bool loadedBinary = loaded.LoadBinary(std::move(binary));
+	report("Binary", ElapsedMilliseconds(start), binaryBytes,
+		loadedBinary && loaded.Objects.size() == objectCount + 1 && loaded.Instances.size() == instanceCount);
+
+	std::error_code error;
+	std::filesystem::remove(textPath, error);
+	std::filesystem::remove(binaryPath, error);
+}
+
+//Scene graph update cost on 1000 roots with 10 children and 100 grandchildren each: a full recompute against the dirty
+//flag update when nothing, a few leaves or a few whole subtrees moved
+inline void BenchmarkSceneGraph()
+{
+	SceneGraph graph;
+	vector<int> roots, leaves;
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+	auto randomLocal = [&]() {
+		glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(offset(random), offset(random), offset(random)));
+		return glm::rotate(local, offset(random), glm::vec3(0.0f, 1.0f, 0.0f));
+	};
+	for (int r = 0; r < 1000; r++) {
+		roots.push_back(graph.Add(randomLocal()));
+		for (int c = 0; c < 10; c++) {
+			int child = graph.Add(randomLocal(), roots.back());
+			for (int g = 0; g < 10; g++) {
+				leaves.push_back(graph.Add(randomLocal(), child));
+			}
+		}
+	}
+	graph.Update();
+	cout << "BENCHMARK::SCENE_GRAPH (" << graph.Size() << " nodes)" << endl;
+
+	const int frames = 100;
+	auto report = [&](const char* name, auto&& move, bool full) {
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t updated = 0;
+		for (int frame = 0; frame < frames; frame++) {
+			move();
+			updated += full ? graph.UpdateAll() : graph.Update();
+		}
+		double time = ElapsedMilliseconds(start) / frames;
+		cout << left << setw(24) << name << right << fixed << setprecision(3) << time << " ms/frame, "
+			<< updated / frames << " nodes updated" << defaultfloat << endl;
+	};
+
+	report("Full recompute", []() {}, true);
+	report("Nothing moved", []() {}, false);
+	report("10 leaves moved", [&]() {
+		for (int i = 0; i < 10; i++) {
+			int leaf = leaves[random() % leaves.size()];
+			graph.SetLocal(leaf, randomLocal());
+		}
+	}, false);
+	report("10 subtrees moved", [&]() {
+		for (int i = 0; i < 10; i++) {
+			int root = roots[random() % roots.size()];
+			graph.SetLocal(root, randomLocal());
+		}
+	}, false);
+
+	//The dirty updates must match a full recompute
+	vector<glm::mat4> incremental;
+	for (int leaf : leaves) {
+		incremental.push_back(graph.World(leaf));
+	}
+	graph.UpdateAll();
+	float maxError = 0.0f;
+	for (size_t i = 0; i < leaves.size(); i++) {
+		for (int c = 0; c < 4; c++) {
+			maxError = std::max(maxError, glm::length(graph.World(leaves[i])[c] - incremental[i][c]));
+		}
+	}
+	cout << "Max difference to a full recompute: " << maxError << endl;
+}
+
+//Per-frame CPU cost of culling, sorting and walking the draw list, with the objects as a vector of Mesh (the transform,
+//bounds, GL handles, textures and vertex vectors of each in one object) against the packed RenderObjects arrays. Nothing
+//is drawn, the submission only reads what a draw would send (the model matrix)
+inline void BenchmarkRenderObjects()
+{
+	cout << "BENCHMARK::RENDER_OBJECTS" << endl;
+	glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f)
+		* glm::lookAt(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(100.0f, 0.0f, 100.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	Frustum frustum(viewProjection);
+	glm::vec3 cameraPosition = glm::vec3(0.0f, 20.0f, 0.0f);
+	const int frames = 20;
+
+	for (int count : { 10000, 100000 }) {
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> coordinate(-300.0f, 300.0f);
+		vector<Mesh> meshes(count);
+		RenderObjects objects;
+		for (int i = 0; i < count; i++) {
+			Mesh& mesh = meshes[i];
+			mesh.LocalTransform = glm::translate(glm::mat4(1.0f), glm::vec3(coordinate(random), 0.0f, coordinate(random)));
+			mesh.BoundsRadius = 1.0f;
+			mesh.VAO = 1 + random() % 64;
+			Texture2D texture;
+			texture.Texture = 1 + random() % 16;
+			mesh.SetTextures(texture, texture);
+			objects.Create(mesh.LocalTransform, glm::vec4(mesh.BoundsCenter, mesh.BoundsRadius), mesh.VAO, texture.Texture, 0);
+		}
+
+		double meshChecksum = 0.0, objectChecksum = 0.0;
+		size_t drawn = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		vector<std::pair<uint64_t, Mesh*>> meshList;
+		for (int frame = 0; frame < frames; frame++) {
+			meshList.clear();
+			for (Mesh& mesh : meshes) {
+				float scale = MeshletCuller::MaxScale(mesh.LocalTransform);
+				glm::vec3 center = glm::vec3(mesh.LocalTransform * glm::vec4(mesh.BoundsCenter, 1.0f));
+				if (frustum.IntersectsSphere(center, mesh.BoundsRadius * scale)) {
+					uint32_t depth = static_cast<uint32_t>(glm::length(center - cameraPosition) * 16.0f);
+					meshList.push_back({ (static_cast<uint64_t>(mesh.GetDiffuseTexture()) << 44) | (static_cast<uint64_t>(mesh.VAO) << 24) | depth, &mesh });
+				}
+			}
+			std::sort(meshList.begin(), meshList.end());
+			for (const auto& entry : meshList) {
+				meshChecksum += entry.second->LocalTransform[3][0];
+			}
+			drawn = meshList.size();
+		}
+		double meshTime = ElapsedMilliseconds(start) / frames;
+
+		vector<uint32_t> visible;
+		start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			objects.Cull(frustum, visible);
+			objects.Sort(visible, cameraPosition);
+			for (uint32_t index : visible) {
+				objectChecksum += objects.Transforms[index][3][0];
+			}
+		}
+		double objectTime = ElapsedMilliseconds(start) / frames;
+
+		cout << left << setw(8) << count << "objects, " << drawn << " visible: vector<Mesh> " << right << fixed << setprecision(3) << meshTime
+			<< " ms, RenderObjects " << objectTime << " ms (" << setprecision(1) << meshTime / objectTime << "x)"
+			<< (visible.size() == drawn && std::abs(meshChecksum - objectChecksum) < 1e-6 * std::abs(meshChecksum) + 1.0 ? "" : " MISMATCH") << defaultfloat << endl;
+	}
+}
+
+//Per-frame preparation of 200k render objects (3000 scene graph roots moving each frame, transforms copied, culled, sort
+//keys built and sorted) as a FrameGraph on a JobSystem, at 1, 2, 4... threads up to the core count
+inline void BenchmarkJobSystem()
+{
+	SceneGraph graph;
+	RenderObjects objects;
+	vector<int> roots;
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> coordinate(-300.0f, 300.0f);
+	for (int r = 0; r < 20000; r++) {
+		roots.push_back(graph.Add(glm::translate(glm::mat4(1.0f), glm::vec3(coordinate(random), 0.0f, coordinate(random)))));
+		for (int c = 0; c < 10; c++) {
+			int node = graph.Add(glm::translate(glm::mat4(1.0f), glm::vec3(c * 0.5f, 0.0f, 0.0f)), roots.back());
+			objects.Create(glm::mat4(1.0f), glm::vec4(0.0f, 0.0f, 0.0f, 0.5f), random() % 64, random() % 16, 0, node);
+		}
+	}
+	graph.Update();
+	objects.SyncTransforms(graph);
+
+	Frustum frustum(glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f)
+		* glm::lookAt(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(100.0f, 0.0f, 100.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	glm::vec3 cameraPosition = glm::vec3(0.0f, 20.0f, 0.0f);
+	cout << "BENCHMARK::JOB_SYSTEM (" << objects.Size() << " objects)" << endl;
+
+	unsigned int cores = std::max(std::thread::hardware_concurrency(), 1u);
+	vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < cores; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(cores);
+
+	double singleThread = 0.0;
+	for (unsigned int threads : threadCounts) {
+		JobSystem jobs(threads - 1);
+		const size_t grain = 1024;
+		vector<vector<uint32_t>> pieces(JobSystem::PieceCount(objects.Size(), grain));
+		vector<uint32_t> visible;
+		vector<std::pair<uint64_t, uint32_t>> keys;
+
+		FrameGraph frame;
+		int transforms = frame.Add("Transforms", TASK_WORKER, [&]() {
+			graph.Update();
+			jobs.ParallelFor(objects.Size(), grain, [&](size_t first, size_t last) { objects.SyncTransforms(graph, first, last); });
+		});
+		int cull = frame.Add("Cull", TASK_WORKER, [&]() {
+			jobs.ParallelFor(objects.Size(), grain, [&](size_t first, size_t last) {
+				pieces[first / grain].clear();
+				objects.CullRange(frustum, first, last, pieces[first / grain]);
+			});
+			visible.clear();
+			for (const vector<uint32_t>& piece : pieces) {
+				visible.insert(visible.end(), piece.begin(), piece.end());
+			}
+		}, { transforms });
+		frame.Add("Sort", TASK_WORKER, [&]() {
+			keys.resize(visible.size());
+			jobs.ParallelFor(visible.size(), grain, [&](size_t first, size_t last) {
+				for (size_t i = first; i < last; i++) {
+					keys[i] = { objects.SortKey(visible[i], cameraPosition), visible[i] };
+				}
+			});
+			jobs.ParallelSort(keys, grain);
+		}, { cull });
+
+		const int frames = 20;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int f = 0; f < frames; f++) {
+			for (int i = 0; i < 3000; i++) {
+				int root = roots[random() % roots.size()];
+				graph.SetLocal(root, glm::translate(graph.Local(root), glm::vec3(0.01f, 0.0f, 0.0f)));
+			}
+			frame.Run(jobs);
+		}
+		double time = ElapsedMilliseconds(start) / frames;
+		if (threads == 1) {
+			singleThread = time;
+		}
+		bool sorted = std::is_sorted(keys.begin(), keys.end());
+		cout << left << setw(4) << threads << "threads " << right << fixed << setprecision(3) << time << " ms/frame, "
+			<< setprecision(2) << singleThread / time << "x, " << visible.size() << " visible" << (sorted ? "" : " UNSORTED") << defaultfloat << endl;
+	}
+}
+
+inline void RunBenchmarks()
+{
+	BenchmarkSphereTessellation();
+	BenchmarkMeshOptimization();
+	BenchmarkSimplification();
+	BenchmarkBufferPool();
+	BenchmarkVertexFormat();
+	BenchmarkProgramCache();
+	BenchmarkParallelCompile();
+	BenchmarkMeshCache();
+	BenchmarkImport();
+	BenchmarkSceneFile();
+	BenchmarkSceneGraph();
+	BenchmarkRenderObjects();
+	BenchmarkJobSystem();
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef BLOCKCOMPRESSION_H
+#define BLOCKCOMPRESSION_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+using std::vector;
+
+//Byte-oriented LZ77 compression in the LZ4 block format: a stream of sequences, each a token (literal length in the high
+//4 bits, match length - 4 in the low 4 bits, 15 means more length bytes follow), the literals, then a 2 byte little endian
+//offset back into the output. The last sequence is literals only. Decoding is a loop of copies with no entropy stage, so it
+//runs at memory speed, which is what matters for assets that are compressed once when packing and decoded on every launch.
+//The compressor is the greedy single-probe kind (one hash table slot per 4 byte prefix), fast rather than tight.
+class BlockCompression
+{
+public:
+	//Largest possible compressed size of size bytes (incompressible data grows by the length bytes)
+	static size_t Bound(size_t size)
+	{
+		return size + size / 255 + 16;
+	}
+
+	//Compresses size bytes of source and returns the block
+	static vector<char> Compress(const char* source, size_t size)
+	{
+		vector<char> block;
+		block.reserve(Bound(size));
+
+		const unsigned char* input = reinterpret_cast<const unsigned char*>(source);
+		size_t anchor = 0;
+
+		//The format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end
+		if (size > MinInput) {
+			vector<int64_t> table(static_cast<size_t>(1) << HashBits, -1);
+			size_t matchStartLimit = size - LastMatchDistance;
+			size_t matchEndLimit = size - LastLiterals;
+
+			for (size_t i = 0; i < matchStartLimit;) {
+				uint32_t sequence = Read32(input + i);
+				uint32_t hash = (sequence * 2654435761u) >> (32 - HashBits);
+				int64_t candidate = table[hash];
+				table[hash] = static_cast<int64_t>(i);
+
+				if (candidate < 0 || i - static_cast<size_t>(candidate) > MaxOffset || Read32(input + candidate) != sequence) {
+					i++;
+					continue;
+				}
+
+				size_t length = MinMatch;
+				while (i + length < matchEndLimit && input[candidate + length] == input[i + length]) {
+					length++;
+				}
+
+				WriteSequence(block, input + anchor, i - anchor, static_cast<uint16_t>(i - candidate), length);
+				i += length;
+				anchor = i;
+			}
+		}
+
+		//Trailing literals
+		size_t literals = size - anchor;
+		block.push_back(static_cast<char>(std::min<size_t>(literals, 15) << 4));
+		WriteLength(block, literals);
+		block.insert(block.end(), source + anchor, source + size);
+		return block;
+	}
+
+	//Decodes a block into exactly destinationSize bytes. Returns false if the block is malformed or does not decode to
+	//that size, nothing is read or written outside the two buffers either way
+	static bool Decompress(const char* source, size_t sourceSize, char* destination, size_t destinationSize)
+	{
+		const unsigned char* input = reinterpret_cast<const unsigned char*>(source);
+		const unsigned char* inputEnd = input + sourceSize;
+		unsigned char* output = reinterpret_cast<unsigned char*>(destination);
+		unsigned char* outputEnd = output + destinationSize;
+
+		while (input < inputEnd) {
+			unsigned int token = *input++;
+
+			size_t literals = token >> 4;
+			if (literals == 15 && !ReadLength(input, inputEnd, literals)) {
+				return false;
+			}
+			if (literals > static_cast<size_t>(inputEnd - input) || literals > static_cast<size_t>(outputEnd - output)) {
+				return false;
+			}
+			if (literals > 0) {
+				memcpy(output, input, literals);
+			}
+			input += literals;
+			output += literals;
+
+			//The last sequence has no match
+			if (input == inputEnd) {
+				break;
+			}
+
+			if (inputEnd - input < 2) {
+				return false;
+			}
+			size_t offset = input[0] | (input[1] << 8);
+			input += 2;
+			if (offset == 0 || offset > static_cast<size_t>(output - reinterpret_cast<unsigned char*>(destination))) {
+				return false;
+			}
+
+			size_t length = token & 15;
+			if (length == 15 && !ReadLength(input, inputEnd, length)) {
+				return false;
+			}
+			length += MinMatch;
+			if (length > static_cast<size_t>(outputEnd - output)) {
+				return false;
+			}
+
+			//Matches may overlap their own output (offset < length repeats a pattern), those are copied byte by byte
+			const unsigned char* match = output - offset;
+			if (offset >= length) {
+				memcpy(output, match, length);
+				output += length;
+			}
+			else {
+				for (size_t i = 0; i < length; i++) {
+					*output++ = match[i];
+				}
+			}
+		}
+
+		return output == outputEnd;
+	}
+
+private:
+	static const size_t MinMatch = 4;
+	static const size_t LastLiterals = 5;
+	static const size_t LastMatchDistance = 12;
+	static const size_t MinInput = 13;
+	static const size_t MaxOffset = 65535;
+	static const int HashBits = 14;
+
+	static uint32_t Read32(const unsigned char* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	//Writes the bytes after a token field of 15: runs of 255, then the rest
+	static void WriteLength(vector<char>& block, size_t length)
+	{
+		if (length < 15) {
+			return;
+		}
+		for (length -= 15; length >= 255; length -= 255) {
+			block.push_back(static_cast<char>(255));
+		}
+		block.push_back(static_cast<char>(length));
+	}
+
+	//Adds the bytes after a token field of 15 to length
+	static bool ReadLength(const unsigned char*& input, const unsigned char* inputEnd, size_t& length)
+	{
+		unsigned int byte;
+		do {
+			if (input == inputEnd) {
+				return false;
+			}
+			byte = *input++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	static void WriteSequence(vector<char>& block, const unsigned char* literals, size_t literalCount, uint16_t offset, size_t matchLength)
+	{
+		size_t matchCode = matchLength - MinMatch;
+		block.push_back(static_cast<char>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(matchCode, 15)));
+		WriteLength(block, literalCount);
+		block.insert(block.end(), reinterpret_cast<const char*>(literals), reinterpret_cast<const char*>(literals) + literalCount);
+		block.push_back(static_cast<char>(offset & 0xFF));
+		block.push_back(static_cast<char>(offset >> 8));
+		WriteLength(block, matchCode);
+	}
+};
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <iostream>
+
+using std::vector;
+
+//Binary buddy allocator over a range of elements. Blocks are powers of two of the minimum block and are always aligned to
+//their size, so two blocks either nest or do not touch. Free blocks are kept per size, lowest offset first.
+class BuddyAllocator
+{
+public:
+	static const unsigned int InvalidOffset = ~0u;
+
+	BuddyAllocator() {}
+
+	//capacity is rounded up to a power of two times minBlock
+	BuddyAllocator(unsigned int capacity, unsigned int minBlock)
+	{
+		MinBlock = std::max(1u, minBlock);
+		MaxOrder = 0;
+		while ((MinBlock << MaxOrder) < capacity) {
+			MaxOrder++;
+		}
+		Capacity = MinBlock << MaxOrder;
+
+		freeLists.assign(MaxOrder + 1, std::set<unsigned int>());
+		freeLists[MaxOrder].insert(0);
+		blockOrder.assign(Capacity / MinBlock, -1);
+	}
+
+	unsigned int Capacity = 0;
+	unsigned int MinBlock = 1;
+	int MaxOrder = 0;
+
+	//Returns the offset of a block holding count elements, InvalidOffset if none is free
+	unsigned int Allocate(unsigned int count)
+	{
+		return AllocateBelow(count, Capacity, false);
+	}
+
+	//Returns the lowest free block below limit that holds count elements (used to move data down), InvalidOffset if none
+	unsigned int AllocateLowest(unsigned int count, unsigned int limit)
+	{
+		return AllocateBelow(count, limit, true);
+	}
+
+	//Frees a block returned by Allocate, merging it with its free buddies
+	void Free(unsigned int offset)
+	{
+		int order = blockOrder[offset / MinBlock];
+		if (order < 0) {
+			std::cout << "ERROR::BUDDY::FREE_OF_UNALLOCATED_BLOCK" << std::endl;
+			return;
+		}
+		blockOrder[offset / MinBlock] = -1;
+		UsedElements -= BlockSize(order);
+
+		while (order < MaxOrder) {
+			unsigned int buddy = offset ^ BlockSize(order);
+			auto found = freeLists[order].find(buddy);
+			if (found == freeLists[order].end()) {
+				break;
+			}
+			freeLists[order].erase(found);
+			offset = std::min(offset, buddy);
+			order++;
+		}
+		freeLists[order].insert(offset);
+	}
+
+	//Size of the block at offset, 0 if it is not allocated
+	unsigned int AllocatedSize(unsigned int offset) const
+	{
+		int order = blockOrder[offset / MinBlock];
+		return (order < 0) ? 0 : BlockSize(order);
+	}
+
+	//Elements in allocated blocks (including the rounding up to block sizes)
+	unsigned int UsedElements = 0;
+
+	//Largest block that could be allocated right now
+	unsigned int LargestFreeBlock() const
+	{
+		for (int order = MaxOrder; order >= 0; order--) {
+			if (!freeLists[order].empty()) {
+				return BlockSize(order);
+			}
+		}
+		return 0;
+	}
+
+	unsigned int BlockSize(int order) const
+	{
+		return MinBlock << order;
+	}
+
+	//Smallest order whose block holds count elements, -1 if it is larger than the whole range
+	int OrderFor(unsigned int count) const
+	{
+		int order = 0;
+		while (order <= MaxOrder && BlockSize(order) < count) {
+			order++;
+		}
+		return (order > MaxOrder) ? -1 : order;
+	}
+
+private:
+	vector<std::set<unsigned int>> freeLists;
+	vector<int> blockOrder; //Order of the allocated block starting at each minimum block, -1 if none starts there
+
+	//Takes a free block of at least the order for count, below limit. lowest picks the lowest offset over every size
+	//(for compaction), otherwise the smallest size that fits is used to keep large blocks whole
+	unsigned int AllocateBelow(unsigned int count, unsigned int limit, bool lowest)
+	{
+		int order = OrderFor(std::max(count, 1u));
+		if (order < 0) {
+			return InvalidOffset;
+		}
+
+		int foundOrder = -1;
+		unsigned int foundOffset = InvalidOffset;
+		for (int o = order; o <= MaxOrder; o++) {
+			if (freeLists[o].empty() || *freeLists[o].begin() >= limit) {
+				continue;
+			}
+			if (!lowest) {
+				foundOrder = o;
+				foundOffset = *freeLists[o].begin();
+				break;
+			}
+			if (*freeLists[o].begin() < foundOffset) {
+				foundOrder = o;
+				foundOffset = *freeLists[o].begin();
+			}
+		}
+
+		if (foundOrder < 0) {
+			return InvalidOffset;
+		}
+
+		//Split down, keeping the low half
+		freeLists[foundOrder].erase(foundOffset);
+		while (foundOrder > order) {
+			foundOrder--;
+			freeLists[foundOrder].insert(foundOffset + BlockSize(foundOrder));
+		}
+
+		blockOrder[foundOffset / MinBlock] = order;
+		UsedElements += BlockSize(order);
+		return foundOffset;
+	}
+};
+
+//Usage of a BufferPool, in bytes
+struct BufferPoolStats
+{
+	size_t CapacityBytes = 0;
+	size_t UsedBytes = 0;            //Allocated blocks
+	size_t RequestedBytes = 0;       //What the allocations asked for, the rest of UsedBytes is rounding
+	size_t LargestFreeBytes = 0;
+	unsigned int Allocations = 0;
+
+	//0 when all free space is one block, towards 1 as it splits into small pieces
+	float Fragmentation() const
+	{
+		size_t freeBytes = CapacityBytes - UsedBytes;
+		return (freeBytes == 0) ? 0.0f : 1.0f - static_cast<float>(LargestFreeBytes) / static_cast<float>(freeBytes);
+	}
+};
+
+//One large GL buffer of fixed size, carved into element ranges by a buddy allocator, so meshes can come and go without
+//creating or deleting GL objects. Allocations are handles: Compact moves data towards the front with glCopyBufferSubData
+//and the handle's offset follows, so read offsets through GetOffset when drawing.
+class BufferPool
+{
+public:
+	static const int InvalidHandle = -1;
+
+	unsigned int Buffer = 0;
+	GLenum Target = GL_ARRAY_BUFFER;
+	unsigned int ElementSize = 1;
+
+	//Bumped whenever Compact moves something
+	unsigned int Generation = 0;
+
+	BufferPool() {}
+
+	//Creates the buffer. Sizes are in elements (a whole vertex or a whole index), so every offset is usable as a base vertex or first index
+	BufferPool(GLenum target, unsigned int elementSize, unsigned int capacity, unsigned int minBlock = 64)
+	{
+		Target = target;
+		ElementSize = elementSize;
+		allocator = BuddyAllocator(capacity, minBlock);
+
+		glGenBuffers(1, &Buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(allocator.Capacity) * ElementSize, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	//Reserves count elements, returns a handle or InvalidHandle when the pool is full
+	int Allocate(unsigned int count)
+	{
+		unsigned int offset = allocator.Allocate(count);
+		if (offset == BuddyAllocator::InvalidOffset) {
+			std::cout << "ERROR::BUFFERPOOL::OUT_OF_SPACE " << count << " ELEMENTS" << std::endl;
+			return InvalidHandle;
+		}
+
+		int handle;
+		if (!freeHandles.empty()) {
+			handle = freeHandles.back();
+			freeHandles.pop_back();
+		}
+		else {
+			handle = static_cast<int>(allocations.size());
+			allocations.push_back(Allocation());
+		}
+
+		allocations[handle].Offset = offset;
+		allocations[handle].Count = count;
+		allocations[handle].Live = true;
+		requestedElements += count;
+		return handle;
+	}
+
+	//Writes count elements at the start of an allocation
+	void Upload(int handle, const void* data, unsigned int count)
+	{
+		const Allocation& allocation = allocations[handle];
+		glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation.Offset) * ElementSize, static_cast<GLsizeiptr>(std::min(count, allocation.Count)) * ElementSize, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	//Returns the range to the pool
+	void Free(int handle)
+	{
+		if (handle < 0 || handle >= static_cast<int>(allocations.size()) || !allocations[handle].Live) {
+			return;
+		}
+
+		allocator.Free(allocations[handle].Offset);
+		requestedElements -= allocations[handle].Count;
+		allocations[handle].Live = false;
+		freeHandles.push_back(handle);
+	}
+
+	//Elements an allocation of count really takes, to size a pool up front
+	static unsigned int BlockSizeFor(unsigned int count, unsigned int minBlock = 64)
+	{
+		unsigned int size = std::max(1u, minBlock);
+		while (size < count) {
+			size <<= 1;
+		}
+		return size;
+	}
+
+	//Current first element of an allocation
+	unsigned int GetOffset(int handle) const
+	{
+		return allocations[handle].Offset;
+	}
+
+	//Moves allocations from the back of the buffer into free blocks nearer the front, copying about budgetBytes (at least one
+	//allocation if any can move). Meant to run a little every frame, returns the bytes moved
+	size_t Compact(size_t budgetBytes)
+	{
+		//Highest offsets first, they are the ones splitting the free space
+		vector<int> order;
+		for (size_t i = 0; i < allocations.size(); i++) {
+			if (allocations[i].Live) {
+				order.push_back(static_cast<int>(i));
+			}
+		}
+		std::sort(order.begin(), order.end(), [&](int a, int b) { return allocations[a].Offset > allocations[b].Offset; });
+
+		size_t moved = 0;
+		for (int handle : order) {
+			Allocation& allocation = allocations[handle];
+			size_t bytes = static_cast<size_t>(allocation.Count) * ElementSize;
+			if (moved > 0 && moved + bytes > budgetBytes) {
+				break;
+			}
+
+			unsigned int target = allocator.AllocateLowest(allocation.Count, allocation.Offset);
+			if (target == BuddyAllocator::InvalidOffset) {
+				continue;
+			}
+
+			//Blocks are aligned to their size, so the old and new ranges never overlap
+			glBindBuffer(GL_COPY_READ_BUFFER, Buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, Buffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(allocation.Offset) * ElementSize,
+				static_cast<GLintptr>(target) * ElementSize, static_cast<GLsizeiptr>(bytes));
+
+			allocator.Free(allocation.Offset);
+			allocation.Offset = target;
+			moved += bytes;
+		}
+
+		if (moved > 0) {
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			Generation++;
+		}
+		return moved;
+	}
+
+	BufferPoolStats GetStats() const
+	{
+		BufferPoolStats stats;
+		stats.CapacityBytes = static_cast<size_t>(allocator.Capacity) * ElementSize;
+		stats.UsedBytes = static_cast<size_t>(allocator.UsedElements) * ElementSize;
+		stats.RequestedBytes = requestedElements * ElementSize;
+		stats.LargestFreeBytes = static_cast<size_t>(allocator.LargestFreeBlock()) * ElementSize;
+		stats.Allocations = static_cast<unsigned int>(allocations.size() - freeHandles.size());
+		return stats;
+	}
+
+	//Prints the stats with a name
+	void PrintStats(const char* name) const
+	{
+		BufferPoolStats stats = GetStats();
+		std::cout << "BUFFERPOOL::" << name << " ALLOCATIONS " << stats.Allocations
+			<< " USED " << stats.UsedBytes / 1024 << "/" << stats.CapacityBytes / 1024 << " KB"
+			<< " REQUESTED " << stats.RequestedBytes / 1024 << " KB"
+			<< " LARGEST_FREE " << stats.LargestFreeBytes / 1024 << " KB"
+			<< " FRAGMENTATION " << stats.Fragmentation() << std::endl;
+	}
+
+	//De-allocates the buffer
+	void Deallocate()
+	{
+		glDeleteBuffers(1, &Buffer);
+	}
+
+private:
+	struct Allocation
+	{
+		unsigned int Offset = 0;
+		unsigned int Count = 0;
+		bool Live = false;
+	};
+
+	BuddyAllocator allocator;
+	vector<Allocation> allocations;
+	vector<int> freeHandles;
+	size_t requestedElements = 0;
+};
+
+#endif
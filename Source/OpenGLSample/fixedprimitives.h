@@ -0,0 +1,122 @@
+#ifndef FIXEDPRIMITIVES_H
+#define FIXEDPRIMITIVES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Mesh.h"
+#include "primitivetables.h"
+
+//Fixed-shape primitives built from the compile time tables in primitivetables.h.
+//The unit geometry is uploaded straight from read-only data, nothing is generated or heap allocated at runtime.
+//Position and dimensions are applied through LocalTransform, so draws need model * LocalTransform and the matching normal matrix.
+
+class FixedMesh : public Mesh
+{
+protected:
+	//Uploads a unit table and places it at Position, scaled to the requested dimensions
+	template<int N>
+	void UploadTable(const PrimitiveTables::VertexTable<N>& table, const glm::vec3& scale) {
+		LocalTransform = glm::scale(glm::translate(glm::mat4(1.0f), Position), scale);
+		StaticVertexData = table.Data;
+		ComputeBounds(table.Data, static_cast<size_t>(N) * numVertexAttributes);
+		GenerateVertexArrayAndBuffer(table.Data, N);
+	}
+};
+
+class FixedCube : public FixedMesh
+{
+public:
+	//Dimensions (w, h, l)
+	glm::vec3 Dimensions;
+
+	//Constructor, same parameters as Cube
+	FixedCube(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float length = 2.0f, float width = 2.0f, float height = 2.0f)
+	{
+		Position = position;
+
+		//X-axis = width, Y-axis = height, Z-axis = length
+		Dimensions = glm::vec3(width, height, length);
+
+		UploadTable(PrimitiveTables::UnitCube, Dimensions);
+	}
+};
+
+class FixedPlane : public FixedMesh
+{
+public:
+	//Dimensions (w, h, l)
+	glm::vec3 Dimensions;
+
+	//Constructor, same parameters as Plane
+	FixedPlane(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float length = 2.0f, float width = 2.0f)
+	{
+		Position = position;
+
+		//X-axis = width, Z-axis = length
+		Dimensions = glm::vec3(width, 0.0f, length);
+
+		UploadTable(PrimitiveTables::UnitPlane, glm::vec3(width, 1.0f, length));
+	}
+};
+
+class FixedPyramid : public FixedMesh
+{
+public:
+	//Dimensions (w, h, l)
+	glm::vec3 Dimensions;
+
+	//Constructor, same parameters as Pyramid
+	FixedPyramid(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float length = 2.0f, float width = 2.0f, float height = 0.5f)
+	{
+		Position = position;
+
+		//X-axis = width, Y-axis = height, Z-axis = length
+		Dimensions = glm::vec3(width, height, length);
+
+		UploadTable(PrimitiveTables::UnitPyramid, Dimensions);
+	}
+};
+
+//Cylinder with the side count, subdivisions and caps fixed at compile time
+template<int Sides, int SubDivisionCount = 1, bool DrawTop = true, bool DrawBottom = true>
+class FixedCylinder : public FixedMesh
+{
+public:
+	//Dimensions (r, h)
+	glm::vec2 Dimensions;
+
+	//Constructor, same as Cylinder minus the template parameters
+	FixedCylinder(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float radius = 2.0f, float height = 2.0f)
+	{
+		Position = position;
+
+		//X-axis = radius, Y-axis = height
+		Dimensions = glm::vec2(radius, height);
+
+		UploadTable(PrimitiveTables::UnitCylinder<Sides, SubDivisionCount, DrawTop, DrawBottom>, glm::vec3(radius, height, radius));
+	}
+};
+
+//UV sphere with the side count fixed at compile time
+template<int Sides, bool SemiCircle = false>
+class FixedSphere : public FixedMesh
+{
+public:
+	float RadiusLong;
+	float RadiusLat;
+
+	//Constructor, same as Sphere minus the template parameters
+	FixedSphere(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float radiusLong = 1.0f, float radiusLat = 1.0f)
+	{
+		Position = position;
+
+		RadiusLong = radiusLong;
+		RadiusLat = radiusLat;
+
+		UploadTable(PrimitiveTables::UnitSphere<Sides, SemiCircle>, glm::vec3(radiusLong, radiusLat, radiusLong));
+	}
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+//View frustum as six planes (left, right, bottom, top, near, far), extracted from a projection * view matrix.
+//Planes point inward, so a point is inside when dot(plane.xyz, point) + plane.w >= 0 for all six.
+class Frustum
+{
+public:
+	glm::vec4 Planes[6];
+
+	Frustum()
+	{
+		for (glm::vec4& plane : Planes) {
+			plane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+	}
+
+	//Builds the planes from a combined matrix (Gribb/Hartmann). Use projection * view for world space tests
+	Frustum(const glm::mat4& viewProjection)
+	{
+		glm::mat4 m = glm::transpose(viewProjection);
+
+		Planes[0] = m[3] + m[0]; //Left
+		Planes[1] = m[3] - m[0]; //Right
+		Planes[2] = m[3] + m[1]; //Bottom
+		Planes[3] = m[3] - m[1]; //Top
+		Planes[4] = m[3] + m[2]; //Near
+		Planes[5] = m[3] - m[2]; //Far
+
+		for (glm::vec4& plane : Planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+	}
+
+	//Returns true if any part of the sphere can be inside the frustum
+	bool IntersectsSphere(const glm::vec3& center, float radius) const
+	{
+		for (const glm::vec4& plane : Planes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//Returns true if any part of the axis aligned box can be inside the frustum
+	bool IntersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const
+	{
+		for (const glm::vec4& plane : Planes) {
+			//Test the corner furthest along the plane normal
+			glm::vec3 positive = glm::vec3(plane.x >= 0.0f ? boxMax.x : boxMin.x, plane.y >= 0.0f ? boxMax.y : boxMin.y, plane.z >= 0.0f ? boxMax.z : boxMin.z);
+			if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef GEOMETRYARENA_H
+#define GEOMETRYARENA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <iostream>
+#include "Mesh.h"
+#include "bufferpool.h"
+
+using std::vector;
+
+//Index range of one level of detail inside the arena
+struct ArenaRange
+{
+	int Allocation = BufferPool::InvalidHandle;   //Handle in the index pool, its offset is the first index
+	GLuint IndexCount = 0;
+	float Error = 0.0f;        //LOD error, 0 for LOD0
+};
+
+//Where a mesh lives in the arena. Every LOD shares the mesh's vertices, only the index range changes.
+//Offsets move when the arena compacts, read them through BaseVertex and FirstIndex when drawing
+struct ArenaMesh
+{
+	int VertexAllocation = BufferPool::InvalidHandle;
+	GLuint VertexCount = 0;
+	vector<ArenaRange> Lods;    //[0] is the full mesh
+};
+
+//One VAO over a vertex and an index BufferPool that every mesh with the standard 11 float layout is suballocated from,
+//so drawing them needs no VAO switches and meshes can be added and removed without creating GL objects.
+//Also owns the per-instance draw id attribute (location 4) used by the indirect path.
+class GeometryArena
+{
+public:
+	unsigned int VAO = 0, DrawIDBuffer = 0;
+
+	BufferPool VertexPool;
+	BufferPool IndexPool;
+
+	//Largest draw id the attribute buffer covers
+	int MaxDraws = 0;
+
+	GeometryArena() {}
+
+	//Allocates the pools, sizes are in vertices and indices (rounded up to powers of two)
+	GeometryArena(int vertexCapacity, int indexCapacity, int maxDraws)
+	{
+		MaxDraws = maxDraws;
+
+		VertexPool = BufferPool(GL_ARRAY_BUFFER, numVertexAttributes * sizeof(float), vertexCapacity);
+		IndexPool = BufferPool(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int), indexCapacity);
+
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+
+		glBindBuffer(GL_ARRAY_BUFFER, VertexPool.Buffer);
+
+		//Same layout as Mesh
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, numVertexAttributes * sizeof(float), (void*)0);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, numVertexAttributes * sizeof(float), (void*)(3 * sizeof(float)));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, numVertexAttributes * sizeof(float), (void*)(6 * sizeof(float)));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, numVertexAttributes * sizeof(float), (void*)(9 * sizeof(float)));
+		glEnableVertexAttribArray(3);
+
+		//Draw id per instance: 0, 1, 2... so an indirect command's base instance picks its own entry
+		vector<float> drawIDs(maxDraws);
+		for (int i = 0; i < maxDraws; i++) {
+			drawIDs[i] = static_cast<float>(i);
+		}
+		glGenBuffers(1, &DrawIDBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, DrawIDBuffer);
+		glBufferData(GL_ARRAY_BUFFER, maxDraws * sizeof(float), drawIDs.data(), GL_STATIC_DRAW);
+		glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+		glVertexAttribDivisor(4, 1);
+		glEnableVertexAttribArray(4);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexPool.Buffer);
+
+		glBindVertexArray(0);
+	}
+
+	//Adds up the arena space a mesh needs (with the pools' block rounding), to size the arena before adding
+	static void Measure(Mesh& mesh, int& vertexCount, int& indexCount)
+	{
+		vertexCount += BufferPool::BlockSizeFor(mesh.GetVertexCount());
+		indexCount += BufferPool::BlockSizeFor(mesh.Indices.empty() ? mesh.GetVertexCount() : static_cast<int>(mesh.Indices.size()));
+		for (const MeshLod& lod : mesh.Lods) {
+			indexCount += BufferPool::BlockSizeFor(static_cast<unsigned int>(lod.Indices.size()));
+		}
+	}
+
+	//Copies a mesh's vertices, LOD0 indices and LOD indices into the arena. Returns false if it does not fit
+	bool Add(Mesh& mesh, ArenaMesh& result)
+	{
+		int vertexCount = mesh.GetVertexCount();
+		const float* vertices = mesh.Vertices.empty() ? mesh.StaticVertexData : mesh.Vertices.data();
+		if (!vertices || vertexCount == 0) {
+			std::cout << "ERROR::ARENA::NO_CPU_VERTEX_DATA" << std::endl;
+			return false;
+		}
+
+		//Meshes drawn with glDrawArrays get sequential indices
+		vector<unsigned int> sequential;
+		const vector<unsigned int>* indices = &mesh.Indices;
+		if (mesh.Indices.empty()) {
+			sequential.resize(vertexCount);
+			for (int i = 0; i < vertexCount; i++) {
+				sequential[i] = i;
+			}
+			indices = &sequential;
+		}
+
+		result = ArenaMesh();
+		result.VertexAllocation = VertexPool.Allocate(vertexCount);
+		if (result.VertexAllocation == BufferPool::InvalidHandle) {
+			return false;
+		}
+		result.VertexCount = vertexCount;
+		VertexPool.Upload(result.VertexAllocation, vertices, vertexCount);
+
+		if (!AddIndices(*indices, 0.0f, result)) {
+			Remove(result);
+			return false;
+		}
+		for (const MeshLod& lod : mesh.Lods) {
+			if (!AddIndices(lod.Indices, lod.Error, result)) {
+				Remove(result);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	//Gives a mesh's space back to the pools
+	void Remove(ArenaMesh& mesh)
+	{
+		VertexPool.Free(mesh.VertexAllocation);
+		for (const ArenaRange& range : mesh.Lods) {
+			IndexPool.Free(range.Allocation);
+		}
+		mesh = ArenaMesh();
+	}
+
+	//Current base vertex of a mesh
+	GLint BaseVertex(const ArenaMesh& mesh) const
+	{
+		return static_cast<GLint>(VertexPool.GetOffset(mesh.VertexAllocation));
+	}
+
+	//Current first index of a range
+	GLuint FirstIndex(const ArenaRange& range) const
+	{
+		return IndexPool.GetOffset(range.Allocation);
+	}
+
+	//Moves up to budgetBytes of data in each pool to close gaps left by removed meshes, returns the bytes moved
+	size_t Compact(size_t budgetBytes)
+	{
+		return VertexPool.Compact(budgetBytes) + IndexPool.Compact(budgetBytes);
+	}
+
+	//Prints the usage and fragmentation of both pools
+	void PrintStats()
+	{
+		VertexPool.PrintStats("VERTICES");
+		IndexPool.PrintStats("INDICES");
+	}
+
+	//Binds the arena VAO
+	void Bind()
+	{
+		glBindVertexArray(VAO);
+	}
+
+	//De-allocates the buffers
+	void Deallocate()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		VertexPool.Deallocate();
+		IndexPool.Deallocate();
+		glDeleteBuffers(1, &DrawIDBuffer);
+	}
+
+private:
+	static const int numVertexAttributes = 11;
+
+	//Uploads an index list into its own range, indices stay relative to the mesh (the base vertex is added when drawing)
+	bool AddIndices(const vector<unsigned int>& indices, float error, ArenaMesh& mesh)
+	{
+		ArenaRange range;
+		range.Allocation = IndexPool.Allocate(static_cast<unsigned int>(indices.size()));
+		if (range.Allocation == BufferPool::InvalidHandle) {
+			return false;
+		}
+		range.IndexCount = static_cast<GLuint>(indices.size());
+		range.Error = error;
+
+		IndexPool.Upload(range.Allocation, indices.data(), range.IndexCount);
+		mesh.Lods.push_back(range);
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef GLEXTENSIONS_H
+#define GLEXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <iostream>
+
+//The GLAD loader in this project is generated for 3.3 core only, so the newer entry points used by the optional fast paths
+//are declared and loaded here. Every feature has a flag, callers check the flag and keep a 3.3 path for when it is false.
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+//glDrawElementsIndirect command layout (GL 4.3 / ARB_multi_draw_indirect)
+struct DrawElementsIndirectCommand
+{
+	GLuint Count;
+	GLuint InstanceCount;
+	GLuint FirstIndex;
+	GLint BaseVertex;
+	GLuint BaseInstance;
+};
+
+typedef void (APIENTRYP PFNMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+typedef void (APIENTRYP PFNBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP PFNBINDVERTEXBUFFERPROC)(GLuint bindingIndex, GLuint buffer, GLintptr offset, GLsizei stride);
+typedef void (APIENTRYP PFNVERTEXATTRIBFORMATPROC)(GLuint attribIndex, GLint size, GLenum type, GLboolean normalized, GLuint relativeOffset);
+typedef void (APIENTRYP PFNVERTEXATTRIBBINDINGPROC)(GLuint attribIndex, GLuint bindingIndex);
+typedef void (APIENTRYP PFNGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+class GLExtensions
+{
+public:
+	//Context version, read by Load
+	static inline int MajorVersion = 3;
+	static inline int MinorVersion = 3;
+
+	//glMultiDrawElementsIndirect with base instance (GL 4.3, or ARB_multi_draw_indirect + ARB_base_instance)
+	static inline bool MultiDrawIndirect = false;
+	static inline PFNMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = nullptr;
+
+	//Separate vertex format and buffer binding (GL 4.3 or ARB_vertex_attrib_binding)
+	static inline bool SeparateAttribFormat = false;
+	static inline PFNBINDVERTEXBUFFERPROC BindVertexBuffer = nullptr;
+	static inline PFNVERTEXATTRIBFORMATPROC VertexAttribFormat = nullptr;
+	static inline PFNVERTEXATTRIBBINDINGPROC VertexAttribBinding = nullptr;
+
+	//Immutable buffer storage, needed for persistent mapping (GL 4.4 or ARB_buffer_storage)
+	static inline bool PersistentMapping = false;
+	static inline PFNBUFFERSTORAGEPROC BufferStorage = nullptr;
+
+	//Saving and loading linked programs (GL 4.1 or ARB_get_program_binary), false if the driver offers no binary formats
+	static inline bool ProgramBinary = false;
+	static inline PFNGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+	static inline PFNPROGRAMBINARYPROC LoadProgramBinary = nullptr;
+	static inline PFNPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+
+	//Compiles and links on driver threads, with GL_COMPLETION_STATUS_KHR to poll them (KHR or ARB_parallel_shader_compile)
+	static inline bool ParallelShaderCompile = false;
+	static inline PFNMAXSHADERCOMPILERTHREADSPROC MaxShaderCompilerThreads = nullptr;
+
+	//Reads the context version and loads what it supports. Call once after GLAD, with the same loader
+	static void Load(GLADloadproc loader)
+	{
+		glGetIntegerv(GL_MAJOR_VERSION, &MajorVersion);
+		glGetIntegerv(GL_MINOR_VERSION, &MinorVersion);
+
+		if (IsVersion(4, 3) || (HasExtension("GL_ARB_multi_draw_indirect") && HasExtension("GL_ARB_base_instance"))) {
+			MultiDrawElementsIndirect = reinterpret_cast<PFNMULTIDRAWELEMENTSINDIRECTPROC>(loader("glMultiDrawElementsIndirect"));
+			MultiDrawIndirect = MultiDrawElementsIndirect != nullptr;
+		}
+
+		if (IsVersion(4, 3) || HasExtension("GL_ARB_vertex_attrib_binding")) {
+			BindVertexBuffer = reinterpret_cast<PFNBINDVERTEXBUFFERPROC>(loader("glBindVertexBuffer"));
+			VertexAttribFormat = reinterpret_cast<PFNVERTEXATTRIBFORMATPROC>(loader("glVertexAttribFormat"));
+			VertexAttribBinding = reinterpret_cast<PFNVERTEXATTRIBBINDINGPROC>(loader("glVertexAttribBinding"));
+			SeparateAttribFormat = BindVertexBuffer && VertexAttribFormat && VertexAttribBinding;
+		}
+
+		if (IsVersion(4, 4) || HasExtension("GL_ARB_buffer_storage")) {
+			BufferStorage = reinterpret_cast<PFNBUFFERSTORAGEPROC>(loader("glBufferStorage"));
+			PersistentMapping = BufferStorage != nullptr;
+		}
+
+		if (IsVersion(4, 1) || HasExtension("GL_ARB_get_program_binary")) {
+			GetProgramBinary = reinterpret_cast<PFNGETPROGRAMBINARYPROC>(loader("glGetProgramBinary"));
+			LoadProgramBinary = reinterpret_cast<PFNPROGRAMBINARYPROC>(loader("glProgramBinary"));
+			ProgramParameteri = reinterpret_cast<PFNPROGRAMPARAMETERIPROC>(loader("glProgramParameteri"));
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			ProgramBinary = GetProgramBinary && LoadProgramBinary && ProgramParameteri && formats > 0;
+		}
+
+		//The ARB version has the same enum and behavior, only the entry point name differs
+		if (HasExtension("GL_KHR_parallel_shader_compile")) {
+			MaxShaderCompilerThreads = reinterpret_cast<PFNMAXSHADERCOMPILERTHREADSPROC>(loader("glMaxShaderCompilerThreadsKHR"));
+		}
+		else if (HasExtension("GL_ARB_parallel_shader_compile")) {
+			MaxShaderCompilerThreads = reinterpret_cast<PFNMAXSHADERCOMPILERTHREADSPROC>(loader("glMaxShaderCompilerThreadsARB"));
+		}
+		if (MaxShaderCompilerThreads) {
+			//0xFFFFFFFF lets the driver pick the thread count
+			MaxShaderCompilerThreads(0xFFFFFFFF);
+			ParallelShaderCompile = true;
+		}
+
+		std::cout << "GL::VERSION " << MajorVersion << "." << MinorVersion
+			<< " MULTI_DRAW_INDIRECT " << (MultiDrawIndirect ? "YES" : "NO")
+			<< " VERTEX_ATTRIB_BINDING " << (SeparateAttribFormat ? "YES" : "NO")
+			<< " PERSISTENT_MAPPING " << (PersistentMapping ? "YES" : "NO")
+			<< " PROGRAM_BINARY " << (ProgramBinary ? "YES" : "NO")
+			<< " PARALLEL_SHADER_COMPILE " << (ParallelShaderCompile ? "YES" : "NO") << std::endl;
+	}
+
+	//Returns true if the context is at least major.minor
+	static bool IsVersion(int major, int minor)
+	{
+		return MajorVersion > major || (MajorVersion == major && MinorVersion >= minor);
+	}
+
+	//Returns true if the context lists the extension
+	static bool HasExtension(const char* name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+			const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (extension && strcmp(extension, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef INDIRECTRENDERER_H
+#define INDIRECTRENDERER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <iostream>
+#include "Mesh.h"
+#include "shader.h"
+#include "frustum.h"
+#include "geometryarena.h"
+#include "glextensions.h"
+#include "streamring.h"
+#include "materialarray.h"
+
+using std::vector;
+
+//Draws every registered mesh out of one GeometryArena. Each frame the visible objects are submitted with their transform,
+//sorted by material and drawn with one glMultiDrawElementsIndirect per material. The per-draw transforms and the commands are
+//written into a StreamRing; the transforms are read through a texture buffer over the ring with the draw id (the base instance
+//of the command, through the arena's instanced attribute) plus drawIDBase, the start of this frame's data.
+//Without GL 4.3 the same commands are issued one by one with glDrawElementsInstancedBaseVertex.
+//Once BuildMaterialArray has packed every material's textures into one array, all draws share a single call.
+class IndirectRenderer
+{
+public:
+	//Texels (vec4) per draw in the texture buffer: model matrix (4), normal matrix (3), material (x = material index)
+	static const int TexelsPerDraw = 8;
+
+	//Texture unit the per-draw data is bound to (0-3 are the mesh textures)
+	static const int DrawDataUnit = 4;
+
+	//Texture unit of the material array
+	static const int MaterialArrayUnit = 5;
+
+	//Draw every material in one call from the material array when it is built
+	bool UseMaterialArray = true;
+
+	//Bytes per draw in the texture buffer, draw data starts on a multiple of it so the shader can index from drawIDBase
+	static const int DrawDataStride = TexelsPerDraw * sizeof(glm::vec4);
+
+	//Stats of the last Flush
+	unsigned int DrawsLastFlush = 0;
+	unsigned int DrawCallsLastFlush = 0;
+
+	IndirectRenderer() {}
+
+	//Creates the arena and the per-frame buffers, capacities are in vertices, indices and draws per frame
+	IndirectRenderer(int vertexCapacity, int indexCapacity, int maxDraws)
+	{
+		arena = GeometryArena(vertexCapacity, indexCapacity, maxDraws);
+		maxDrawsPerFrame = maxDraws;
+
+		//Draw data and commands of a frame, with room for the alignment of each
+		GLsizeiptr frameSize = static_cast<GLsizeiptr>(maxDraws) * (DrawDataStride + sizeof(DrawElementsIndirectCommand)) + 2 * DrawDataStride;
+		stream = StreamRing(GL_TEXTURE_BUFFER, frameSize);
+
+		glGenTextures(1, &drawDataTexture);
+		glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, stream.Buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+
+	//Copies the mesh (and its LODs) into the arena. Returns the object id to submit with, -1 if it did not fit
+	int Register(Mesh& mesh)
+	{
+		RenderObject object;
+		if (!arena.Add(mesh, object.Geometry)) {
+			return -1;
+		}
+
+		object.Source = &mesh;
+		object.Material = FindMaterial(mesh);
+		CalculateBounds(mesh, object);
+
+		//Reuse the slot of an unregistered object so ids stay small
+		if (!freeObjects.empty()) {
+			int id = freeObjects.back();
+			freeObjects.pop_back();
+			objects[id] = object;
+			return id;
+		}
+
+		objects.push_back(object);
+		return static_cast<int>(objects.size()) - 1;
+	}
+
+	//Frees an object's arena space, its id may be handed out again by Register
+	void Unregister(int object)
+	{
+		if (object < 0 || object >= static_cast<int>(objects.size()) || !objects[object].Source) {
+			return;
+		}
+
+		arena.Remove(objects[object].Geometry);
+		objects[object] = RenderObject();
+		freeObjects.push_back(object);
+	}
+
+	//Moves up to budgetBytes per pool to close the gaps left by Unregister, cheap when there are none. Call between frames
+	size_t Compact(size_t budgetBytes)
+	{
+		return arena.Compact(budgetBytes);
+	}
+
+	//Prints the arena pool usage
+	void PrintStats()
+	{
+		arena.PrintStats();
+	}
+
+	//Clears the draws of the previous frame
+	void Begin()
+	{
+		draws.clear();
+	}
+
+	//Queues an object with its model matrix if its bounds are inside the frustum. lod picks the level (clamped), returns false if culled
+	bool Submit(int object, const glm::mat4& model, const Frustum& frustum, int lod = 0)
+	{
+		if (object < 0 || object >= static_cast<int>(objects.size()) || !objects[object].Source || static_cast<int>(draws.size()) >= maxDrawsPerFrame) {
+			return false;
+		}
+
+		const RenderObject& renderObject = objects[object];
+		glm::vec3 center = glm::vec3(model * glm::vec4(renderObject.BoundsCenter, 1.0f));
+		if (!frustum.IntersectsSphere(center, renderObject.BoundsRadius * MeshletCuller::MaxScale(model))) {
+			return false;
+		}
+
+		Draw draw;
+		draw.Object = object;
+		draw.Lod = glm::clamp(lod, 0, static_cast<int>(renderObject.Geometry.Lods.size()) - 1);
+		draw.Model = model;
+		draws.push_back(draw);
+		return true;
+	}
+
+	//Picks the LOD for an object the same way Mesh::SelectLod does
+	int SelectLod(int object, const glm::mat4& model, const glm::vec3& cameraPosition, float pixelsPerUnit, float maxPixelError = 1.0f)
+	{
+		return objects[object].Source->SelectLod(model, cameraPosition, pixelsPerUnit, maxPixelError);
+	}
+
+	//Packs the textures of every material registered so far into one texture array, size is the layer width and height.
+	//Call again after registering meshes with new materials
+	bool BuildMaterialArray(int size = 1024, const TextureResidency* residency = nullptr)
+	{
+		materialArray.Deallocate();
+		return materialArray.Build(materials, size, residency);
+	}
+
+	//Uploads the queued draws and issues them, one call per material (or one in all with the material array). The shader must be in use
+	void Flush(Shader& shader)
+	{
+		DrawsLastFlush = static_cast<unsigned int>(draws.size());
+		DrawCallsLastFlush = 0;
+		if (draws.empty()) {
+			return;
+		}
+
+		stream.BeginFrame();
+		StreamAllocation drawData = stream.Allocate(static_cast<GLsizeiptr>(draws.size()) * DrawDataStride, DrawDataStride);
+		StreamAllocation commandData;
+		if (GLExtensions::MultiDrawIndirect) {
+			commandData = stream.Allocate(static_cast<GLsizeiptr>(draws.size()) * sizeof(DrawElementsIndirectCommand), sizeof(GLuint));
+		}
+		if (!drawData.Data || (GLExtensions::MultiDrawIndirect && !commandData.Data)) {
+			return;
+		}
+		int drawIDBase = static_cast<int>(drawData.Offset / DrawDataStride);
+
+		//With the material array every draw is in one group, otherwise one group per material
+		bool arrayed = UseMaterialArray && materialArray.Texture != 0 && materialArray.MaterialLayers.size() == materials.size();
+		size_t groups = arrayed ? 1 : materials.size();
+
+		//Counting sort by group, keeps submit order inside a group
+		vector<unsigned int> groupStart(groups + 1, 0);
+		for (const Draw& draw : draws) {
+			groupStart[(arrayed ? 0 : objects[draw.Object].Material) + 1]++;
+		}
+		for (size_t i = 0; i < groups; i++) {
+			groupStart[i + 1] += groupStart[i];
+		}
+		vector<unsigned int> fill(groupStart.begin(), groupStart.end() - 1);
+		sorted.resize(draws.size());
+		for (const Draw& draw : draws) {
+			sorted[fill[arrayed ? 0 : objects[draw.Object].Material]++] = draw;
+		}
+
+		//Per-draw data and commands, written straight into the stream. Draw i reads texels [(drawIDBase + i) * 8, +8)
+		commands.resize(sorted.size());
+		for (size_t i = 0; i < sorted.size(); i++) {
+			const Draw& draw = sorted[i];
+			const RenderObject& object = objects[draw.Object];
+			glm::mat3 normalMatrix = Mesh::GetNormalMatrix(draw.Model);
+
+			glm::vec4* texels = static_cast<glm::vec4*>(drawData.Data) + i * TexelsPerDraw;
+			texels[0] = draw.Model[0];
+			texels[1] = draw.Model[1];
+			texels[2] = draw.Model[2];
+			texels[3] = draw.Model[3];
+			texels[4] = glm::vec4(normalMatrix[0], 0.0f);
+			texels[5] = glm::vec4(normalMatrix[1], 0.0f);
+			texels[6] = glm::vec4(normalMatrix[2], 0.0f);
+			texels[7] = glm::vec4(static_cast<float>(object.Material), 0.0f, 0.0f, 0.0f);
+
+			const ArenaRange& range = object.Geometry.Lods[draw.Lod];
+			commands[i].Count = range.IndexCount;
+			commands[i].InstanceCount = 1;
+			commands[i].FirstIndex = arena.FirstIndex(range);
+			commands[i].BaseVertex = arena.BaseVertex(object.Geometry);
+			commands[i].BaseInstance = static_cast<GLuint>(i);
+		}
+
+		if (GLExtensions::MultiDrawIndirect) {
+			memcpy(commandData.Data, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+		}
+		stream.Commit();
+
+		glActiveTexture(GL_TEXTURE0 + DrawDataUnit);
+		glBindTexture(GL_TEXTURE_BUFFER, drawDataTexture);
+
+		shader.setBool("useDrawData", true);
+		shader.setInt("drawData", DrawDataUnit);
+		shader.setInt("drawIDBase", drawIDBase);
+
+		arena.Bind();
+
+		if (GLExtensions::MultiDrawIndirect) {
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream.Buffer);
+		}
+
+		if (arrayed) {
+			materialArray.Bind(shader, MaterialArrayUnit);
+			shader.setBool("useMaterialArray", true);
+		}
+
+		for (size_t m = 0; m < groups; m++) {
+			unsigned int first = groupStart[m];
+			unsigned int count = groupStart[m + 1] - first;
+			if (count == 0) {
+				continue;
+			}
+
+			if (!arrayed) {
+				Mesh& material = materials[m];
+				shader.setBool("material.useOverlayTexture", material.HasOverlay());
+				shader.setFloat("material.shininess", material.GetShininess());
+				material.BindTextures();
+			}
+
+			if (GLExtensions::MultiDrawIndirect) {
+				GLExtensions::MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+					reinterpret_cast<const void*>(commandData.Offset + static_cast<size_t>(first) * sizeof(DrawElementsIndirectCommand)), static_cast<GLsizei>(count), 0);
+				DrawCallsLastFlush++;
+			}
+			else {
+				//No base instance, the draw id comes from the uniform instead
+				for (unsigned int i = first; i < first + count; i++) {
+					shader.setInt("drawIDBase", drawIDBase + static_cast<int>(i));
+					glDrawElementsInstancedBaseVertex(GL_TRIANGLES, commands[i].Count, GL_UNSIGNED_INT,
+						reinterpret_cast<const void*>(static_cast<size_t>(commands[i].FirstIndex) * sizeof(unsigned int)), 1, commands[i].BaseVertex);
+					DrawCallsLastFlush++;
+				}
+			}
+		}
+
+		if (GLExtensions::MultiDrawIndirect) {
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+		glBindVertexArray(0);
+		shader.setBool("useDrawData", false);
+		shader.setBool("useMaterialArray", false);
+		stream.EndFrame();
+	}
+
+	//Number of registered objects
+	int GetObjectCount()
+	{
+		return static_cast<int>(objects.size() - freeObjects.size());
+	}
+
+	//De-allocates the arena and the per-frame buffers
+	void Deallocate()
+	{
+		arena.Deallocate();
+		stream.Deallocate();
+		materialArray.Deallocate();
+		glDeleteTextures(1, &drawDataTexture);
+	}
+
+private:
+	struct RenderObject
+	{
+		Mesh* Source = nullptr;
+		ArenaMesh Geometry;
+		int Material = 0;
+		glm::vec3 BoundsCenter = glm::vec3(0.0f);
+		float BoundsRadius = 0.0f;
+	};
+
+	struct Draw
+	{
+		int Object;
+		int Lod;
+		glm::mat4 Model;
+	};
+
+	GeometryArena arena;
+	int maxDrawsPerFrame = 0;
+
+	StreamRing stream;
+	MaterialArray materialArray;
+	unsigned int drawDataTexture = 0;
+
+	vector<RenderObject> objects;
+	vector<int> freeObjects;        //Unregistered slots
+	vector<Mesh> materials;         //Textures of each material, copied so meshes can be unregistered and destroyed
+
+	//Per-frame lists, kept to reuse their memory
+	vector<Draw> draws;
+	vector<Draw> sorted;
+	vector<DrawElementsIndirectCommand> commands;
+
+	int FindMaterial(Mesh& mesh)
+	{
+		for (size_t i = 0; i < materials.size(); i++) {
+			if (materials[i].SameMaterial(mesh)) {
+				return static_cast<int>(i);
+			}
+		}
+		materials.emplace_back();
+		materials.back().CopyMaterial(mesh);
+		return static_cast<int>(materials.size()) - 1;
+	}
+
+	//Object space bounding sphere of the vertex data
+	void CalculateBounds(Mesh& mesh, RenderObject& object)
+	{
+		const float* vertices = mesh.Vertices.empty() ? mesh.StaticVertexData : mesh.Vertices.data();
+		int vertexCount = mesh.GetVertexCount();
+
+		glm::vec3 boxMin = glm::vec3(INFINITY);
+		glm::vec3 boxMax = glm::vec3(-INFINITY);
+		for (int v = 0; v < vertexCount; v++) {
+			glm::vec3 p = glm::vec3(vertices[v * 11], vertices[v * 11 + 1], vertices[v * 11 + 2]);
+			boxMin = glm::min(boxMin, p);
+			boxMax = glm::max(boxMax, p);
+		}
+
+		object.BoundsCenter = (boxMin + boxMax) * 0.5f;
+		object.BoundsRadius = glm::length(boxMax - boxMin) * 0.5f;
+	}
+};
+
+#endif
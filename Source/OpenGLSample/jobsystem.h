@@ -0,0 +1,330 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "taskgraph.h"
+
+using std::vector;
+
+//Work stealing job system for the per-frame work. Every worker thread has its own deque of jobs, and so do the threads
+//outside the pool (they share one): a thread pushes and pops at the back of its deque, so the jobs it just split off stay
+//hot in its cache, and an idle thread steals from the front of another's, taking the oldest and usually largest piece.
+//A job can bump a Counter when it is queued and drop it when done; Wait on the counter runs jobs (its own first, then
+//stolen ones) until it reaches zero instead of blocking, so waiting inside a job never deadlocks the pool.
+//The workers stay alive between frames and sleep while there is nothing to do.
+class JobSystem
+{
+public:
+	//Jobs queued and not finished yet
+	typedef std::atomic<int> Counter;
+
+	//threadCount is the number of workers besides the threads that queue and wait on jobs (0 runs everything in Wait)
+	JobSystem(unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1)
+	{
+		for (unsigned int q = 0; q <= threadCount; q++) {
+			queues.push_back(std::make_unique<Queue>());
+		}
+		for (unsigned int t = 0; t < threadCount; t++) {
+			workers.emplace_back([this, t]() { WorkerLoop(static_cast<int>(t) + 1); });
+		}
+	}
+
+	~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> guard(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	//Threads that run jobs, the workers and the calling thread
+	unsigned int ThreadCount() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+	//Queues a job on the calling thread's deque. counter (if any) is raised now and lowered once the job has run
+	void Run(std::function<void()> work, Counter* counter = nullptr)
+	{
+		if (counter) {
+			counter->fetch_add(1, std::memory_order_relaxed);
+		}
+		Queue& queue = *queues[QueueIndex()];
+		{
+			std::lock_guard<std::mutex> guard(queue.Mutex);
+			queue.Jobs.push_back(Job{ std::move(work), counter });
+		}
+		pending.fetch_add(1, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> guard(sleepMutex);
+		}
+		wake.notify_one();
+	}
+
+	//Runs jobs until counter is zero
+	void Wait(const Counter& counter)
+	{
+		int spins = 0;
+		while (counter.load(std::memory_order_acquire) > 0) {
+			if (RunOne()) {
+				spins = 0;
+			}
+			else if (++spins > 64) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	//Calls body(first, last) over [0, count) in pieces of grain, spread over the threads, and returns when all are done.
+	//Piece i covers [i * grain, min((i + 1) * grain, count)), so a body can keep per piece results in order
+	template<typename Body>
+	void ParallelFor(size_t count, size_t grain, Body&& body)
+	{
+		grain = std::max<size_t>(grain, 1);
+		if (count <= grain || workers.empty()) {
+			for (size_t first = 0; first < count; first += grain) {
+				body(first, std::min(first + grain, count));
+			}
+			return;
+		}
+
+		//The calling thread takes the first piece itself, the rest go to the deque for the others to steal
+		Counter counter{ 0 };
+		for (size_t first = grain; first < count; first += grain) {
+			size_t last = std::min(first + grain, count);
+			Run([&body, first, last]() { body(first, last); }, &counter);
+		}
+		body(size_t(0), grain);
+		Wait(counter);
+	}
+
+	//Sorts values with operator<: pieces of grain values are sorted in parallel, then merged in pairs, every pair of a round
+	//in parallel
+	template<typename T>
+	void ParallelSort(vector<T>& values, size_t grain)
+	{
+		grain = std::max<size_t>(grain, 1);
+		size_t count = values.size();
+		ParallelFor(count, grain, [&values](size_t first, size_t last) {
+			std::sort(values.begin() + first, values.begin() + last);
+		});
+		for (size_t width = grain; width < count; width *= 2) {
+			ParallelFor((count + 2 * width - 1) / (2 * width), 1, [&values, width, count](size_t first, size_t last) {
+				for (size_t pair = first; pair < last; pair++) {
+					size_t begin = pair * 2 * width;
+					size_t middle = std::min(begin + width, count);
+					size_t end = std::min(begin + 2 * width, count);
+					std::inplace_merge(values.begin() + begin, values.begin() + middle, values.begin() + end);
+				}
+			});
+		}
+	}
+
+	//Number of pieces ParallelFor splits count into
+	static size_t PieceCount(size_t count, size_t grain)
+	{
+		grain = std::max<size_t>(grain, 1);
+		return (count + grain - 1) / grain;
+	}
+
+	//Pops the newest job of the calling thread's deque, else steals the oldest of another, and runs it. False if every deque
+	//was empty
+	bool RunOne()
+	{
+		int own = QueueIndex();
+		Job job;
+		bool found = false;
+		for (size_t i = 0; i < queues.size() && !found; i++) {
+			Queue& queue = *queues[(own + i) % queues.size()];
+			std::lock_guard<std::mutex> guard(queue.Mutex);
+			if (queue.Jobs.empty()) {
+				continue;
+			}
+			if (i == 0) {
+				job = std::move(queue.Jobs.back());
+				queue.Jobs.pop_back();
+			}
+			else {
+				job = std::move(queue.Jobs.front());
+				queue.Jobs.pop_front();
+			}
+			found = true;
+		}
+		if (!found) {
+			return false;
+		}
+
+		pending.fetch_sub(1, std::memory_order_relaxed);
+		job.Work();
+		if (job.Done) {
+			job.Done->fetch_sub(1, std::memory_order_release);
+		}
+		return true;
+	}
+
+private:
+	struct Job
+	{
+		std::function<void()> Work;
+		Counter* Done = nullptr;
+	};
+
+	struct Queue
+	{
+		std::mutex Mutex;
+		std::deque<Job> Jobs;
+	};
+
+	vector<std::unique_ptr<Queue>> queues;
+	vector<std::thread> workers;
+	std::atomic<int> pending{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	//Deque of the calling thread: its own for a worker of this system, the shared one (0) for any other thread
+	static inline thread_local const JobSystem* workerOf = nullptr;
+	static inline thread_local int workerQueue = 0;
+
+	int QueueIndex() const { return workerOf == this ? workerQueue : 0; }
+
+	void WorkerLoop(int queue)
+	{
+		workerOf = this;
+		workerQueue = queue;
+		int spins = 0;
+		while (true) {
+			if (RunOne()) {
+				spins = 0;
+				continue;
+			}
+			if (++spins < 64) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			spins = 0;
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this]() { return stopping || pending.load(std::memory_order_acquire) > 0; });
+			if (stopping) {
+				return;
+			}
+		}
+	}
+};
+
+//Per-frame tasks with dependencies, on a JobSystem. The graph is built once and Run every frame: worker tasks go to the
+//job system as soon as their dependencies are done (and can split themselves further with ParallelFor), main tasks run on
+//the thread calling Run (the one holding the GL context). While there is no main task ready, the calling thread helps with
+//the jobs.
+class FrameGraph
+{
+public:
+	//Time of the last Run
+	double LastMilliseconds = 0.0;
+
+	//Adds a task, dependencies are ids returned by earlier Adds. Returns the task's id
+	int Add(const std::string& name, TaskThread thread, std::function<void()> work, const vector<int>& dependencies = {})
+	{
+		int id = static_cast<int>(tasks.size());
+		tasks.push_back(std::make_unique<Task>());
+		Task& task = *tasks.back();
+		task.Name = name;
+		task.Thread = thread;
+		task.Work = std::move(work);
+		task.DependencyCount = static_cast<int>(dependencies.size());
+		for (int dependency : dependencies) {
+			tasks[dependency]->Dependents.push_back(id);
+		}
+		return id;
+	}
+
+	//Runs every task once and returns when all are done
+	void Run(JobSystem& jobs)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		remaining.store(static_cast<int>(tasks.size()), std::memory_order_relaxed);
+		for (std::unique_ptr<Task>& task : tasks) {
+			task->Remaining.store(task->DependencyCount, std::memory_order_relaxed);
+		}
+		for (int id = 0; id < static_cast<int>(tasks.size()); id++) {
+			if (tasks[id]->DependencyCount == 0) {
+				Queue(jobs, id);
+			}
+		}
+
+		while (remaining.load(std::memory_order_acquire) > 0) {
+			int id = -1;
+			{
+				std::lock_guard<std::mutex> guard(mainMutex);
+				if (!mainReady.empty()) {
+					id = mainReady.front();
+					mainReady.pop_front();
+				}
+			}
+			if (id >= 0) {
+				Execute(jobs, id);
+			}
+			else if (!jobs.RunOne()) {
+				std::this_thread::yield();
+			}
+		}
+		LastMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+private:
+	struct Task
+	{
+		std::string Name;
+		TaskThread Thread = TASK_WORKER;
+		std::function<void()> Work;
+		vector<int> Dependents;
+		int DependencyCount = 0;
+		std::atomic<int> Remaining{ 0 };
+	};
+
+	vector<std::unique_ptr<Task>> tasks;
+	std::atomic<int> remaining{ 0 };
+	std::mutex mainMutex;
+	std::deque<int> mainReady;
+
+	void Queue(JobSystem& jobs, int id)
+	{
+		if (tasks[id]->Thread == TASK_MAIN) {
+			std::lock_guard<std::mutex> guard(mainMutex);
+			mainReady.push_back(id);
+		}
+		else {
+			jobs.Run([this, &jobs, id]() { Execute(jobs, id); });
+		}
+	}
+
+	//Runs a task, then queues the dependents it was the last dependency of
+	void Execute(JobSystem& jobs, int id)
+	{
+		Task& task = *tasks[id];
+		task.Work();
+		for (int dependent : task.Dependents) {
+			if (tasks[dependent]->Remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				Queue(jobs, dependent);
+			}
+		}
+		remaining.fetch_sub(1, std::memory_order_acq_rel);
+	}
+};
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef MATERIALARRAY_H
+#define MATERIALARRAY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <map>
+#include <string>
+#include <iostream>
+#include "Mesh.h"
+#include "shader.h"
+#include "textureresidency.h"
+
+using std::vector;
+
+//Every material's diffuse, specular and overlay maps as layers of one GL_TEXTURE_2D_ARRAY, so meshes with different
+//materials can share a draw and pick their layers by material index in the shader. The layers are read back from the
+//meshes' existing textures and resampled to one size and format (RGBA8), since an array only holds one of each.
+class MaterialArray
+{
+public:
+	//Size of the materialLayers / materialShininess uniform arrays in the shader
+	static const int MaxMaterials = 32;
+
+	unsigned int Texture = 0;
+	int Size = 0;
+	int LayerCount = 0;
+
+	//Per material: layer of the diffuse, specular, overlay diffuse and overlay specular map (-1 for none)
+	vector<glm::vec4> MaterialLayers;
+	vector<float> MaterialShininess;
+
+	MaterialArray() {}
+
+	//Builds the array from the textures of each material, in order (material i of the list is material index i in the shader).
+	//size is the width and height of every layer. Textures owned by residency are copied from its system memory levels,
+	//whatever is resident on the GPU. Returns false if there are too many materials
+	bool Build(vector<Mesh>& materials, int size = 1024, const TextureResidency* residency = nullptr)
+	{
+		if (static_cast<int>(materials.size()) > MaxMaterials) {
+			std::cout << "ERROR::MATERIALARRAY::TOO_MANY_MATERIALS " << materials.size() << std::endl;
+			return false;
+		}
+
+		Size = size;
+		MaterialLayers.clear();
+		MaterialShininess.clear();
+
+		//Each texture gets one layer, however many materials use it
+		std::map<unsigned int, int> layers;
+		vector<unsigned int> sources;
+		auto layerOf = [&](unsigned int texture) {
+			if (texture == 0) {
+				return -1;
+			}
+			auto found = layers.find(texture);
+			if (found != layers.end()) {
+				return found->second;
+			}
+			int layer = static_cast<int>(sources.size());
+			layers[texture] = layer;
+			sources.push_back(texture);
+			return layer;
+		};
+
+		for (Mesh& material : materials) {
+			MaterialLayers.push_back(glm::vec4(layerOf(material.GetDiffuseTexture()), layerOf(material.GetSpecularTexture()),
+				layerOf(material.GetOverlayDiffuseTexture()), layerOf(material.GetOverlaySpecularTexture())));
+			MaterialShininess.push_back(material.GetShininess());
+		}
+
+		LayerCount = static_cast<int>(sources.size());
+		if (LayerCount == 0) {
+			return true;
+		}
+
+		glGenTextures(1, &Texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, Texture);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, Size, Size, LayerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+		vector<unsigned char> source;
+		vector<unsigned char> layer;
+		for (int i = 0; i < LayerCount; i++) {
+			int width = 0, height = 0;
+			const unsigned char* pixels = residency ? residency->GetLevel(sources[i], Size, width, height) : nullptr;
+			if (!pixels) {
+				//Read back the finest level on the GPU
+				GLint baseLevel = 0;
+				glBindTexture(GL_TEXTURE_2D, sources[i]);
+				glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, &baseLevel);
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, baseLevel, GL_TEXTURE_WIDTH, &width);
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, baseLevel, GL_TEXTURE_HEIGHT, &height);
+				if (width == 0 || height == 0) {
+					std::cout << "ERROR::MATERIALARRAY::EMPTY_TEXTURE " << sources[i] << std::endl;
+					continue;
+				}
+
+				source.resize(static_cast<size_t>(width) * height * 4);
+				glPixelStorei(GL_PACK_ALIGNMENT, 1);
+				glGetTexImage(GL_TEXTURE_2D, baseLevel, GL_RGBA, GL_UNSIGNED_BYTE, source.data());
+				pixels = source.data();
+			}
+
+			if (width != Size || height != Size) {
+				Resample(pixels, width, height, layer, Size);
+				pixels = layer.data();
+			}
+
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, Size, Size, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		std::cout << "MATERIALARRAY::" << materials.size() << " MATERIALS " << LayerCount << " LAYERS " << Size << "x" << Size << std::endl;
+		return true;
+	}
+
+	//Binds the array to a texture unit and sets the material table. The shader must be in use
+	void Bind(Shader& shader, int unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, Texture);
+		shader.setInt("materialTextures", unit);
+
+		for (size_t i = 0; i < MaterialLayers.size(); i++) {
+			std::string index = "[" + std::to_string(i) + "]";
+			shader.setVec4("materialLayers" + index, MaterialLayers[i]);
+			shader.setFloat("materialShininess" + index, MaterialShininess[i]);
+		}
+	}
+
+	//De-allocates the array
+	void Deallocate()
+	{
+		glDeleteTextures(1, &Texture);
+		Texture = 0;
+	}
+
+private:
+	//Bilinear resample of an RGBA image to size x size
+	static void Resample(const unsigned char* source, int width, int height, vector<unsigned char>& result, int size)
+	{
+		result.resize(static_cast<size_t>(size) * size * 4);
+		for (int y = 0; y < size; y++) {
+			float sy = glm::clamp((y + 0.5f) * height / size - 0.5f, 0.0f, static_cast<float>(height - 1));
+			int y0 = static_cast<int>(sy);
+			int y1 = glm::min(y0 + 1, height - 1);
+			float fy = sy - y0;
+
+			for (int x = 0; x < size; x++) {
+				float sx = glm::clamp((x + 0.5f) * width / size - 0.5f, 0.0f, static_cast<float>(width - 1));
+				int x0 = static_cast<int>(sx);
+				int x1 = glm::min(x0 + 1, width - 1);
+				float fx = sx - x0;
+
+				for (int c = 0; c < 4; c++) {
+					float top = source[(static_cast<size_t>(y0) * width + x0) * 4 + c] * (1.0f - fx) + source[(static_cast<size_t>(y0) * width + x1) * 4 + c] * fx;
+					float bottom = source[(static_cast<size_t>(y1) * width + x0) * 4 + c] * (1.0f - fx) + source[(static_cast<size_t>(y1) * width + x1) * 4 + c] * fx;
+					result[(static_cast<size_t>(y) * size + x) * 4 + c] = static_cast<unsigned char>(top * (1.0f - fy) + bottom * fy + 0.5f);
+				}
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,347 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <atomic>
+#include <thread>
+#include "Mesh.h"
+#include "sharedassetcache.h"
+
+using std::vector;
+
+//Derived mesh data saved to disk, so later launches read it back instead of generating, optimizing, splitting into meshlets
+//and simplifying again. What is stored is the final CPU side of a mesh: the welded and reordered vertices and indices, the
+//meshlets, the LOD index lists and the bounds, ready to upload as is.
+//The key is a hash of whatever the mesh was built from (the generator parameters, or the bytes of an imported file), mixed
+//with the processing settings and FormatVersion. Bump FormatVersion when a generator, the optimizer or the simplifier
+//changes its output, every stored mesh then misses and is rebuilt.
+//With a SharedAssetCache mounted the stored form of every mesh loaded or built is also published there, and looked up
+//there before the disk, so viewers started later skip the file reads.
+//Load and Store are safe to call from several worker threads at once.
+class MeshCache
+{
+public:
+	//Where the meshes are written, relative to the working directory
+	static inline std::string Directory = "meshcache";
+
+	//When false nothing is loaded or stored, every mesh is generated
+	static inline bool Enabled = true;
+
+	//Meshes loaded from disk and meshes that had to be generated (cache disabled or missed) since the last reset
+	static inline std::atomic<unsigned int> Hits{ 0 };
+	static inline std::atomic<unsigned int> Misses{ 0 };
+
+	//Version of the stored data and of the code producing it
+	static const uint32_t FormatVersion = 2;
+
+	//Starting value of Hash
+	static const uint64_t HashSeed = 14695981039346656037ull;
+
+	//64 bit FNV-1a of a block of bytes, pass the previous result to hash several blocks in a row
+	static uint64_t Hash(const void* data, size_t size, uint64_t hash = HashSeed)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	//Hash of a file's contents, for meshes imported from a source file. Returns 0 if the file can not be read
+	static uint64_t HashFile(const std::string& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return 0;
+		}
+
+		uint64_t hash = HashSeed;
+		char block[64 * 1024];
+		while (file.read(block, sizeof(block)) || file.gcount() > 0) {
+			hash = Hash(block, static_cast<size_t>(file.gcount()), hash);
+		}
+		return hash;
+	}
+
+	//Key of a mesh: the hash of its source, the processing switches of Mesh, the LOD ratios and FormatVersion
+	static uint64_t Key(uint64_t sourceHash, const vector<float>& lodRatios)
+	{
+		uint32_t settings[3] = { FormatVersion, Mesh::OptimizeOnLoad ? 1u : 0u, Mesh::BuildMeshletsOnLoad ? 1u : 0u };
+		uint64_t hash = Hash(&sourceHash, sizeof(sourceHash));
+		hash = Hash(settings, sizeof(settings), hash);
+		return Hash(lodRatios.data(), lodRatios.size() * sizeof(float), hash);
+	}
+
+	//Reads the mesh stored under key into the CPU data of mesh (Vertices, Indices, Meshlets, Lods, bounds). Returns false if
+	//there is none or it does not match, mesh is then left empty. Nothing is uploaded, call Mesh::UploadPrepared afterwards
+	static bool Load(uint64_t key, Mesh& mesh)
+	{
+		if (!Enabled) {
+			Misses++;
+			return false;
+		}
+
+		//The shared segment first, the arrays are copied out of it since the mesh owns its data
+		uint64_t sharedKey = SharedKey(key);
+		AssetView view;
+		if (sharedKey && SharedAssetCache::Mounted->Find(sharedKey, view)) {
+			if (Read(view.Data, view.Size, key, mesh)) {
+				Hits++;
+				return true;
+			}
+			ClearMesh(mesh);
+		}
+
+		//One read of the whole file, the arrays are copied out of the buffer
+		std::ifstream file(PathFor(key), std::ios::binary | std::ios::ate);
+		if (!file) {
+			Misses++;
+			return false;
+		}
+		vector<char> buffer(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(buffer.data(), buffer.size());
+		if (!file || !Read(buffer.data(), buffer.size(), key, mesh)) {
+			std::cout << "ERROR::MESHCACHE::BAD_FILE " << PathFor(key) << std::endl;
+			ClearMesh(mesh);
+			Misses++;
+			return false;
+		}
+
+		Publish(sharedKey, buffer);
+		Hits++;
+		return true;
+	}
+
+	//Writes the CPU data of a mesh under key. Call once the mesh is complete (after GenerateLods)
+	static void Store(uint64_t key, const Mesh& mesh)
+	{
+		if (!Enabled || mesh.Vertices.empty()) {
+			return;
+		}
+
+		Header header;
+		memset(&header, 0, sizeof(header));
+		header.Magic = Magic;
+		header.Version = FormatVersion;
+		header.Key = key;
+		header.VertexFloats = static_cast<uint32_t>(mesh.Vertices.size());
+		header.Indices = static_cast<uint32_t>(mesh.Indices.size());
+		header.Meshlets = static_cast<uint32_t>(mesh.Meshlets.size());
+		header.Lods = static_cast<uint32_t>(mesh.Lods.size());
+		header.MeshletsClosed = mesh.MeshletsClosed ? 1 : 0;
+		header.Position[0] = mesh.Position.x;
+		header.Position[1] = mesh.Position.y;
+		header.Position[2] = mesh.Position.z;
+		header.BoundsCenter[0] = mesh.BoundsCenter.x;
+		header.BoundsCenter[1] = mesh.BoundsCenter.y;
+		header.BoundsCenter[2] = mesh.BoundsCenter.z;
+		header.BoundsRadius = mesh.BoundsRadius;
+		header.AcmrBefore = mesh.AcmrBefore;
+		header.AcmrAfter = mesh.AcmrAfter;
+
+		//Assembled in memory, then published and written in one go
+		vector<char> buffer;
+		auto append = [&buffer](const void* data, size_t bytes) {
+			buffer.insert(buffer.end(), static_cast<const char*>(data), static_cast<const char*>(data) + bytes);
+		};
+		append(&header, sizeof(header));
+		append(mesh.Vertices.data(), mesh.Vertices.size() * sizeof(float));
+		append(mesh.Indices.data(), mesh.Indices.size() * sizeof(unsigned int));
+		append(mesh.Meshlets.data(), mesh.Meshlets.size() * sizeof(Meshlet));
+		for (const MeshLod& lod : mesh.Lods) {
+			LodHeader lodHeader = { static_cast<uint32_t>(lod.Indices.size()), lod.TargetRatio, lod.Error };
+			append(&lodHeader, sizeof(lodHeader));
+			append(lod.Indices.data(), lod.Indices.size() * sizeof(unsigned int));
+		}
+		Publish(SharedKey(key), buffer);
+
+		std::error_code error;
+		std::filesystem::create_directories(Directory, error);
+
+		//Written to a temporary name first so a crash mid-write never leaves a half file under the real name. The name is
+		//per thread, two workers may build the same mesh at once
+		std::string path = PathFor(key);
+		std::string temporary = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write(buffer.data(), buffer.size());
+			if (!file) {
+				std::cout << "ERROR::MESHCACHE::WRITE_FAILED " << temporary << std::endl;
+				file.close();
+				std::filesystem::remove(temporary, error);
+				return;
+			}
+		}
+
+		std::filesystem::rename(temporary, path, error);
+		if (error) {
+			std::cout << "ERROR::MESHCACHE::WRITE_FAILED " << path << " " << error.message() << std::endl;
+			std::filesystem::remove(temporary, error);
+		}
+	}
+
+	//Deletes every stored mesh
+	static void Clear()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(Directory, error);
+	}
+
+	static void ResetStats()
+	{
+		Hits = 0;
+		Misses = 0;
+	}
+
+private:
+	//"GLMC"
+	static const uint32_t Magic = 0x434D4C47;
+
+	//File layout: Header, vertex floats, indices, meshlets, then a LodHeader and its indices for every LOD
+	struct Header
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t Key;
+		uint32_t VertexFloats;
+		uint32_t Indices;
+		uint32_t Meshlets;
+		uint32_t Lods;
+		uint32_t MeshletsClosed;
+		float Position[3];
+		float BoundsCenter[3];
+		float BoundsRadius;
+		float AcmrBefore;
+		float AcmrAfter;
+	};
+
+	struct LodHeader
+	{
+		uint32_t Indices;
+		float TargetRatio;
+		float Error;
+	};
+
+	static std::string PathFor(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.mesh", static_cast<unsigned long long>(key));
+		return Directory + "/" + name;
+	}
+
+	//Key of a mesh in the shared segment, 0 when none is mounted
+	static uint64_t SharedKey(uint64_t key)
+	{
+		return SharedAssetCache::Mounted ? SharedAssetCache::Key(&key, sizeof(key), Magic) : 0;
+	}
+
+	static void Publish(uint64_t sharedKey, const vector<char>& buffer)
+	{
+		if (sharedKey) {
+			SharedAssetCache::Mounted->Publish(sharedKey, buffer.size(), [&buffer](char* destination) {
+				memcpy(destination, buffer.data(), buffer.size());
+			});
+		}
+	}
+
+	static void ClearMesh(Mesh& mesh)
+	{
+		mesh.Vertices.clear();
+		mesh.Indices.clear();
+		mesh.Meshlets.clear();
+		mesh.Lods.clear();
+	}
+
+	//Copies count elements of T out of the buffer at offset, false if the buffer is too short
+	template<typename T>
+	static bool Take(const char* buffer, size_t size, size_t& offset, size_t count, vector<T>& out)
+	{
+		size_t bytes = count * sizeof(T);
+		if (count > size / sizeof(T) || bytes > size - offset) {
+			return false;
+		}
+		out.resize(count);
+		if (bytes > 0) {
+			memcpy(out.data(), buffer + offset, bytes);
+		}
+		offset += bytes;
+		return true;
+	}
+
+	//Fills mesh from the stored form, checking every size against the buffer and every index against the vertex count
+	static bool Read(const char* buffer, size_t size, uint64_t key, Mesh& mesh)
+	{
+		Header header;
+		if (size < sizeof(header)) {
+			return false;
+		}
+		memcpy(&header, buffer, sizeof(header));
+		if (header.Magic != Magic || header.Version != FormatVersion || header.Key != key || header.VertexFloats % 11 != 0) {
+			return false;
+		}
+
+		size_t offset = sizeof(header);
+		if (!Take(buffer, size, offset, header.VertexFloats, mesh.Vertices) || !Take(buffer, size, offset, header.Indices, mesh.Indices)
+			|| !Take(buffer, size, offset, header.Meshlets, mesh.Meshlets)) {
+			return false;
+		}
+
+		unsigned int vertexCount = header.VertexFloats / 11;
+		auto indicesValid = [vertexCount](const vector<unsigned int>& indices) {
+			for (unsigned int index : indices) {
+				if (index >= vertexCount) {
+					return false;
+				}
+			}
+			return indices.size() % 3 == 0;
+		};
+		if (!indicesValid(mesh.Indices)) {
+			return false;
+		}
+		for (const Meshlet& meshlet : mesh.Meshlets) {
+			if (meshlet.IndexOffset > mesh.Indices.size() || meshlet.TriangleCount * 3ull > mesh.Indices.size() - meshlet.IndexOffset) {
+				return false;
+			}
+		}
+
+		//Every LOD takes at least its header, a count the rest of the buffer can not hold is a corrupt file
+		if (header.Lods > (size - offset) / sizeof(LodHeader)) {
+			return false;
+		}
+		mesh.Lods.resize(header.Lods);
+		for (MeshLod& lod : mesh.Lods) {
+			LodHeader lodHeader;
+			if (sizeof(lodHeader) > size - offset) {
+				return false;
+			}
+			memcpy(&lodHeader, buffer + offset, sizeof(lodHeader));
+			offset += sizeof(lodHeader);
+			if (!Take(buffer, size, offset, lodHeader.Indices, lod.Indices) || !indicesValid(lod.Indices)) {
+				return false;
+			}
+			lod.TargetRatio = lodHeader.TargetRatio;
+			lod.Error = lodHeader.Error;
+		}
+		if (offset != size) {
+			return false;
+		}
+
+		mesh.MeshletsClosed = header.MeshletsClosed != 0;
+		mesh.Position = glm::vec3(header.Position[0], header.Position[1], header.Position[2]);
+		mesh.BoundsCenter = glm::vec3(header.BoundsCenter[0], header.BoundsCenter[1], header.BoundsCenter[2]);
+		mesh.BoundsRadius = header.BoundsRadius;
+		mesh.AcmrBefore = header.AcmrBefore;
+		mesh.AcmrAfter = header.AcmrAfter;
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,868 @@
+#ifndef MESHIMPORTER_H
+#define MESHIMPORTER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <memory>
+#include <filesystem>
+#include <iostream>
+#include "Mesh.h"
+#include "assetpack.h"
+
+using std::vector;
+
+//Minimal JSON reader for glTF. Strings are views into the source text and are not unescaped (glTF keys and the values
+//used here are plain ASCII), numbers are doubles
+struct JsonValue
+{
+	enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+	Type Kind = JSON_NULL;
+	double Number = 0.0;
+	std::string_view String;
+	vector<JsonValue> Items;
+	vector<std::pair<std::string_view, JsonValue>> Members;
+
+	//Member of an object, nullptr if missing
+	const JsonValue* Find(std::string_view key) const
+	{
+		for (const auto& member : Members) {
+			if (member.first == key) {
+				return &member.second;
+			}
+		}
+		return nullptr;
+	}
+
+	//Integer member, fallback if missing or not a number
+	int64_t Int(std::string_view key, int64_t fallback = -1) const
+	{
+		const JsonValue* value = Find(key);
+		return (value && value->Kind == JSON_NUMBER) ? static_cast<int64_t>(value->Number) : fallback;
+	}
+
+	//Element of an array, nullptr if out of range
+	const JsonValue* At(int64_t index) const
+	{
+		return (Kind == JSON_ARRAY && index >= 0 && static_cast<size_t>(index) < Items.size()) ? &Items[static_cast<size_t>(index)] : nullptr;
+	}
+
+	//Parses text into value, false on a syntax error
+	static bool Parse(std::string_view text, JsonValue& value)
+	{
+		const char* cursor = text.data();
+		const char* end = text.data() + text.size();
+		if (!ParseValue(cursor, end, value, 0)) {
+			return false;
+		}
+		SkipSpace(cursor, end);
+		return cursor == end;
+	}
+
+private:
+	static const int MaxDepth = 64;
+
+	static void SkipSpace(const char*& cursor, const char* end)
+	{
+		while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r' || *cursor == '\0')) {
+			cursor++;
+		}
+	}
+
+	static bool ParseString(const char*& cursor, const char* end, std::string_view& out)
+	{
+		if (cursor == end || *cursor != '"') {
+			return false;
+		}
+		const char* start = ++cursor;
+		while (cursor < end && *cursor != '"') {
+			cursor += (*cursor == '\\') ? 2 : 1;
+		}
+		if (cursor >= end) {
+			return false;
+		}
+		out = std::string_view(start, cursor - start);
+		cursor++;
+		return true;
+	}
+
+	static bool ParseValue(const char*& cursor, const char* end, JsonValue& value, int depth)
+	{
+		SkipSpace(cursor, end);
+		if (cursor == end || depth > MaxDepth) {
+			return false;
+		}
+
+		switch (*cursor) {
+		case '{':
+			value.Kind = JSON_OBJECT;
+			cursor++;
+			SkipSpace(cursor, end);
+			if (cursor < end && *cursor == '}') {
+				cursor++;
+				return true;
+			}
+			while (true) {
+				std::pair<std::string_view, JsonValue> member;
+				SkipSpace(cursor, end);
+				if (!ParseString(cursor, end, member.first)) {
+					return false;
+				}
+				SkipSpace(cursor, end);
+				if (cursor == end || *cursor++ != ':' || !ParseValue(cursor, end, member.second, depth + 1)) {
+					return false;
+				}
+				value.Members.push_back(std::move(member));
+				SkipSpace(cursor, end);
+				if (cursor == end) {
+					return false;
+				}
+				if (*cursor == '}') {
+					cursor++;
+					return true;
+				}
+				if (*cursor++ != ',') {
+					return false;
+				}
+			}
+		case '[':
+			value.Kind = JSON_ARRAY;
+			cursor++;
+			SkipSpace(cursor, end);
+			if (cursor < end && *cursor == ']') {
+				cursor++;
+				return true;
+			}
+			while (true) {
+				value.Items.emplace_back();
+				if (!ParseValue(cursor, end, value.Items.back(), depth + 1)) {
+					return false;
+				}
+				SkipSpace(cursor, end);
+				if (cursor == end) {
+					return false;
+				}
+				if (*cursor == ']') {
+					cursor++;
+					return true;
+				}
+				if (*cursor++ != ',') {
+					return false;
+				}
+			}
+		case '"':
+			value.Kind = JSON_STRING;
+			return ParseString(cursor, end, value.String);
+		case 't':
+		case 'f':
+		case 'n': {
+			std::string_view rest(cursor, end - cursor);
+			for (const char* word : { "true", "false", "null" }) {
+				if (rest.substr(0, strlen(word)) == word) {
+					value.Kind = (word[0] == 'n') ? JSON_NULL : JSON_BOOL;
+					value.Number = (word[0] == 't') ? 1.0 : 0.0;
+					cursor += strlen(word);
+					return true;
+				}
+			}
+			return false;
+		}
+		default: {
+			value.Kind = JSON_NUMBER;
+			auto result = std::from_chars(cursor, end, value.Number);
+			if (result.ec != std::errc()) {
+				return false;
+			}
+			cursor = result.ptr;
+			return true;
+		}
+		}
+	}
+};
+
+//Importers for OBJ and glTF (.gltf with its buffers, or binary .glb) into the 11 float vertex layout of Mesh plus indices.
+//Both read memory-mapped files and only produce CPU data, so they can run on worker threads; ImportedMesh wraps them
+//in a Mesh that uploads like the generated primitives.
+//Vertices get a white color. Missing normals are computed smooth (area weighted per position), missing UVs are 0.
+class MeshImporter
+{
+public:
+	//Parses OBJ text (v, vt, vn and f; faces with more than 3 corners are fanned, everything else is skipped).
+	//The text is split at line boundaries into one chunk per thread. Each chunk is parsed in parallel with from_chars,
+	//after a first parallel pass counts the attribute lines so every chunk knows its global attribute numbering
+	//(negative indices are relative to it). Corners are deduplicated within a chunk, so only vertices shared across a
+	//chunk boundary are stored twice
+	static bool ParseObj(const char* text, size_t size, vector<float>& vertices, vector<unsigned int>& indices,
+		unsigned int threadCount = std::thread::hardware_concurrency())
+	{
+		vertices.clear();
+		indices.clear();
+
+		//Chunks end after a newline, at most one per thread and none smaller than 64 KB
+		threadCount = std::max(1u, std::min<unsigned int>(threadCount, static_cast<unsigned int>(size / (64 * 1024) + 1)));
+		vector<ObjChunk> chunks(threadCount);
+		size_t start = 0;
+		for (unsigned int c = 0; c < threadCount; c++) {
+			size_t end = (c + 1 == threadCount) ? size : std::max(start, size * (c + 1) / threadCount);
+			while (end < size && text[end - 1] != '\n') {
+				end++;
+			}
+			chunks[c].Begin = text + start;
+			chunks[c].End = text + end;
+			start = end;
+		}
+
+		//1. Count attribute lines per chunk
+		ParallelFor(chunks.size(), threadCount, [&](size_t c) { CountObjAttributes(chunks[c]); });
+		ObjCounts total;
+		for (ObjChunk& chunk : chunks) {
+			chunk.First = total;
+			total.Positions += chunk.Count.Positions;
+			total.TexCoords += chunk.Count.TexCoords;
+			total.Normals += chunk.Count.Normals;
+		}
+
+		//2. Parse the attributes into the shared arrays (each chunk owns a range) and the faces into per chunk corners
+		vector<float> positions(total.Positions * 3), texCoords(total.TexCoords * 2), normals(total.Normals * 3);
+		ParallelFor(chunks.size(), threadCount, [&](size_t c) { ParseObjChunk(chunks[c], total, positions.data(), texCoords.data(), normals.data()); });
+		for (const ObjChunk& chunk : chunks) {
+			if (!chunk.Error.empty()) {
+				std::cout << "ERROR::IMPORT::OBJ " << chunk.Error << std::endl;
+				return false;
+			}
+		}
+
+		//3. Build each chunk's vertices from its corners
+		ParallelFor(chunks.size(), threadCount, [&](size_t c) { BuildObjVertices(chunks[c], positions, texCoords, normals); });
+
+		//Concatenate, rebasing every chunk's indices
+		size_t vertexFloats = 0, indexCount = 0;
+		for (ObjChunk& chunk : chunks) {
+			chunk.VertexBase = vertexFloats / VertexFloats;
+			chunk.IndexBase = indexCount;
+			vertexFloats += chunk.Vertices.size();
+			indexCount += chunk.Indices.size();
+		}
+		if (indexCount == 0) {
+			std::cout << "ERROR::IMPORT::OBJ NO_FACES" << std::endl;
+			return false;
+		}
+		vertices.resize(vertexFloats);
+		indices.resize(indexCount);
+		vector<unsigned int> vertexPositions(vertexFloats / VertexFloats);
+		ParallelFor(chunks.size(), threadCount, [&](size_t c) {
+			const ObjChunk& chunk = chunks[c];
+			std::copy(chunk.Vertices.begin(), chunk.Vertices.end(), vertices.begin() + chunk.VertexBase * VertexFloats);
+			std::copy(chunk.VertexPositions.begin(), chunk.VertexPositions.end(), vertexPositions.begin() + chunk.VertexBase);
+			for (size_t i = 0; i < chunk.Indices.size(); i++) {
+				indices[chunk.IndexBase + i] = chunk.Indices[i] + static_cast<unsigned int>(chunk.VertexBase);
+			}
+		});
+
+		bool missingNormals = false;
+		for (const ObjChunk& chunk : chunks) {
+			missingNormals = missingNormals || chunk.MissingNormals;
+		}
+		if (missingNormals) {
+			ComputeNormals(vertices, indices, &vertexPositions, total.Positions);
+		}
+		return true;
+	}
+
+	//Parses a .glb, or a .gltf whose buffers are files next to it (data URIs are not supported). Every triangle primitive
+	//of every mesh is appended, node transforms are not applied. Attributes are read from the mapped buffers straight into
+	//the interleaved vertices, and indices are widened into indices, with no other copies
+	static bool ParseGltf(const char* data, size_t size, const std::string& baseDirectory, vector<float>& vertices, vector<unsigned int>& indices)
+	{
+		vertices.clear();
+		indices.clear();
+
+		std::string_view json;
+		AssetView binaryChunk;
+		if (size >= 12 && memcmp(data, "glTF", 4) == 0) {
+			uint32_t version, length;
+			memcpy(&version, data + 4, 4);
+			memcpy(&length, data + 8, 4);
+			if (version != 2 || length > size) {
+				return Fail("UNSUPPORTED_GLB");
+			}
+			//Chunks: 4 byte length, 4 byte type, data padded to 4 bytes
+			for (size_t offset = 12; offset + 8 <= length;) {
+				uint32_t chunkLength, chunkType;
+				memcpy(&chunkLength, data + offset, 4);
+				memcpy(&chunkType, data + offset + 4, 4);
+				if (chunkLength > length - offset - 8) {
+					return Fail("TRUNCATED_GLB");
+				}
+				if (chunkType == 0x4E4F534A) {
+					json = std::string_view(data + offset + 8, chunkLength);
+				}
+				else if (chunkType == 0x004E4942 && !binaryChunk.Data) {
+					binaryChunk.Data = data + offset + 8;
+					binaryChunk.Size = chunkLength;
+				}
+				offset += 8 + static_cast<size_t>(chunkLength);
+			}
+		}
+		else {
+			json = std::string_view(data, size);
+		}
+
+		JsonValue document;
+		if (json.empty() || !JsonValue::Parse(json, document) || document.Kind != JsonValue::JSON_OBJECT) {
+			return Fail("BAD_JSON");
+		}
+
+		//Buffers: the GLB binary chunk, or mapped files
+		vector<AssetView> buffers;
+		vector<std::unique_ptr<MappedFile>> mapped;
+		if (const JsonValue* list = document.Find("buffers")) {
+			for (const JsonValue& buffer : list->Items) {
+				const JsonValue* uri = buffer.Find("uri");
+				if (!uri) {
+					buffers.push_back(binaryChunk);
+					continue;
+				}
+				if (uri->String.substr(0, 5) == "data:") {
+					return Fail("DATA_URI_NOT_SUPPORTED");
+				}
+				mapped.push_back(std::make_unique<MappedFile>());
+				std::string path = (std::filesystem::path(baseDirectory) / std::string(uri->String)).string();
+				if (!mapped.back()->Open(path)) {
+					return Fail("BUFFER_NOT_FOUND " + path);
+				}
+				buffers.push_back(AssetView{ mapped.back()->Data(), mapped.back()->Size() });
+			}
+		}
+
+		const JsonValue* meshes = document.Find("meshes");
+		if (!meshes) {
+			return Fail("NO_MESHES");
+		}
+		for (const JsonValue& mesh : meshes->Items) {
+			const JsonValue* primitives = mesh.Find("primitives");
+			if (!primitives) {
+				continue;
+			}
+			for (const JsonValue& primitive : primitives->Items) {
+				if (primitive.Int("mode", 4) != 4) {
+					continue;
+				}
+				if (!AppendGltfPrimitive(document, buffers, primitive, vertices, indices)) {
+					return false;
+				}
+			}
+		}
+
+		if (indices.empty()) {
+			return Fail("NO_TRIANGLES");
+		}
+		return true;
+	}
+
+	//Imports a file by extension (.obj, .gltf, .glb), from the mounted asset pack or else the memory-mapped loose file.
+	//Returns false if it can not be read or parsed
+	static bool Import(const std::string& path, vector<float>& vertices, vector<unsigned int>& indices)
+	{
+		vector<char> scratch;
+		AssetView view;
+		MappedFile file;
+		if (!AssetPack::Mounted || !AssetPack::Mounted->Find(path, scratch, view)) {
+			if (!file.Open(path)) {
+				std::cout << "ERROR::IMPORT::FILE_NOT_FOUND " << path << std::endl;
+				return false;
+			}
+			view = AssetView{ file.Data(), file.Size() };
+		}
+
+		std::string extension = std::filesystem::path(path).extension().string();
+		for (char& c : extension) {
+			c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+		}
+		if (extension == ".obj") {
+			return ParseObj(view.Data, view.Size, vertices, indices);
+		}
+		if (extension == ".gltf" || extension == ".glb") {
+			return ParseGltf(view.Data, view.Size, std::filesystem::path(path).parent_path().string(), vertices, indices);
+		}
+		std::cout << "ERROR::IMPORT::UNKNOWN_FORMAT " << path << std::endl;
+		return false;
+	}
+
+	//Smooth normals: area weighted face normals summed per position (vertexPositions maps vertices to positions, or
+	//nullptr if every vertex is its own position), written to every vertex at that position
+	static void ComputeNormals(vector<float>& vertices, const vector<unsigned int>& indices, const vector<unsigned int>* vertexPositions, size_t positionCount)
+	{
+		size_t vertexCount = vertices.size() / VertexFloats;
+		if (!vertexPositions) {
+			positionCount = vertexCount;
+		}
+		auto positionOf = [&](unsigned int vertex) { return vertexPositions ? (*vertexPositions)[vertex] : vertex; };
+
+		vector<glm::vec3> sums(positionCount, glm::vec3(0.0f));
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			const float* a = &vertices[indices[i] * VertexFloats];
+			const float* b = &vertices[indices[i + 1] * VertexFloats];
+			const float* c = &vertices[indices[i + 2] * VertexFloats];
+			glm::vec3 normal = glm::cross(glm::vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]), glm::vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+			for (int corner = 0; corner < 3; corner++) {
+				sums[positionOf(indices[i + corner])] += normal;
+			}
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+			glm::vec3 sum = sums[positionOf(static_cast<unsigned int>(v))];
+			float length = glm::length(sum);
+			glm::vec3 normal = (length > 0.0f) ? sum / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			vertices[v * VertexFloats + 6] = normal.x;
+			vertices[v * VertexFloats + 7] = normal.y;
+			vertices[v * VertexFloats + 8] = normal.z;
+		}
+	}
+
+private:
+	static const int VertexFloats = 11;
+
+	struct ObjCounts
+	{
+		size_t Positions = 0;
+		size_t TexCoords = 0;
+		size_t Normals = 0;
+	};
+
+	//A corner's attribute indices, 0 based, -1 when absent
+	struct ObjCorner
+	{
+		int64_t Position, TexCoord, Normal;
+	};
+
+	struct ObjChunk
+	{
+		const char* Begin = nullptr;
+		const char* End = nullptr;
+		ObjCounts Count;
+		ObjCounts First;
+		vector<ObjCorner> Corners;   //Three per triangle
+		std::string Error;
+
+		vector<float> Vertices;
+		vector<unsigned int> Indices;
+		vector<unsigned int> VertexPositions;
+		bool MissingNormals = false;
+		size_t VertexBase = 0;
+		size_t IndexBase = 0;
+	};
+
+	//Runs work(0..count-1) on up to threadCount threads, the calling thread included
+	template<typename Work>
+	static void ParallelFor(size_t count, unsigned int threadCount, Work work)
+	{
+		vector<std::thread> workers;
+		for (size_t i = 1; i < count && i < threadCount; i++) {
+			workers.emplace_back([&, i]() {
+				for (size_t item = i; item < count; item += threadCount) {
+					work(item);
+				}
+			});
+		}
+		for (size_t item = 0; item < count; item += std::max(threadCount, 1u)) {
+			work(item);
+		}
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+	}
+
+	static const char* LineEnd(const char* cursor, const char* end)
+	{
+		const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+		return newline ? newline : end;
+	}
+
+	static void SkipBlanks(const char*& cursor, const char* end)
+	{
+		while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')) {
+			cursor++;
+		}
+	}
+
+	enum ObjLine { OBJ_OTHER, OBJ_POSITION, OBJ_TEXCOORD, OBJ_NORMAL, OBJ_FACE };
+
+	//Kind of the line at cursor (past its leading blanks). Both passes go by this, so every attribute the counting pass
+	//numbers is one the parsing pass reads (or fails on, like a bare "vt"), and the indices of the two always agree
+	static ObjLine ClassifyObjLine(const char* cursor, const char* end)
+	{
+		if (end - cursor < 2) {
+			return OBJ_OTHER;
+		}
+		bool blank = cursor[1] == ' ' || cursor[1] == '\t';
+		if (cursor[0] == 'f') {
+			return blank ? OBJ_FACE : OBJ_OTHER;
+		}
+		if (cursor[0] != 'v') {
+			return OBJ_OTHER;
+		}
+		if (blank) {
+			return OBJ_POSITION;
+		}
+		if (cursor[1] == 't') {
+			return OBJ_TEXCOORD;
+		}
+		return cursor[1] == 'n' ? OBJ_NORMAL : OBJ_OTHER;
+	}
+
+	static void CountObjAttributes(ObjChunk& chunk)
+	{
+		for (const char* line = chunk.Begin; line < chunk.End;) {
+			const char* end = LineEnd(line, chunk.End);
+			const char* cursor = line;
+			SkipBlanks(cursor, end);
+			ObjLine kind = ClassifyObjLine(cursor, end);
+			if (kind == OBJ_POSITION) {
+				chunk.Count.Positions++;
+			}
+			else if (kind == OBJ_TEXCOORD) {
+				chunk.Count.TexCoords++;
+			}
+			else if (kind == OBJ_NORMAL) {
+				chunk.Count.Normals++;
+			}
+			line = end + 1;
+		}
+	}
+
+	static bool ParseFloats(const char*& cursor, const char* end, float* out, int count)
+	{
+		for (int i = 0; i < count; i++) {
+			SkipBlanks(cursor, end);
+			auto result = std::from_chars(cursor, end, out[i]);
+			if (result.ec != std::errc()) {
+				return false;
+			}
+			cursor = result.ptr;
+		}
+		return true;
+	}
+
+	//Resolves a 1 based (or negative, relative to the attributes read so far) OBJ index to 0 based
+	static bool ParseIndex(const char*& cursor, const char* end, size_t readSoFar, size_t total, int64_t& index)
+	{
+		int64_t value = 0;
+		auto result = std::from_chars(cursor, end, value);
+		if (result.ec != std::errc() || value == 0) {
+			return false;
+		}
+		cursor = result.ptr;
+		index = (value > 0) ? value - 1 : static_cast<int64_t>(readSoFar) + value;
+		return index >= 0 && static_cast<size_t>(index) < total;
+	}
+
+	static void ParseObjChunk(ObjChunk& chunk, const ObjCounts& total, float* positions, float* texCoords, float* normals)
+	{
+		ObjCounts read = chunk.First;
+		vector<ObjCorner> face;
+
+		for (const char* line = chunk.Begin; line < chunk.End;) {
+			const char* end = LineEnd(line, chunk.End);
+			const char* cursor = line;
+			SkipBlanks(cursor, end);
+			bool ok = true;
+			ObjLine kind = ClassifyObjLine(cursor, end);
+
+			if (kind == OBJ_POSITION) {
+				cursor += 1;
+				ok = ParseFloats(cursor, end, positions + read.Positions * 3, 3);
+				read.Positions++;
+			}
+			else if (kind == OBJ_TEXCOORD) {
+				cursor += 2;
+				ok = ParseFloats(cursor, end, texCoords + read.TexCoords * 2, 2);
+				read.TexCoords++;
+			}
+			else if (kind == OBJ_NORMAL) {
+				cursor += 2;
+				ok = ParseFloats(cursor, end, normals + read.Normals * 3, 3);
+				read.Normals++;
+			}
+			else if (kind == OBJ_FACE) {
+				cursor += 1;
+				face.clear();
+				while (ok) {
+					SkipBlanks(cursor, end);
+					if (cursor == end) {
+						break;
+					}
+					//v, v/vt, v//vn or v/vt/vn
+					ObjCorner corner = { -1, -1, -1 };
+					ok = ParseIndex(cursor, end, read.Positions, total.Positions, corner.Position);
+					if (ok && cursor < end && *cursor == '/') {
+						cursor++;
+						if (cursor < end && *cursor != '/') {
+							ok = ParseIndex(cursor, end, read.TexCoords, total.TexCoords, corner.TexCoord);
+						}
+						if (ok && cursor < end && *cursor == '/') {
+							cursor++;
+							ok = ParseIndex(cursor, end, read.Normals, total.Normals, corner.Normal);
+						}
+					}
+					face.push_back(corner);
+				}
+				ok = ok && face.size() >= 3;
+				for (size_t i = 2; ok && i < face.size(); i++) {
+					chunk.Corners.push_back(face[0]);
+					chunk.Corners.push_back(face[i - 1]);
+					chunk.Corners.push_back(face[i]);
+				}
+			}
+
+			if (!ok) {
+				chunk.Error = "BAD_LINE " + std::string(line, std::min<size_t>(end - line, 80));
+				return;
+			}
+			line = end + 1;
+		}
+	}
+
+	//Deduplicates the chunk's corners into vertices with an open addressing table keyed on the three indices
+	static void BuildObjVertices(ObjChunk& chunk, const vector<float>& positions, const vector<float>& texCoords, const vector<float>& normals)
+	{
+		size_t tableSize = 16;
+		while (tableSize < chunk.Corners.size() * 2) {
+			tableSize *= 2;
+		}
+		vector<int64_t> table(tableSize, -1);
+		vector<ObjCorner> unique;
+		chunk.Indices.reserve(chunk.Corners.size());
+
+		for (const ObjCorner& corner : chunk.Corners) {
+			uint64_t hash = (static_cast<uint64_t>(corner.Position) * 73856093u) ^ (static_cast<uint64_t>(corner.TexCoord) * 19349663u) ^ (static_cast<uint64_t>(corner.Normal) * 83492791u);
+			size_t slot = static_cast<size_t>(hash * 0x9E3779B97F4A7C15ull >> 32) & (tableSize - 1);
+			while (table[slot] >= 0) {
+				const ObjCorner& other = unique[static_cast<size_t>(table[slot])];
+				if (other.Position == corner.Position && other.TexCoord == corner.TexCoord && other.Normal == corner.Normal) {
+					break;
+				}
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] < 0) {
+				table[slot] = static_cast<int64_t>(unique.size());
+				unique.push_back(corner);
+			}
+			chunk.Indices.push_back(static_cast<unsigned int>(table[slot]));
+		}
+
+		chunk.Vertices.resize(unique.size() * VertexFloats);
+		chunk.VertexPositions.resize(unique.size());
+		for (size_t v = 0; v < unique.size(); v++) {
+			const ObjCorner& corner = unique[v];
+			float* vertex = &chunk.Vertices[v * VertexFloats];
+			const float* position = &positions[static_cast<size_t>(corner.Position) * 3];
+			vertex[0] = position[0];
+			vertex[1] = position[1];
+			vertex[2] = position[2];
+			vertex[3] = vertex[4] = vertex[5] = 1.0f;
+			if (corner.Normal >= 0) {
+				memcpy(vertex + 6, &normals[static_cast<size_t>(corner.Normal) * 3], 3 * sizeof(float));
+			}
+			else {
+				chunk.MissingNormals = true;
+			}
+			if (corner.TexCoord >= 0) {
+				memcpy(vertex + 9, &texCoords[static_cast<size_t>(corner.TexCoord) * 2], 2 * sizeof(float));
+			}
+			chunk.VertexPositions[v] = static_cast<unsigned int>(corner.Position);
+		}
+		chunk.Corners = vector<ObjCorner>();
+	}
+
+	static bool Fail(const std::string& error)
+	{
+		std::cout << "ERROR::IMPORT::GLTF " << error << std::endl;
+		return false;
+	}
+
+	//Location and layout of an accessor's elements in its buffer
+	struct GltfStream
+	{
+		const char* Data = nullptr;
+		size_t Count = 0;
+		size_t Stride = 0;
+		int64_t ComponentType = 0;
+		int Components = 0;
+		bool Normalized = false;
+	};
+
+	static bool Accessor(const JsonValue& document, const vector<AssetView>& buffers, int64_t index, int components, GltfStream& stream)
+	{
+		const JsonValue* accessors = document.Find("accessors");
+		const JsonValue* accessor = accessors ? accessors->At(index) : nullptr;
+		if (!accessor) {
+			return false;
+		}
+		const JsonValue* type = accessor->Find("type");
+		int typeComponents = !type ? 0 : type->String == "SCALAR" ? 1 : type->String == "VEC2" ? 2 : type->String == "VEC3" ? 3 : type->String == "VEC4" ? 4 : 0;
+		if (typeComponents != components || accessor->Find("sparse")) {
+			return false;
+		}
+
+		const JsonValue* views = document.Find("bufferViews");
+		const JsonValue* view = views ? views->At(accessor->Int("bufferView")) : nullptr;
+		if (!view) {
+			return false;
+		}
+		int64_t bufferIndex = view->Int("buffer");
+		if (bufferIndex < 0 || static_cast<size_t>(bufferIndex) >= buffers.size() || !buffers[bufferIndex].Data) {
+			return false;
+		}
+		const AssetView& buffer = buffers[bufferIndex];
+
+		stream.ComponentType = accessor->Int("componentType");
+		size_t componentSize = (stream.ComponentType == 5121 || stream.ComponentType == 5120) ? 1
+			: (stream.ComponentType == 5123 || stream.ComponentType == 5122) ? 2 : (stream.ComponentType == 5125 || stream.ComponentType == 5126) ? 4 : 0;
+		if (componentSize == 0) {
+			return false;
+		}
+		const JsonValue* normalized = accessor->Find("normalized");
+		stream.Normalized = normalized && normalized->Number != 0.0;
+		stream.Components = components;
+		stream.Count = static_cast<size_t>(std::max<int64_t>(accessor->Int("count", 0), 0));
+		size_t elementSize = componentSize * components;
+		stream.Stride = static_cast<size_t>(std::max<int64_t>(view->Int("byteStride", 0), 0));
+		if (stream.Stride == 0) {
+			stream.Stride = elementSize;
+		}
+
+		//Everything the accessor reads has to be inside its view and the view inside its buffer
+		size_t viewOffset = static_cast<size_t>(std::max<int64_t>(view->Int("byteOffset", 0), 0));
+		size_t viewLength = static_cast<size_t>(std::max<int64_t>(view->Int("byteLength", 0), 0));
+		size_t accessorOffset = static_cast<size_t>(std::max<int64_t>(accessor->Int("byteOffset", 0), 0));
+		if (viewOffset > buffer.Size || viewLength > buffer.Size - viewOffset || stream.Count == 0 || stream.Stride < elementSize) {
+			return false;
+		}
+		if (accessorOffset > viewLength || (stream.Count - 1) > (viewLength - accessorOffset) / stream.Stride
+			|| (stream.Count - 1) * stream.Stride + elementSize > viewLength - accessorOffset) {
+			return false;
+		}
+		stream.Data = buffer.Data + viewOffset + accessorOffset;
+		return true;
+	}
+
+	//Component c of element i as a float (normalized integers are scaled to 0-1)
+	static float ReadFloat(const GltfStream& stream, size_t i, int c)
+	{
+		const char* element = stream.Data + i * stream.Stride;
+		switch (stream.ComponentType) {
+		case 5126: { float value; memcpy(&value, element + c * 4, 4); return value; }
+		case 5121: { uint8_t value = static_cast<uint8_t>(element[c]); return stream.Normalized ? value / 255.0f : value; }
+		case 5123: { uint16_t value; memcpy(&value, element + c * 2, 2); return stream.Normalized ? value / 65535.0f : value; }
+		default: return 0.0f;
+		}
+	}
+
+	static bool AppendGltfPrimitive(const JsonValue& document, const vector<AssetView>& buffers, const JsonValue& primitive,
+		vector<float>& vertices, vector<unsigned int>& indices)
+	{
+		const JsonValue* attributes = primitive.Find("attributes");
+		GltfStream positions, normals, texCoords;
+		if (!attributes || !Accessor(document, buffers, attributes->Int("POSITION"), 3, positions) || positions.ComponentType != 5126) {
+			return Fail("BAD_POSITIONS");
+		}
+		bool hasNormals = Accessor(document, buffers, attributes->Int("NORMAL"), 3, normals) && normals.ComponentType == 5126 && normals.Count == positions.Count;
+		bool hasTexCoords = Accessor(document, buffers, attributes->Int("TEXCOORD_0"), 2, texCoords) && texCoords.Count == positions.Count;
+
+		size_t base = vertices.size() / VertexFloats;
+		vertices.resize(vertices.size() + positions.Count * VertexFloats);
+		float* vertex = &vertices[base * VertexFloats];
+		for (size_t i = 0; i < positions.Count; i++, vertex += VertexFloats) {
+			memcpy(vertex, positions.Data + i * positions.Stride, 3 * sizeof(float));
+			vertex[3] = vertex[4] = vertex[5] = 1.0f;
+			if (hasNormals) {
+				memcpy(vertex + 6, normals.Data + i * normals.Stride, 3 * sizeof(float));
+			}
+			else {
+				vertex[6] = vertex[8] = 0.0f;
+				vertex[7] = 1.0f;
+			}
+			//glTF puts the UV origin at the top left, the textures here are flipped on load to GL's bottom left
+			vertex[9] = hasTexCoords ? ReadFloat(texCoords, i, 0) : 0.0f;
+			vertex[10] = hasTexCoords ? 1.0f - ReadFloat(texCoords, i, 1) : 0.0f;
+		}
+
+		size_t firstIndex = indices.size();
+		GltfStream indexStream;
+		if (primitive.Find("indices")) {
+			if (!Accessor(document, buffers, primitive.Int("indices"), 1, indexStream) || indexStream.Count % 3 != 0) {
+				return Fail("BAD_INDICES");
+			}
+			indices.resize(firstIndex + indexStream.Count);
+			for (size_t i = 0; i < indexStream.Count; i++) {
+				const char* element = indexStream.Data + i * indexStream.Stride;
+				uint32_t index = 0;
+				switch (indexStream.ComponentType) {
+				case 5121: index = static_cast<uint8_t>(*element); break;
+				case 5123: { uint16_t value; memcpy(&value, element, 2); index = value; break; }
+				case 5125: memcpy(&index, element, 4); break;
+				default: return Fail("BAD_INDEX_TYPE");
+				}
+				if (index >= positions.Count) {
+					return Fail("INDEX_OUT_OF_RANGE");
+				}
+				indices[firstIndex + i] = static_cast<unsigned int>(base + index);
+			}
+		}
+		else {
+			//Non-indexed, every three vertices are a triangle
+			for (size_t i = 0; i < positions.Count / 3 * 3; i++) {
+				indices.push_back(static_cast<unsigned int>(base + i));
+			}
+		}
+
+		if (!hasNormals) {
+			vector<float> primitiveVertices(vertices.begin() + base * VertexFloats, vertices.end());
+			vector<unsigned int> primitiveIndices(indices.begin() + firstIndex, indices.end());
+			for (unsigned int& index : primitiveIndices) {
+				index -= static_cast<unsigned int>(base);
+			}
+			ComputeNormals(primitiveVertices, primitiveIndices, nullptr, 0);
+			std::copy(primitiveVertices.begin(), primitiveVertices.end(), vertices.begin() + base * VertexFloats);
+		}
+		return true;
+	}
+};
+
+//A mesh imported from an OBJ or glTF file, placed at position and scaled (baked into the vertices like the generated
+//primitives). Uploads like them too, so it is optimized, split into meshlets and deferred with Mesh::DeferUpload.
+//Loaded is false if the file could not be imported, the mesh is then empty
+class ImportedMesh : public Mesh
+{
+public:
+	bool Loaded = false;
+
+	ImportedMesh(const std::string& path, glm::vec3 position = glm::vec3(0.0f), float scale = 1.0f)
+	{
+		Position = position;
+		Loaded = MeshImporter::Import(path, Vertices, Indices);
+		if (!Loaded) {
+			Vertices.clear();
+			Indices.clear();
+			return;
+		}
+
+		for (size_t i = 0; i + 2 < Vertices.size(); i += numVertexAttributes) {
+			Vertices[i] = Vertices[i] * scale + position.x;
+			Vertices[i + 1] = Vertices[i + 1] * scale + position.y;
+			Vertices[i + 2] = Vertices[i + 2] * scale + position.z;
+		}
+
+		//Generate the VAO/VBO
+		GenerateVertexArrayAndBuffer();
+	}
+};
+
+#endif
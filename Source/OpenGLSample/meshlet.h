@@ -0,0 +1,345 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <cmath>
+#include <cstdint>
+#include "frustum.h"
+#include "meshoptimizer.h"
+
+using std::vector;
+
+//A run of triangles in a mesh's index buffer, small enough to be culled on its own
+struct Meshlet
+{
+	unsigned int IndexOffset;   //First index in the mesh's index buffer
+	unsigned int TriangleCount;
+	unsigned int VertexCount;   //Unique vertices referenced
+
+	//Bounding sphere (object space)
+	glm::vec3 Center;
+	float Radius;
+
+	//Normal cone (object space). ConeCutoff is the sine of the cone's spread, 1.0 means the cone cannot cull
+	glm::vec3 ConeAxis;
+	float ConeCutoff;
+};
+
+//Splits an indexed mesh into meshlets. Each meshlet is grown from the next free triangle in index buffer order (which is
+//cache optimized by then) across neighbouring triangles whose normals agree, then the index buffer is rewritten in meshlet
+//order so every meshlet is one contiguous range.
+class MeshletBuilder
+{
+public:
+	static const int MaxVertices = 64;
+	static const int MaxTriangles = 124;
+
+	//Triangles further than this from the running cone axis are not added (cos 60 degrees), keeps the cones tight
+	static constexpr float MinNormalAgreement = 0.5f;
+
+	//Builds the meshlets and reorders the triangles in indices to match. Face normals are oriented away from the mesh center
+	//instead of trusting the winding or the vertex normals (the generators are not consistent), which is right for the closed,
+	//convex-ish shapes in the scene
+	static vector<Meshlet> Build(vector<unsigned int>& indices, const vector<float>& vertices, int stride)
+	{
+		vector<Meshlet> meshlets;
+		size_t triangleCount = indices.size() / 3;
+		if (triangleCount == 0) {
+			return meshlets;
+		}
+
+		glm::vec3 meshMin, meshMax;
+		CalculateBounds(vertices, stride, meshMin, meshMax);
+		glm::vec3 meshCenter = (meshMin + meshMax) * 0.5f;
+
+		vector<glm::vec3> normals(triangleCount);
+		for (size_t t = 0; t < triangleCount; t++) {
+			normals[t] = OrientedFaceNormal(indices, vertices, stride, t, meshCenter);
+		}
+
+		//Triangles around each welded position, flat shaded generators share positions but not vertices
+		vector<unsigned int> positionOf = MeshOptimizer::WeldPositions(vertices, stride);
+		unsigned int positionCount = 0;
+		for (unsigned int id : positionOf) {
+			positionCount = glm::max(positionCount, id + 1);
+		}
+
+		vector<unsigned int> adjacencyStart(positionCount + 1, 0);
+		for (unsigned int index : indices) {
+			adjacencyStart[positionOf[index] + 1]++;
+		}
+		for (unsigned int i = 0; i < positionCount; i++) {
+			adjacencyStart[i + 1] += adjacencyStart[i];
+		}
+
+		vector<unsigned int> adjacency(indices.size());
+		vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++) {
+			adjacency[fill[positionOf[indices[i]]]++] = static_cast<unsigned int>(i / 3);
+		}
+
+		vector<bool> assigned(triangleCount, false);
+		vector<unsigned int> seenIn(vertices.size() / stride, ~0u);     //Last meshlet each vertex was added to
+		vector<unsigned int> candidateIn(triangleCount, ~0u);            //Last meshlet each triangle was a candidate for
+		vector<unsigned int> candidates;
+		vector<unsigned int> reordered;
+		reordered.reserve(indices.size());
+
+		size_t nextSeed = 0;
+		while (true) {
+			while (nextSeed < triangleCount && assigned[nextSeed]) {
+				nextSeed++;
+			}
+			if (nextSeed == triangleCount) {
+				break;
+			}
+
+			unsigned int meshletId = static_cast<unsigned int>(meshlets.size());
+			unsigned int start = static_cast<unsigned int>(reordered.size() / 3);
+			unsigned int uniqueVertices = 0;
+			glm::vec3 normalSum = glm::vec3(0.0f);
+			candidates.clear();
+
+			unsigned int triangle = static_cast<unsigned int>(nextSeed);
+			while (true) {
+				//Add the triangle
+				assigned[triangle] = true;
+				normalSum += normals[triangle];
+				for (int c = 0; c < 3; c++) {
+					unsigned int index = indices[triangle * 3 + c];
+					reordered.push_back(index);
+					if (seenIn[index] != meshletId) {
+						seenIn[index] = meshletId;
+						uniqueVertices++;
+					}
+
+					//Its neighbours become candidates
+					unsigned int position = positionOf[index];
+					for (unsigned int a = adjacencyStart[position]; a < adjacencyStart[position + 1]; a++) {
+						unsigned int neighbour = adjacency[a];
+						if (!assigned[neighbour] && candidateIn[neighbour] != meshletId) {
+							candidateIn[neighbour] = meshletId;
+							candidates.push_back(neighbour);
+						}
+					}
+				}
+
+				if (reordered.size() / 3 - start >= static_cast<size_t>(MaxTriangles)) {
+					break;
+				}
+
+				//Pick the candidate that agrees most with the cone, ties go to the one reusing more vertices
+				glm::vec3 axis = (glm::length(normalSum) > 0.0f) ? glm::normalize(normalSum) : glm::vec3(0.0f);
+				float bestScore = -INFINITY;
+				size_t best = candidates.size();
+				for (size_t i = 0; i < candidates.size(); i++) {
+					unsigned int candidate = candidates[i];
+					if (assigned[candidate]) {
+						continue;
+					}
+
+					unsigned int newVertices = 0;
+					for (int c = 0; c < 3; c++) {
+						if (seenIn[indices[candidate * 3 + c]] != meshletId) {
+							newVertices++;
+						}
+					}
+					if (uniqueVertices + newVertices > static_cast<unsigned int>(MaxVertices)) {
+						continue;
+					}
+
+					float agreement = (normals[candidate] == glm::vec3(0.0f) || axis == glm::vec3(0.0f)) ? 1.0f : glm::dot(normals[candidate], axis);
+					if (agreement < MinNormalAgreement) {
+						continue;
+					}
+
+					float score = agreement - 0.1f * static_cast<float>(newVertices);
+					if (score > bestScore) {
+						bestScore = score;
+						best = i;
+					}
+				}
+
+				if (best == candidates.size()) {
+					break;
+				}
+
+				triangle = candidates[best];
+				candidates[best] = candidates.back();
+				candidates.pop_back();
+			}
+
+			meshlets.push_back(Finish(reordered, vertices, stride, start, static_cast<unsigned int>(reordered.size() / 3), uniqueVertices, meshCenter));
+		}
+
+		indices.swap(reordered);
+		return meshlets;
+	}
+
+	//Returns true if the mesh has no boundary edges. Positions are welded on a small grid so seams and the 0/2PI wrap still match.
+	//Cone culling is only safe on closed meshes while face culling is off, otherwise the inside of an open shape would vanish
+	static bool IsClosed(const vector<unsigned int>& indices, const vector<float>& vertices, int stride)
+	{
+		vector<unsigned int> positionOf = MeshOptimizer::WeldPositions(vertices, stride);
+
+		//Count undirected edges, degenerate edges (sphere poles) are ignored
+		std::unordered_map<uint64_t, unsigned int> edgeCounts;
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			for (int c = 0; c < 3; c++) {
+				unsigned int a = positionOf[indices[i + c]];
+				unsigned int b = positionOf[indices[i + (c + 1) % 3]];
+				if (a == b) {
+					continue;
+				}
+				uint64_t key = (static_cast<uint64_t>(glm::min(a, b)) << 32) | glm::max(a, b);
+				edgeCounts[key]++;
+			}
+		}
+
+		for (const auto& edge : edgeCounts) {
+			if (edge.second < 2) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	static void CalculateBounds(const vector<float>& vertices, int stride, glm::vec3& boxMin, glm::vec3& boxMax)
+	{
+		boxMin = glm::vec3(INFINITY);
+		boxMax = glm::vec3(-INFINITY);
+		for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+			glm::vec3 p = glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]);
+			boxMin = glm::min(boxMin, p);
+			boxMax = glm::max(boxMax, p);
+		}
+	}
+
+	static glm::vec3 Position(const vector<unsigned int>& indices, const vector<float>& vertices, int stride, size_t index)
+	{
+		const float* p = &vertices[indices[index] * stride];
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+
+	static glm::vec3 OrientedFaceNormal(const vector<unsigned int>& indices, const vector<float>& vertices, int stride, size_t triangle, const glm::vec3& meshCenter)
+	{
+		glm::vec3 a = Position(indices, vertices, stride, triangle * 3);
+		glm::vec3 b = Position(indices, vertices, stride, triangle * 3 + 1);
+		glm::vec3 c = Position(indices, vertices, stride, triangle * 3 + 2);
+
+		glm::vec3 normal = glm::cross(b - a, c - a);
+		float length = glm::length(normal);
+		if (length <= 0.0f) {
+			return glm::vec3(0.0f);
+		}
+
+		normal /= length;
+		return (glm::dot(normal, (a + b + c) / 3.0f - meshCenter) < 0.0f) ? -normal : normal;
+	}
+
+	//Calculates the bounds and cone for triangles [start, end)
+	static Meshlet Finish(const vector<unsigned int>& indices, const vector<float>& vertices, int stride, unsigned int start, unsigned int end, unsigned int uniqueVertices, const glm::vec3& meshCenter)
+	{
+		Meshlet meshlet;
+		meshlet.IndexOffset = start * 3;
+		meshlet.TriangleCount = end - start;
+		meshlet.VertexCount = uniqueVertices;
+
+		//Sphere around the box center
+		glm::vec3 boxMin = glm::vec3(INFINITY);
+		glm::vec3 boxMax = glm::vec3(-INFINITY);
+		for (unsigned int i = start * 3; i < end * 3; i++) {
+			glm::vec3 p = Position(indices, vertices, stride, i);
+			boxMin = glm::min(boxMin, p);
+			boxMax = glm::max(boxMax, p);
+		}
+
+		meshlet.Center = (boxMin + boxMax) * 0.5f;
+		meshlet.Radius = 0.0f;
+		for (unsigned int i = start * 3; i < end * 3; i++) {
+			meshlet.Radius = glm::max(meshlet.Radius, glm::length(Position(indices, vertices, stride, i) - meshlet.Center));
+		}
+
+		//Cone around the average normal, its spread is the worst agreeing triangle
+		glm::vec3 axis = glm::vec3(0.0f);
+		for (unsigned int t = start; t < end; t++) {
+			axis += OrientedFaceNormal(indices, vertices, stride, t, meshCenter);
+		}
+
+		meshlet.ConeAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+		meshlet.ConeCutoff = 1.0f;
+
+		if (glm::length(axis) > 0.0f) {
+			axis = glm::normalize(axis);
+
+			float minDot = 1.0f;
+			for (unsigned int t = start; t < end; t++) {
+				glm::vec3 normal = OrientedFaceNormal(indices, vertices, stride, t, meshCenter);
+				if (normal != glm::vec3(0.0f)) {
+					minDot = glm::min(minDot, glm::dot(normal, axis));
+				}
+			}
+
+			meshlet.ConeAxis = axis;
+			meshlet.ConeCutoff = (minDot <= 0.0f) ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+		}
+
+		return meshlet;
+	}
+};
+
+//Per-frame meshlet visibility, run on the CPU
+class MeshletCuller
+{
+public:
+	//Meshlets tested and drawn since the last ResetStats
+	static inline unsigned int MeshletsTested = 0;
+	static inline unsigned int MeshletsDrawn = 0;
+	static inline unsigned int TrianglesTested = 0;
+	static inline unsigned int TrianglesDrawn = 0;
+
+	static void ResetStats()
+	{
+		MeshletsTested = 0;
+		MeshletsDrawn = 0;
+		TrianglesTested = 0;
+		TrianglesDrawn = 0;
+	}
+
+	//Returns true if the meshlet may be visible. Bounds are moved to world space with the model matrix, the cone axis with the normal matrix.
+	//The cone test takes cameraPosition as a perspective eye point, pass coneCulling false with an orthographic projection
+	static bool IsVisible(const Meshlet& meshlet, const glm::mat4& model, const glm::mat3& normalMatrix, float maxScale,
+		const Frustum& frustum, const glm::vec3& cameraPosition, bool coneCulling)
+	{
+		glm::vec3 center = glm::vec3(model * glm::vec4(meshlet.Center, 1.0f));
+		float radius = meshlet.Radius * maxScale;
+
+		if (!frustum.IntersectsSphere(center, radius)) {
+			return false;
+		}
+
+		if (coneCulling && meshlet.ConeCutoff < 1.0f) {
+			glm::vec3 axis = glm::normalize(normalMatrix * meshlet.ConeAxis);
+			glm::vec3 toCenter = center - cameraPosition;
+
+			//Every triangle faces away from the camera
+			if (glm::dot(toCenter, axis) >= meshlet.ConeCutoff * glm::length(toCenter) + radius) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	//Largest axis scale of a model matrix, for the bounding spheres
+	static float MaxScale(const glm::mat4& model)
+	{
+		return glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	}
+};
+
+#endif
@@ -0,0 +1,405 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <unordered_map>
+
+using std::vector;
+
+//Index and vertex reordering for indexed triangle meshes (interleaved float vertices with the normal at floats 6-8, 32 bit indices).
+//Vertex cache order uses Tipsify (Sander, Nehab and Barczak 2007), overdraw order sorts the Tipsify clusters
+//so outward facing clusters on the hull draw first, and vertex fetch order follows the first use in the index buffer.
+//Works on any vertex/index data so generated and imported meshes go through the same path.
+class MeshOptimizer
+{
+public:
+	//Default post-transform cache size used for the simulation and the optimizer
+	static const int DefaultCacheSize = 16;
+
+	//Merges bit-identical vertices of a triangle soup into a unique vertex list plus indices
+	static void WeldVertices(const vector<float>& soup, int stride, vector<float>& outVertices, vector<unsigned int>& outIndices)
+	{
+		size_t vertexCount = soup.size() / stride;
+
+		outVertices.clear();
+		outIndices.clear();
+		outVertices.reserve(soup.size());
+		outIndices.reserve(vertexCount);
+
+		//Open addressing table of unique vertex ids, sized to the next power of two above twice the vertex count
+		size_t tableSize = 1;
+		while (tableSize < vertexCount * 2) {
+			tableSize <<= 1;
+		}
+		vector<unsigned int> table(tableSize, ~0u);
+
+		unsigned int uniqueCount = 0;
+		for (size_t i = 0; i < vertexCount; i++) {
+			const float* vertex = &soup[i * stride];
+			size_t slot = HashVertex(vertex, stride) & (tableSize - 1);
+
+			while (table[slot] != ~0u && memcmp(&outVertices[table[slot] * stride], vertex, stride * sizeof(float)) != 0) {
+				slot = (slot + 1) & (tableSize - 1);
+			}
+
+			if (table[slot] == ~0u) {
+				table[slot] = uniqueCount++;
+				outVertices.insert(outVertices.end(), vertex, vertex + stride);
+			}
+
+			outIndices.push_back(table[slot]);
+		}
+	}
+
+	//Returns an id per vertex shared by every vertex at the same position (snapped to a small grid), ignoring the other attributes.
+	//Used to find seams and hard edges, which are split vertices at one position
+	static vector<unsigned int> WeldPositions(const vector<float>& vertices, int stride, float snap = 1e-4f)
+	{
+		std::unordered_map<GridPosition, unsigned int, GridPositionHash> positionIds;
+		vector<unsigned int> positionOf(vertices.size() / stride);
+		for (size_t v = 0; v < positionOf.size(); v++) {
+			const float* p = &vertices[v * stride];
+			GridPosition key = { static_cast<int64_t>(std::floor(p[0] / static_cast<double>(snap) + 0.5)),
+				static_cast<int64_t>(std::floor(p[1] / static_cast<double>(snap) + 0.5)),
+				static_cast<int64_t>(std::floor(p[2] / static_cast<double>(snap) + 0.5)) };
+			auto inserted = positionIds.emplace(key, static_cast<unsigned int>(positionIds.size()));
+			positionOf[v] = inserted.first->second;
+		}
+		return positionOf;
+	}
+
+	//Average cache miss ratio: post-transform cache misses per triangle with a FIFO cache. 3.0 is the worst case, ~0.5 the best
+	static float CalculateACMR(const vector<unsigned int>& indices, int vertexCount, int cacheSize = DefaultCacheSize)
+	{
+		if (indices.empty()) {
+			return 0.0f;
+		}
+
+		vector<unsigned int> insertedAt(vertexCount, 0);
+		unsigned int misses = 0;
+
+		for (unsigned int index : indices) {
+			if (insertedAt[index] == 0 || misses - insertedAt[index] >= static_cast<unsigned int>(cacheSize)) {
+				misses++;
+				insertedAt[index] = misses;
+			}
+		}
+
+		return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+	}
+
+	//Reorders the triangles for the post-transform vertex cache. Cluster starts (in triangles) are written to clusterStarts if given,
+	//a new cluster begins at every dead end and wherever the local miss ratio drops below acmrThreshold times the overall ratio
+	static vector<unsigned int> OptimizeVertexCache(const vector<unsigned int>& indices, int vertexCount, int cacheSize = DefaultCacheSize,
+		vector<unsigned int>* clusterStarts = nullptr, float acmrThreshold = 1.05f)
+	{
+		size_t triangleCount = indices.size() / 3;
+		vector<unsigned int> output;
+		output.reserve(indices.size());
+
+		if (triangleCount == 0) {
+			return output;
+		}
+
+		//Vertex -> triangle adjacency in CSR form
+		vector<unsigned int> liveCount(vertexCount, 0);
+		for (unsigned int index : indices) {
+			liveCount[index]++;
+		}
+
+		vector<unsigned int> offsets(vertexCount + 1, 0);
+		for (int v = 0; v < vertexCount; v++) {
+			offsets[v + 1] = offsets[v] + liveCount[v];
+		}
+
+		vector<unsigned int> adjacency(indices.size());
+		vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++) {
+			for (int c = 0; c < 3; c++) {
+				adjacency[fill[indices[t * 3 + c]]++] = static_cast<unsigned int>(t);
+			}
+		}
+
+		vector<unsigned int> cacheTime(vertexCount, 0);
+		vector<char> emitted(triangleCount, 0);
+		vector<unsigned int> deadEnd;
+		vector<unsigned int> candidates;
+		vector<unsigned int> hardBoundaries;
+
+		int fanning = 0;
+		unsigned int timeStamp = cacheSize + 1;
+		int cursor = 1;
+
+		hardBoundaries.push_back(0);
+
+		while (fanning >= 0) {
+			candidates.clear();
+
+			//Emit every live triangle around the fanning vertex
+			for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+				unsigned int t = adjacency[a];
+				if (emitted[t]) {
+					continue;
+				}
+
+				for (int c = 0; c < 3; c++) {
+					unsigned int v = indices[t * 3 + c];
+					output.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					liveCount[v]--;
+
+					if (timeStamp - cacheTime[v] > static_cast<unsigned int>(cacheSize)) {
+						cacheTime[v] = timeStamp++;
+					}
+				}
+
+				emitted[t] = 1;
+			}
+
+			//Pick the candidate still in the cache with the most to gain, otherwise fall back to the dead end stack
+			int next = -1;
+			int bestPriority = -1;
+			for (unsigned int v : candidates) {
+				if (liveCount[v] == 0) {
+					continue;
+				}
+
+				int priority = 0;
+				if (timeStamp - cacheTime[v] + 2 * liveCount[v] <= static_cast<unsigned int>(cacheSize)) {
+					priority = static_cast<int>(timeStamp - cacheTime[v]);
+				}
+
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = static_cast<int>(v);
+				}
+			}
+
+			if (next == -1) {
+				next = SkipDeadEnd(liveCount, deadEnd, cursor, vertexCount);
+
+				if (next >= 0) {
+					hardBoundaries.push_back(static_cast<unsigned int>(output.size() / 3));
+				}
+			}
+
+			fanning = next;
+		}
+
+		if (clusterStarts) {
+			BuildClusters(output, vertexCount, cacheSize, hardBoundaries, acmrThreshold, *clusterStarts);
+		}
+
+		return output;
+	}
+
+	//Reorders the clusters so the ones facing out from the mesh center draw first, which lets the depth test reject more of the rest
+	static vector<unsigned int> OptimizeOverdraw(const vector<unsigned int>& indices, const vector<float>& vertices, int stride, const vector<unsigned int>& clusterStarts)
+	{
+		size_t triangleCount = indices.size() / 3;
+		if (clusterStarts.size() < 2) {
+			return indices;
+		}
+
+		//Mesh center, area weighted
+		glm::vec3 meshCenter = glm::vec3(0.0f);
+		float meshArea = 0.0f;
+		for (size_t t = 0; t < triangleCount; t++) {
+			glm::vec3 a, b, c;
+			TrianglePositions(indices, vertices, stride, t, a, b, c);
+			float area = glm::length(glm::cross(b - a, c - a)) * 0.5f;
+			meshCenter += (a + b + c) / 3.0f * area;
+			meshArea += area;
+		}
+		if (meshArea > 0.0f) {
+			meshCenter /= meshArea;
+		}
+
+		struct ClusterSort {
+			unsigned int start;
+			unsigned int end;
+			float key;
+		};
+
+		vector<ClusterSort> clusters;
+		for (size_t i = 0; i < clusterStarts.size(); i++) {
+			unsigned int start = clusterStarts[i];
+			unsigned int end = (i + 1 < clusterStarts.size()) ? clusterStarts[i + 1] : static_cast<unsigned int>(triangleCount);
+
+			glm::vec3 center = glm::vec3(0.0f);
+			glm::vec3 normal = glm::vec3(0.0f);
+			float area = 0.0f;
+			for (unsigned int t = start; t < end; t++) {
+				glm::vec3 a, b, c;
+				TrianglePositions(indices, vertices, stride, t, a, b, c);
+				float faceArea = glm::length(glm::cross(b - a, c - a)) * 0.5f;
+				center += (a + b + c) / 3.0f * faceArea;
+				area += faceArea;
+
+				//Use the vertex normals rather than the winding, the generators do not wind consistently
+				for (int corner = 0; corner < 3; corner++) {
+					const float* vertex = &vertices[indices[t * 3 + corner] * stride];
+					normal += glm::vec3(vertex[6], vertex[7], vertex[8]) * faceArea;
+				}
+			}
+
+			float key = 0.0f;
+			if (area > 0.0f && glm::length(normal) > 0.0f) {
+				key = glm::dot(center / area - meshCenter, glm::normalize(normal));
+			}
+
+			clusters.push_back(ClusterSort{ start, end, key });
+		}
+
+		//Stable so equal keys keep their cache friendly order and the result is deterministic
+		std::stable_sort(clusters.begin(), clusters.end(), [](const ClusterSort& lhs, const ClusterSort& rhs) {
+			return lhs.key > rhs.key;
+		});
+
+		vector<unsigned int> output;
+		output.reserve(indices.size());
+		for (const ClusterSort& cluster : clusters) {
+			output.insert(output.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+		}
+
+		return output;
+	}
+
+	//Reorders the vertices into the order the index buffer first touches them, unused vertices are dropped
+	static void OptimizeVertexFetch(vector<float>& vertices, int stride, vector<unsigned int>& indices)
+	{
+		size_t vertexCount = vertices.size() / stride;
+		vector<unsigned int> remap(vertexCount, ~0u);
+		vector<float> reordered;
+		reordered.reserve(vertices.size());
+
+		unsigned int nextIndex = 0;
+		for (unsigned int& index : indices) {
+			if (remap[index] == ~0u) {
+				remap[index] = nextIndex++;
+				reordered.insert(reordered.end(), vertices.begin() + index * stride, vertices.begin() + (index + 1) * stride);
+			}
+			index = remap[index];
+		}
+
+		vertices.swap(reordered);
+	}
+
+private:
+	//A position snapped to the WeldPositions grid, every axis kept whole so far apart positions never share a key
+	struct GridPosition
+	{
+		int64_t X, Y, Z;
+		bool operator==(const GridPosition& other) const { return X == other.X && Y == other.Y && Z == other.Z; }
+	};
+
+	struct GridPositionHash
+	{
+		size_t operator()(const GridPosition& position) const
+		{
+			uint64_t hash = static_cast<uint64_t>(position.X) * 0x9E3779B97F4A7C15ull;
+			hash = (hash ^ (hash >> 29) ^ static_cast<uint64_t>(position.Y)) * 0xBF58476D1CE4E5B9ull;
+			hash = (hash ^ (hash >> 32) ^ static_cast<uint64_t>(position.Z)) * 0x94D049BB133111EBull;
+			return static_cast<size_t>(hash ^ (hash >> 31));
+		}
+	};
+
+	//FNV-1a over the raw float bits
+	static size_t HashVertex(const float* vertex, int stride)
+	{
+		uint32_t hash = 2166136261u;
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(vertex);
+		for (size_t i = 0; i < stride * sizeof(float); i++) {
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	//Tipsify dead end handling: the most recent vertex that still has live triangles, otherwise the next one in input order
+	static int SkipDeadEnd(const vector<unsigned int>& liveCount, vector<unsigned int>& deadEnd, int& cursor, int vertexCount)
+	{
+		while (!deadEnd.empty()) {
+			unsigned int v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveCount[v] > 0) {
+				return static_cast<int>(v);
+			}
+		}
+
+		while (cursor < vertexCount) {
+			if (liveCount[cursor] > 0) {
+				return cursor;
+			}
+			cursor++;
+		}
+
+		return -1;
+	}
+
+	//Splits the Tipsify output into clusters at the hard boundaries, plus soft boundaries where the local miss ratio is low
+	static void BuildClusters(const vector<unsigned int>& indices, int vertexCount, int cacheSize, const vector<unsigned int>& hardBoundaries,
+		float acmrThreshold, vector<unsigned int>& clusterStarts)
+	{
+		const unsigned int minClusterTriangles = 8;
+
+		float threshold = CalculateACMR(indices, vertexCount, cacheSize) * acmrThreshold;
+		size_t triangleCount = indices.size() / 3;
+
+		clusterStarts.clear();
+
+		vector<unsigned int> insertedAt(vertexCount, 0);
+		unsigned int misses = 0;
+		unsigned int clusterStart = 0;
+		unsigned int clusterMisses = 0;
+		size_t nextHard = 0;
+
+		for (size_t t = 0; t < triangleCount; t++) {
+			bool hard = nextHard < hardBoundaries.size() && hardBoundaries[nextHard] == t;
+			if (hard) {
+				nextHard++;
+			}
+
+			unsigned int clusterTriangles = static_cast<unsigned int>(t) - clusterStart;
+			bool soft = clusterTriangles >= minClusterTriangles && static_cast<float>(clusterMisses) / clusterTriangles <= threshold;
+
+			if (t == 0 || hard || soft) {
+				clusterStarts.push_back(static_cast<unsigned int>(t));
+				clusterStart = static_cast<unsigned int>(t);
+				clusterMisses = 0;
+
+				//Each cluster is costed as if it starts on a cold cache, since it can end up anywhere in the draw order.
+				//Jumping the miss counter past the cache size evicts everything without touching the whole array
+				misses += cacheSize;
+			}
+
+			for (int c = 0; c < 3; c++) {
+				unsigned int index = indices[t * 3 + c];
+				if (insertedAt[index] == 0 || misses - insertedAt[index] >= static_cast<unsigned int>(cacheSize)) {
+					misses++;
+					clusterMisses++;
+					insertedAt[index] = misses;
+				}
+			}
+		}
+	}
+
+	static void TrianglePositions(const vector<unsigned int>& indices, const vector<float>& vertices, int stride, size_t triangle, glm::vec3& a, glm::vec3& b, glm::vec3& c)
+	{
+		const float* va = &vertices[indices[triangle * 3] * stride];
+		const float* vb = &vertices[indices[triangle * 3 + 1] * stride];
+		const float* vc = &vertices[indices[triangle * 3 + 2] * stride];
+		a = glm::vec3(va[0], va[1], va[2]);
+		b = glm::vec3(vb[0], vb[1], vb[2]);
+		c = glm::vec3(vc[0], vc[1], vc[2]);
+	}
+};
+
+#endif
@@ -0,0 +1,566 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "meshoptimizer.h"
+
+using std::vector;
+
+//One level of detail: its own index list into the mesh's vertices, plus where it lives in the uploaded index buffer
+struct MeshLod
+{
+	vector<unsigned int> Indices;
+	float TargetRatio = 1.0f;   //Requested fraction of the LOD0 triangles
+	float Error = 0.0f;         //Conservative geometric error against LOD0, object space units
+	int IndexOffset = 0;        //First index in the EBO
+	int IndexCount = 0;
+};
+
+//Quadric error metric simplification (Garland and Heckbert 1997) by edge collapse, for indexed meshes with the position at floats 0-2.
+//Collapses work on positions, not vertices. The vertices at a position are grouped into wedges: vertices whose UVs and colors match
+//and whose normals are within the crease angle of each other (the generators are flat shaded, so every face has its own normal).
+//A collapse is only taken if every wedge at the removed position has exactly one partner wedge at the kept position, so UV seams and
+//hard normal edges slide along themselves and never tear. Open and non-manifold edges are locked.
+//Vertices are never moved or created, only the index list changes, so one vertex buffer serves every LOD. The result only depends on the input, so it is deterministic and can be cached and compared.
+class MeshSimplifier
+{
+public:
+	//Cosine of the largest normal angle that still counts as the same smooth surface (45 degrees)
+	static constexpr float CreaseCosine = 0.7071f;
+
+	//Simplifies towards targetTriangles, stopping early if the next collapse would exceed maxError. Returns the new index list,
+	//resultError is the largest collapse error taken: the square root of the accumulated quadric cost, a conservative distance in object units
+	static vector<unsigned int> Simplify(const vector<float>& vertices, int stride, const vector<unsigned int>& indices,
+		size_t targetTriangles, float maxError, float& resultError)
+	{
+		resultError = 0.0f;
+		vector<unsigned int> result = indices;
+		size_t vertexCount = vertices.size() / stride;
+		if (result.size() / 3 <= targetTriangles || vertexCount == 0) {
+			return result;
+		}
+
+		vector<unsigned int> positionOf = MeshOptimizer::WeldPositions(vertices, stride);
+		unsigned int positionCount = 0;
+		for (unsigned int id : positionOf) {
+			positionCount = std::max(positionCount, id + 1);
+		}
+
+		//Position of each welded id (first vertex wins)
+		vector<glm::dvec3> positions(positionCount);
+		vector<bool> positionSet(positionCount, false);
+		for (size_t v = 0; v < vertexCount; v++) {
+			if (!positionSet[positionOf[v]]) {
+				positionSet[positionOf[v]] = true;
+				positions[positionOf[v]] = glm::dvec3(vertices[v * stride], vertices[v * stride + 1], vertices[v * stride + 2]);
+			}
+		}
+
+		//Plane quadrics of the original triangles
+		vector<Quadric> quadrics(positionCount);
+		for (size_t i = 0; i + 2 < result.size(); i += 3) {
+			Quadric plane = PlaneQuadric(positions[positionOf[result[i]]], positions[positionOf[result[i + 1]]], positions[positionOf[result[i + 2]]]);
+			for (int c = 0; c < 3; c++) {
+				quadrics[positionOf[result[i + c]]].Add(plane);
+			}
+		}
+
+		vector<unsigned int> wedgeOf = FindWedges(vertices, stride, positionOf, positionCount);
+		vector<bool> locked = FindLockedPositions(result, positionOf, positionCount);
+		double maxCost = static_cast<double>(maxError) * static_cast<double>(maxError);
+		double worstCost = 0.0;
+
+		vector<unsigned int> remap(vertexCount);
+		vector<bool> touched(positionCount);
+
+		//Collapses are taken in passes: every edge is costed, the cheapest independent collapses are applied, then the index list is rebuilt
+		while (result.size() / 3 > targetTriangles) {
+			vector<Collapse> collapses = FindCollapses(result, positionOf, wedgeOf, positions, quadrics, locked);
+			if (collapses.empty()) {
+				break;
+			}
+
+			PositionTriangles fans = BuildPositionTriangles(result, positionOf, positionCount);
+
+			for (size_t v = 0; v < vertexCount; v++) {
+				remap[v] = static_cast<unsigned int>(v);
+			}
+			std::fill(touched.begin(), touched.end(), false);
+
+			size_t triangles = result.size() / 3;
+			size_t collapsed = 0;
+
+			for (const Collapse& collapse : collapses) {
+				if (triangles - collapsed <= targetTriangles || collapse.Cost > maxCost) {
+					break;
+				}
+				if (touched[collapse.From] || touched[collapse.To]) {
+					continue;
+				}
+				if (Flips(result, positionOf, positions, fans, collapse.From, collapse.To)) {
+					continue;
+				}
+
+				for (const VertexPair& pair : collapse.Pairs) {
+					remap[pair.From] = pair.To;
+				}
+
+				quadrics[collapse.To].Add(quadrics[collapse.From]);
+				worstCost = std::max(worstCost, collapse.Cost);
+
+				//The fan around the removed position changed, nothing in it may collapse again this pass
+				for (unsigned int f = fans.Start[collapse.From]; f < fans.Start[collapse.From + 1]; f++) {
+					unsigned int triangle = fans.Triangles[f];
+					for (int c = 0; c < 3; c++) {
+						touched[positionOf[result[triangle * 3 + c]]] = true;
+					}
+				}
+
+				collapsed += collapse.Triangles;
+			}
+
+			if (collapsed == 0) {
+				break;
+			}
+
+			//Apply the remap and drop the triangles that collapsed
+			vector<unsigned int> next;
+			next.reserve(result.size());
+			for (size_t i = 0; i + 2 < result.size(); i += 3) {
+				unsigned int a = remap[result[i]];
+				unsigned int b = remap[result[i + 1]];
+				unsigned int c = remap[result[i + 2]];
+				if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c]) {
+					continue;
+				}
+				next.push_back(a);
+				next.push_back(b);
+				next.push_back(c);
+			}
+			result.swap(next);
+		}
+
+		resultError = static_cast<float>(std::sqrt(worstCost));
+		return result;
+	}
+
+	//Builds a chain of LODs at the requested triangle ratios (e.g. 0.5, 0.25, 0.125), each simplified from the full mesh so the
+	//errors are measured against LOD0. LODs that could not get below the previous level's triangle count are dropped
+	static vector<MeshLod> BuildLodChain(const vector<float>& vertices, int stride, const vector<unsigned int>& indices, const vector<float>& ratios)
+	{
+		vector<MeshLod> lods;
+		size_t previousTriangles = indices.size() / 3;
+
+		for (float ratio : ratios) {
+			MeshLod lod;
+			lod.TargetRatio = ratio;
+
+			size_t target = static_cast<size_t>(static_cast<double>(indices.size() / 3) * ratio);
+			lod.Indices = Simplify(vertices, stride, indices, target, INFINITY, lod.Error);
+
+			if (lod.Indices.empty() || lod.Indices.size() / 3 >= previousTriangles) {
+				continue;
+			}
+
+			previousTriangles = lod.Indices.size() / 3;
+			lods.push_back(std::move(lod));
+		}
+
+		return lods;
+	}
+
+private:
+	//Symmetric 4x4 matrix of a sum of squared plane distances
+	struct Quadric
+	{
+		double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+		double a11 = 0, a12 = 0, a13 = 0;
+		double a22 = 0, a23 = 0;
+		double a33 = 0;
+
+		void Add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+		}
+
+		double Evaluate(const glm::dvec3& p) const
+		{
+			double x = p.x, y = p.y, z = p.z;
+			double result = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+				+ a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+				+ a22 * z * z + 2 * a23 * z
+				+ a33;
+			return std::max(result, 0.0);
+		}
+	};
+
+	struct VertexPair
+	{
+		unsigned int From;
+		unsigned int To;
+	};
+
+	//Moving position From onto position To
+	struct Collapse
+	{
+		unsigned int From;
+		unsigned int To;
+		double Cost;
+		unsigned int Triangles;  //Triangles removed
+		vector<VertexPair> Pairs;
+	};
+
+	//Triangles around each position (CSR)
+	struct PositionTriangles
+	{
+		vector<unsigned int> Start;
+		vector<unsigned int> Triangles;
+	};
+
+	static Quadric PlaneQuadric(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c)
+	{
+		Quadric q;
+		glm::dvec3 normal = glm::cross(b - a, c - a);
+		double length = glm::length(normal);
+		if (length <= 0.0) {
+			return q;
+		}
+
+		normal /= length;
+		double d = -glm::dot(normal, a);
+
+		q.a00 = normal.x * normal.x; q.a01 = normal.x * normal.y; q.a02 = normal.x * normal.z; q.a03 = normal.x * d;
+		q.a11 = normal.y * normal.y; q.a12 = normal.y * normal.z; q.a13 = normal.y * d;
+		q.a22 = normal.z * normal.z; q.a23 = normal.z * d;
+		q.a33 = d * d;
+		return q;
+	}
+
+	static uint64_t EdgeKey(unsigned int a, unsigned int b)
+	{
+		return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+	}
+
+	//Returns a wedge id per vertex (the lowest vertex index in the wedge). Vertices at one position join a wedge when every attribute
+	//except the normal matches and the normals are within the crease angle
+	static vector<unsigned int> FindWedges(const vector<float>& vertices, int stride, const vector<unsigned int>& positionOf, unsigned int positionCount)
+	{
+		size_t vertexCount = positionOf.size();
+
+		vector<unsigned int> start(positionCount + 1, 0);
+		for (unsigned int position : positionOf) {
+			start[position + 1]++;
+		}
+		for (unsigned int i = 0; i < positionCount; i++) {
+			start[i + 1] += start[i];
+		}
+		vector<unsigned int> at(vertexCount);
+		vector<unsigned int> fill(start.begin(), start.end() - 1);
+		for (size_t v = 0; v < vertexCount; v++) {
+			at[fill[positionOf[v]]++] = static_cast<unsigned int>(v);
+		}
+
+		//Union find, the root is always the lowest index
+		vector<unsigned int> parent(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) {
+			parent[v] = static_cast<unsigned int>(v);
+		}
+		auto find = [&](unsigned int v) {
+			while (parent[v] != v) {
+				parent[v] = parent[parent[v]];
+				v = parent[v];
+			}
+			return v;
+		};
+
+		for (unsigned int position = 0; position < positionCount; position++) {
+			for (unsigned int i = start[position]; i < start[position + 1]; i++) {
+				for (unsigned int j = i + 1; j < start[position + 1]; j++) {
+					if (SameSurface(&vertices[at[i] * stride], &vertices[at[j] * stride], stride)) {
+						unsigned int a = find(at[i]);
+						unsigned int b = find(at[j]);
+						parent[std::max(a, b)] = std::min(a, b);
+					}
+				}
+			}
+		}
+
+		vector<unsigned int> wedgeOf(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) {
+			wedgeOf[v] = find(static_cast<unsigned int>(v));
+		}
+		return wedgeOf;
+	}
+
+	static bool SameSurface(const float* a, const float* b, int stride)
+	{
+		for (int i = 3; i < stride; i++) {
+			if ((i < 6 || i > 8) && std::fabs(a[i] - b[i]) > 1e-4f) {
+				return false;
+			}
+		}
+
+		//Zero length normals (degenerate pole triangles) go with anything
+		glm::vec3 na = glm::vec3(a[6], a[7], a[8]);
+		glm::vec3 nb = glm::vec3(b[6], b[7], b[8]);
+		float lengths = glm::length(na) * glm::length(nb);
+		if (!(lengths > 0.0f)) {
+			return true;
+		}
+		return glm::dot(na, nb) >= CreaseCosine * lengths;
+	}
+
+	//Positions on an open or non-manifold edge never move
+	static vector<bool> FindLockedPositions(const vector<unsigned int>& indices, const vector<unsigned int>& positionOf, unsigned int positionCount)
+	{
+		vector<uint64_t> edges;
+		edges.reserve(indices.size());
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			for (int c = 0; c < 3; c++) {
+				unsigned int a = positionOf[indices[i + c]];
+				unsigned int b = positionOf[indices[i + (c + 1) % 3]];
+				if (a != b) {
+					edges.push_back(EdgeKey(a, b));
+				}
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		vector<bool> locked(positionCount, false);
+		for (size_t i = 0; i < edges.size();) {
+			size_t j = i;
+			while (j < edges.size() && edges[j] == edges[i]) {
+				j++;
+			}
+			if (j - i != 2) {
+				locked[static_cast<unsigned int>(edges[i] >> 32)] = true;
+				locked[static_cast<unsigned int>(edges[i] & 0xFFFFFFFFu)] = true;
+			}
+			i = j;
+		}
+		return locked;
+	}
+
+	static PositionTriangles BuildPositionTriangles(const vector<unsigned int>& indices, const vector<unsigned int>& positionOf, unsigned int positionCount)
+	{
+		PositionTriangles fans;
+		fans.Start.assign(positionCount + 1, 0);
+		for (unsigned int index : indices) {
+			fans.Start[positionOf[index] + 1]++;
+		}
+		for (unsigned int i = 0; i < positionCount; i++) {
+			fans.Start[i + 1] += fans.Start[i];
+		}
+
+		fans.Triangles.resize(indices.size());
+		vector<unsigned int> fill(fans.Start.begin(), fans.Start.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++) {
+			fans.Triangles[fill[positionOf[indices[i]]]++] = static_cast<unsigned int>(i / 3);
+		}
+		return fans;
+	}
+
+	//Costs every valid collapse of the current mesh, cheapest first. Ties break on the position ids so the order is deterministic
+	static vector<Collapse> FindCollapses(const vector<unsigned int>& indices, const vector<unsigned int>& positionOf, const vector<unsigned int>& wedgeOf, const vector<glm::dvec3>& positions,
+		const vector<Quadric>& quadrics, const vector<bool>& locked)
+	{
+		//Directed vertex edges, sorted by (from position, to position, from vertex, to vertex)
+		struct VertexEdge
+		{
+			unsigned int FromPosition, ToPosition, From, To;
+			bool operator<(const VertexEdge& o) const
+			{
+				if (FromPosition != o.FromPosition) return FromPosition < o.FromPosition;
+				if (ToPosition != o.ToPosition) return ToPosition < o.ToPosition;
+				if (From != o.From) return From < o.From;
+				return To < o.To;
+			}
+			bool operator==(const VertexEdge& o) const
+			{
+				return From == o.From && To == o.To;
+			}
+		};
+
+		vector<VertexEdge> edges;
+		edges.reserve(indices.size() * 2);
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			for (int c = 0; c < 3; c++) {
+				unsigned int a = indices[i + c];
+				unsigned int b = indices[i + (c + 1) % 3];
+				edges.push_back({ positionOf[a], positionOf[b], a, b });
+				edges.push_back({ positionOf[b], positionOf[a], b, a });
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		//Vertices still in use at each position (CSR), and how many wedges they form
+		unsigned int positionCount = static_cast<unsigned int>(positions.size());
+		vector<unsigned int> used;
+		{
+			vector<bool> seen(positionOf.size(), false);
+			for (unsigned int index : indices) {
+				if (!seen[index]) {
+					seen[index] = true;
+					used.push_back(index);
+				}
+			}
+			std::sort(used.begin(), used.end(), [&](unsigned int a, unsigned int b) {
+				if (positionOf[a] != positionOf[b]) return positionOf[a] < positionOf[b];
+				return a < b;
+			});
+		}
+		vector<unsigned int> usedStart(positionCount + 1, 0);
+		for (unsigned int v : used) {
+			usedStart[positionOf[v] + 1]++;
+		}
+		for (unsigned int i = 0; i < positionCount; i++) {
+			usedStart[i + 1] += usedStart[i];
+		}
+
+		vector<unsigned int> wedgesAt(positionCount, 0);
+		for (unsigned int position = 0; position < positionCount; position++) {
+			for (unsigned int i = usedStart[position]; i < usedStart[position + 1]; i++) {
+				bool first = true;
+				for (unsigned int k = usedStart[position]; k < i; k++) {
+					if (wedgeOf[used[k]] == wedgeOf[used[i]]) {
+						first = false;
+						break;
+					}
+				}
+				wedgesAt[position] += first ? 1 : 0;
+			}
+		}
+
+		//Triangles on each position edge, removed by its collapse
+		vector<uint64_t> triangleEdges;
+		triangleEdges.reserve(indices.size());
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			for (int c = 0; c < 3; c++) {
+				triangleEdges.push_back(EdgeKey(positionOf[indices[i + c]], positionOf[indices[i + (c + 1) % 3]]));
+			}
+		}
+		std::sort(triangleEdges.begin(), triangleEdges.end());
+
+		//Partner wedge and vertex at To for each wedge at From
+		struct WedgePartner
+		{
+			unsigned int Wedge, ToWedge, ToVertex;
+		};
+		vector<WedgePartner> partners;
+
+		vector<Collapse> collapses;
+		for (size_t i = 0; i < edges.size();) {
+			size_t j = i;
+			while (j < edges.size() && edges[j].FromPosition == edges[i].FromPosition && edges[j].ToPosition == edges[i].ToPosition) {
+				j++;
+			}
+
+			unsigned int from = edges[i].FromPosition;
+			unsigned int to = edges[i].ToPosition;
+
+			//Every wedge at From needs exactly one partner wedge at To
+			bool valid = !locked[from] && from != to;
+			partners.clear();
+			for (size_t k = i; valid && k < j; k++) {
+				unsigned int wedge = wedgeOf[edges[k].From];
+				unsigned int toWedge = wedgeOf[edges[k].To];
+
+				bool found = false;
+				for (const WedgePartner& partner : partners) {
+					if (partner.Wedge == wedge) {
+						found = true;
+						valid = partner.ToWedge == toWedge;
+						break;
+					}
+				}
+				if (!found) {
+					partners.push_back({ wedge, toWedge, edges[k].To });
+				}
+			}
+			valid = valid && partners.size() == wedgesAt[from];
+
+			if (valid) {
+				Collapse collapse;
+				collapse.From = from;
+				collapse.To = to;
+
+				Quadric combined = quadrics[from];
+				combined.Add(quadrics[to]);
+				collapse.Cost = combined.Evaluate(positions[to]);
+
+				uint64_t key = EdgeKey(from, to);
+				auto range = std::equal_range(triangleEdges.begin(), triangleEdges.end(), key);
+				collapse.Triangles = static_cast<unsigned int>(range.second - range.first);
+
+				//Vertices on the edge keep their own partner, the rest of the wedge goes to the wedge's partner
+				for (unsigned int u = usedStart[from]; u < usedStart[from + 1]; u++) {
+					unsigned int vertex = used[u];
+					unsigned int target = ~0u;
+					for (size_t k = i; k < j; k++) {
+						if (edges[k].From == vertex) {
+							target = edges[k].To;
+							break;
+						}
+					}
+					if (target == ~0u) {
+						for (const WedgePartner& partner : partners) {
+							if (partner.Wedge == wedgeOf[vertex]) {
+								target = partner.ToVertex;
+								break;
+							}
+						}
+					}
+					collapse.Pairs.push_back({ vertex, target });
+				}
+				collapses.push_back(std::move(collapse));
+			}
+
+			i = j;
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			if (a.Cost != b.Cost) return a.Cost < b.Cost;
+			if (a.From != b.From) return a.From < b.From;
+			return a.To < b.To;
+		});
+		return collapses;
+	}
+
+	//Returns true if moving From onto To would turn any surviving triangle around From over (or make it degenerate)
+	static bool Flips(const vector<unsigned int>& indices, const vector<unsigned int>& positionOf, const vector<glm::dvec3>& positions,
+		const PositionTriangles& fans, unsigned int from, unsigned int to)
+	{
+		for (unsigned int f = fans.Start[from]; f < fans.Start[from + 1]; f++) {
+			unsigned int triangle = fans.Triangles[f];
+			unsigned int p[3] = { positionOf[indices[triangle * 3]], positionOf[indices[triangle * 3 + 1]], positionOf[indices[triangle * 3 + 2]] };
+
+			if (p[0] == to || p[1] == to || p[2] == to) {
+				continue; //Collapses away
+			}
+
+			glm::dvec3 before = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+			for (int c = 0; c < 3; c++) {
+				if (p[c] == from) {
+					p[c] = to;
+				}
+			}
+			glm::dvec3 after = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+
+			if (glm::dot(before, after) <= 1e-3 * glm::length(before) * glm::length(after) || glm::length(after) <= 0.0) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+#endif
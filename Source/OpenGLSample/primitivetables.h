@@ -0,0 +1,359 @@
+#ifndef PRIMITIVETABLES_H
+#define PRIMITIVETABLES_H
+
+//Compile time vertex tables for the fixed-shape primitives.
+//The tables hold unit geometry in the same 11 float layout the Mesh class uses (position, color, normals, uv),
+//are built entirely by the compiler, and end up in read-only data. Placement and scaling happen through Mesh::LocalTransform.
+//Building the larger sphere tables takes more constexpr steps than MSVC allows by default, see /constexpr:steps in the project.
+
+namespace PrimitiveTables
+{
+	constexpr int FloatsPerVertex = 11;
+
+	//Small constexpr vector, glm is not usable at compile time
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	constexpr Float3 Subtract(Float3 a, Float3 b)
+	{
+		return Float3{ a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	constexpr Float3 Cross(Float3 a, Float3 b)
+	{
+		return Float3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	//Newton iteration square root
+	constexpr double Sqrt(double value)
+	{
+		if (value <= 0.0) {
+			return 0.0;
+		}
+
+		double guess = value > 1.0 ? value : 1.0;
+		for (int i = 0; i < 64; i++) {
+			double next = 0.5 * (guess + value / guess);
+			if (next == guess) {
+				break;
+			}
+			guess = next;
+		}
+		return guess;
+	}
+
+	//Degenerate triangles (sphere poles) get a zero normal instead of a NaN
+	constexpr Float3 Normalize(Float3 a)
+	{
+		double length = Sqrt(static_cast<double>(a.x) * a.x + static_cast<double>(a.y) * a.y + static_cast<double>(a.z) * a.z);
+		if (length == 0.0) {
+			return Float3{ 0.0f, 0.0f, 0.0f };
+		}
+		return Float3{ static_cast<float>(a.x / length), static_cast<float>(a.y / length), static_cast<float>(a.z / length) };
+	}
+
+	constexpr double Pi = 3.1415926535897932384626433832795;
+
+	//Taylor series sine, wrapped into [-PI, PI] first so the series converges quickly
+	constexpr double Sin(double angle)
+	{
+		while (angle > Pi) {
+			angle -= 2.0 * Pi;
+		}
+		while (angle < -Pi) {
+			angle += 2.0 * Pi;
+		}
+
+		double term = angle;
+		double sum = angle;
+		for (int n = 1; n < 12; n++) {
+			term *= -angle * angle / ((2.0 * n) * (2.0 * n + 1.0));
+			sum += term;
+		}
+		return sum;
+	}
+
+	constexpr double Cos(double angle)
+	{
+		return Sin(angle + Pi / 2.0);
+	}
+
+	template<int N>
+	struct VertexTable
+	{
+		static constexpr int VertexCount = N;
+		float Data[N * FloatsPerVertex];
+	};
+
+	//Writes one vertex at the cursor, color is always white like the runtime generators
+	template<int N>
+	constexpr void PutVertex(VertexTable<N>& table, int& cursor, Float3 pos, Float3 normals, float u, float v)
+	{
+		float* out = table.Data + cursor * FloatsPerVertex;
+		out[0] = pos.x;
+		out[1] = pos.y;
+		out[2] = pos.z;
+		out[3] = 1.0f;
+		out[4] = 1.0f;
+		out[5] = 1.0f;
+		out[6] = normals.x;
+		out[7] = normals.y;
+		out[8] = normals.z;
+		out[9] = u;
+		out[10] = v;
+		cursor++;
+	}
+
+	//Unit cube, bottom face centered on the origin, 1 unit on each side (same layout as Cube)
+	inline constexpr VertexTable<36> UnitCube = { {
+		//Bottom
+		-0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+		-0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f, -1.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f, -1.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f, -1.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f, -1.0f,  0.0f,  0.0f, 0.0f,
+		//Back
+		 0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f,  1.0f,  0.0f, 0.0f,
+		 0.5f, 1.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+		-0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+		-0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f,  1.0f,  1.0f, 0.0f,
+		-0.5f, 1.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f,  1.0f,  1.0f, 1.0f,
+		 0.5f, 1.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f,  1.0f,  0.0f, 1.0f,
+		//Right
+		-0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,  -1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+		-0.5f, 1.0f, -0.5f,  1.0f, 1.0f, 1.0f,  -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		-0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,  -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,  -1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f, 1.0f,  0.5f,  1.0f, 1.0f, 1.0f,  -1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+		-0.5f, 1.0f, -0.5f,  1.0f, 1.0f, 1.0f,  -1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		//Front
+		 0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f, -1.0f,  0.0f, 0.0f,
+		 0.5f, 1.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+		-0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+		-0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f, -1.0f,  1.0f, 0.0f,
+		-0.5f, 1.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f, -1.0f,  1.0f, 1.0f,
+		 0.5f, 1.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  0.0f, -1.0f,  0.0f, 1.0f,
+		//Left
+		 0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,   1.0f,  0.0f,  0.0f,  0.0f, 0.0f,
+		 0.5f, 1.0f,  0.5f,  1.0f, 1.0f, 1.0f,   1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,   1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+		 0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,   1.0f,  0.0f,  0.0f,  1.0f, 0.0f,
+		 0.5f, 1.0f, -0.5f,  1.0f, 1.0f, 1.0f,   1.0f,  0.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f, 1.0f,  0.5f,  1.0f, 1.0f, 1.0f,   1.0f,  0.0f,  0.0f,  0.0f, 1.0f,
+		//Top
+		-0.5f, 1.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  1.0f,  0.0f,  0.0f, 0.0f,
+		-0.5f, 1.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  1.0f,  0.0f,  0.0f, 1.0f,
+		 0.5f, 1.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f, 1.0f,  0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  1.0f,  0.0f,  1.0f, 1.0f,
+		 0.5f, 1.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  1.0f,  0.0f,  1.0f, 0.0f,
+		-0.5f, 1.0f, -0.5f,  1.0f, 1.0f, 1.0f,   0.0f,  1.0f,  0.0f,  0.0f, 0.0f
+	} };
+
+	//Unit plane on the XZ axis, centered on the origin (same layout as Plane)
+	inline constexpr VertexTable<6> UnitPlane = { {
+		-0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
+		-0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f,
+		 0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f,
+		 0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f,
+		 0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,
+		-0.5f, 0.0f, -0.5f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f
+	} };
+
+	//Unit pyramid, 1x1 base on the origin with the tip 1 unit up (same layout as Pyramid)
+	constexpr VertexTable<18> BuildUnitPyramid()
+	{
+		VertexTable<18> table{};
+		int cursor = 0;
+
+		Float3 down = { 0.0f, -1.0f, 0.0f };
+		Float3 tip = { 0.0f, 1.0f, 0.0f };
+
+		//Base
+		PutVertex(table, cursor, Float3{ -0.5f, 0.0f, -0.5f }, down, 0.0f, 0.0f);
+		PutVertex(table, cursor, Float3{  0.5f, 0.0f, -0.5f }, down, 1.0f, 0.0f);
+		PutVertex(table, cursor, Float3{ -0.5f, 0.0f,  0.5f }, down, 0.0f, 1.0f);
+		PutVertex(table, cursor, Float3{  0.5f, 0.0f, -0.5f }, down, 1.0f, 0.0f);
+		PutVertex(table, cursor, Float3{  0.5f, 0.0f,  0.5f }, down, 1.0f, 1.0f);
+		PutVertex(table, cursor, Float3{ -0.5f, 0.0f,  0.5f }, down, 0.0f, 1.0f);
+
+		//Sides, first and third use cross(edge1, edge2), second and fourth use cross(edge2, edge1)
+		Float3 corners[4][2] = {
+			{ Float3{  0.5f, 0.0f,  0.5f }, Float3{  0.5f, 0.0f, -0.5f } }, //Right
+			{ Float3{ -0.5f, 0.0f, -0.5f }, Float3{  0.5f, 0.0f, -0.5f } }, //Back
+			{ Float3{ -0.5f, 0.0f, -0.5f }, Float3{ -0.5f, 0.0f,  0.5f } }, //Left
+			{ Float3{  0.5f, 0.0f,  0.5f }, Float3{ -0.5f, 0.0f,  0.5f } }  //Front
+		};
+
+		for (int i = 0; i < 4; i++) {
+			Float3 edge1 = Subtract(corners[i][1], corners[i][0]);
+			Float3 edge2 = Subtract(tip, corners[i][0]);
+			Float3 normals = (i % 2 == 0) ? Normalize(Cross(edge1, edge2)) : Normalize(Cross(edge2, edge1));
+
+			PutVertex(table, cursor, corners[i][0], normals, 0.0f, 0.0f);
+			PutVertex(table, cursor, tip, normals, 0.5f, 0.5f);
+			PutVertex(table, cursor, corners[i][1], normals, 1.0f, 0.0f);
+		}
+
+		return table;
+	}
+
+	inline constexpr VertexTable<18> UnitPyramid = BuildUnitPyramid();
+
+	constexpr int CylinderVertexCount(int sides, int subDivisions, bool drawTop, bool drawBottom)
+	{
+		return sides * subDivisions * 6 + (drawTop ? (sides + 1) * 3 : 0) + (drawBottom ? (sides + 1) * 3 : 0);
+	}
+
+	//Unit cylinder, radius 1 and height 1 standing on the origin (same layout as Cylinder)
+	template<int Sides, int SubDivisions, bool DrawTop, bool DrawBottom>
+	constexpr VertexTable<CylinderVertexCount(Sides, SubDivisions, DrawTop, DrawBottom)> BuildUnitCylinder()
+	{
+		static_assert(Sides >= 3, "A cylinder needs at least 3 sides");
+		static_assert(SubDivisions >= 1, "A cylinder needs at least one subdivision");
+
+		VertexTable<CylinderVertexCount(Sides, SubDivisions, DrawTop, DrawBottom)> table{};
+		int cursor = 0;
+
+		float u = 1.0f / Sides;
+		float v = 1.0f / SubDivisions;
+		float divHeight = 1.0f / SubDivisions;
+
+		for (int i = 0; i < Sides; i++) {
+			double theta1 = 2.0 * Pi * i / Sides;
+			double theta2 = 2.0 * Pi * (i + 1) / Sides;
+
+			float x1 = static_cast<float>(Cos(theta1));
+			float z1 = static_cast<float>(Sin(theta1));
+			float x2 = static_cast<float>(Cos(theta2));
+			float z2 = static_cast<float>(Sin(theta2));
+
+			for (int j = 0; j < SubDivisions; j++) {
+				float btmY = divHeight * j;
+				float topY = divHeight * (j + 1);
+
+				//Right triangle
+				Float3 vert1 = { x1, btmY, z1 };
+				Float3 vert2 = { x1, topY, z1 };
+				Float3 vert3 = { x2, topY, z2 };
+				Float3 normals = Normalize(Cross(Subtract(vert3, vert1), Subtract(vert2, vert1)));
+
+				PutVertex(table, cursor, vert1, normals, 1 - (u * i), v * j);
+				PutVertex(table, cursor, vert2, normals, 1 - (u * i), v * (j + 1));
+				PutVertex(table, cursor, vert3, normals, 1 - (u * (i + 1)), v * (j + 1));
+
+				//Left triangle
+				vert1 = Float3{ x2, topY, z2 };
+				vert2 = Float3{ x2, btmY, z2 };
+				vert3 = Float3{ x1, btmY, z1 };
+				normals = Normalize(Cross(Subtract(vert3, vert1), Subtract(vert2, vert1)));
+
+				PutVertex(table, cursor, vert1, normals, 1 - (u * (i + 1)), v * (j + 1));
+				PutVertex(table, cursor, vert2, normals, 1 - (u * (i + 1)), v * j);
+				PutVertex(table, cursor, vert3, normals, 1 - (u * i), v * j);
+			}
+		}
+
+		//Caps, bottom first to match the runtime generator
+		for (int cap = 0; cap < 2; cap++) {
+			bool isTop = (cap == 1);
+			if ((isTop && !DrawTop) || (!isTop && !DrawBottom)) {
+				continue;
+			}
+
+			float capY = isTop ? 1.0f : 0.0f;
+			Float3 normals = { 0.0f, isTop ? 1.0f : -1.0f, 0.0f };
+
+			for (int i = 0; i <= Sides; ++i) {
+				float curX = static_cast<float>(Cos(2.0 * Pi * i / Sides));
+				float curZ = static_cast<float>(Sin(2.0 * Pi * i / Sides));
+				float nxtX = static_cast<float>(Cos(2.0 * Pi * (i + 1) / Sides));
+				float nxtZ = static_cast<float>(Sin(2.0 * Pi * (i + 1) / Sides));
+
+				PutVertex(table, cursor, Float3{ 0.0f, capY, 0.0f }, normals, 0.0f, 0.0f); //Center
+				PutVertex(table, cursor, Float3{ curX, capY, curZ }, normals, curX, curZ);
+				PutVertex(table, cursor, Float3{ nxtX, capY, nxtZ }, normals, nxtX, nxtZ);
+			}
+		}
+
+		return table;
+	}
+
+	template<int Sides, int SubDivisions = 1, bool DrawTop = true, bool DrawBottom = true>
+	inline constexpr auto UnitCylinder = BuildUnitCylinder<Sides, SubDivisions, DrawTop, DrawBottom>();
+
+	constexpr int SphereVertexCount(int sides, bool semiCircle)
+	{
+		return (semiCircle ? sides / 2 : sides) * sides * 6 + (semiCircle ? (sides + 1) * 3 : 0);
+	}
+
+	constexpr Float3 UnitSphereVertex(double phi, double theta)
+	{
+		return Float3{ static_cast<float>(Sin(phi) * Cos(theta)), static_cast<float>(Cos(phi)), static_cast<float>(Sin(phi) * Sin(theta)) };
+	}
+
+	//Unit UV sphere centered on the origin (same layout as Sphere in UV_SPHERE mode)
+	template<int Sides, bool SemiCircle>
+	constexpr VertexTable<SphereVertexCount(Sides, SemiCircle)> BuildUnitSphere()
+	{
+		static_assert(Sides >= 3, "A sphere needs at least 3 sides");
+
+		VertexTable<SphereVertexCount(Sides, SemiCircle)> table{};
+		int cursor = 0;
+
+		float u = 1.0f / static_cast<float>(Sides - 1);
+		float v = 1.0f / static_cast<float>(Sides);
+		int latitudeLimit = SemiCircle ? Sides / 2 : Sides;
+
+		for (int i = 0; i < latitudeLimit; i++) {
+			double phi1 = Pi * i / (Sides - 1);
+			double phi2 = Pi * (i + 1) / (Sides - 1);
+
+			for (int j = 0; j < Sides; j++) {
+				double theta1 = 2.0 * Pi * j / Sides;
+				double theta2 = 2.0 * Pi * (j + 1) / Sides;
+
+				Float3 vert1 = UnitSphereVertex(phi1, theta1);
+				Float3 vert2 = UnitSphereVertex(phi1, theta2);
+				Float3 vert3 = UnitSphereVertex(phi2, theta1);
+				Float3 vert4 = UnitSphereVertex(phi2, theta2);
+
+				// Right triangle
+				Float3 normals = Normalize(Cross(Subtract(vert3, vert1), Subtract(vert2, vert1)));
+				PutVertex(table, cursor, vert1, normals, 1.0f - (u * j), v * i);
+				PutVertex(table, cursor, vert2, normals, 1.0f - (u * (j + 1)), v * i);
+				PutVertex(table, cursor, vert3, normals, 1.0f - (u * j), v * (i + 1));
+
+				// Left triangle
+				normals = Normalize(Cross(Subtract(vert2, vert4), Subtract(vert3, vert4)));
+				PutVertex(table, cursor, vert2, normals, 1.0f - (u * (j + 1)), v * i);
+				PutVertex(table, cursor, vert4, normals, 1.0f - (u * (j + 1)), v * (i + 1));
+				PutVertex(table, cursor, vert3, normals, 1.0f - (u * j), v * (i + 1));
+			}
+		}
+
+		if (SemiCircle) {
+			Float3 normals = { 0.0f, -1.0f, 0.0f };
+
+			for (int i = 0; i <= Sides; ++i) {
+				float curX = static_cast<float>(Cos(2.0 * Pi * i / Sides));
+				float curZ = static_cast<float>(Sin(2.0 * Pi * i / Sides));
+				float nxtX = static_cast<float>(Cos(2.0 * Pi * (i + 1) / Sides));
+				float nxtZ = static_cast<float>(Sin(2.0 * Pi * (i + 1) / Sides));
+
+				PutVertex(table, cursor, Float3{ 0.0f, 0.0f, 0.0f }, normals, 0.0f, 0.0f); //Center
+				PutVertex(table, cursor, Float3{ curX, 0.0f, curZ }, normals, curX, curZ);
+				PutVertex(table, cursor, Float3{ nxtX, 0.0f, nxtZ }, normals, nxtX, nxtZ);
+			}
+		}
+
+		return table;
+	}
+
+	template<int Sides, bool SemiCircle = false>
+	inline constexpr auto UnitSphere = BuildUnitSphere<Sides, SemiCircle>();
+}
+
+#endif
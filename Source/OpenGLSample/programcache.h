@@ -0,0 +1,207 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include "glextensions.h"
+
+using std::vector;
+
+//Linked programs saved to disk with glGetProgramBinary and loaded back with glProgramBinary, so later launches skip compiling
+//and linking. A binary is only valid for the driver that wrote it, so the key hashes the sources and defines together with
+//the GL vendor, renderer and version strings: a driver update or another GPU misses the cache instead of loading a stale file.
+//Drivers may still reject a binary (GL_LINK_STATUS false after loading), the caller then compiles from source and stores again.
+class ProgramCache
+{
+public:
+	//Where the binaries are written, relative to the working directory
+	static inline std::string Directory = "shadercache";
+
+	//When false nothing is loaded or stored, every program compiles from source
+	static inline bool Enabled = true;
+
+	//Programs loaded from disk, programs compiled from source (cache disabled or missed), and binaries the driver refused, since the last reset
+	static inline unsigned int Hits = 0;
+	static inline unsigned int Misses = 0;
+	static inline unsigned int Rejected = 0;
+
+	//True if programs can be cached on this context
+	static bool IsAvailable()
+	{
+		return Enabled && GLExtensions::ProgramBinary;
+	}
+
+	//Key of a program: 64 bit FNV-1a of the sources, the defines and the driver strings
+	static uint64_t Key(const std::string& vertexSource, const std::string& fragmentSource, const std::string& defines)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		auto add = [&hash](const char* text) {
+			if (text) {
+				for (const char* c = text; *c; c++) {
+					hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+				}
+			}
+			//Separator so "ab" + "c" and "a" + "bc" differ
+			hash = (hash ^ 0xFFu) * 1099511628211ull;
+		};
+
+		add(vertexSource.c_str());
+		add(fragmentSource.c_str());
+		add(defines.c_str());
+		add(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+		add(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+		add(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+		return hash;
+	}
+
+	//Loads the binary stored under key into program. Returns false if there is none or the driver rejects it, program
+	//is then unlinked and can be re-used for a source compile
+	static bool Load(uint64_t key, unsigned int program)
+	{
+		if (!IsAvailable()) {
+			Misses++;
+			return false;
+		}
+
+		std::ifstream file(PathFor(key), std::ios::binary);
+		if (!file) {
+			Misses++;
+			return false;
+		}
+
+		//Header: magic, key, binary format, binary length
+		uint32_t magic = 0, format = 0, length = 0;
+		uint64_t storedKey = 0;
+		file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+		file.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey));
+		file.read(reinterpret_cast<char*>(&format), sizeof(format));
+		file.read(reinterpret_cast<char*>(&length), sizeof(length));
+		if (!file || magic != Magic || storedKey != key || length == 0) {
+			std::cout << "ERROR::PROGRAMCACHE::BAD_FILE " << PathFor(key) << std::endl;
+			Misses++;
+			return false;
+		}
+
+		//The binary is the rest of the file, a length that does not match is a damaged entry (checked before allocating it)
+		std::streamoff headerEnd = file.tellg();
+		file.seekg(0, std::ios::end);
+		std::streamoff remaining = file.tellg() - headerEnd;
+		file.seekg(headerEnd);
+		if (!file || remaining != static_cast<std::streamoff>(length)) {
+			std::cout << "ERROR::PROGRAMCACHE::TRUNCATED_FILE " << PathFor(key) << std::endl;
+			Misses++;
+			return false;
+		}
+
+		vector<char> binary(length);
+		file.read(binary.data(), length);
+		if (!file) {
+			std::cout << "ERROR::PROGRAMCACHE::TRUNCATED_FILE " << PathFor(key) << std::endl;
+			Misses++;
+			return false;
+		}
+
+		GLExtensions::LoadProgramBinary(program, format, binary.data(), static_cast<GLsizei>(length));
+		GLint linked = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked) {
+			std::cout << "PROGRAMCACHE::BINARY_REJECTED " << PathFor(key) << ", COMPILING FROM SOURCE" << std::endl;
+			Rejected++;
+			Misses++;
+			return false;
+		}
+
+		Hits++;
+		return true;
+	}
+
+	//Asks the driver to keep the binary of program retrievable, call before glLinkProgram
+	static void PrepareForLink(unsigned int program)
+	{
+		if (IsAvailable()) {
+			GLExtensions::ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+	}
+
+	//Writes the binary of a linked program under key
+	static void Store(uint64_t key, unsigned int program)
+	{
+		if (!IsAvailable()) {
+			return;
+		}
+
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) {
+			return;
+		}
+
+		vector<char> binary(length);
+		GLenum format = 0;
+		GLsizei written = 0;
+		GLExtensions::GetProgramBinary(program, length, &written, &format, binary.data());
+		if (written <= 0) {
+			return;
+		}
+
+		std::error_code error;
+		std::filesystem::create_directories(Directory, error);
+
+		//Written to a temporary name first so a crash mid-write never leaves a half file under the real name
+		std::string path = PathFor(key);
+		std::string temporary = path + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			uint32_t magic = Magic, storedFormat = format, storedLength = static_cast<uint32_t>(written);
+			file.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+			file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+			file.write(reinterpret_cast<const char*>(&storedFormat), sizeof(storedFormat));
+			file.write(reinterpret_cast<const char*>(&storedLength), sizeof(storedLength));
+			file.write(binary.data(), written);
+			if (!file) {
+				std::cout << "ERROR::PROGRAMCACHE::WRITE_FAILED " << temporary << std::endl;
+				return;
+			}
+		}
+
+		std::filesystem::rename(temporary, path, error);
+		if (error) {
+			std::cout << "ERROR::PROGRAMCACHE::WRITE_FAILED " << path << " " << error.message() << std::endl;
+			std::filesystem::remove(temporary, error);
+		}
+	}
+
+	//Deletes every stored binary
+	static void Clear()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(Directory, error);
+	}
+
+	static void ResetStats()
+	{
+		Hits = 0;
+		Misses = 0;
+		Rejected = 0;
+	}
+
+private:
+	//"GLPB"
+	static const uint32_t Magic = 0x42504C47;
+
+	static std::string PathFor(uint64_t key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+		return Directory + "/" + name;
+	}
+};
+
+#endif
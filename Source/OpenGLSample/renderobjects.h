@@ -0,0 +1,187 @@
+#ifndef RENDEROBJECTS_H
+#define RENDEROBJECTS_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "frustum.h"
+#include "meshlet.h"
+#include "scenegraph.h"
+
+using std::vector;
+
+//RenderObjects::Flags
+const uint32_t RENDER_STATIC = 1; //Never moves (the static scene, also drawn by the StaticBatches)
+const uint32_t RENDER_HIDDEN = 2; //Skipped by Cull
+
+//Everything drawn per object each frame, stored entity-component style: an entity is a handle, and its components (world
+//transform, normal matrix, bounds, mesh, material, flags and scene graph node) sit at the same index of densely packed
+//arrays, one array per component. The meshes and materials themselves live in tables of the caller, the arrays only hold
+//their indices, so culling reads 16 bytes per object instead of walking whole Mesh objects with their GL handles, textures
+//and vertex vectors.
+//The handle to index mapping is a sparse set: Destroy moves the last object into the hole, so the arrays never have gaps.
+//Handles of destroyed entities are reused by later ones.
+class RenderObjects
+{
+public:
+	typedef uint32_t Entity;
+	static const Entity InvalidEntity = ~0u;
+
+	//Components, index i of every array belongs to the same entity
+	vector<glm::mat4> Transforms;
+	vector<glm::mat3> NormalMatrices;
+	vector<glm::vec4> Bounds;      //World space sphere: center and radius
+	vector<glm::vec4> LocalBounds; //Sphere around the mesh's vertices, before Transforms
+	vector<uint32_t> MeshIds;
+	vector<uint32_t> MaterialIds;
+	vector<uint32_t> Flags;
+	vector<int> Nodes;             //SceneGraph handle the transform follows, -1 for none
+	vector<Entity> Entities;
+
+	size_t Size() const { return Entities.size(); }
+
+	Entity Create(const glm::mat4& transform, const glm::vec4& localBounds, uint32_t mesh, uint32_t material, uint32_t flags, int node = -1)
+	{
+		Entity entity;
+		if (!freeEntities.empty()) {
+			entity = freeEntities.back();
+			freeEntities.pop_back();
+		}
+		else {
+			entity = static_cast<Entity>(indexOf.size());
+			indexOf.push_back(0);
+		}
+
+		indexOf[entity] = static_cast<uint32_t>(Entities.size());
+		Transforms.push_back(transform);
+		NormalMatrices.push_back(glm::transpose(glm::inverse(glm::mat3(transform))));
+		Bounds.push_back(WorldBounds(transform, localBounds));
+		LocalBounds.push_back(localBounds);
+		MeshIds.push_back(mesh);
+		MaterialIds.push_back(material);
+		Flags.push_back(flags);
+		Nodes.push_back(node);
+		Entities.push_back(entity);
+		return entity;
+	}
+
+	void Destroy(Entity entity)
+	{
+		if (!Alive(entity)) {
+			return;
+		}
+
+		uint32_t index = indexOf[entity];
+		uint32_t last = static_cast<uint32_t>(Entities.size() - 1);
+		if (index != last) {
+			Transforms[index] = Transforms[last];
+			NormalMatrices[index] = NormalMatrices[last];
+			Bounds[index] = Bounds[last];
+			LocalBounds[index] = LocalBounds[last];
+			MeshIds[index] = MeshIds[last];
+			MaterialIds[index] = MaterialIds[last];
+			Flags[index] = Flags[last];
+			Nodes[index] = Nodes[last];
+			Entities[index] = Entities[last];
+			indexOf[Entities[index]] = index;
+		}
+		Transforms.pop_back();
+		NormalMatrices.pop_back();
+		Bounds.pop_back();
+		LocalBounds.pop_back();
+		MeshIds.pop_back();
+		MaterialIds.pop_back();
+		Flags.pop_back();
+		Nodes.pop_back();
+		Entities.pop_back();
+		indexOf[entity] = InvalidEntity;
+		freeEntities.push_back(entity);
+	}
+
+	bool Alive(Entity entity) const { return entity < indexOf.size() && indexOf[entity] != InvalidEntity; }
+
+	//Index of the entity's components in the arrays. Only valid until the next Destroy
+	uint32_t IndexOf(Entity entity) const { return indexOf[entity]; }
+
+	void SetTransform(Entity entity, const glm::mat4& transform, const glm::mat3& normalMatrix)
+	{
+		uint32_t index = indexOf[entity];
+		Transforms[index] = transform;
+		NormalMatrices[index] = normalMatrix;
+		Bounds[index] = WorldBounds(transform, LocalBounds[index]);
+	}
+
+	//Copies the matrices of the objects that follow a scene graph node. Call after SceneGraph::Update recomputed anything.
+	//first and last limit it to part of the arrays, to split the work across threads
+	void SyncTransforms(const SceneGraph& graph, size_t first = 0, size_t last = SIZE_MAX)
+	{
+		for (size_t i = first; i < std::min(last, Entities.size()); i++) {
+			if (Nodes[i] >= 0) {
+				Transforms[i] = graph.World(Nodes[i]);
+				NormalMatrices[i] = graph.Normal(Nodes[i]);
+				Bounds[i] = WorldBounds(Transforms[i], LocalBounds[i]);
+			}
+		}
+	}
+
+	//Indices of the objects whose bounds touch the frustum, skipping the ones with any of skipFlags
+	void Cull(const Frustum& frustum, vector<uint32_t>& visible, uint32_t skipFlags = RENDER_HIDDEN) const
+	{
+		visible.clear();
+		CullRange(frustum, 0, Bounds.size(), visible, skipFlags);
+	}
+
+	//Cull over the objects first to last, appending to visible
+	void CullRange(const Frustum& frustum, size_t first, size_t last, vector<uint32_t>& visible, uint32_t skipFlags = RENDER_HIDDEN) const
+	{
+		for (size_t i = first; i < last; i++) {
+			if ((Flags[i] & skipFlags) == 0 && frustum.IntersectsSphere(glm::vec3(Bounds[i]), Bounds[i].w)) {
+				visible.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	//Orders indices for submission: static objects first, then by material and mesh so state changes group together, then
+	//front to back
+	void Sort(vector<uint32_t>& indices, const glm::vec3& cameraPosition)
+	{
+		sortKeys.resize(indices.size());
+		for (size_t i = 0; i < indices.size(); i++) {
+			sortKeys[i] = { SortKey(indices[i], cameraPosition), indices[i] };
+		}
+		std::sort(sortKeys.begin(), sortKeys.end());
+		for (size_t i = 0; i < indices.size(); i++) {
+			indices[i] = sortKeys[i].second;
+		}
+	}
+
+	//The key Sort orders an object by. Materials and meshes past 2^20 share a key
+	uint64_t SortKey(uint32_t index, const glm::vec3& cameraPosition) const
+	{
+		float distance = glm::length(glm::vec3(Bounds[index]) - cameraPosition);
+		uint32_t depth;
+		memcpy(&depth, &distance, sizeof(depth)); //Positive floats order like their bits
+		uint64_t key = (Flags[index] & RENDER_STATIC) ? 0 : (1ull << 63);
+		key |= static_cast<uint64_t>(std::min(MaterialIds[index], 0xFFFFFu)) << 43;
+		key |= static_cast<uint64_t>(std::min(MeshIds[index], 0xFFFFFu)) << 23;
+		return key | (depth >> 9);
+	}
+
+	//Sphere around the mesh's vertices moved by transform, scaled by its largest axis
+	static glm::vec4 WorldBounds(const glm::mat4& transform, const glm::vec4& localBounds)
+	{
+		glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(localBounds), 1.0f));
+		return glm::vec4(center, localBounds.w * MeshletCuller::MaxScale(transform));
+	}
+
+private:
+	//Entity handle to array index, InvalidEntity for destroyed handles
+	vector<uint32_t> indexOf;
+	vector<Entity> freeEntities;
+	vector<std::pair<uint64_t, uint32_t>> sortKeys;
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <iostream>
+
+using std::vector;
+
+//Hands the frames from the simulation to a thread that owns the GL context. The simulation thread Acquires a Snapshot (an
+//immutable record of everything a frame draws: camera, settings, the draw list with its transforms), fills it and Submits
+//it; the render thread draws it and gives the slot back. With Buffers slots the simulation runs up to Buffers - 1 frames
+//ahead: while the render thread submits frame N to GL the simulation builds N + 1 (and N + 2 when triple buffered). Once
+//every slot is queued or being drawn Acquire waits, which keeps the latency from input to screen bounded.
+//A submitted snapshot is not touched by the simulation until the render thread has drawn it, so neither side locks while
+//working on one. The slots are reused, so their vectors keep their capacity and a frame allocates nothing.
+//Started without a thread, Submit draws the snapshot right away on the calling thread.
+template<typename Snapshot>
+class RenderThread
+{
+public:
+	//buffers is the number of snapshots, 2 or more
+	RenderThread(unsigned int buffers = 2) : slots(std::max(buffers, 2u))
+	{
+		for (size_t i = 0; i < slots.size(); i++) {
+			freeSlots.push_back(i);
+		}
+		statsStart = Clock::now();
+	}
+
+	~RenderThread() { Stop(); }
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	unsigned int Buffers() const { return static_cast<unsigned int>(slots.size()); }
+	bool IsThreaded() const { return threaded; }
+
+	//render draws a snapshot. With threaded the render thread runs attach first (to make the context current there) and
+	//detach when it stops
+	void Start(std::function<void(const Snapshot&)> render, bool threaded, std::function<void()> attach = {}, std::function<void()> detach = {})
+	{
+		Stop();
+		this->render = std::move(render);
+		this->threaded = threaded;
+		stopping = false;
+		if (threaded) {
+			thread = std::thread([this, attach, detach]() { RenderLoop(attach, detach); });
+		}
+	}
+
+	//Draws whatever is queued, then stops the render thread (detach has run when this returns). No Acquire after this until
+	//the next Start
+	void Stop()
+	{
+		if (thread.joinable()) {
+			{
+				std::lock_guard<std::mutex> guard(mutex);
+				stopping = true;
+			}
+			changed.notify_all();
+			thread.join();
+		}
+	}
+
+	//Snapshot for the next frame, waits while every slot is queued or being drawn. The frame's simulation time starts here
+	Snapshot& Acquire()
+	{
+		Clock::time_point start = Clock::now();
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this]() { return !freeSlots.empty(); });
+		current = freeSlots.front();
+		freeSlots.pop_front();
+
+		Clock::time_point now = Clock::now();
+		simulation.Waiting += Milliseconds(start, now);
+		slots[current].Started = now;
+		return slots[current].Frame;
+	}
+
+	//Queues the snapshot from the last Acquire for drawing
+	void Submit()
+	{
+		Clock::time_point now = Clock::now();
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			simulation.Frames++;
+			simulation.Busy += Milliseconds(slots[current].Started, now);
+			if (threaded) {
+				readySlots.push_back(current);
+			}
+		}
+		if (threaded) {
+			changed.notify_all();
+		}
+		else {
+			Draw(current);
+		}
+	}
+
+	//Prints, per thread, the time a frame took and the time spent waiting on the other thread (per frame) and the frame
+	//rate, and the latency from the start of a frame's simulation until it was presented. Then starts over
+	void PrintStats()
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		double seconds = std::max(Milliseconds(statsStart, Clock::now()) / 1000.0, 1e-6);
+		std::cout << "RENDERTHREAD::" << (threaded ? "ON " : "OFF ") << slots.size() << " BUFFERS" << std::endl;
+		PrintThread("SIMULATION", simulation, seconds);
+		PrintThread("RENDER", renderer, seconds);
+		std::cout << "RENDERTHREAD::LATENCY " << (renderer.Frames ? latencySum / renderer.Frames : 0.0) << " ms, MAX " << latencyMax << " ms" << std::endl;
+
+		simulation = ThreadStats();
+		renderer = ThreadStats();
+		latencySum = 0.0;
+		latencyMax = 0.0;
+		statsStart = Clock::now();
+	}
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct Slot
+	{
+		Snapshot Frame;
+		Clock::time_point Started;
+	};
+
+	struct ThreadStats
+	{
+		unsigned int Frames = 0;
+		double Busy = 0.0;
+		double Waiting = 0.0;
+	};
+
+	vector<Slot> slots;
+	std::deque<size_t> freeSlots;
+	std::deque<size_t> readySlots;
+	size_t current = 0; //Slot the simulation is filling
+
+	std::function<void(const Snapshot&)> render;
+	std::thread thread;
+	bool threaded = false;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable changed;
+
+	//Guarded by mutex
+	ThreadStats simulation;
+	ThreadStats renderer;
+	double latencySum = 0.0;
+	double latencyMax = 0.0;
+	Clock::time_point statsStart;
+
+	static double Milliseconds(Clock::time_point start, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	static void PrintThread(const char* name, const ThreadStats& stats, double seconds)
+	{
+		double frames = std::max(stats.Frames, 1u);
+		std::cout << "RENDERTHREAD::" << name << " " << stats.Busy / frames << " ms/FRAME, " << stats.Waiting / frames << " ms WAITING, "
+			<< stats.Frames / seconds << " FPS" << std::endl;
+	}
+
+	//Draws a slot and gives it back to the simulation
+	void Draw(size_t slot)
+	{
+		Clock::time_point start = Clock::now();
+		render(slots[slot].Frame);
+		Clock::time_point end = Clock::now();
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			double latency = Milliseconds(slots[slot].Started, end);
+			renderer.Frames++;
+			renderer.Busy += Milliseconds(start, end);
+			latencySum += latency;
+			latencyMax = std::max(latencyMax, latency);
+			freeSlots.push_back(slot);
+		}
+		changed.notify_all();
+	}
+
+	void RenderLoop(std::function<void()> attach, std::function<void()> detach)
+	{
+		if (attach) {
+			attach();
+		}
+		while (true) {
+			size_t slot;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				Clock::time_point start = Clock::now();
+				changed.wait(lock, [this]() { return stopping || !readySlots.empty(); });
+				renderer.Waiting += Milliseconds(start, Clock::now());
+				if (readySlots.empty()) {
+					break;
+				}
+				slot = readySlots.front();
+				readySlots.pop_front();
+			}
+			Draw(slot);
+		}
+		if (detach) {
+			detach();
+		}
+	}
+};
+
+#endif
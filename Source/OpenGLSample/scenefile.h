@@ -0,0 +1,633 @@
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "assetpack.h"
+
+using std::vector;
+
+//Scene descriptions: textures, materials, objects (primitives), point lights and instances of prototypes (groups of
+//objects drawn with one transform each, like the pumpkins). There are two forms of the same data:
+//
+//Text, for authoring. One entry per line, '#' starts a comment, names must be defined before they are used:
+//  texture <name> <path> [clampu]
+//  material <name> <diffuse texture> <specular texture> [overlay <diffuse texture> <specular texture>] [shininess <value>]
+//  plane <material> <x y z> <length> <width> [in <prototype>]
+//  cylinder <material> <x y z> <radius> <height> <sides> <subdivisions> <top 0/1> <bottom 0/1> [in <prototype>]
+//  sphere <material> <x y z> <radius long> <radius lat> <sides> <semi 0/1> <uv/geodesic> [in <prototype>]
+//  fixedcylinder <material> <x y z> <radius> <height> <sides> <subdivisions> [in <prototype>]
+//  model <material> <x y z> <scale> <path to .obj, .gltf or .glb> [in <prototype>]
+//  light <x y z> <r g b> <constant linear quadratic> [cube <scale>]
+//  instance <prototype> <x y z> <scale> <angle>
+//Sides are 3 to MaxSides, subdivisions 1 to MaxSubdivisions, in both forms.
+//Objects without "in" are static scene geometry, the others are parts of the named prototype. The first part of a prototype
+//is the parent of its other parts in the scene graph (the pumpkin's stem follows its body).
+//
+//Binary, for deployment. A SceneFileHeader, then each record array in the order of the header counts, then the string
+//table. Records are plain 4 byte aligned structs, so the arrays are used in place in the file buffer.
+//
+//Either way the file is read into memory in one block and the scene points into it: numbers are parsed with
+//std::from_chars straight from the buffer, and text paths and names are terminated in place instead of copied.
+
+enum ScenePrimitive : uint32_t
+{
+	SCENE_PLANE,
+	SCENE_CYLINDER,
+	SCENE_SPHERE,
+	SCENE_FIXED_CYLINDER,
+	SCENE_MODEL,
+	SCENE_PRIMITIVE_COUNT
+};
+
+//SceneObject::Flags
+const uint32_t SCENE_DRAW_TOP = 1;
+const uint32_t SCENE_DRAW_BOTTOM = 2;
+const uint32_t SCENE_SEMI_CIRCLE = 4;
+const uint32_t SCENE_GEODESIC = 8;
+
+struct SceneTexture
+{
+	uint32_t Path;      //Offset in the string table
+	uint32_t RepeatU;   //0 to clamp U (labels)
+};
+
+struct SceneMaterial
+{
+	int32_t Diffuse;
+	int32_t Specular;
+	int32_t OverlayDiffuse;   //-1 for none
+	int32_t OverlaySpecular;  //-1 for none
+	float Shininess;
+};
+
+struct SceneObject
+{
+	uint32_t Primitive;
+	int32_t Material;
+	int32_t Prototype;        //-1 for static geometry
+	float Position[3];
+	float Size[2];            //Plane: length, width. Cylinders: radius, height. Sphere: radius long, radius lat. Model: scale
+	int32_t Sides;
+	int32_t Subdivisions;
+	uint32_t Flags;
+	uint32_t Path;            //Offset in the string table, models only
+};
+
+struct SceneLight
+{
+	float Position[3];
+	float Color[3];
+	float Attenuation[3];     //Constant, linear, quadratic
+	float CubeScale;          //Size of the light's marker cube
+};
+
+struct SceneInstance
+{
+	int32_t Prototype;
+	float Position[3];
+	float Scale;
+	float Angle;              //Degrees around (1, 0, 1)
+};
+
+struct ScenePrototype
+{
+	uint32_t Name;            //Offset in the string table
+};
+
+struct SceneFileHeader
+{
+	char Magic[4];            //"SCNB"
+	uint32_t Version;
+	uint32_t TextureCount;
+	uint32_t MaterialCount;
+	uint32_t ObjectCount;
+	uint32_t LightCount;
+	uint32_t InstanceCount;
+	uint32_t PrototypeCount;
+	uint32_t StringBytes;
+};
+
+//Read-only view of a record array, either in the file buffer or in the scene's own storage
+template<typename T>
+struct SceneArray
+{
+	const T* Data = nullptr;
+	size_t Count = 0;
+
+	size_t size() const { return Count; }
+	const T* begin() const { return Data; }
+	const T* end() const { return Data + Count; }
+	const T& operator[](size_t i) const { return Data[i]; }
+};
+
+class Scene
+{
+public:
+	static const uint32_t Version = 2;
+
+	//Tessellation limits of the generated primitives. Fewer than 3 sides is no solid, far more only runs out of memory
+	static const int32_t MaxSides = 4096;
+	static const int32_t MaxSubdivisions = 4096;
+
+	SceneArray<SceneTexture> Textures;
+	SceneArray<SceneMaterial> Materials;
+	SceneArray<SceneObject> Objects;
+	SceneArray<SceneLight> Lights;
+	SceneArray<SceneInstance> Instances;
+	SceneArray<ScenePrototype> Prototypes;
+
+	Scene() {}
+
+	//The arrays point into the scene's own buffers
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	//Loads either form, binary files are recognized by their magic
+	bool Load(const std::string& path)
+	{
+		//From the asset pack if one is mounted (copied, the text parser writes into its buffer), else the loose file
+		vector<char> data;
+		AssetView file;
+		if (!AssetPack::Load(path, data, file)) {
+			std::cout << "ERROR::SCENE::FILE_NOT_FOUND " << path << std::endl;
+			return false;
+		}
+		if (file.Data != data.data()) {
+			data.assign(file.Data, file.Data + file.Size);
+		}
+		size_t size = data.size();
+		//One extra byte, the text parser relies on a terminator at the end
+		data.push_back('\0');
+
+		if (size >= 4 && memcmp(data.data(), "SCNB", 4) == 0) {
+			data.pop_back();
+			return LoadBinary(std::move(data));
+		}
+		return LoadText(std::move(data));
+	}
+
+	//Parses the text form. The scene keeps the buffer (it must end with a '\0') and terminates names and paths in it
+	bool LoadText(vector<char>&& text)
+	{
+		Clear();
+		if (text.empty() || text.back() != '\0') {
+			text.push_back('\0');
+		}
+		buffer = std::move(text);
+		strings = buffer.data();
+		stringBytes = buffer.size();
+
+		std::unordered_map<std::string_view, int> textureNames, materialNames, prototypeNames;
+		char* cursor = buffer.data();
+		char* end = buffer.data() + buffer.size() - 1;
+		int lineNumber = 0;
+		std::string_view tokens[MaxTokens];
+
+		while (cursor < end) {
+			lineNumber++;
+			char* lineEnd = static_cast<char*>(memchr(cursor, '\n', end - cursor));
+			if (!lineEnd) {
+				lineEnd = end;
+			}
+
+			//Split on whitespace up to a comment
+			int count = 0;
+			for (char* c = cursor; c < lineEnd && *c != '#';) {
+				if (*c == ' ' || *c == '\t' || *c == '\r') {
+					c++;
+					continue;
+				}
+				char* start = c;
+				while (c < lineEnd && *c != ' ' && *c != '\t' && *c != '\r' && *c != '#') {
+					c++;
+				}
+				if (count == MaxTokens) {
+					return Fail(lineNumber, "TOO_MANY_VALUES");
+				}
+				tokens[count++] = std::string_view(start, c - start);
+			}
+			cursor = lineEnd + 1;
+			if (count == 0) {
+				continue;
+			}
+
+			LineParser line(tokens, count);
+			std::string_view keyword = line.Word();
+
+			if (keyword == "texture") {
+				std::string_view name = line.Word();
+				std::string_view path = line.Word();
+				SceneTexture texture = { Terminate(path), 1 };
+				if (line.Ok() && line.Remaining()) {
+					if (line.Word() != "clampu") {
+						return Fail(lineNumber, "UNKNOWN_TEXTURE_OPTION");
+					}
+					texture.RepeatU = 0;
+				}
+				if (!line.Ok() || line.Remaining() || !textureNames.emplace(name, static_cast<int>(textures.size())).second) {
+					return Fail(lineNumber, "BAD_TEXTURE");
+				}
+				textures.push_back(texture);
+			}
+			else if (keyword == "material") {
+				std::string_view name = line.Word();
+				SceneMaterial material = { Find(textureNames, line.Word()), Find(textureNames, line.Word()), -1, -1, 32.0f };
+				while (line.Ok() && line.Remaining()) {
+					std::string_view option = line.Word();
+					if (option == "overlay") {
+						material.OverlayDiffuse = Find(textureNames, line.Word());
+						material.OverlaySpecular = Find(textureNames, line.Word());
+						if (material.OverlayDiffuse < 0 || material.OverlaySpecular < 0) {
+							return Fail(lineNumber, "UNKNOWN_TEXTURE");
+						}
+					}
+					else if (option == "shininess") {
+						material.Shininess = line.Float();
+					}
+					else {
+						return Fail(lineNumber, "UNKNOWN_MATERIAL_OPTION");
+					}
+				}
+				if (!line.Ok() || material.Diffuse < 0 || material.Specular < 0) {
+					return Fail(lineNumber, "BAD_MATERIAL");
+				}
+				if (!materialNames.emplace(name, static_cast<int>(materials.size())).second) {
+					return Fail(lineNumber, "DUPLICATE_MATERIAL");
+				}
+				materials.push_back(material);
+			}
+			else if (keyword == "plane" || keyword == "cylinder" || keyword == "sphere" || keyword == "fixedcylinder" || keyword == "model") {
+				SceneObject object = {};
+				object.Prototype = -1;
+				object.Material = Find(materialNames, line.Word());
+				line.Floats(object.Position, 3);
+
+				if (keyword == "model") {
+					object.Primitive = SCENE_MODEL;
+					object.Size[0] = object.Size[1] = line.Float();
+					object.Path = Terminate(line.Word());
+				}
+				else {
+					line.Floats(object.Size, 2);
+				}
+
+				if (keyword == "plane") {
+					object.Primitive = SCENE_PLANE;
+				}
+				else if (keyword == "cylinder") {
+					object.Primitive = SCENE_CYLINDER;
+					object.Sides = line.Int();
+					object.Subdivisions = line.Int();
+					object.Flags |= line.Int() ? SCENE_DRAW_TOP : 0;
+					object.Flags |= line.Int() ? SCENE_DRAW_BOTTOM : 0;
+				}
+				else if (keyword == "sphere") {
+					object.Primitive = SCENE_SPHERE;
+					object.Sides = line.Int();
+					object.Flags |= line.Int() ? SCENE_SEMI_CIRCLE : 0;
+					std::string_view tessellation = line.Word();
+					if (tessellation == "geodesic") {
+						object.Flags |= SCENE_GEODESIC;
+					}
+					else if (tessellation != "uv") {
+						return Fail(lineNumber, "UNKNOWN_TESSELLATION");
+					}
+				}
+				else if (keyword == "fixedcylinder") {
+					object.Primitive = SCENE_FIXED_CYLINDER;
+					object.Sides = line.Int();
+					object.Subdivisions = line.Int();
+					object.Flags = SCENE_DRAW_TOP;
+				}
+
+				if (line.Ok() && line.Remaining()) {
+					if (line.Word() != "in") {
+						return Fail(lineNumber, "EXPECTED_IN");
+					}
+					std::string_view prototype = line.Word();
+					auto found = prototypeNames.find(prototype);
+					if (found == prototypeNames.end()) {
+						found = prototypeNames.emplace(prototype, static_cast<int>(prototypes.size())).first;
+						prototypes.push_back(ScenePrototype{ Terminate(prototype) });
+					}
+					object.Prototype = found->second;
+				}
+				if (!line.Ok() || line.Remaining() || object.Material < 0) {
+					return Fail(lineNumber, "BAD_OBJECT");
+				}
+				if (!ValidTessellation(object)) {
+					return Fail(lineNumber, "BAD_TESSELLATION");
+				}
+				objects.push_back(object);
+			}
+			else if (keyword == "light") {
+				SceneLight light = {};
+				line.Floats(light.Position, 3);
+				line.Floats(light.Color, 3);
+				line.Floats(light.Attenuation, 3);
+				light.CubeScale = 1.0f;
+				if (line.Ok() && line.Remaining()) {
+					if (line.Word() != "cube") {
+						return Fail(lineNumber, "UNKNOWN_LIGHT_OPTION");
+					}
+					light.CubeScale = line.Float();
+				}
+				if (!line.Ok() || line.Remaining()) {
+					return Fail(lineNumber, "BAD_LIGHT");
+				}
+				lights.push_back(light);
+			}
+			else if (keyword == "instance") {
+				SceneInstance instance = {};
+				instance.Prototype = Find(prototypeNames, line.Word());
+				line.Floats(instance.Position, 3);
+				instance.Scale = line.Float();
+				instance.Angle = line.Float();
+				if (!line.Ok() || line.Remaining() || instance.Prototype < 0) {
+					return Fail(lineNumber, "BAD_INSTANCE");
+				}
+				instances.push_back(instance);
+			}
+			else {
+				return Fail(lineNumber, "UNKNOWN_KEYWORD");
+			}
+		}
+
+		Textures = { textures.data(), textures.size() };
+		Materials = { materials.data(), materials.size() };
+		Objects = { objects.data(), objects.size() };
+		Lights = { lights.data(), lights.size() };
+		Instances = { instances.data(), instances.size() };
+		Prototypes = { prototypes.data(), prototypes.size() };
+		return true;
+	}
+
+	//Uses the binary form in place, the scene keeps the buffer. Every index is checked, so a bad file fails here and
+	//not while building the scene
+	bool LoadBinary(vector<char>&& data)
+	{
+		Clear();
+		buffer = std::move(data);
+
+		SceneFileHeader header;
+		if (buffer.size() < sizeof(header)) {
+			return Fail(0, "TRUNCATED_FILE");
+		}
+		memcpy(&header, buffer.data(), sizeof(header));
+		if (memcmp(header.Magic, "SCNB", 4) != 0 || header.Version != Version) {
+			return Fail(0, "UNSUPPORTED_BINARY_VERSION");
+		}
+
+		size_t offset = sizeof(header);
+		if (!Section(Textures, header.TextureCount, offset) || !Section(Materials, header.MaterialCount, offset)
+			|| !Section(Objects, header.ObjectCount, offset) || !Section(Lights, header.LightCount, offset)
+			|| !Section(Instances, header.InstanceCount, offset) || !Section(Prototypes, header.PrototypeCount, offset)) {
+			return Fail(0, "TRUNCATED_FILE");
+		}
+		if (buffer.size() - offset != header.StringBytes || header.StringBytes == 0 || buffer.back() != '\0') {
+			return Fail(0, "BAD_STRING_TABLE");
+		}
+		strings = buffer.data() + offset;
+		stringBytes = header.StringBytes;
+
+		auto isTexture = [this](int32_t index) { return index >= 0 && static_cast<size_t>(index) < Textures.size(); };
+		for (const SceneTexture& texture : Textures) {
+			if (texture.Path >= stringBytes) {
+				return Fail(0, "BAD_TEXTURE");
+			}
+		}
+		for (const SceneMaterial& material : Materials) {
+			if (!isTexture(material.Diffuse) || !isTexture(material.Specular)
+				|| (material.OverlayDiffuse != -1 && !isTexture(material.OverlayDiffuse))
+				|| (material.OverlaySpecular != -1 && !isTexture(material.OverlaySpecular))) {
+				return Fail(0, "BAD_MATERIAL");
+			}
+		}
+		for (const SceneObject& object : Objects) {
+			if (object.Primitive >= SCENE_PRIMITIVE_COUNT || object.Material < 0 || static_cast<size_t>(object.Material) >= Materials.size()
+				|| object.Prototype < -1 || (object.Prototype >= 0 && static_cast<size_t>(object.Prototype) >= Prototypes.size())
+				|| (object.Primitive == SCENE_MODEL && object.Path >= stringBytes)) {
+				return Fail(0, "BAD_OBJECT");
+			}
+			if (!ValidTessellation(object)) {
+				return Fail(0, "BAD_TESSELLATION");
+			}
+		}
+		for (const SceneInstance& instance : Instances) {
+			if (instance.Prototype < 0 || static_cast<size_t>(instance.Prototype) >= Prototypes.size()) {
+				return Fail(0, "BAD_INSTANCE");
+			}
+		}
+		for (const ScenePrototype& prototype : Prototypes) {
+			if (prototype.Name >= stringBytes) {
+				return Fail(0, "BAD_PROTOTYPE");
+			}
+		}
+		return true;
+	}
+
+	//Writes the binary form
+	bool WriteBinary(const std::string& path) const
+	{
+		//Only the strings still in use, the text buffer holds the whole file
+		vector<char> table;
+		vector<SceneTexture> outTextures(Textures.begin(), Textures.end());
+		vector<SceneObject> outObjects(Objects.begin(), Objects.end());
+		vector<ScenePrototype> outPrototypes(Prototypes.begin(), Prototypes.end());
+		auto addString = [&](uint32_t offset) {
+			uint32_t position = static_cast<uint32_t>(table.size());
+			const char* text = String(offset);
+			table.insert(table.end(), text, text + strlen(text) + 1);
+			return position;
+		};
+		for (SceneTexture& texture : outTextures) {
+			texture.Path = addString(texture.Path);
+		}
+		for (SceneObject& object : outObjects) {
+			object.Path = (object.Primitive == SCENE_MODEL) ? addString(object.Path) : 0;
+		}
+		for (ScenePrototype& prototype : outPrototypes) {
+			prototype.Name = addString(prototype.Name);
+		}
+		if (table.empty()) {
+			table.push_back('\0');
+		}
+
+		SceneFileHeader header = { { 'S', 'C', 'N', 'B' }, Version,
+			static_cast<uint32_t>(Textures.size()), static_cast<uint32_t>(Materials.size()), static_cast<uint32_t>(Objects.size()),
+			static_cast<uint32_t>(Lights.size()), static_cast<uint32_t>(Instances.size()), static_cast<uint32_t>(Prototypes.size()),
+			static_cast<uint32_t>(table.size()) };
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(outTextures.data()), outTextures.size() * sizeof(SceneTexture));
+		file.write(reinterpret_cast<const char*>(Materials.Data), Materials.size() * sizeof(SceneMaterial));
+		file.write(reinterpret_cast<const char*>(outObjects.data()), outObjects.size() * sizeof(SceneObject));
+		file.write(reinterpret_cast<const char*>(Lights.Data), Lights.size() * sizeof(SceneLight));
+		file.write(reinterpret_cast<const char*>(Instances.Data), Instances.size() * sizeof(SceneInstance));
+		file.write(reinterpret_cast<const char*>(outPrototypes.data()), outPrototypes.size() * sizeof(ScenePrototype));
+		file.write(table.data(), table.size());
+		if (!file) {
+			std::cout << "ERROR::SCENE::WRITE_FAILED " << path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	//A path or name from the string table
+	const char* String(uint32_t offset) const
+	{
+		return offset < stringBytes ? strings + offset : "";
+	}
+
+private:
+	static const int MaxTokens = 16;
+
+	vector<char> buffer;
+	const char* strings = nullptr;
+	size_t stringBytes = 0;
+
+	//Records parsed from text (binary scenes use the buffer)
+	vector<SceneTexture> textures;
+	vector<SceneMaterial> materials;
+	vector<SceneObject> objects;
+	vector<SceneLight> lights;
+	vector<SceneInstance> instances;
+	vector<ScenePrototype> prototypes;
+
+	//Reads the values of one line in order, any failure sticks so a line is checked once at the end
+	struct LineParser
+	{
+		const std::string_view* Tokens;
+		int Count;
+		int Next = 0;
+		bool Good = true;
+
+		LineParser(const std::string_view* tokens, int count) : Tokens(tokens), Count(count) {}
+
+		bool Ok() const { return Good; }
+		bool Remaining() const { return Next < Count; }
+
+		std::string_view Word()
+		{
+			if (Next >= Count) {
+				Good = false;
+				return std::string_view();
+			}
+			return Tokens[Next++];
+		}
+
+		float Float()
+		{
+			std::string_view token = Word();
+			float value = 0.0f;
+			if (!token.empty() && token[0] == '+') {
+				token.remove_prefix(1);
+			}
+			auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+			Good = Good && result.ec == std::errc() && result.ptr == token.data() + token.size();
+			return value;
+		}
+
+		int Int()
+		{
+			std::string_view token = Word();
+			int value = 0;
+			if (!token.empty() && token[0] == '+') {
+				token.remove_prefix(1);
+			}
+			auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+			Good = Good && result.ec == std::errc() && result.ptr == token.data() + token.size();
+			return value;
+		}
+
+		void Floats(float* values, int count)
+		{
+			for (int i = 0; i < count; i++) {
+				values[i] = Float();
+			}
+		}
+	};
+
+	void Clear()
+	{
+		buffer.clear();
+		strings = nullptr;
+		stringBytes = 0;
+		textures.clear();
+		materials.clear();
+		objects.clear();
+		lights.clear();
+		instances.clear();
+		prototypes.clear();
+		Textures = {};
+		Materials = {};
+		Objects = {};
+		Lights = {};
+		Instances = {};
+		Prototypes = {};
+	}
+
+	//Ends a token with '\0' where its separator was and returns its offset in the buffer (a missing token fails its line anyway)
+	uint32_t Terminate(std::string_view token)
+	{
+		if (token.empty()) {
+			return 0;
+		}
+		char* start = buffer.data() + (token.data() - buffer.data());
+		start[token.size()] = '\0';
+		return static_cast<uint32_t>(start - buffer.data());
+	}
+
+	static int Find(const std::unordered_map<std::string_view, int>& names, std::string_view name)
+	{
+		auto found = names.find(name);
+		return found == names.end() ? -1 : found->second;
+	}
+
+	//Points an array at the next section of the binary buffer
+	template<typename T>
+	bool Section(SceneArray<T>& array, uint32_t count, size_t& offset)
+	{
+		size_t bytes = static_cast<size_t>(count) * sizeof(T);
+		if (offset + bytes > buffer.size()) {
+			return false;
+		}
+		array.Data = reinterpret_cast<const T*>(buffer.data() + offset);
+		array.Count = count;
+		offset += bytes;
+		return true;
+	}
+
+	//Sides of cylinders and spheres in [3, MaxSides], subdivisions of cylinders in [1, MaxSubdivisions]
+	static bool ValidTessellation(const SceneObject& object)
+	{
+		bool cylinder = object.Primitive == SCENE_CYLINDER || object.Primitive == SCENE_FIXED_CYLINDER;
+		if (!cylinder && object.Primitive != SCENE_SPHERE) {
+			return true;
+		}
+		return object.Sides >= 3 && object.Sides <= MaxSides
+			&& (!cylinder || (object.Subdivisions >= 1 && object.Subdivisions <= MaxSubdivisions));
+	}
+
+	bool Fail(int lineNumber, const char* error)
+	{
+		std::cout << "ERROR::SCENE::" << error;
+		if (lineNumber > 0) {
+			std::cout << " LINE " << lineNumber;
+		}
+		std::cout << std::endl;
+		Clear();
+		return false;
+	}
+};
+
+#endif
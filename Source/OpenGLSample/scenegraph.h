@@ -0,0 +1,218 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+using std::vector;
+
+//Transform hierarchy of the scene: every node has a local transform relative to its parent, and the graph keeps the world
+//matrix and the normal matrix of every node ready for drawing.
+//The nodes are stored as structure of arrays (local, world, normal, parent, children) in breadth first order, so they are
+//sorted by depth, a parent always comes before its children and the children of a node are next to each other. A node is
+//addressed by the handle Add returned, which stays the same when the arrays are reordered.
+//SetLocal only flags the node. Update recomputes the flagged nodes and everything below them and leaves the rest alone, so
+//a frame where nothing moved costs nothing and the cost of a frame grows with what moved, not with the size of the scene.
+class SceneGraph
+{
+public:
+	//Nodes whose matrices were recomputed by the last Update
+	size_t UpdatedLastFrame = 0;
+
+	//Adds a node under parent (a handle, -1 for a root) and returns its handle. The parent must already be in the graph
+	int Add(const glm::mat4& local, int parent = -1)
+	{
+		int handle = static_cast<int>(slotOf.size());
+		int slot = static_cast<int>(locals.size());
+		slotOf.push_back(slot);
+		parentHandles.push_back(parent);
+		locals.push_back(local);
+		worlds.push_back(local);
+		normals.push_back(glm::mat3(1.0f));
+		parents.push_back(parent >= 0 ? slotOf[parent] : -1);
+		firstChild.push_back(0);
+		childCount.push_back(0);
+		dirty.push_back(1);
+		dirtyNodes.push_back(handle);
+		unsorted = true;
+		return handle;
+	}
+
+	void SetLocal(int node, const glm::mat4& local)
+	{
+		int slot = slotOf[node];
+		locals[slot] = local;
+		if (!dirty[slot]) {
+			dirty[slot] = 1;
+			dirtyNodes.push_back(node);
+		}
+	}
+
+	const glm::mat4& Local(int node) const { return locals[slotOf[node]]; }
+
+	//World matrix and normal matrix (inverse transpose, see Mesh::GetNormalMatrix) as of the last Update
+	const glm::mat4& World(int node) const { return worlds[slotOf[node]]; }
+	const glm::mat3& Normal(int node) const { return normals[slotOf[node]]; }
+
+	int Parent(int node) const { return parentHandles[node]; }
+
+	size_t Size() const { return locals.size(); }
+
+	//Recomputes the matrices of the flagged nodes and their subtrees. Returns the number of nodes recomputed
+	size_t Update()
+	{
+		if (unsorted) {
+			Sort();
+		}
+
+		size_t updated = 0;
+		for (int handle : dirtyNodes) {
+			int slot = slotOf[handle];
+			if (!dirty[slot]) {
+				continue;
+			}
+
+			//A flagged ancestor recomputes this subtree with its own
+			bool covered = false;
+			for (int parent = parents[slot]; parent >= 0 && !covered; parent = parents[parent]) {
+				covered = dirty[parent] != 0;
+			}
+			if (!covered) {
+				updated += UpdateSubtree(slot);
+			}
+		}
+		dirtyNodes.clear();
+		UpdatedLastFrame = updated;
+		return updated;
+	}
+
+	//Recomputes every node in one pass over the arrays (parents come first), whatever is flagged
+	size_t UpdateAll()
+	{
+		if (unsorted) {
+			Sort();
+		}
+
+		for (size_t slot = 0; slot < locals.size(); slot++) {
+			ComputeNode(static_cast<int>(slot));
+		}
+		dirtyNodes.clear();
+		UpdatedLastFrame = locals.size();
+		return locals.size();
+	}
+
+private:
+	//Per slot (breadth first order)
+	vector<glm::mat4> locals;
+	vector<glm::mat4> worlds;
+	vector<glm::mat3> normals;
+	vector<int> parents;
+	vector<int> firstChild;
+	vector<int> childCount;
+	vector<uint8_t> dirty;
+
+	//Per handle
+	vector<int> slotOf;
+	vector<int> parentHandles;
+
+	//Handles flagged since the last Update, in the order they were flagged
+	vector<int> dirtyNodes;
+	vector<int> stack;
+	bool unsorted = false;
+
+	void ComputeNode(int slot)
+	{
+		int parent = parents[slot];
+		worlds[slot] = parent >= 0 ? worlds[parent] * locals[slot] : locals[slot];
+		normals[slot] = glm::transpose(glm::inverse(glm::mat3(worlds[slot])));
+		dirty[slot] = 0;
+	}
+
+	size_t UpdateSubtree(int root)
+	{
+		size_t updated = 0;
+		stack.push_back(root);
+		while (!stack.empty()) {
+			int slot = stack.back();
+			stack.pop_back();
+			ComputeNode(slot);
+			updated++;
+			for (int child = firstChild[slot] + childCount[slot] - 1; child >= firstChild[slot]; child--) {
+				stack.push_back(child);
+			}
+		}
+		return updated;
+	}
+
+	//Reorders the arrays breadth first after nodes were added: the roots in the order they were added, then the children of
+	//each node in turn, so every level of the hierarchy and every group of siblings is contiguous
+	void Sort()
+	{
+		size_t count = locals.size();
+
+		//Children of every handle, in the order they were added
+		vector<int> childStart(count + 1, 0);
+		for (int parent : parentHandles) {
+			if (parent >= 0) {
+				childStart[parent + 1]++;
+			}
+		}
+		for (size_t i = 0; i < count; i++) {
+			childStart[i + 1] += childStart[i];
+		}
+		vector<int> children(childStart[count]);
+		vector<int> filled(childStart.begin(), childStart.end() - 1);
+		for (size_t handle = 0; handle < count; handle++) {
+			if (parentHandles[handle] >= 0) {
+				children[filled[parentHandles[handle]]++] = static_cast<int>(handle);
+			}
+		}
+
+		vector<int> order;
+		order.reserve(count);
+		for (size_t handle = 0; handle < count; handle++) {
+			if (parentHandles[handle] < 0) {
+				order.push_back(static_cast<int>(handle));
+			}
+		}
+		vector<int> newFirstChild(count), newChildCount(count);
+		for (size_t i = 0; i < order.size(); i++) {
+			int handle = order[i];
+			newFirstChild[i] = static_cast<int>(order.size());
+			newChildCount[i] = childStart[handle + 1] - childStart[handle];
+			order.insert(order.end(), children.begin() + childStart[handle], children.begin() + childStart[handle + 1]);
+		}
+
+		vector<glm::mat4> newLocals(count), newWorlds(count);
+		vector<glm::mat3> newNormals(count);
+		vector<uint8_t> newDirty(count);
+		vector<int> newParents(count);
+		for (size_t slot = 0; slot < count; slot++) {
+			int oldSlot = slotOf[order[slot]];
+			newLocals[slot] = locals[oldSlot];
+			newWorlds[slot] = worlds[oldSlot];
+			newNormals[slot] = normals[oldSlot];
+			newDirty[slot] = dirty[oldSlot];
+		}
+		for (size_t slot = 0; slot < count; slot++) {
+			slotOf[order[slot]] = static_cast<int>(slot);
+		}
+		for (size_t slot = 0; slot < count; slot++) {
+			int parent = parentHandles[order[slot]];
+			newParents[slot] = parent >= 0 ? slotOf[parent] : -1;
+		}
+
+		locals.swap(newLocals);
+		worlds.swap(newWorlds);
+		normals.swap(newNormals);
+		dirty.swap(newDirty);
+		parents.swap(newParents);
+		firstChild.swap(newFirstChild);
+		childCount.swap(newChildCount);
+		unsorted = false;
+	}
+};
+
+#endif
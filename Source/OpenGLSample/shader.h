@@ -7,6 +7,8 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include "programcache.h"
+#include "assetpack.h"
 
 //GLM Libs
 #include <glm/glm.hpp>
@@ -17,66 +19,93 @@ class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly, or loads the linked program from the ProgramCache
+    // defines (e.g. "#define USE_SHADOWS\n") are inserted after the #version line of both stages
+    // deferred only submits the compile and link, the status checks wait for Finish (or the first use) so the
+    // driver can build several programs, on its own threads with KHR_parallel_shader_compile, while the caller loads other assets
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "", bool deferred = false)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
+        // 1. retrieve the vertex/fragment source code, from the asset pack if one is mounted, else from filePath
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
-        }
-        catch (std::ifstream::failure& e)
-        {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
-        }
+        std::vector<char> scratch;
+        AssetView file;
+        if (AssetPack::Load(vertexPath, scratch, file))
+            vertexCode.assign(file.Data, file.Size);
+        else
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << vertexPath << std::endl;
+        if (AssetPack::Load(fragmentPath, scratch, file))
+            fragmentCode.assign(file.Data, file.Size);
+        else
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << fragmentPath << std::endl;
+        vertexCode = insertDefines(vertexCode, defines);
+        fragmentCode = insertDefines(fragmentCode, defines);
+        // try the cached binary first, it skips compiling and linking entirely
+        ID = glCreateProgram();
+        cacheKey = ProgramCache::Key(vertexCode, fragmentCode, defines);
+        if (ProgramCache::Load(cacheKey, ID))
+            return;
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
+        // 2. compile shaders, no status queries in between so nothing waits on the driver
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
         // shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        ProgramCache::PrepareForLink(ID);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        pending = true;
+        // 3. check the results
+        if (!deferred)
+            Finish();
+    }
+    // true if Finish would not have to wait for the driver. Without KHR_parallel_shader_compile there is no way
+    // to ask, so it is always true and Finish may still wait
+    // ------------------------------------------------------------------------
+    bool IsReady() const
+    {
+        if (!pending || !GLExtensions::ParallelShaderCompile)
+            return true;
+        int done = 0;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done != 0;
+    }
+    // checks the compile and link status of a deferred build and stores the binary in the ProgramCache,
+    // returns true if the program linked. Called by use() if it was not called before
+    // ------------------------------------------------------------------------
+    bool Finish()
+    {
+        if (!pending)
+            return linked;
+        pending = false;
+        checkCompileErrors(vertex, "VERTEX");
+        checkCompileErrors(fragment, "FRAGMENT");
+        linked = checkCompileErrors(ID, "PROGRAM");
+        if (linked)
+            ProgramCache::Store(cacheKey, ID);
+        glDetachShader(ID, vertex);
+        glDetachShader(ID, fragment);
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+        vertex = 0;
+        fragment = 0;
+        return linked;
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
+        if (pending)
+            Finish();
         glUseProgram(ID);
     }
     // utility uniform functions
@@ -96,11 +125,16 @@ public:
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string& name, glm::mat4 &mat) const
+    void setMat4(const std::string& name, const glm::mat4 &mat) const
     {
         glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
+    void setMat3(const std::string& name, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3 &value) const
     {
         glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
@@ -109,11 +143,35 @@ public:
     {
         glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
     }
+    void setVec4(const std::string& name, const glm::vec4 &value) const
+    {
+        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    }
 
 private:
-    // utility function for checking shader compilation/linking errors.
+    // state of a build that has not been checked yet
+    unsigned int vertex = 0;
+    unsigned int fragment = 0;
+    uint64_t cacheKey = 0;
+    bool pending = false;
+    bool linked = true;
+    // puts the defines on the line after #version (which has to stay first), or at the top if there is none
+    // ------------------------------------------------------------------------
+    static std::string insertDefines(const std::string& source, const std::string& defines)
+    {
+        if (defines.empty())
+            return source;
+        size_t version = source.find("#version");
+        if (version == std::string::npos)
+            return defines + "\n" + source;
+        size_t lineEnd = source.find('\n', version);
+        if (lineEnd == std::string::npos)
+            return source + "\n" + defines + "\n";
+        return source.substr(0, lineEnd + 1) + defines + "\n" + source.substr(lineEnd + 1);
+    }
+    // utility function for checking shader compilation/linking errors, returns true on success.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(unsigned int shader, std::string type)
+    bool checkCompileErrors(unsigned int shader, std::string type)
     {
         int success;
         char infoLog[1024];
@@ -135,6 +193,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success != 0;
     }
 };
 #endif
\ No newline at end of file
@@ -69,19 +69,34 @@ uniform PointLight pointLights[NR_POINT_LIGHTS];
 
 uniform SpotLight spotLight;
 
+//Texture array path (indirect renderer): every material's maps are layers of one array, the draw picks its material
+#define MAX_MATERIALS 32
+uniform bool useMaterialArray;
+uniform sampler2DArray materialTextures;
+uniform vec4 materialLayers[MAX_MATERIALS]; //Layer of the diffuse, specular, overlay diffuse and overlay specular map, -1 if none
+uniform float materialShininess[MAX_MATERIALS];
+flat in int MaterialIndex;
+
 //Prototypes
+void SampleSurface();
 vec3 CalculateDirectionalLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 vec2 overlayTexCoord; //Coordinates for overlay texuture
 
+//Material colors at this fragment, shared by every light
+vec3 surfaceDiffuse;
+vec3 surfaceSpecular;
+float surfaceShininess;
+
 void main(){
     //properties
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPosition);
     vec3 result;
     overlayTexCoord = vec2(TexCoords.x * 2.0, TexCoords.y); //for halfing the overlay to prevent overstrecthing
+    SampleSurface();
 
     //Phase 1: Directional Light
     if(dirLight.useDirectionalLight){
@@ -103,40 +118,63 @@ void main(){
 
 //Helper Functions
 
-//Calculate the directional light's impact on the fragment
-vec3 CalculateDirectionalLight(DirLight light, vec3 normal, vec3 viewDir)
+//Samples the material (with its overlay) into the surface colors
+void SampleSurface()
 {
-    vec3 lightDir = normalize(-light.direction); //Normalized vector of the light direction (lights Pos - fragments pos)
-
-    //Diffuse
-    float diff = max(dot(normal, lightDir), 0.0); //Get the dot product of the normals/light dir, and ensure it never goes negative (if over 90 deg, it will go negative)
+    if (useMaterialArray) {
+        vec4 layers = materialLayers[MaterialIndex];
+        surfaceShininess = materialShininess[MaterialIndex];
+
+        if (layers.z >= 0.0 || layers.w >= 0.0) {
+            //The overlays do not repeat on U, clamp to the edge texels since the array repeats
+            float halfTexel = 0.5 / float(textureSize(materialTextures, 0).x);
+            vec2 labelCoord = vec2(clamp(overlayTexCoord.x, halfTexel, 1.0 - halfTexel), overlayTexCoord.y);
+            vec4 overlayDiffuseColor = (layers.z >= 0.0) ? texture(materialTextures, vec3(labelCoord, layers.z)) : vec4(0.0);
+            vec4 overlaySpecularColor = (layers.w >= 0.0) ? texture(materialTextures, vec3(labelCoord, layers.w)) : vec4(0.0);
+            surfaceDiffuse = mix(texture(materialTextures, vec3(overlayTexCoord, layers.x)).rgb, overlayDiffuseColor.rgb, overlayDiffuseColor.a);
+            surfaceSpecular = mix(texture(materialTextures, vec3(overlayTexCoord, layers.y)).rgb, overlaySpecularColor.rgb, overlaySpecularColor.a);
+        }
+        else {
+            surfaceDiffuse = texture(materialTextures, vec3(TexCoords, layers.x)).rgb;
+            surfaceSpecular = texture(materialTextures, vec3(TexCoords, layers.y)).rgb;
+        }
+        return;
+    }
 
-    //Specular
-    vec3 reflectDir = reflect(-lightDir, normal); //reflect the light in the opposite direction it hit the normal from.
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess); //Get the dot product of the view/reflect, and ensure its not negative. Then raise to the power of material's shininess.
-
-    vec3 ambient; 
-    vec3 diffuse;
-    vec3 specular;
+    surfaceShininess = material.shininess;
 
     // Check if the overlayDiffuse texture is used
-    vec4 overlayDiffuseColor = vec4(1.0);
-    vec4 overlaySpecularColor = vec4(1.0);
     if (material.useOverlayTexture) {
-        overlayDiffuseColor = texture(material.overlayDiffuse, overlayTexCoord);
-        overlaySpecularColor = texture(material.overlaySpecular, overlayTexCoord);
+        vec4 overlayDiffuseColor = texture(material.overlayDiffuse, overlayTexCoord);
+        vec4 overlaySpecularColor = texture(material.overlaySpecular, overlayTexCoord);
 
         // Combine the results with the overlay
-        ambient = light.ambient * mix(texture(material.diffuse, overlayTexCoord).rgb, overlayDiffuseColor.rgb, overlayDiffuseColor.a);
-        diffuse = light.diffuse * diff * mix(texture(material.diffuse, overlayTexCoord).rgb, overlayDiffuseColor.rgb, overlayDiffuseColor.a);
-        specular = light.specular * spec * mix(texture(material.specular, overlayTexCoord).rgb, overlaySpecularColor.rgb, overlaySpecularColor.a);
+        surfaceDiffuse = mix(texture(material.diffuse, overlayTexCoord).rgb, overlayDiffuseColor.rgb, overlayDiffuseColor.a);
+        surfaceSpecular = mix(texture(material.specular, overlayTexCoord).rgb, overlaySpecularColor.rgb, overlaySpecularColor.a);
     }
     else {
         // Combine the results without the overlay
-        ambient = light.ambient * texture(material.diffuse, TexCoords).rgb;
-        diffuse = light.diffuse * diff * texture(material.diffuse, TexCoords).rgb;
-        specular = light.specular * spec * texture(material.specular, TexCoords).rgb;
+        surfaceDiffuse = texture(material.diffuse, TexCoords).rgb;
+        surfaceSpecular = texture(material.specular, TexCoords).rgb;
     }
+}
+
+//Calculate the directional light's impact on the fragment
+vec3 CalculateDirectionalLight(DirLight light, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction); //Normalized vector of the light direction (lights Pos - fragments pos)
+
+    //Diffuse
+    float diff = max(dot(normal, lightDir), 0.0); //Get the dot product of the normals/light dir, and ensure it never goes negative (if over 90 deg, it will go negative)
+
+    //Specular
+    vec3 reflectDir = reflect(-lightDir, normal); //reflect the light in the opposite direction it hit the normal from.
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surfaceShininess); //Get the dot product of the view/reflect, and ensure its not negative. Then raise to the power of material's shininess.
+
+    //Surface colors were sampled once in SampleSurface
+    vec3 ambient = light.ambient * surfaceDiffuse;
+    vec3 diffuse = light.diffuse * diff * surfaceDiffuse;
+    vec3 specular = light.specular * spec * surfaceSpecular;
 
     return (ambient + diffuse + specular);
 }
@@ -151,34 +189,16 @@ vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewD
 
     //Specular
     vec3 reflectDir = reflect(-lightDir, normal); //reflect the light in the opposite direction it hit the normal from.
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess); //Get the dot product of the view/reflect, and ensure its not negative. Then raise to the power of material's shininess.
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surfaceShininess); //Get the dot product of the view/reflect, and ensure its not negative. Then raise to the power of material's shininess.
 
     //Attenuation - Light intensity fall off for spot/area lights
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance)); //F-att = 1.0 / Kc + (Kl * d) + Kq * d^2
 
-    vec3 ambient; 
-    vec3 diffuse;
-    vec3 specular;
-
-    // Check if the overlayDiffuse texture is used
-    vec4 overlayDiffuseColor = vec4(1.0);
-    vec4 overlaySpecularColor = vec4(1.0);
-    if (material.useOverlayTexture) {
-        overlayDiffuseColor = texture(material.overlayDiffuse, overlayTexCoord);
-        overlaySpecularColor = texture(material.overlaySpecular, overlayTexCoord);
-
-        // Combine the results with the overlay
-        ambient = light.ambient * mix(texture(material.diffuse, overlayTexCoord).rgb, overlayDiffuseColor.rgb, overlayDiffuseColor.a);
-        diffuse = light.diffuse * diff * mix(texture(material.diffuse, overlayTexCoord).rgb, overlayDiffuseColor.rgb, overlayDiffuseColor.a);
-        specular = light.specular * spec * mix(texture(material.specular, overlayTexCoord).rgb, overlaySpecularColor.rgb, overlaySpecularColor.a);
-    }
-    else {
-        // Combine the results without the overlay
-        ambient = light.ambient * texture(material.diffuse, TexCoords).rgb;
-        diffuse = light.diffuse * diff * texture(material.diffuse, TexCoords).rgb;
-        specular = light.specular * spec * texture(material.specular, TexCoords).rgb;
-    }
+    //Surface colors were sampled once in SampleSurface
+    vec3 ambient = light.ambient * surfaceDiffuse;
+    vec3 diffuse = light.diffuse * diff * surfaceDiffuse;
+    vec3 specular = light.specular * spec * surfaceSpecular;
 
     // Multiply the attenuation for all components
     ambient *= attenuation;
@@ -198,7 +218,7 @@ vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir
 
     //Specular
     vec3 reflectDir = reflect(-lightDir, normal); //reflect the light in the opposite direction it hit the normal from.
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess); //Get the dot product of the view/reflect, and ensure its not negative. Then raise to the power of material's shininess.
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), surfaceShininess); //Get the dot product of the view/reflect, and ensure its not negative. Then raise to the power of material's shininess.
 
     //Attenuation - Light intensity fall off for spot/area lights
     float distance = length(light.position - fragPos);
@@ -210,28 +230,10 @@ vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
 
-    vec3 ambient; 
-    vec3 diffuse;
-    vec3 specular;
-
-    // Check if the overlayDiffuse texture is used
-    vec4 overlayDiffuseColor = vec4(1.0);
-    vec4 overlaySpecularColor = vec4(1.0);
-    if (material.useOverlayTexture) {
-        overlayDiffuseColor = texture(material.overlayDiffuse, overlayTexCoord);
-        overlaySpecularColor = texture(material.overlaySpecular, overlayTexCoord);
-
-        // Combine the results with the overlay
-        ambient = light.ambient * mix(texture(material.diffuse, overlayTexCoord).rgb, overlayDiffuseColor.rgb, overlayDiffuseColor.a);
-        diffuse = light.diffuse * diff * mix(texture(material.diffuse, overlayTexCoord).rgb, overlayDiffuseColor.rgb, overlayDiffuseColor.a);
-        specular = light.specular * spec * mix(texture(material.specular, overlayTexCoord).rgb, overlaySpecularColor.rgb, overlaySpecularColor.a);
-    }
-    else {
-        // Combine the results without the overlay
-        ambient = light.ambient * texture(material.diffuse, TexCoords).rgb;
-        diffuse = light.diffuse * diff * texture(material.diffuse, TexCoords).rgb;
-        specular = light.specular * spec * texture(material.specular, TexCoords).rgb;
-    }
+    //Surface colors were sampled once in SampleSurface
+    vec3 ambient = light.ambient * surfaceDiffuse;
+    vec3 diffuse = light.diffuse * diff * surfaceDiffuse;
+    vec3 specular = light.specular * spec * surfaceSpecular;
 
     //Combine the attenuation * intensity to the components
     ambient  *= attenuation * intensity;
@@ -0,0 +1,301 @@
+#ifndef SHAREDASSETCACHE_H
+#define SHAREDASSETCACHE_H
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <new>
+#include <iostream>
+#include "assetpack.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#endif
+
+//Decoded asset payloads (texture pixels with their mips, finished meshes) shared between the viewers running on one host,
+//in a named shared memory segment: POSIX shared memory, or a pagefile-backed file mapping on Windows.
+//The first process to open the name creates the segment and is its only writer, every payload it decodes is published
+//there. Processes started later map the segment read-only and use the payloads in place, so they skip the decoding and
+//the pixels exist once in host RAM instead of once per process.
+//The index is a fixed open addressing table of 64 bit keys. A writer thread claims a slot with a compare-and-swap on its
+//key, bump allocates the payload, copies it in and then publishes the slot with a release store of its state; readers only
+//use slots whose state they see published (acquire). There are no locks, so the decoding threads of the writer and any
+//number of reader processes use it at once. Entries are never removed; a full segment just stops taking new ones.
+//On POSIX the segment outlives the processes (delete it with Remove), on Windows it goes with the last process using it.
+class SharedAssetCache
+{
+public:
+	//Segment of the running viewer, nullptr when the cache is not in use
+	static inline SharedAssetCache* Mounted = nullptr;
+
+	//Payloads found in the segment and looked up but missing, since the last reset
+	static inline std::atomic<unsigned int> Hits{ 0 };
+	static inline std::atomic<unsigned int> Misses{ 0 };
+
+	//Version of the segment layout and of the payload formats stored in it
+	static const uint32_t FormatVersion = 1;
+
+	SharedAssetCache() {}
+	~SharedAssetCache() { Close(); }
+
+	SharedAssetCache(const SharedAssetCache&) = delete;
+	SharedAssetCache& operator=(const SharedAssetCache&) = delete;
+
+	//Creates the segment (capacity bytes, the index included) and becomes its writer, or maps the existing one read-only.
+	//Returns false if shared memory is not available or the existing segment is from another version or still being set up
+	bool Open(const std::string& name, size_t capacity = 512 * 1024 * 1024)
+	{
+		Close();
+		uint32_t slotCount = 4096;
+		while (slotCount < capacity / (64 * 1024)) {
+			slotCount *= 2;
+		}
+		size_t dataStart = (sizeof(SegmentHeader) + slotCount * sizeof(Slot) + 4095) & ~static_cast<size_t>(4095);
+		if (capacity <= dataStart) {
+			return false;
+		}
+
+#ifdef _WIN32
+		std::string mappingName = "Local\\" + name;
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(capacity) >> 32),
+			static_cast<DWORD>(capacity & 0xFFFFFFFF), mappingName.c_str());
+		if (!mapping) {
+			return false;
+		}
+		writer = GetLastError() != ERROR_ALREADY_EXISTS;
+		base = static_cast<char*>(MapViewOfFile(mapping, writer ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0));
+		MEMORY_BASIC_INFORMATION region;
+		size = (base && VirtualQuery(base, &region, sizeof(region))) ? region.RegionSize : 0;
+#else
+		std::string segmentName = "/" + name;
+		int file = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+		writer = file >= 0;
+		if (writer && ftruncate(file, static_cast<off_t>(capacity)) != 0) {
+			close(file);
+			shm_unlink(segmentName.c_str());
+			return false;
+		}
+		if (!writer) {
+			if (errno != EEXIST) {
+				return false;
+			}
+			file = shm_open(segmentName.c_str(), O_RDONLY, 0);
+		}
+		struct stat status;
+		if (file < 0 || fstat(file, &status) != 0) {
+			if (file >= 0) {
+				close(file);
+			}
+			return false;
+		}
+		size = static_cast<size_t>(status.st_size);
+		void* view = mmap(nullptr, size, writer ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+		close(file);
+		base = (view == MAP_FAILED) ? nullptr : static_cast<char*>(view);
+#endif
+		if (!base || size < dataStart) {
+			Close();
+			return false;
+		}
+
+		if (writer) {
+			//The new segment is zero filled, construct the header and the empty slots and announce it last
+			SegmentHeader* header = new (base) SegmentHeader();
+			header->Magic = Magic;
+			header->Version = FormatVersion;
+			header->Size = size;
+			header->SlotCount = slotCount;
+			header->DataStart = dataStart;
+			header->DataUsed.store(dataStart);
+			for (uint32_t i = 0; i < slotCount; i++) {
+				new (base + sizeof(SegmentHeader) + i * sizeof(Slot)) Slot();
+			}
+			header->Ready.store(1, std::memory_order_release);
+			return true;
+		}
+
+		//An existing segment is only used if it is complete and the same layout, anything else is left alone
+		const SegmentHeader* header = Header();
+		if (header->Ready.load(std::memory_order_acquire) != 1 || header->Magic != Magic || header->Version != FormatVersion
+			|| header->Size != size || header->DataStart > size
+			|| sizeof(SegmentHeader) + static_cast<size_t>(header->SlotCount) * sizeof(Slot) > header->DataStart
+			|| header->SlotCount == 0 || (header->SlotCount & (header->SlotCount - 1)) != 0) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (base) {
+			UnmapViewOfFile(base);
+		}
+		if (mapping) {
+			CloseHandle(mapping);
+		}
+		mapping = NULL;
+#else
+		if (base) {
+			munmap(base, size);
+		}
+#endif
+		base = nullptr;
+		size = 0;
+		writer = false;
+	}
+
+	bool IsOpen() const { return base != nullptr; }
+
+	//True for the process that created the segment, the only one that publishes
+	bool IsWriter() const { return writer; }
+
+	//Bytes of payload data in use and available
+	size_t UsedBytes() const { return IsOpen() ? static_cast<size_t>(std::min<uint64_t>(Header()->DataUsed.load(), size)) - Header()->DataStart : 0; }
+	size_t CapacityBytes() const { return IsOpen() ? size - Header()->DataStart : 0; }
+
+	//Deletes a POSIX segment so the next viewer creates a fresh one (processes that have it mapped keep their mapping)
+	static void Remove(const std::string& name)
+	{
+#ifndef _WIN32
+		shm_unlink(("/" + name).c_str());
+#endif
+	}
+
+	//Key of a payload: a hash of the source bytes (the image file, the mesh parameters) and of how it was decoded.
+	//Never 0, that marks an empty slot
+	static uint64_t Key(const void* data, size_t size, uint64_t variant)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		for (int i = 0; i < 8; i++) {
+			hash = (hash ^ ((variant >> (i * 8)) & 0xFF)) * 1099511628211ull;
+		}
+		return hash ? hash : 1;
+	}
+
+	//The published payload of key, valid while the segment is open. False if there is none (or it is still being written)
+	bool Find(uint64_t key, AssetView& view) const
+	{
+		if (!IsOpen()) {
+			return false;
+		}
+
+		const SegmentHeader* header = Header();
+		uint32_t mask = header->SlotCount - 1;
+		for (uint32_t probe = 0, slot = static_cast<uint32_t>(key) & mask; probe <= mask; probe++, slot = (slot + 1) & mask) {
+			const Slot& entry = Slots()[slot];
+			uint64_t slotKey = entry.Key.load(std::memory_order_acquire);
+			if (slotKey == 0) {
+				break;
+			}
+			if (slotKey != key) {
+				continue;
+			}
+			if (entry.State.load(std::memory_order_acquire) != SLOT_PUBLISHED || entry.Offset < header->DataStart
+				|| entry.Offset > size || entry.Size > size - entry.Offset) {
+				break;
+			}
+			view.Data = base + entry.Offset;
+			view.Size = static_cast<size_t>(entry.Size);
+			Hits++;
+			return true;
+		}
+		Misses++;
+		return false;
+	}
+
+	//Publishes size bytes under key, write(destination) fills them. Only the writer publishes; returns false if this is a
+	//reader, the key is already there or being written, or the segment is full. Safe to call from several threads
+	template<typename Writer>
+	bool Publish(uint64_t key, size_t size, Writer write)
+	{
+		if (!writer) {
+			return false;
+		}
+
+		SegmentHeader* header = Header();
+		uint64_t bytes = (static_cast<uint64_t>(size) + 63) & ~static_cast<uint64_t>(63);
+		uint32_t mask = header->SlotCount - 1;
+		Slot* entry = nullptr;
+		for (uint32_t probe = 0, slot = static_cast<uint32_t>(key) & mask; probe <= mask; probe++, slot = (slot + 1) & mask) {
+			uint64_t expected = 0;
+			Slot& candidate = Slots()[slot];
+			if (candidate.Key.compare_exchange_strong(expected, key, std::memory_order_acq_rel)) {
+				entry = &candidate;
+				break;
+			}
+			if (expected == key) {
+				return false;
+			}
+		}
+		if (!entry) {
+			return false;
+		}
+
+		//A claimed slot that does not fit stays unpublished, readers treat it as missing
+		uint64_t offset = header->DataUsed.fetch_add(bytes);
+		if (offset + bytes > this->size) {
+			return false;
+		}
+		write(base + offset);
+		entry->Offset = offset;
+		entry->Size = size;
+		entry->State.store(SLOT_PUBLISHED, std::memory_order_release);
+		return true;
+	}
+
+	//Prints the segment's use and this process's hits
+	void PrintStats() const
+	{
+		std::cout << "SHAREDCACHE::" << (writer ? "WRITER " : "READER ") << UsedBytes() / 1024 << "/" << CapacityBytes() / 1024 << " KB, "
+			<< Hits << " HITS " << Misses << " MISSES" << std::endl;
+	}
+
+private:
+	//"GLSC"
+	static const uint32_t Magic = 0x43534C47;
+	static const uint32_t SLOT_PUBLISHED = 1;
+
+	static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+		"The index needs address free atomics to work across processes");
+
+	//Segment layout: SegmentHeader, SlotCount slots, then the payloads from DataStart (64 byte aligned)
+	struct SegmentHeader
+	{
+		uint32_t Magic = 0;
+		uint32_t Version = 0;
+		uint64_t Size = 0;
+		uint64_t DataStart = 0;
+		uint32_t SlotCount = 0;
+		std::atomic<uint32_t> Ready{ 0 };
+		std::atomic<uint64_t> DataUsed{ 0 };
+		char Reserved[24] = {};
+	};
+
+	struct Slot
+	{
+		std::atomic<uint64_t> Key{ 0 };
+		std::atomic<uint32_t> State{ 0 };
+		uint32_t Reserved = 0;
+		uint64_t Offset = 0;
+		uint64_t Size = 0;
+	};
+
+	char* base = nullptr;
+	size_t size = 0;
+	bool writer = false;
+#ifdef _WIN32
+	HANDLE mapping = NULL;
+#endif
+
+	SegmentHeader* Header() const { return reinterpret_cast<SegmentHeader*>(base); }
+	Slot* Slots() const { return reinterpret_cast<Slot*>(base + sizeof(SegmentHeader)); }
+};
+
+#endif
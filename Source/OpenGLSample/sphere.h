@@ -3,13 +3,21 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include <vector>
 #include <random>
+#include <utility>
 #include "Mesh.h"
 
 using namespace std;
 
+//Tessellation modes for the sphere
+enum SphereTessellation {
+	UV_SPHERE,        //Latitude/Longitude grid, triangles bunch up at the poles
+	GEODESIC_SPHERE   //Subdivided icosahedron, semi circles are clipped at the equator
+};
+
 class Sphere : public Mesh
 {
 public:
@@ -21,8 +29,11 @@ public:
 	int SubDivisions;
 	bool SemiCircle;
 
+	SphereTessellation Tessellation;
+	int GeodesicLevel;
+
 	//Constructor - Uniform Sphere.
-	Sphere(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float radius = 1.0f, int sides = 8, bool semiCircle = false)
+	Sphere(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float radius = 1.0f, int sides = 8, bool semiCircle = false, SphereTessellation tessellation = UV_SPHERE)
 	{
 		Position = position;
 
@@ -35,15 +46,23 @@ public:
 		SideCount = sides;
 		SubDivisions = sides;
 
+		Tessellation = tessellation;
+		GeodesicLevel = GeodesicLevelForSides(sides);
+
 		//Calculate the vertices
-		CalculateVertices();
+		if (Tessellation == GEODESIC_SPHERE) {
+			CalculateGeodesicVertices();
+		}
+		else {
+			CalculateVertices();
+		}
 
 		//Generate the VAO/VBO
 		GenerateVertexArrayAndBuffer();
 	}
 
 	//Constructor - Allows for differing longitude and latitude radius
-	Sphere(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float radiusLong = 1.0f, float radiusLat = 1.0f, int sides = 8, bool semiCircle = false)
+	Sphere(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float radiusLong = 1.0f, float radiusLat = 1.0f, int sides = 8, bool semiCircle = false, SphereTessellation tessellation = UV_SPHERE)
 	{
 		Position = position;
 
@@ -56,13 +75,82 @@ public:
 		SideCount = sides;
 		SubDivisions = sides;
 
+		Tessellation = tessellation;
+		GeodesicLevel = GeodesicLevelForSides(sides);
+
 		//Calculate the vertices
-		CalculateVertices();
+		if (Tessellation == GEODESIC_SPHERE) {
+			CalculateGeodesicVertices();
+		}
+		else {
+			CalculateVertices();
+		}
 
 		//Generate the VAO/VBO
 		GenerateVertexArrayAndBuffer();
 	}
 
+	//Returns the geodesic subdivision level whose edges are no longer than the UV sphere's equator edges for the same side count
+	static int GeodesicLevelForSides(int sides)
+	{
+		//Central angle of an icosahedron edge (~63.4 degrees)
+		float baseAngle = 1.10714872f;
+		float targetAngle = static_cast<float>(2.0f * M_PI) / (sides < 3 ? 3 : sides);
+
+		int level = 0;
+		while (baseAngle > targetAngle && level < 6) {
+			baseAngle *= 0.5f;
+			level++;
+		}
+
+		return level;
+	}
+
+	//Returns the largest radial distance between the generated triangles and the true (ellipsoid) surface, which is what shows up on the silhouette
+	float CalculateSilhouetteError(int samplesPerEdge = 8)
+	{
+		float maxError = 0.0f;
+		int triangleCount = GetTriangleCount();
+
+		for (int t = 0; t < triangleCount; t++) {
+			glm::vec3 corners[3];
+			for (int c = 0; c < 3; c++) {
+				corners[c] = GetTriangleCorner(t, c);
+			}
+
+			//Skip the flat cap, it is not part of the curved surface
+			if (SemiCircle && corners[0].y == Position.y && corners[1].y == Position.y && corners[2].y == Position.y) {
+				continue;
+			}
+
+			//Walk a barycentric grid across the triangle
+			for (int i = 0; i <= samplesPerEdge; i++) {
+				for (int j = 0; j <= samplesPerEdge - i; j++) {
+					float b1 = static_cast<float>(i) / samplesPerEdge;
+					float b2 = static_cast<float>(j) / samplesPerEdge;
+					glm::vec3 point = corners[0] + (corners[1] - corners[0]) * b1 + (corners[2] - corners[0]) * b2;
+
+					//Bring the point back into unit sphere space, measure, then scale the error back by the local radius
+					glm::vec3 local = point - Position;
+					glm::vec3 unit = glm::vec3(local.x / RadiusLong, local.y / RadiusLat, local.z / RadiusLong);
+					float length = glm::length(unit);
+					if (length <= 0.0f) {
+						continue;
+					}
+
+					glm::vec3 surface = unit / length;
+					glm::vec3 surfacePoint = glm::vec3(surface.x * RadiusLong, surface.y * RadiusLat, surface.z * RadiusLong);
+					float error = glm::length(surfacePoint - local);
+					if (error > maxError) {
+						maxError = error;
+					}
+				}
+			}
+		}
+
+		return maxError;
+	}
+
 private:
 
 	//Calculates the vertices that make up the plane
@@ -149,6 +237,201 @@ private:
 		}
 	}
 
+	//Calculates the vertices for the geodesic mode. Each icosahedron face is split into a (2^level) triangle grid and pushed out onto the sphere
+	void CalculateGeodesicVertices() {
+		glm::vec3 vertColor = glm::vec3(1.0f);
+		int frequency = 1 << GeodesicLevel;
+
+		//Icosahedron
+		float t = (1.0f + sqrt(5.0f)) / 2.0f;
+		glm::vec3 baseVerts[12] = {
+			glm::vec3(-1.0f,  t, 0.0f), glm::vec3( 1.0f,  t, 0.0f), glm::vec3(-1.0f, -t, 0.0f), glm::vec3( 1.0f, -t, 0.0f),
+			glm::vec3(0.0f, -1.0f,  t), glm::vec3(0.0f,  1.0f,  t), glm::vec3(0.0f, -1.0f, -t), glm::vec3(0.0f,  1.0f, -t),
+			glm::vec3( t, 0.0f, -1.0f), glm::vec3( t, 0.0f,  1.0f), glm::vec3(-t, 0.0f, -1.0f), glm::vec3(-t, 0.0f,  1.0f)
+		};
+		glm::ivec3 baseFaces[20] = {
+			glm::ivec3(0, 11, 5), glm::ivec3(0, 5, 1),  glm::ivec3(0, 1, 7),   glm::ivec3(0, 7, 10), glm::ivec3(0, 10, 11),
+			glm::ivec3(1, 5, 9),  glm::ivec3(5, 11, 4), glm::ivec3(11, 10, 2), glm::ivec3(10, 7, 6), glm::ivec3(7, 1, 8),
+			glm::ivec3(3, 9, 4),  glm::ivec3(3, 4, 2),  glm::ivec3(3, 2, 6),   glm::ivec3(3, 6, 8),  glm::ivec3(3, 8, 9),
+			glm::ivec3(4, 9, 5),  glm::ivec3(2, 4, 11), glm::ivec3(6, 2, 10),  glm::ivec3(8, 6, 7),  glm::ivec3(9, 8, 1)
+		};
+
+		//Tilt so vertex 0 sits on the north pole, this keeps the poles in the same place as the UV sphere
+		glm::vec3 pole = glm::normalize(baseVerts[0]);
+		glm::vec3 axis = glm::normalize(glm::cross(pole, glm::vec3(0.0f, 1.0f, 0.0f)));
+		float angle = acos(glm::dot(pole, glm::vec3(0.0f, 1.0f, 0.0f)));
+		glm::mat4 tilt = glm::rotate(glm::mat4(1.0f), angle, axis);
+		for (glm::vec3& vert : baseVerts) {
+			vert = glm::vec3(tilt * glm::vec4(glm::normalize(vert), 1.0f));
+		}
+
+		//Equator edges left behind by the clipping, used to build the cap
+		vector<pair<glm::vec3, glm::vec3>> capEdges;
+
+		for (const glm::ivec3& face : baseFaces) {
+			glm::vec3 a = baseVerts[face.x];
+			glm::vec3 b = baseVerts[face.y];
+			glm::vec3 c = baseVerts[face.z];
+
+			//Grid point (i, j) lies at a + (b - a) * i/f + (c - a) * j/f, projected onto the unit sphere
+			auto gridPoint = [&](int i, int j) {
+				return glm::normalize(a + (b - a) * (static_cast<float>(i) / frequency) + (c - a) * (static_cast<float>(j) / frequency));
+			};
+
+			for (int i = 0; i < frequency; i++) {
+				for (int j = 0; j < frequency - i; j++) {
+					AddClippedGeodesicTriangle(gridPoint(i, j), gridPoint(i + 1, j), gridPoint(i, j + 1), vertColor, capEdges);
+
+					if (i + j < frequency - 1) {
+						AddClippedGeodesicTriangle(gridPoint(i + 1, j), gridPoint(i + 1, j + 1), gridPoint(i, j + 1), vertColor, capEdges);
+					}
+				}
+			}
+		}
+
+		// If this is a semi-circle, cap it using the edges the clip left on the equator plane.
+		if (SemiCircle) {
+			glm::vec3 normals = glm::vec3(0.0f, -1.0f, 0.0f);
+
+			for (const pair<glm::vec3, glm::vec3>& edge : capEdges) {
+				glm::vec3 cur = edge.first;
+				glm::vec3 nxt = edge.second;
+
+				//Face downward, counter clockwise when viewed from below
+				if (glm::cross(cur, nxt).y > 0.0f) {
+					std::swap(cur, nxt);
+				}
+
+				// Triangle connecting the center, current, and next vertices
+				AddVertex(Position.x, Position.y, Position.z, vertColor, normals, 0.0f, 0.0f); //Center
+				AddVertex(Position.x + RadiusLong * cur.x, Position.y, Position.z + RadiusLong * cur.z, vertColor, normals, cur.x, cur.z);
+				AddVertex(Position.x + RadiusLong * nxt.x, Position.y, Position.z + RadiusLong * nxt.z, vertColor, normals, nxt.x, nxt.z);
+			}
+		}
+	}
+
+	//Helper function that adds a geodesic triangle, clipping it against the equator when building a semi circle.
+	//Clipping happens along the flat face, so the equator ring stays on the same chords the rest of the mesh uses.
+	void AddClippedGeodesicTriangle(const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, const glm::vec3& vertColor, vector<pair<glm::vec3, glm::vec3>>& capEdges) {
+		const float epsilon = 1e-6f;
+
+		if (!SemiCircle || (p1.y >= -epsilon && p2.y >= -epsilon && p3.y >= -epsilon)) {
+			AddGeodesicTriangle(p1, p2, p3, vertColor);
+
+			//Subdivided edges can land exactly on the equator, those still need capping
+			if (SemiCircle) {
+				glm::vec3 corners[3] = { p1, p2, p3 };
+				for (int i = 0; i < 3; i++) {
+					const glm::vec3& cur = corners[i];
+					const glm::vec3& nxt = corners[(i + 1) % 3];
+					if (abs(cur.y) <= epsilon && abs(nxt.y) <= epsilon) {
+						capEdges.push_back(make_pair(cur, nxt));
+					}
+				}
+			}
+			return;
+		}
+
+		if (p1.y <= epsilon && p2.y <= epsilon && p3.y <= epsilon) {
+			return;
+		}
+
+		//Sutherland-Hodgman against the y = 0 plane, keeping the upper half
+		glm::vec3 input[3] = { p1, p2, p3 };
+		glm::vec3 output[4];
+		glm::vec3 onPlane[2];
+		int outputCount = 0;
+		int onPlaneCount = 0;
+
+		for (int i = 0; i < 3; i++) {
+			const glm::vec3& cur = input[i];
+			const glm::vec3& nxt = input[(i + 1) % 3];
+			bool curInside = cur.y >= 0.0f;
+			bool nxtInside = nxt.y >= 0.0f;
+
+			if (curInside) {
+				output[outputCount++] = cur;
+			}
+
+			if (curInside != nxtInside) {
+				float amount = cur.y / (cur.y - nxt.y);
+				glm::vec3 crossing = cur + (nxt - cur) * amount;
+				crossing.y = 0.0f;
+				output[outputCount++] = crossing;
+				onPlane[onPlaneCount++] = crossing;
+			}
+		}
+
+		for (int i = 1; i + 1 < outputCount; i++) {
+			AddGeodesicTriangle(output[0], output[i], output[i + 1], vertColor);
+		}
+
+		if (onPlaneCount == 2) {
+			capEdges.push_back(make_pair(onPlane[0], onPlane[1]));
+		}
+	}
+
+	//Helper function to scale three unit sphere points onto the ellipsoid and add them as a flat shaded, outward facing triangle
+	void AddGeodesicTriangle(glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, const glm::vec3& vertColor) {
+		glm::vec3 vert1 = ScaleToEllipsoid(p1);
+		glm::vec3 vert2 = ScaleToEllipsoid(p2);
+		glm::vec3 vert3 = ScaleToEllipsoid(p3);
+
+		//Clipping can leave slivers with no area, skip them
+		glm::vec3 faceCross = glm::cross(vert2 - vert1, vert3 - vert1);
+		if (glm::length(faceCross) < 1e-10f) {
+			return;
+		}
+
+		glm::vec3 normals = glm::normalize(faceCross);
+
+		//Keep the winding counter clockwise when viewed from outside
+		if (glm::dot(normals, ((vert1 + vert2 + vert3) / 3.0f) - Position) < 0.0f) {
+			std::swap(p2, p3);
+			std::swap(vert2, vert3);
+			normals = -normals;
+		}
+
+		//Spherical texture coordinates, matching the UV sphere layout (u wraps around the Y axis, v runs pole to pole)
+		glm::vec2 uv1 = SphericalUV(p1);
+		glm::vec2 uv2 = SphericalUV(p2);
+		glm::vec2 uv3 = SphericalUV(p3);
+
+		//Triangles crossing the seam get their low side wrapped past 1.0
+		float maxU = glm::max(uv1.x, glm::max(uv2.x, uv3.x));
+		float minU = glm::min(uv1.x, glm::min(uv2.x, uv3.x));
+		if (maxU - minU > 0.5f) {
+			if (uv1.x < 0.5f) uv1.x += 1.0f;
+			if (uv2.x < 0.5f) uv2.x += 1.0f;
+			if (uv3.x < 0.5f) uv3.x += 1.0f;
+		}
+
+		//Pole vertices have no longitude, take the middle of the other two
+		if (abs(p1.y) > 0.9999f) uv1.x = (uv2.x + uv3.x) * 0.5f;
+		if (abs(p2.y) > 0.9999f) uv2.x = (uv1.x + uv3.x) * 0.5f;
+		if (abs(p3.y) > 0.9999f) uv3.x = (uv1.x + uv2.x) * 0.5f;
+
+		AddVertex(vert1, vertColor, normals, uv1.x, uv1.y);
+		AddVertex(vert2, vertColor, normals, uv2.x, uv2.y);
+		AddVertex(vert3, vertColor, normals, uv3.x, uv3.y);
+	}
+
+	//Helper function to place a unit sphere point onto the RadiusLong/RadiusLat ellipsoid
+	glm::vec3 ScaleToEllipsoid(const glm::vec3& unitPoint) {
+		return Position + glm::vec3(unitPoint.x * RadiusLong, unitPoint.y * RadiusLat, unitPoint.z * RadiusLong);
+	}
+
+	//Helper function for the spherical texture coordinates of a unit sphere point
+	glm::vec2 SphericalUV(const glm::vec3& unitPoint) {
+		float theta = atan2(unitPoint.z, unitPoint.x);
+		if (theta < 0.0f) {
+			theta += static_cast<float>(2.0f * M_PI);
+		}
+
+		float phi = acos(glm::clamp(unitPoint.y, -1.0f, 1.0f));
+		return glm::vec2(1.0f - theta / static_cast<float>(2.0f * M_PI), phi / static_cast<float>(M_PI));
+	}
+
 	//Helper function to calculate the vertices for the sphere.
 	glm::vec3 CalculateSphereVertex(const glm::vec3& position, float radiusLong, float radiusLat, float phi, float theta) {
 		float x = position.x + radiusLong * sin(phi) * cos(theta);
@@ -0,0 +1,141 @@
+#ifndef STATICBATCH_H
+#define STATICBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include "Mesh.h"
+
+using std::vector;
+
+//Meshes that never move, pre-transformed into world space and merged into one VAO/VBO/EBO per material at scene load.
+//Every source mesh keeps its meshlets (moved to world space) as sub-ranges, so DrawCulled still skips the pieces out of view
+//and the survivors go out in one glMultiDrawElements. Draw with an identity model and normal matrix.
+class StaticBatch : public Mesh
+{
+public:
+	//Number of meshes merged into this batch
+	int SourceCount = 0;
+
+	//Merges the meshes into as few batches as there are materials, in the order each material first appears
+	static vector<StaticBatch> Build(const vector<Mesh*>& meshes)
+	{
+		vector<StaticBatch> batches;
+		vector<Mesh*> materials;
+
+		for (Mesh* mesh : meshes) {
+			size_t batch = 0;
+			while (batch < materials.size() && !materials[batch]->SameMaterial(*mesh)) {
+				batch++;
+			}
+
+			if (batch == materials.size()) {
+				materials.push_back(mesh);
+				batches.emplace_back();
+				batches.back().CopyMaterial(*mesh);
+			}
+
+			batches[batch].Append(*mesh);
+		}
+
+		for (StaticBatch& batch : batches) {
+			batch.Upload();
+		}
+
+		return batches;
+	}
+
+private:
+	//Adds a mesh's triangles in world space, with its meshlets as the culling ranges
+	void Append(Mesh& mesh)
+	{
+		int vertexCount = mesh.GetVertexCount();
+		const float* source = mesh.Vertices.empty() ? mesh.StaticVertexData : mesh.Vertices.data();
+		if (!source || vertexCount == 0) {
+			std::cout << "ERROR::STATICBATCH::NO_CPU_VERTEX_DATA" << std::endl;
+			return;
+		}
+
+		glm::mat4 model = mesh.LocalTransform;
+		glm::mat3 normalMatrix = GetNormalMatrix(model);
+		float maxScale = MeshletCuller::MaxScale(model);
+		float minScale = glm::min(glm::length(glm::vec3(model[0])), glm::min(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		bool uniformScale = maxScale - minScale <= 1e-4f * maxScale;
+
+		unsigned int baseVertex = static_cast<unsigned int>(Vertices.size() / numVertexAttributes);
+		unsigned int baseIndex = static_cast<unsigned int>(Indices.size());
+
+		for (int v = 0; v < vertexCount; v++) {
+			const float* vertex = &source[v * numVertexAttributes];
+			glm::vec3 position = glm::vec3(model * glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f));
+			glm::vec3 normal = normalMatrix * glm::vec3(vertex[6], vertex[7], vertex[8]);
+			if (glm::length(normal) > 0.0f) {
+				normal = glm::normalize(normal);
+			}
+			AddVertex(position, glm::vec3(vertex[3], vertex[4], vertex[5]), normal, vertex[9], vertex[10]);
+		}
+
+		if (mesh.Indices.empty()) {
+			for (int i = 0; i < vertexCount; i++) {
+				Indices.push_back(baseVertex + i);
+			}
+		}
+		else {
+			for (unsigned int index : mesh.Indices) {
+				Indices.push_back(baseVertex + index);
+			}
+		}
+
+		if (mesh.Meshlets.empty()) {
+			Meshlets.push_back(WholeMeshRange(baseIndex, static_cast<unsigned int>(Indices.size()) - baseIndex));
+		}
+		else {
+			//Cones only survive when the source could be cone culled and the transform keeps angles
+			bool keepCones = mesh.MeshletsClosed && uniformScale;
+			for (Meshlet meshlet : mesh.Meshlets) {
+				meshlet.IndexOffset += baseIndex;
+				meshlet.Center = glm::vec3(model * glm::vec4(meshlet.Center, 1.0f));
+				meshlet.Radius *= maxScale;
+				meshlet.ConeAxis = glm::normalize(normalMatrix * meshlet.ConeAxis);
+				if (!keepCones) {
+					meshlet.ConeCutoff = 1.0f;
+				}
+				Meshlets.push_back(meshlet);
+			}
+		}
+
+		SourceCount++;
+	}
+
+	//One frustum-only range around the triangles [baseIndex, baseIndex + indexCount), for meshes without meshlets
+	Meshlet WholeMeshRange(unsigned int baseIndex, unsigned int indexCount)
+	{
+		glm::vec3 boxMin = glm::vec3(INFINITY);
+		glm::vec3 boxMax = glm::vec3(-INFINITY);
+		for (unsigned int i = baseIndex; i < baseIndex + indexCount; i++) {
+			const float* p = &Vertices[Indices[i] * numVertexAttributes];
+			boxMin = glm::min(boxMin, glm::vec3(p[0], p[1], p[2]));
+			boxMax = glm::max(boxMax, glm::vec3(p[0], p[1], p[2]));
+		}
+
+		Meshlet range;
+		range.IndexOffset = baseIndex;
+		range.TriangleCount = indexCount / 3;
+		range.VertexCount = 0;
+		range.Center = (boxMin + boxMax) * 0.5f;
+		range.Radius = glm::length(boxMax - boxMin) * 0.5f;
+		range.ConeAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+		range.ConeCutoff = 1.0f;
+		return range;
+	}
+
+	//Uploads the merged data as is, the ranges depend on the order so it is not re-optimized
+	void Upload()
+	{
+		MeshletsClosed = true; //Per range, open sources already had their cones switched off
+		GenerateVertexArrayAndBuffer(Vertices.data(), static_cast<int>(Vertices.size() / numVertexAttributes), Indices.data(), static_cast<int>(Indices.size()));
+	}
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef STREAMRING_H
+#define STREAMRING_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "glextensions.h"
+
+using std::vector;
+
+//Where a StreamRing allocation was written: Data to fill on the CPU, Offset in the GL buffer to read it from once committed
+struct StreamAllocation
+{
+	void* Data = nullptr;
+	GLintptr Offset = 0;
+};
+
+//Per-frame data (transforms, draw commands, uniform blocks) written by the CPU and read by the GPU in the same frame.
+//With persistent mapping the buffer holds one section per frame in flight, mapped once for its whole life, and each
+//section is fenced after the frame's draws so the CPU only ever writes a section the GPU is done with.
+//Without it the data is staged in memory and the buffer is orphaned and refilled on Commit.
+class StreamRing
+{
+public:
+	unsigned int Buffer = 0;
+	GLenum Target = GL_ARRAY_BUFFER;
+
+	//Bytes one frame may use
+	GLsizeiptr FrameSize = 0;
+
+	//Sections in flight with persistent mapping
+	int Frames = 3;
+
+	//True when the buffer is persistently mapped
+	bool Persistent = false;
+
+	//Time BeginFrame spent waiting for the GPU, since the last reset
+	double WaitMilliseconds = 0.0;
+	unsigned int Waits = 0;
+
+	StreamRing() {}
+
+	//Creates the buffer, frameSize is the most one frame will allocate (alignment padding included)
+	StreamRing(GLenum target, GLsizeiptr frameSize, int frames = 3)
+	{
+		Target = target;
+		FrameSize = frameSize;
+		Frames = frames;
+		Persistent = GLExtensions::PersistentMapping;
+
+		glGenBuffers(1, &Buffer);
+		glBindBuffer(Target, Buffer);
+
+		if (Persistent) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			GLExtensions::BufferStorage(Target, FrameSize * Frames, nullptr, flags);
+			mapped = static_cast<char*>(glMapBufferRange(Target, 0, FrameSize * Frames, flags));
+			if (!mapped) {
+				std::cout << "ERROR::STREAMRING::MAP_FAILED, USING ORPHANING" << std::endl;
+				Persistent = false;
+
+				//Immutable storage cannot be re-specified, start over with a mutable buffer
+				glBindBuffer(Target, 0);
+				glDeleteBuffers(1, &Buffer);
+				glGenBuffers(1, &Buffer);
+				glBindBuffer(Target, Buffer);
+			}
+			else {
+				fences.assign(Frames, nullptr);
+			}
+		}
+
+		if (!Persistent) {
+			glBufferData(Target, FrameSize, nullptr, GL_STREAM_DRAW);
+			staging.resize(static_cast<size_t>(FrameSize));
+		}
+
+		glBindBuffer(Target, 0);
+	}
+
+	//Moves to the next section, waiting only if the GPU is still reading it from Frames frames ago
+	void BeginFrame()
+	{
+		used = 0;
+		committed = 0;
+		if (!Persistent) {
+			return;
+		}
+
+		section = (section + 1) % Frames;
+		GLsync& fence = fences[section];
+		if (fence) {
+			auto start = std::chrono::high_resolution_clock::now();
+			GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (result == GL_TIMEOUT_EXPIRED) {
+				Waits++;
+				while (result == GL_TIMEOUT_EXPIRED) {
+					result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+				}
+				WaitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	//Reserves bytes in this frame's section. Data is nullptr if the section is full
+	StreamAllocation Allocate(GLsizeiptr bytes, GLsizeiptr alignment = 16)
+	{
+		//Align the offset in the buffer, not in the section
+		StreamAllocation allocation;
+		GLsizeiptr base = Persistent ? static_cast<GLsizeiptr>(section) * FrameSize : 0;
+		GLsizeiptr start = (base + used + alignment - 1) / alignment * alignment - base;
+		if (start + bytes > FrameSize) {
+			std::cout << "ERROR::STREAMRING::FRAME_FULL" << std::endl;
+			return allocation;
+		}
+
+		used = start + bytes;
+		allocation.Offset = base + start;
+		allocation.Data = Persistent ? static_cast<void*>(mapped + allocation.Offset) : static_cast<void*>(staging.data() + start);
+		return allocation;
+	}
+
+	//Allocates and copies in one step, returns the offset (-1 if the section is full)
+	GLintptr Write(const void* data, GLsizeiptr bytes, GLsizeiptr alignment = 16)
+	{
+		StreamAllocation allocation = Allocate(bytes, alignment);
+		if (!allocation.Data) {
+			return -1;
+		}
+		memcpy(allocation.Data, data, static_cast<size_t>(bytes));
+		return allocation.Offset;
+	}
+
+	//Makes the allocations so far readable by the GPU. Nothing to do when mapped coherently, otherwise orphans and uploads
+	void Commit()
+	{
+		if (Persistent || used == committed) {
+			return;
+		}
+
+		glBindBuffer(Target, Buffer);
+		glBufferData(Target, FrameSize, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(Target, 0, used, staging.data());
+		glBindBuffer(Target, 0);
+		committed = used;
+	}
+
+	//Fences the section after the last draw that reads it
+	void EndFrame()
+	{
+		if (Persistent && used > 0) {
+			fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+	}
+
+	//Required alignment for uniform block offsets
+	static GLsizeiptr UniformAlignment()
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		return alignment;
+	}
+
+	//Unmaps and de-allocates the buffer
+	void Deallocate()
+	{
+		for (GLsync fence : fences) {
+			if (fence) {
+				glDeleteSync(fence);
+			}
+		}
+		fences.clear();
+
+		if (Persistent) {
+			glBindBuffer(Target, Buffer);
+			glUnmapBuffer(Target);
+			glBindBuffer(Target, 0);
+		}
+		glDeleteBuffers(1, &Buffer);
+	}
+
+private:
+	char* mapped = nullptr;
+	vector<char> staging;
+	vector<GLsync> fences;
+	int section = 0;
+	GLsizeiptr used = 0;
+	GLsizeiptr committed = 0;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+using std::vector;
+
+//Where a task runs: any worker thread, or the thread that calls Run (the one holding the GL context)
+enum TaskThread
+{
+	TASK_WORKER,
+	TASK_MAIN
+};
+
+//Tasks with dependencies, run as soon as everything they depend on has finished. Worker tasks (file reads, decoding,
+//tessellation) run in parallel on a pool of threads, main tasks (uploads, shader submission) run one at a time on the
+//calling thread in the order they become ready. Each task's start and end are recorded for the timeline and critical path.
+class TaskGraph
+{
+public:
+	//Time from Run to the last task finishing
+	double TotalMilliseconds = 0.0;
+
+	//Adds a task, dependencies are ids returned by earlier Adds (so there can be no cycles). Returns the task's id
+	int Add(const std::string& name, TaskThread thread, std::function<void()> work, const vector<int>& dependencies = {})
+	{
+		int id = static_cast<int>(tasks.size());
+		Task task;
+		task.Name = name;
+		task.Thread = thread;
+		task.Work = std::move(work);
+		task.Dependencies = dependencies;
+		tasks.push_back(std::move(task));
+
+		for (int dependency : dependencies) {
+			tasks[dependency].Dependents.push_back(id);
+		}
+		return id;
+	}
+
+	//Runs every task, returns once all are done. threadCount is the number of workers besides the calling thread
+	void Run(unsigned int threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1)
+	{
+		threadCount = std::max(threadCount, 1u);
+		start = std::chrono::high_resolution_clock::now();
+		finished = 0;
+		stopped = false;
+		workerQueue.clear();
+		mainQueue.clear();
+
+		for (int i = 0; i < static_cast<int>(tasks.size()); i++) {
+			tasks[i].Remaining = static_cast<int>(tasks[i].Dependencies.size());
+			if (tasks[i].Remaining == 0) {
+				Queue(i);
+			}
+		}
+
+		vector<std::thread> workers;
+		for (unsigned int t = 0; t < threadCount; t++) {
+			workers.emplace_back([this, t]() { WorkerLoop(static_cast<int>(t) + 1); });
+		}
+
+		//The calling thread runs the main tasks until everything is done
+		std::unique_lock<std::mutex> lock(mutex);
+		while (finished < tasks.size()) {
+			if (mainQueue.empty()) {
+				mainReady.wait(lock);
+				continue;
+			}
+
+			int id = mainQueue.front();
+			mainQueue.pop_front();
+			Execute(id, 0, lock);
+		}
+		lock.unlock();
+
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopped = true;
+		}
+		workerReady.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+
+		TotalMilliseconds = Milliseconds(std::chrono::high_resolution_clock::now());
+	}
+
+	//Prints the chain of tasks that decided when the last task finished: each one waited on the dependency that finished last
+	void PrintCriticalPath() const
+	{
+		if (tasks.empty()) {
+			return;
+		}
+
+		int last = 0;
+		for (int i = 1; i < static_cast<int>(tasks.size()); i++) {
+			if (tasks[i].End > tasks[last].End) {
+				last = i;
+			}
+		}
+
+		vector<int> path;
+		for (int id = last; id >= 0;) {
+			path.push_back(id);
+			int latest = -1;
+			for (int dependency : tasks[id].Dependencies) {
+				if (latest < 0 || tasks[dependency].End > tasks[latest].End) {
+					latest = dependency;
+				}
+			}
+			id = latest;
+		}
+		std::reverse(path.begin(), path.end());
+
+		double busy = 0.0;
+		std::cout << "TASKGRAPH::CRITICAL_PATH " << std::fixed << std::setprecision(2) << TotalMilliseconds << " ms, " << tasks.size() << " tasks" << std::endl;
+		for (int id : path) {
+			const Task& task = tasks[id];
+			busy += task.End - task.Start;
+			std::cout << "  " << std::setw(9) << task.Start << " +" << std::setw(8) << task.End - task.Start << " ms "
+				<< (task.Thread == TASK_MAIN ? "[main]   " : "[worker] ") << task.Name << std::endl;
+		}
+		std::cout << "  " << busy << " ms of work on the path, the rest is waiting for a thread" << std::defaultfloat << std::endl;
+	}
+
+	//Writes the timeline in the Chrome trace event format (open in chrome://tracing or ui.perfetto.dev)
+	bool WriteTrace(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file) {
+			std::cout << "ERROR::TASKGRAPH::TRACE_NOT_WRITTEN " << path << std::endl;
+			return false;
+		}
+
+		file << "{\"traceEvents\":[\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main (GL)\"}}";
+		int threads = 0;
+		for (const Task& task : tasks) {
+			threads = std::max(threads, task.ThreadIndex);
+		}
+		for (int t = 1; t <= threads; t++) {
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t << ",\"args\":{\"name\":\"worker " << t << "\"}}";
+		}
+
+		file << std::fixed << std::setprecision(1);
+		for (const Task& task : tasks) {
+			file << ",\n{\"name\":\"" << Escape(task.Name) << "\",\"cat\":\"" << (task.Thread == TASK_MAIN ? "main" : "worker")
+				<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << task.ThreadIndex << ",\"ts\":" << task.Start * 1000.0
+				<< ",\"dur\":" << (task.End - task.Start) * 1000.0 << "}";
+		}
+		file << "\n]}\n";
+		return true;
+	}
+
+private:
+	struct Task
+	{
+		std::string Name;
+		TaskThread Thread = TASK_WORKER;
+		std::function<void()> Work;
+		vector<int> Dependencies;
+		vector<int> Dependents;
+		int Remaining = 0;
+
+		//Milliseconds since Run, and the thread that ran it (0 is the calling thread)
+		double Start = 0.0;
+		double End = 0.0;
+		int ThreadIndex = 0;
+	};
+
+	vector<Task> tasks;
+	std::deque<int> workerQueue;
+	std::deque<int> mainQueue;
+	std::mutex mutex;
+	std::condition_variable workerReady;
+	std::condition_variable mainReady;
+	size_t finished = 0;
+	bool stopped = false;
+	std::chrono::high_resolution_clock::time_point start;
+
+	double Milliseconds(std::chrono::high_resolution_clock::time_point time) const
+	{
+		return std::chrono::duration<double, std::milli>(time - start).count();
+	}
+
+	//Puts a ready task on its thread's queue, the mutex must be held (or no workers running yet)
+	void Queue(int id)
+	{
+		if (tasks[id].Thread == TASK_MAIN) {
+			mainQueue.push_back(id);
+			mainReady.notify_one();
+		}
+		else {
+			workerQueue.push_back(id);
+			workerReady.notify_one();
+		}
+	}
+
+	//Runs a task with the lock released, then releases its dependents
+	void Execute(int id, int threadIndex, std::unique_lock<std::mutex>& lock)
+	{
+		lock.unlock();
+
+		Task& task = tasks[id];
+		task.ThreadIndex = threadIndex;
+		task.Start = Milliseconds(std::chrono::high_resolution_clock::now());
+		task.Work();
+		task.End = Milliseconds(std::chrono::high_resolution_clock::now());
+
+		lock.lock();
+		finished++;
+		for (int dependent : task.Dependents) {
+			if (--tasks[dependent].Remaining == 0) {
+				Queue(dependent);
+			}
+		}
+		//The main thread checks for the end whenever a task finishes
+		mainReady.notify_one();
+	}
+
+	void WorkerLoop(int threadIndex)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			workerReady.wait(lock, [this]() { return stopped || !workerQueue.empty(); });
+			if (stopped) {
+				return;
+			}
+
+			int id = workerQueue.front();
+			workerQueue.pop_front();
+			Execute(id, threadIndex, lock);
+		}
+	}
+
+	static std::string Escape(const std::string& text)
+	{
+		std::string result;
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				result += '\\';
+			}
+			result += c;
+		}
+		return result;
+	}
+};
+
+#endif
@@ -7,6 +7,8 @@
 #include <vector>
 #include <random>
 #include "stb_image.h"
+#include "assetpack.h"
+#include "sharedassetcache.h"
 #include <iostream>
 
 using namespace std;
@@ -80,19 +82,36 @@ private:
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		}
 
-		data = stbi_load(path, &width, &height, &numChannels, 0);
+		//From the asset pack if one is mounted, else the loose file.
+		//With a SharedAssetCache mounted the pixels come from there if another viewer decoded this file, and the cache's
+		//writer publishes what it decodes
+		data = nullptr;
+		const unsigned char* pixels = nullptr;
+		std::vector<char> scratch;
+		AssetView file;
+		if (AssetPack::Load(path, scratch, file)) {
+			uint64_t sharedKey = SharedAssetCache::Mounted ? SharedAssetCache::Key(file.Data, file.Size, flip ? 3 : 2) : 0;
+			pixels = sharedKey ? LoadShared(sharedKey) : nullptr;
+			if (!pixels) {
+				data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.Data), static_cast<int>(file.Size), &width, &height, &numChannels, 0);
+				pixels = data;
+				if (data && sharedKey) {
+					PublishShared(sharedKey);
+				}
+			}
+		}
 
 		//Generate texture/mipmaps if data is available
-		if (data) {
+		if (pixels) {
 
 			//If the type has support for alpha channel, set this to true
 			if (!hasAlpha) {
 				//           target         miplvl storeFormat  self explanatory   legacy, always 0  format/datatype of source  actual image data
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
 			}
 			else {
 				//           target         miplvl storeFormat  self explanatory   legacy, always 0  format/datatype of source  actual image data
-				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 			}
 
 			glGenerateMipmap(GL_TEXTURE_2D); //Gens all required mipmaps for currently bound texture
@@ -106,6 +125,34 @@ private:
 
 	}
 
+	//Pixels published under key with their size, nullptr if they are not in the shared cache.
+	//Payload: width, height, channel count and a reserved word, then the pixels
+	const unsigned char* LoadShared(uint64_t key) {
+		AssetView view;
+		uint32_t header[4];
+		if (!SharedAssetCache::Mounted->Find(key, view) || view.Size < sizeof(header)) {
+			return nullptr;
+		}
+		memcpy(header, view.Data, sizeof(header));
+		if (header[2] == 0 || header[2] > 4 || static_cast<uint64_t>(header[0]) * header[1] * header[2] > view.Size - sizeof(header)) {
+			return nullptr;
+		}
+		width = static_cast<int>(header[0]);
+		height = static_cast<int>(header[1]);
+		numChannels = static_cast<int>(header[2]);
+		return reinterpret_cast<const unsigned char*>(view.Data + sizeof(header));
+	}
+
+	//Publishes the decoded data under key
+	void PublishShared(uint64_t key) {
+		uint32_t header[4] = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), static_cast<uint32_t>(numChannels), 0 };
+		size_t bytes = static_cast<size_t>(width) * height * numChannels;
+		SharedAssetCache::Mounted->Publish(key, sizeof(header) + bytes, [&](char* destination) {
+			memcpy(destination, header, sizeof(header));
+			memcpy(destination + sizeof(header), data, bytes);
+		});
+	}
+
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,471 @@
+#ifndef TEXTURERESIDENCY_H
+#define TEXTURERESIDENCY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include "stb_image.h"
+#include "texture2d.h"
+#include "Mesh.h"
+#include "assetpack.h"
+#include "sharedassetcache.h"
+
+using std::vector;
+
+//Keeps textures under a GPU memory budget. The full mip chain of every texture stays in system memory, only the coarse
+//levels are uploaded at load and finer levels are uploaded as objects using the texture come close to the camera.
+//The finest uploaded level is the texture's GL_TEXTURE_BASE_LEVEL, so sampling never touches a level that is not there.
+//When the budget is exceeded the finest levels of the least recently requested textures are dropped first.
+class TextureResidency
+{
+public:
+	//Bytes of texture levels that may be resident at once (the always resident coarse levels can exceed it)
+	size_t BudgetBytes = 64 * 1024 * 1024;
+
+	//Bytes uploaded per Update at most, so streaming never causes a long frame (at least one level is uploaded)
+	size_t UploadBytesPerFrame = 8 * 1024 * 1024;
+
+	//Levels this size and smaller are uploaded at load and never evicted
+	int ResidentMinSize = 64;
+
+	//Added to the requested level, negative to keep textures sharper than the estimate
+	int LevelBias = 0;
+
+	TextureResidency() {}
+
+	TextureResidency(size_t budgetBytes)
+	{
+		BudgetBytes = budgetBytes;
+	}
+
+	struct MipLevel
+	{
+		int Width;
+		int Height;
+		vector<unsigned char> Pixels; //RGBA8
+		const unsigned char* SharedPixels = nullptr; //The level in the SharedAssetCache instead of Pixels
+
+		const unsigned char* Data() const { return SharedPixels ? SharedPixels : Pixels.data(); }
+		size_t Bytes() const { return static_cast<size_t>(Width) * Height * 4; }
+	};
+
+	//An image decoded with its full mip chain, not on the GPU yet (Levels is empty if the file could not be read)
+	struct DecodedTexture
+	{
+		vector<MipLevel> Levels;
+	};
+
+	//Loads an image and uploads its coarse levels, the returned texture can be used like any other
+	Texture2D Load(const char* path, bool repeatU = true, bool repeatV = true, bool flip = true)
+	{
+		return Upload(Decode(path, flip), repeatU, repeatV);
+	}
+
+	//Reads and decodes an image and builds its mip chain. No GL calls, safe to run on a worker thread.
+	//With a SharedAssetCache mounted the levels are taken from it when another viewer decoded the same file, and a decode
+	//by the cache's writer is published there (the levels then point into the cache either way)
+	static DecodedTexture Decode(const char* path, bool flip = true)
+	{
+		DecodedTexture decoded;
+
+		//Per thread, the global flag would race with decodes on other threads
+		stbi_set_flip_vertically_on_load_thread(flip);
+		int width = 0, height = 0, channels = 0;
+		unsigned char* data = nullptr;
+		vector<char> scratch;
+		AssetView file;
+		uint64_t sharedKey = 0;
+		if (AssetPack::Load(path, scratch, file)) {
+			if (SharedAssetCache::Mounted) {
+				sharedKey = SharedAssetCache::Key(file.Data, file.Size, flip ? 1 : 0);
+				if (LoadShared(sharedKey, decoded)) {
+					return decoded;
+				}
+			}
+			data = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.Data), static_cast<int>(file.Size), &width, &height, &channels, 4);
+		}
+		if (!data) {
+			std::cout << "FAILURE::LOAD::TEXTURE " << path << std::endl;
+			return decoded;
+		}
+
+		decoded.Levels.push_back(MipLevel{ width, height, vector<unsigned char>(data, data + static_cast<size_t>(width) * height * 4) });
+		stbi_image_free(data);
+		BuildMipChain(decoded.Levels);
+		if (sharedKey) {
+			PublishShared(sharedKey, decoded);
+		}
+		return decoded;
+	}
+
+	//Creates the texture from a decoded image and uploads its coarse levels, call on the GL thread
+	Texture2D Upload(DecodedTexture&& decoded, bool repeatU = true, bool repeatV = true)
+	{
+		Texture2D result;
+		if (decoded.Levels.empty()) {
+			return result;
+		}
+
+		ManagedTexture texture;
+		texture.Levels = std::move(decoded.Levels);
+
+		glGenTextures(1, &texture.Texture);
+		glBindTexture(GL_TEXTURE_2D, texture.Texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, repeatU ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, repeatV ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LevelCount(texture) - 1);
+
+		//Coarse levels, always resident
+		texture.ResidentLevel = LevelCount(texture) - 1;
+		while (texture.ResidentLevel > 0 && std::max(texture.Levels[texture.ResidentLevel - 1].Width, texture.Levels[texture.ResidentLevel - 1].Height) <= ResidentMinSize) {
+			texture.ResidentLevel--;
+		}
+		texture.MinimumLevel = texture.ResidentLevel;
+		for (int level = LevelCount(texture) - 1; level >= texture.ResidentLevel; level--) {
+			UploadLevel(texture, level);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.ResidentLevel);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		texture.RequestedLevel = texture.ResidentLevel;
+		result.Texture = texture.Texture;
+		textures[texture.Texture] = std::move(texture);
+		return result;
+	}
+
+	//Asks for a texture to have level (or finer) resident, for this frame. Textures the manager does not own are ignored
+	void Request(unsigned int texture, int level)
+	{
+		auto found = textures.find(texture);
+		if (found == textures.end()) {
+			return;
+		}
+
+		ManagedTexture& managed = found->second;
+		level = glm::clamp(level + LevelBias, 0, LevelCount(managed) - 1);
+		if (managed.LastRequestFrame != frame) {
+			managed.LastRequestFrame = frame;
+			managed.RequestedLevel = level;
+		}
+		else {
+			managed.RequestedLevel = std::min(managed.RequestedLevel, level);
+		}
+	}
+
+	//Requests the textures of a mesh at the level that matches its size on screen. pixelsPerUnit is the screen height over
+	//2 * tan(fov / 2), as for Mesh::SelectLod. Assumes each texture is mapped once across the mesh's bounds
+	void RequestForMesh(Mesh& mesh, const glm::mat4& model, const glm::vec3& cameraPosition, float pixelsPerUnit)
+	{
+		float radius = mesh.BoundsRadius * MeshletCuller::MaxScale(model);
+		glm::vec3 center = glm::vec3(model * glm::vec4(mesh.BoundsCenter, 1.0f));
+		float distance = std::max(glm::length(center - cameraPosition) - radius, 0.01f);
+		float pixels = 2.0f * radius * pixelsPerUnit / distance;
+
+		unsigned int meshTextures[] = { mesh.GetDiffuseTexture(), mesh.GetSpecularTexture(), mesh.GetOverlayDiffuseTexture(), mesh.GetOverlaySpecularTexture() };
+		for (unsigned int texture : meshTextures) {
+			auto found = textures.find(texture);
+			if (found == textures.end()) {
+				continue;
+			}
+
+			//Texels per pixel across the object, each halving is one level
+			const MipLevel& top = found->second.Levels[0];
+			float texelsPerPixel = static_cast<float>(std::max(top.Width, top.Height)) / std::max(pixels, 1.0f);
+			Request(texture, static_cast<int>(std::floor(std::log2(std::max(texelsPerPixel, 1.0f)))));
+		}
+	}
+
+	//Uploads the requested levels within the upload and memory budgets, evicting least recently requested levels to make room.
+	//Call once per frame, after the requests
+	void Update()
+	{
+		//Furthest from what they asked for first
+		vector<ManagedTexture*> wanting;
+		for (auto& entry : textures) {
+			ManagedTexture& texture = entry.second;
+			if (texture.LastRequestFrame == frame && texture.RequestedLevel < texture.ResidentLevel) {
+				wanting.push_back(&texture);
+			}
+		}
+		std::sort(wanting.begin(), wanting.end(), [](const ManagedTexture* a, const ManagedTexture* b) {
+			return a->ResidentLevel - a->RequestedLevel > b->ResidentLevel - b->RequestedLevel;
+		});
+
+		size_t uploaded = 0;
+		for (ManagedTexture* texture : wanting) {
+			while (texture->RequestedLevel < texture->ResidentLevel) {
+				size_t bytes = LevelBytes(*texture, texture->ResidentLevel - 1);
+				if (uploaded > 0 && uploaded + bytes > UploadBytesPerFrame) {
+					break;
+				}
+				if (!MakeRoom(bytes, texture)) {
+					break;
+				}
+
+				glBindTexture(GL_TEXTURE_2D, texture->Texture);
+				UploadLevel(*texture, texture->ResidentLevel - 1);
+				texture->ResidentLevel--;
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture->ResidentLevel);
+				uploaded += bytes;
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		UploadedLastUpdate = uploaded;
+		frame++;
+	}
+
+	//Bytes resident for one texture, 0 if the manager does not own it
+	size_t GetResidentBytes(unsigned int texture) const
+	{
+		auto found = textures.find(texture);
+		return (found == textures.end()) ? 0 : found->second.ResidentBytes;
+	}
+
+	//Bytes resident for every managed texture
+	size_t TotalResidentBytes = 0;
+
+	//Bytes uploaded by the last Update
+	size_t UploadedLastUpdate = 0;
+
+	//Pixels of the finest level in system memory that is at least minSize wide (or the full image), nullptr if the manager does not own it.
+	//Lets copies of a texture (the material array) use the full resolution whatever is resident
+	const unsigned char* GetLevel(unsigned int texture, int minSize, int& width, int& height) const
+	{
+		auto found = textures.find(texture);
+		if (found == textures.end()) {
+			return nullptr;
+		}
+
+		const vector<MipLevel>& levels = found->second.Levels;
+		size_t level = 0;
+		while (level + 1 < levels.size() && std::max(levels[level + 1].Width, levels[level + 1].Height) >= minSize) {
+			level++;
+		}
+		width = levels[level].Width;
+		height = levels[level].Height;
+		return levels[level].Data();
+	}
+
+	//Prints the resident size and level of every texture and the total against the budget
+	void PrintStats() const
+	{
+		for (const auto& entry : textures) {
+			const ManagedTexture& texture = entry.second;
+			std::cout << "TEXTURES::" << texture.Texture << " " << texture.Levels[0].Width << "x" << texture.Levels[0].Height
+				<< " LEVEL " << texture.ResidentLevel << " (" << texture.Levels[texture.ResidentLevel].Width << "x" << texture.Levels[texture.ResidentLevel].Height << ")"
+				<< " RESIDENT " << texture.ResidentBytes / 1024 << " KB" << std::endl;
+		}
+		std::cout << "TEXTURES::RESIDENT " << TotalResidentBytes / 1024 << "/" << BudgetBytes / 1024 << " KB" << std::endl;
+	}
+
+	//Deletes one managed texture and drops its system memory copy. Textures the manager does not own are ignored
+	void Unload(unsigned int texture)
+	{
+		auto found = textures.find(texture);
+		if (found == textures.end()) {
+			return;
+		}
+
+		glDeleteTextures(1, &found->second.Texture);
+		TotalResidentBytes -= found->second.ResidentBytes;
+		textures.erase(found);
+	}
+
+	//De-allocates every managed texture
+	void Deallocate()
+	{
+		for (auto& entry : textures) {
+			glDeleteTextures(1, &entry.second.Texture);
+		}
+		textures.clear();
+		TotalResidentBytes = 0;
+	}
+
+private:
+	struct ManagedTexture
+	{
+		unsigned int Texture = 0;
+		vector<MipLevel> Levels;
+		int ResidentLevel = 0;      //Finest level on the GPU (the base level)
+		int MinimumLevel = 0;       //Coarsest level that is never evicted
+		int RequestedLevel = 0;     //Finest level asked for in LastRequestFrame
+		unsigned int LastRequestFrame = 0;
+		size_t ResidentBytes = 0;
+	};
+
+	std::map<unsigned int, ManagedTexture> textures;
+	unsigned int frame = 1;
+
+	static int LevelCount(const ManagedTexture& texture)
+	{
+		return static_cast<int>(texture.Levels.size());
+	}
+
+	static size_t LevelBytes(const ManagedTexture& texture, int level)
+	{
+		return texture.Levels[level].Bytes();
+	}
+
+	//2x2 box filtered levels down to 1x1 (odd sizes round down and repeat the last row or column)
+	static void BuildMipChain(vector<MipLevel>& levels)
+	{
+		while (levels.back().Width > 1 || levels.back().Height > 1) {
+			const MipLevel& source = levels.back();
+			MipLevel level;
+			level.Width = std::max(source.Width / 2, 1);
+			level.Height = std::max(source.Height / 2, 1);
+			level.Pixels.resize(static_cast<size_t>(level.Width) * level.Height * 4);
+
+			for (int y = 0; y < level.Height; y++) {
+				int y0 = std::min(y * 2, source.Height - 1);
+				int y1 = std::min(y * 2 + 1, source.Height - 1);
+				for (int x = 0; x < level.Width; x++) {
+					int x0 = std::min(x * 2, source.Width - 1);
+					int x1 = std::min(x * 2 + 1, source.Width - 1);
+					for (int c = 0; c < 4; c++) {
+						int sum = source.Pixels[(static_cast<size_t>(y0) * source.Width + x0) * 4 + c] + source.Pixels[(static_cast<size_t>(y0) * source.Width + x1) * 4 + c]
+							+ source.Pixels[(static_cast<size_t>(y1) * source.Width + x0) * 4 + c] + source.Pixels[(static_cast<size_t>(y1) * source.Width + x1) * 4 + c];
+						level.Pixels[(static_cast<size_t>(y) * level.Width + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+					}
+				}
+			}
+
+			levels.push_back(std::move(level));
+		}
+	}
+
+	//Shared cache payload of a mip chain: the level count, each level's width and height, then every level's pixels
+	struct SharedHeader
+	{
+		uint32_t LevelCount;
+		uint32_t Reserved;
+	};
+
+	//Points decoded at the levels published under key, false if they are not in the shared cache
+	static bool LoadShared(uint64_t key, DecodedTexture& decoded)
+	{
+		AssetView view;
+		if (!SharedAssetCache::Mounted->Find(key, view) || view.Size < sizeof(SharedHeader)) {
+			return false;
+		}
+
+		SharedHeader header;
+		memcpy(&header, view.Data, sizeof(header));
+		size_t offset = sizeof(header) + static_cast<size_t>(header.LevelCount) * 2 * sizeof(uint32_t);
+		if (header.LevelCount == 0 || header.LevelCount > 32 || offset > view.Size) {
+			return false;
+		}
+
+		vector<MipLevel> levels(header.LevelCount);
+		for (uint32_t i = 0; i < header.LevelCount; i++) {
+			uint32_t size[2];
+			memcpy(size, view.Data + sizeof(header) + i * sizeof(size), sizeof(size));
+			levels[i].Width = static_cast<int>(size[0]);
+			levels[i].Height = static_cast<int>(size[1]);
+			if (size[0] == 0 || size[1] == 0 || size[0] > 65536 || size[1] > 65536 || levels[i].Bytes() > view.Size - offset) {
+				return false;
+			}
+			levels[i].SharedPixels = reinterpret_cast<const unsigned char*>(view.Data + offset);
+			offset += levels[i].Bytes();
+		}
+		decoded.Levels = std::move(levels);
+		return true;
+	}
+
+	//Publishes a decoded mip chain under key and, if that worked, swaps the levels for the shared copy
+	static void PublishShared(uint64_t key, DecodedTexture& decoded)
+	{
+		size_t bytes = sizeof(SharedHeader) + decoded.Levels.size() * 2 * sizeof(uint32_t);
+		for (const MipLevel& level : decoded.Levels) {
+			bytes += level.Bytes();
+		}
+
+		const char* shared = nullptr;
+		bool published = SharedAssetCache::Mounted->Publish(key, bytes, [&decoded, &shared](char* destination) {
+			shared = destination;
+			SharedHeader header = { static_cast<uint32_t>(decoded.Levels.size()), 0 };
+			memcpy(destination, &header, sizeof(header));
+			destination += sizeof(header);
+			for (const MipLevel& level : decoded.Levels) {
+				uint32_t size[2] = { static_cast<uint32_t>(level.Width), static_cast<uint32_t>(level.Height) };
+				memcpy(destination, size, sizeof(size));
+				destination += sizeof(size);
+			}
+			for (const MipLevel& level : decoded.Levels) {
+				memcpy(destination, level.Data(), level.Bytes());
+				destination += level.Bytes();
+			}
+		});
+		if (!published) {
+			return;
+		}
+
+		size_t offset = sizeof(SharedHeader) + decoded.Levels.size() * 2 * sizeof(uint32_t);
+		for (MipLevel& level : decoded.Levels) {
+			level.SharedPixels = reinterpret_cast<const unsigned char*>(shared + offset);
+			level.Pixels = vector<unsigned char>();
+			offset += level.Bytes();
+		}
+	}
+
+	//Uploads one level of the bound texture
+	void UploadLevel(ManagedTexture& texture, int level)
+	{
+		const MipLevel& mip = texture.Levels[level];
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, mip.Width, mip.Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, mip.Data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		texture.ResidentBytes += mip.Bytes();
+		TotalResidentBytes += mip.Bytes();
+	}
+
+	//Drops the finest level of a texture, the base level moves up first so the texture stays complete
+	void EvictLevel(ManagedTexture& texture)
+	{
+		int level = texture.ResidentLevel;
+		texture.ResidentLevel++;
+
+		glBindTexture(GL_TEXTURE_2D, texture.Texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.ResidentLevel);
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr); //Releases the level's storage
+
+		texture.ResidentBytes -= LevelBytes(texture, level);
+		TotalResidentBytes -= LevelBytes(texture, level);
+	}
+
+	//Evicts levels until bytes more fit in the budget. Textures requested this frame only give up levels finer than they asked for,
+	//the least recently requested go first. Returns false if there is not enough to evict
+	bool MakeRoom(size_t bytes, const ManagedTexture* keep)
+	{
+		while (TotalResidentBytes + bytes > BudgetBytes) {
+			ManagedTexture* victim = nullptr;
+			for (auto& entry : textures) {
+				ManagedTexture& texture = entry.second;
+				if (&texture == keep || texture.ResidentLevel >= texture.MinimumLevel) {
+					continue;
+				}
+				if (texture.LastRequestFrame == frame && texture.ResidentLevel >= texture.RequestedLevel) {
+					continue;
+				}
+				if (!victim || texture.LastRequestFrame < victim->LastRequestFrame) {
+					victim = &texture;
+				}
+			}
+
+			if (!victim) {
+				return false;
+			}
+			EvictLevel(*victim);
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <glad/glad.h>
+
+#include "glextensions.h"
+
+//One VAO for the standard 11 float vertex layout (position, color, normal, uv). The attribute formats are set once with
+//glVertexAttribFormat and every mesh only swaps the buffer behind binding 0 and the index buffer, so switching meshes
+//does not switch (and re-validate) vertex arrays. Needs vertex attrib binding (GL 4.3), meshes keep their own VAO without it.
+class VertexFormat
+{
+public:
+	//Floats per vertex
+	static const int VertexAttributes = 11;
+
+	//When false, meshes uploaded from now on get their own VAO even if the shared format is supported
+	static inline bool Enabled = true;
+
+	//The shared VAO, created on first use
+	static inline unsigned int VAO = 0;
+
+	//True if meshes uploaded now should use the shared VAO
+	static bool IsShared()
+	{
+		return Enabled && GLExtensions::SeparateAttribFormat;
+	}
+
+	//Binds the shared VAO with a mesh's buffers (ebo may be 0)
+	static void Bind(unsigned int vbo, unsigned int ebo)
+	{
+		if (VAO == 0) {
+			Create();
+		}
+
+		glBindVertexArray(VAO);
+		GLExtensions::BindVertexBuffer(0, vbo, 0, VertexAttributes * sizeof(float));
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	}
+
+	//De-allocates the shared VAO
+	static void Deallocate()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		VAO = 0;
+	}
+
+private:
+	static void Create()
+	{
+		glGenVertexArrays(1, &VAO);
+		glBindVertexArray(VAO);
+
+		//Position, color, normal, uv, all read from binding 0
+		GLExtensions::VertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
+		GLExtensions::VertexAttribFormat(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float));
+		GLExtensions::VertexAttribFormat(2, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float));
+		GLExtensions::VertexAttribFormat(3, 2, GL_FLOAT, GL_FALSE, 9 * sizeof(float));
+		for (GLuint attribute = 0; attribute < 4; attribute++) {
+			GLExtensions::VertexAttribBinding(attribute, 0);
+			glEnableVertexAttribArray(attribute);
+		}
+	}
+};
+
+#endif
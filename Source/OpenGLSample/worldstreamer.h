@@ -0,0 +1,476 @@
+#ifndef WORLDSTREAMER_H
+#define WORLDSTREAMER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include "Mesh.h"
+#include "scenefile.h"
+#include "textureresidency.h"
+
+using std::vector;
+
+//Loads the static objects of a scene by distance to the camera instead of all at startup, so a scene does not have to fit in
+//memory at once. The objects are binned into square cells on the XZ plane. A cell that comes within LoadRadius is built on a
+//loader thread (meshes through the builder, usually from the MeshCache, and the textures its materials need that are not
+//loaded yet), then uploaded on the GL thread a few items per frame and drawn once all of it is there. Cells further than
+//UnloadRadius are freed again; UnloadRadius is larger than LoadRadius so a camera on a cell border does not load and unload
+//the same cell every frame. Textures are shared between cells and freed with the last cell using them.
+//Every GL call is made in Update and Deallocate, on the thread that calls them.
+class WorldStreamer
+{
+public:
+	//Side of a cell
+	float CellSize = 8.0f;
+
+	//Distance from the camera to a cell's bounds at which it is loaded, and the larger one at which it is freed
+	float LoadRadius = 12.0f;
+	float UnloadRadius = 16.0f;
+
+	//Bytes of vertex, index and texture data uploaded per Update. Stops once spent, so the last item may go over
+	size_t UploadBytesPerFrame = 4 * 1024 * 1024;
+
+	//Cells handed to the loader thread per Update, and queued or building at once
+	int LoadsPerFrame = 1;
+	int MaxLoadsInFlight = 2;
+
+	//Bytes of vertex and index data that may be resident. A cell that does not fit frees loaded cells further away than
+	//itself, or waits (built, not uploaded) until the camera moves
+	size_t GeometryBudgetBytes = 256 * 1024 * 1024;
+
+	//Builds the mesh of a scene object with its CPU data only (runs on the loader thread, where Mesh::DeferUploadOnThread is set)
+	using MeshBuilder = std::function<std::shared_ptr<Mesh>(size_t object)>;
+
+	//Streams the given objects of scene (indices into scene.Objects). The scene and the texture manager must outlive the streamer
+	WorldStreamer(const Scene& scene, TextureResidency& textureResidency, MeshBuilder builder, const vector<size_t>& objects, float cellSize = 8.0f)
+		: scene(scene), textureResidency(textureResidency), builder(std::move(builder)), sceneTextures(scene.Textures.size())
+	{
+		CellSize = cellSize;
+
+		std::map<std::pair<int, int>, size_t> cellAt;
+		for (size_t object : objects) {
+			const SceneObject& sceneObject = scene.Objects[object];
+			glm::vec3 position = glm::vec3(sceneObject.Position[0], sceneObject.Position[1], sceneObject.Position[2]);
+			std::pair<int, int> key(static_cast<int>(std::floor(position.x / CellSize)), static_cast<int>(std::floor(position.z / CellSize)));
+			auto found = cellAt.find(key);
+			if (found == cellAt.end()) {
+				found = cellAt.emplace(key, cells.size()).first;
+				cells.emplace_back();
+				cells.back().Min = cells.back().Max = position;
+			}
+
+			//Bounds from the generator sizes until the meshes are built
+			Cell& cell = cells[found->second];
+			float extent = std::max(sceneObject.Size[0], sceneObject.Size[1]);
+			cell.Objects.push_back(object);
+			cell.Min = glm::min(cell.Min, position - glm::vec3(extent));
+			cell.Max = glm::max(cell.Max, position + glm::vec3(extent));
+
+			const SceneMaterial& material = scene.Materials[sceneObject.Material];
+			for (int32_t texture : { material.Diffuse, material.Specular, material.OverlayDiffuse, material.OverlaySpecular }) {
+				if (texture >= 0 && std::find(cell.Textures.begin(), cell.Textures.end(), texture) == cell.Textures.end()) {
+					cell.Textures.push_back(texture);
+				}
+			}
+		}
+
+		if (!cells.empty()) {
+			loader = std::thread(&WorldStreamer::LoaderThread, this);
+		}
+	}
+
+	WorldStreamer(const WorldStreamer&) = delete;
+	WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+	~WorldStreamer()
+	{
+		StopLoader();
+	}
+
+	//Frees cells that moved out of range, starts loading the ones in range (nearest first) and uploads finished loads within
+	//the budgets. Call once per frame on the GL thread, before drawing ResidentMeshes
+	void Update(const glm::vec3& cameraPosition)
+	{
+		for (Cell& cell : cells) {
+			glm::vec3 nearest = glm::clamp(cameraPosition, cell.Min, cell.Max);
+			cell.Distance = glm::length(nearest - cameraPosition);
+		}
+
+		//Out of range, whatever state they are in
+		for (Cell& cell : cells) {
+			if (cell.State != CELL_UNLOADED && !cell.Cancelled && cell.Distance > UnloadRadius) {
+				Unload(cell);
+			}
+		}
+
+		CollectLoads();
+		StartLoads();
+		UploadBytesLastUpdate = Upload();
+	}
+
+	//Meshes of every resident cell, with their materials set. Changes in Update
+	const vector<Mesh*>& ResidentMeshes() const
+	{
+		return residentMeshes;
+	}
+
+	//Bytes of vertex and index data on the GPU
+	size_t ResidentGeometryBytes = 0;
+
+	//Bytes uploaded by the last Update
+	size_t UploadBytesLastUpdate = 0;
+
+	//Prints the cells in each state and the memory in use
+	void PrintStats() const
+	{
+		int counts[4] = { 0, 0, 0, 0 };
+		for (const Cell& cell : cells) {
+			counts[cell.State]++;
+		}
+		int textures = 0;
+		for (const StreamedTexture& texture : sceneTextures) {
+			textures += (texture.State == TEXTURE_RESIDENT) ? 1 : 0;
+		}
+		std::cout << "STREAMING::CELLS " << cells.size() << " RESIDENT " << counts[CELL_RESIDENT] << " UPLOADING " << counts[CELL_BUILT]
+			<< " LOADING " << counts[CELL_LOADING] << " MESHES " << residentMeshes.size() << " GEOMETRY " << ResidentGeometryBytes / 1024 << "/"
+			<< GeometryBudgetBytes / 1024 << " KB TEXTURES " << textures << " (" << textureResidency.TotalResidentBytes / 1024 << " KB)" << std::endl;
+	}
+
+	//Frees every resident cell and stops the loader thread
+	void Deallocate()
+	{
+		StopLoader();
+		for (Cell& cell : cells) {
+			if (cell.State != CELL_UNLOADED) {
+				Unload(cell);
+			}
+		}
+	}
+
+private:
+	enum CellState { CELL_UNLOADED, CELL_LOADING, CELL_BUILT, CELL_RESIDENT };
+	enum TextureState { TEXTURE_NONE, TEXTURE_DECODING, TEXTURE_DECODED, TEXTURE_RESIDENT };
+
+	struct Cell
+	{
+		vector<size_t> Objects;
+		vector<int32_t> Textures;               //Scene textures of the objects' materials
+		glm::vec3 Min = glm::vec3(0.0f);
+		glm::vec3 Max = glm::vec3(0.0f);
+		float Distance = 0.0f;
+		CellState State = CELL_UNLOADED;
+		bool Cancelled = false;                 //Unloaded while on the loader thread, its result is dropped
+		vector<std::shared_ptr<Mesh>> Meshes;   //One per object once built
+		size_t UploadedMeshes = 0;
+		size_t GeometryBytes = 0;               //Of the uploaded meshes
+	};
+
+	struct StreamedTexture
+	{
+		Texture2D Texture;
+		TextureState State = TEXTURE_NONE;
+		int Users = 0;                          //Cells loading or holding it
+		TextureResidency::DecodedTexture Decoded;
+	};
+
+	struct LoadJob
+	{
+		size_t Cell;
+		vector<size_t> Objects;
+		vector<int32_t> Textures;               //To decode, the ones no other cell has loaded or is loading
+	};
+
+	struct LoadResult
+	{
+		size_t Cell;
+		vector<std::shared_ptr<Mesh>> Meshes;
+		vector<std::pair<int32_t, TextureResidency::DecodedTexture>> Textures;
+	};
+
+	const Scene& scene;
+	TextureResidency& textureResidency;
+	MeshBuilder builder;
+	vector<Cell> cells;
+	vector<StreamedTexture> sceneTextures;
+	vector<Mesh*> residentMeshes;
+	int loadsInFlight = 0;
+
+	//Loader thread and its queues, guarded by mutex
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<LoadJob> jobs;
+	vector<LoadResult> results;
+	bool stopping = false;
+
+	void LoaderThread()
+	{
+		Mesh::DeferUploadOnThread = true;
+		while (true) {
+			LoadJob job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+				if (stopping) {
+					return;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			LoadResult result;
+			result.Cell = job.Cell;
+			for (size_t object : job.Objects) {
+				result.Meshes.push_back(builder(object));
+			}
+			for (int32_t texture : job.Textures) {
+				result.Textures.emplace_back(texture, TextureResidency::Decode(scene.String(scene.Textures[texture].Path)));
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			results.push_back(std::move(result));
+		}
+	}
+
+	void StopLoader()
+	{
+		if (!loader.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		loader.join();
+	}
+
+	//Takes the finished loads from the loader thread
+	void CollectLoads()
+	{
+		vector<LoadResult> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.swap(results);
+		}
+
+		for (LoadResult& result : finished) {
+			loadsInFlight--;
+			Cell& cell = cells[result.Cell];
+
+			//Decoded textures are kept if any cell still wants them, whoever asked first. One that failed to load counts as
+			//resident with no texture, as at startup, so its cells do not wait for it
+			for (auto& decoded : result.Textures) {
+				StreamedTexture& texture = sceneTextures[decoded.first];
+				if (texture.Users == 0) {
+					texture.State = TEXTURE_NONE;
+				}
+				else if (decoded.second.Levels.empty()) {
+					texture.State = TEXTURE_RESIDENT;
+				}
+				else {
+					texture.Decoded = std::move(decoded.second);
+					texture.State = TEXTURE_DECODED;
+				}
+			}
+
+			if (cell.Cancelled) {
+				cell.Cancelled = false;
+				cell.State = CELL_UNLOADED;
+				continue;
+			}
+
+			cell.Meshes = std::move(result.Meshes);
+			cell.UploadedMeshes = 0;
+			cell.State = CELL_BUILT;
+			for (const std::shared_ptr<Mesh>& mesh : cell.Meshes) {
+				if (mesh && mesh->BoundsRadius > 0.0f) {
+					cell.Min = glm::min(cell.Min, mesh->BoundsCenter - glm::vec3(mesh->BoundsRadius));
+					cell.Max = glm::max(cell.Max, mesh->BoundsCenter + glm::vec3(mesh->BoundsRadius));
+				}
+			}
+		}
+	}
+
+	//Queues the nearest unloaded cells in range
+	void StartLoads()
+	{
+		vector<size_t> wanted;
+		for (size_t i = 0; i < cells.size(); i++) {
+			if (cells[i].State == CELL_UNLOADED && !cells[i].Cancelled && cells[i].Distance <= LoadRadius) {
+				wanted.push_back(i);
+			}
+		}
+		std::sort(wanted.begin(), wanted.end(), [this](size_t a, size_t b) { return cells[a].Distance < cells[b].Distance; });
+
+		int started = 0;
+		for (size_t i : wanted) {
+			if (started == LoadsPerFrame || loadsInFlight == MaxLoadsInFlight) {
+				break;
+			}
+
+			Cell& cell = cells[i];
+			LoadJob job = { i, cell.Objects, {} };
+			for (int32_t texture : cell.Textures) {
+				StreamedTexture& streamed = sceneTextures[texture];
+				if (streamed.Users++ == 0 && streamed.State == TEXTURE_NONE) {
+					streamed.State = TEXTURE_DECODING;
+					job.Textures.push_back(texture);
+				}
+			}
+
+			cell.State = CELL_LOADING;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				jobs.push_back(std::move(job));
+			}
+			wake.notify_one();
+			loadsInFlight++;
+			started++;
+		}
+	}
+
+	//Uploads the built cells' textures and meshes, nearest cell first, and makes the complete ones resident
+	size_t Upload()
+	{
+		vector<Cell*> built;
+		for (Cell& cell : cells) {
+			if (cell.State == CELL_BUILT) {
+				built.push_back(&cell);
+			}
+		}
+		std::sort(built.begin(), built.end(), [](const Cell* a, const Cell* b) { return a->Distance < b->Distance; });
+
+		size_t uploaded = 0;
+		for (Cell* cell : built) {
+			bool texturesReady = true;
+			for (int32_t texture : cell->Textures) {
+				StreamedTexture& streamed = sceneTextures[texture];
+				if (streamed.State == TEXTURE_DECODED && uploaded < UploadBytesPerFrame) {
+					size_t before = textureResidency.TotalResidentBytes;
+					streamed.Texture = textureResidency.Upload(std::move(streamed.Decoded), scene.Textures[texture].RepeatU != 0, true);
+					streamed.Decoded = TextureResidency::DecodedTexture();
+					streamed.State = TEXTURE_RESIDENT;
+					uploaded += textureResidency.TotalResidentBytes - before;
+				}
+				texturesReady = texturesReady && streamed.State == TEXTURE_RESIDENT;
+			}
+
+			while (cell->UploadedMeshes < cell->Meshes.size() && uploaded < UploadBytesPerFrame) {
+				Mesh& mesh = *cell->Meshes[cell->UploadedMeshes];
+				size_t bytes = mesh.GeometryBytes();
+				if (ResidentGeometryBytes + bytes > GeometryBudgetBytes && !MakeRoom(bytes, cell->Distance)) {
+					break;
+				}
+
+				mesh.UploadDeferred();
+				mesh.UploadLods();
+				mesh.ReleaseGeometryData();
+				cell->GeometryBytes += bytes;
+				ResidentGeometryBytes += bytes;
+				uploaded += bytes;
+				cell->UploadedMeshes++;
+			}
+
+			if (texturesReady && cell->UploadedMeshes == cell->Meshes.size()) {
+				MakeResident(*cell);
+			}
+		}
+		return uploaded;
+	}
+
+	//Frees resident cells further away than distance, furthest first, until bytes more fit. False if that is not enough
+	bool MakeRoom(size_t bytes, float distance)
+	{
+		while (ResidentGeometryBytes + bytes > GeometryBudgetBytes) {
+			Cell* victim = nullptr;
+			for (Cell& cell : cells) {
+				if (cell.State == CELL_RESIDENT && cell.Distance > distance && (!victim || cell.Distance > victim->Distance)) {
+					victim = &cell;
+				}
+			}
+			if (!victim) {
+				return false;
+			}
+			Unload(*victim);
+		}
+		return true;
+	}
+
+	//Gives the uploaded meshes their materials and adds them to the drawn list
+	void MakeResident(Cell& cell)
+	{
+		auto texture = [this](int32_t index) { return index >= 0 ? sceneTextures[index].Texture : Texture2D(); };
+		for (size_t i = 0; i < cell.Objects.size(); i++) {
+			const SceneMaterial& material = scene.Materials[scene.Objects[cell.Objects[i]].Material];
+			Texture2D diffuse = texture(material.Diffuse);
+			Texture2D specular = texture(material.Specular);
+			diffuse.SetShininess(material.Shininess);
+			specular.SetShininess(material.Shininess);
+			cell.Meshes[i]->SetTextures(diffuse, specular);
+			if (material.OverlayDiffuse >= 0) {
+				cell.Meshes[i]->SetOverlayTextures(texture(material.OverlayDiffuse), texture(material.OverlaySpecular));
+			}
+			residentMeshes.push_back(cell.Meshes[i].get());
+		}
+		cell.State = CELL_RESIDENT;
+	}
+
+	//Frees a cell's meshes and its share of the textures. A cell on the loader thread is only marked, CollectLoads drops it
+	void Unload(Cell& cell)
+	{
+		if (cell.State == CELL_RESIDENT) {
+			residentMeshes.erase(std::remove_if(residentMeshes.begin(), residentMeshes.end(), [&cell](Mesh* mesh) {
+				for (const std::shared_ptr<Mesh>& owned : cell.Meshes) {
+					if (owned.get() == mesh) {
+						return true;
+					}
+				}
+				return false;
+			}), residentMeshes.end());
+		}
+
+		for (size_t i = 0; i < cell.UploadedMeshes; i++) {
+			cell.Meshes[i]->DeallocateVertexArrayBuffers();
+		}
+		ResidentGeometryBytes -= cell.GeometryBytes;
+		cell.GeometryBytes = 0;
+		cell.UploadedMeshes = 0;
+		cell.Meshes.clear();
+
+		for (int32_t texture : cell.Textures) {
+			StreamedTexture& streamed = sceneTextures[texture];
+			if (--streamed.Users > 0) {
+				continue;
+			}
+			if (streamed.State == TEXTURE_RESIDENT) {
+				textureResidency.Unload(streamed.Texture.Texture);
+				streamed.Texture = Texture2D();
+				streamed.State = TEXTURE_NONE;
+			}
+			else if (streamed.State == TEXTURE_DECODED) {
+				streamed.Decoded = TextureResidency::DecodedTexture();
+				streamed.State = TEXTURE_NONE;
+			}
+		}
+
+		if (cell.State == CELL_LOADING) {
+			cell.Cancelled = true;
+		}
+		else {
+			cell.State = CELL_UNLOADED;
+		}
+	}
+};
+
+#endif